@@ -73,7 +73,7 @@ int main(int argc, char *argv[])
     }
 
     /* Initialize the TCP-based RPC transport */
-    rv = raft_io_uv_tcp_init(&transport, &logger, &loop);
+    rv = raft_io_uv_tcp_init(&transport, &logger, &loop, NULL);
     if (rv != 0) {
         printf("error: init TCP transport: %s\n", raft_strerror(rv));
         return rv;
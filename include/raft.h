@@ -41,7 +41,9 @@ enum {
     RAFT_ERR_IO_MALFORMED,
     RAFT_ERR_IO_NOTEMPTY,
     RAFT_ERR_IO_TOOBIG,
-    RAFT_ERR_IO_CONNECT
+    RAFT_ERR_IO_CONNECT,
+    RAFT_ERR_OVERLOADED,
+    RAFT_ERR_LEADERSHIP_TRANSFER
 };
 
 /**
@@ -71,7 +73,9 @@ enum {
     X(RAFT_ERR_IO_MALFORMED, "encoded data is malformed")                \
     X(RAFT_ERR_IO_NOTEMPTY, "persisted log is not empty")                \
     X(RAFT_ERR_IO_TOOBIG, "encoded configuration is too big")            \
-    X(RAFT_ERR_IO_CONNECT, "no connection to remote server available")
+    X(RAFT_ERR_IO_CONNECT, "no connection to remote server available")  \
+    X(RAFT_ERR_OVERLOADED, "too many entries waiting to be applied")      \
+    X(RAFT_ERR_LEADERSHIP_TRANSFER, "leadership transfer in progress")
 
 /**
  * Return the error message describing the given error code.
@@ -121,6 +125,66 @@ void raft_heap_set(struct raft_heap *heap);
  */
 void raft_heap_set_default();
 
+/**
+ * Number of size classes of the slab heap. Class i serves requests of up to
+ * (16 << i) bytes, so the largest class holds blocks of 1 megabyte. Larger
+ * requests are passed straight through to the backend heap.
+ */
+#define RAFT_HEAP_SLAB_N_CLASSES 17
+
+/**
+ * Default number of bytes that the slab heap keeps cached in the freelist of
+ * each size class.
+ */
+#define RAFT_HEAP_SLAB_DEFAULT_MAX_CACHED (4 * 1024 * 1024)
+
+/**
+ * Usage statistics of a slab heap.
+ */
+struct raft_heap_slab_stats
+{
+    struct
+    {
+        unsigned long long n_alloc; /* Number of blocks handed out */
+        unsigned long long n_free;  /* Number of blocks given back */
+        unsigned long long n_hits;  /* Allocations served by the freelist */
+        unsigned n_cached;          /* Blocks currently in the freelist */
+    } classes[RAFT_HEAP_SLAB_N_CLASSES];
+    unsigned long long n_large; /* Allocations above the largest class */
+    unsigned long long n_backend; /* Allocations that hit the backend heap */
+};
+
+/**
+ * Initialize a @raft_heap that serves allocations out of per-size-class
+ * freelists, falling back to the given @backend heap (or to the stdlib if
+ * @backend is #NULL) only when a freelist is empty.
+ *
+ * This is meant for the buffers that raft allocates and releases at a steady
+ * rate, such as message headers, entries arrays and batch payloads received
+ * over the network or loaded from disk: once the freelists are warm, steady
+ * state replication doesn't need to call the backend allocator at all.
+ *
+ * Each size class keeps at most @max_cached bytes worth of free blocks (use 0
+ * for #RAFT_HEAP_SLAB_DEFAULT_MAX_CACHED), excess blocks are returned to the
+ * backend. Each freelist is protected by its own spinlock, so the heap can be
+ * installed with @raft_heap_set in multi-threaded programs.
+ */
+int raft_heap_slab_init(struct raft_heap *h,
+                        struct raft_heap *backend,
+                        size_t max_cached);
+
+/**
+ * Release all cached blocks back to the backend heap. All memory allocated
+ * with the given slab heap must have been released.
+ */
+void raft_heap_slab_close(struct raft_heap *h);
+
+/**
+ * Fill @stats with a snapshot of the usage statistics of the given slab heap.
+ */
+void raft_heap_slab_stats(struct raft_heap *h,
+                          struct raft_heap_slab_stats *stats);
+
 /**
  * Hold the value of a raft term. Guaranteed to be at least 64-bit long.
  */
@@ -210,18 +274,29 @@ struct raft_buffer
  */
 struct raft_server
 {
-    unsigned id;   /* Server ID, must be greater than zero. */
-    char *address; /* Server address. User defined. */
-    bool voting;   /* Whether this is a voting server. */
+    unsigned id;     /* Server ID, must be greater than zero. */
+    char *address;   /* Server address. User defined. */
+    bool voting;     /* Whether this is a voting server. */
+    bool voting_old; /* Whether it was voting in C_old, if joint. */
+    bool removed;    /* Whether it's not part of C_new, if joint. */
+    bool learner;    /* Whether this is a permanent non-voting server. */
 };
 
 /**
  * Hold information about all servers part of the cluster.
+ *
+ * The servers array must be modified only with @raft_configuration_add and
+ * @raft_configuration_remove, which also maintain a hash table mapping server
+ * IDs to their position in the array.
  */
 struct raft_configuration
 {
     struct raft_server *servers; /* Array of servers member of the cluster. */
     unsigned n;                  /* Number of servers in the array. */
+    unsigned *slots;             /* Hash table of positions in servers + 1. */
+    unsigned n_slots;            /* Size of the hash table, a power of 2. */
+    unsigned *ranks;             /* Voting servers preceding each server. */
+    unsigned n_voting;           /* Number of voting servers. */
 };
 
 void raft_configuration_init(struct raft_configuration *c);
@@ -356,10 +431,15 @@ struct raft_request_vote
     unsigned candidate_id;     /* ID of the server requesting the vote. */
     raft_index last_log_index; /* Index of candidate's last log entry. */
     raft_index last_log_term;  /* Term of log entry at last_log_index. */
+    bool disrupt_leader;       /* True if the leader asked for the election. */
 };
 
 /**
  * Hold the result of a RequestVote RPC (figure 3.1).
+ *
+ * The same structures are used for PreVote RPCs (Section §9.6), which are
+ * sent with the term the candidate would use in the real election and don't
+ * change the state of either side.
  */
 struct raft_request_vote_result
 {
@@ -394,6 +474,42 @@ struct raft_append_entries_result
     raft_index last_log_index; /* Receiver's last log entry index, as hint */
 };
 
+/**
+ * Hold the arguments of a ReadIndex RPC.
+ *
+ * The ReadIndex RPC is invoked by followers to learn the commit index of the
+ * leader, in order to serve linearizable reads locally (Section 6.4).
+ */
+struct raft_read_index
+{
+    raft_term term;        /* Follower's current term. */
+    unsigned long long id; /* Matched against the one of the result. */
+};
+
+/**
+ * Hold the result of a ReadIndex RPC.
+ */
+struct raft_read_index_result
+{
+    raft_term term;        /* Receiver's current_term. */
+    unsigned long long id; /* ID of the request being answered. */
+    bool success;          /* True if the receiver is the leader. */
+    raft_index index;      /* Leader's commit index, once confirmed. */
+};
+
+/**
+ * Hold the arguments of a TimeoutNow RPC.
+ *
+ * The TimeoutNow RPC is invoked by the leader to transfer leadership to a
+ * follower whose log is up-to-date (Section §3.10).
+ */
+struct raft_timeout_now
+{
+    raft_term term;            /* Leader's term. */
+    raft_index last_log_index; /* Index of leader's last log entry. */
+    raft_term last_log_term;   /* Term of log entry at last_log_index. */
+};
+
 /**
  * Type codes for raft I/O requests.
  */
@@ -403,7 +519,12 @@ enum {
     RAFT_IO_APPEND_ENTRIES,
     RAFT_IO_APPEND_ENTRIES_RESULT,
     RAFT_IO_REQUEST_VOTE,
-    RAFT_IO_REQUEST_VOTE_RESULT
+    RAFT_IO_REQUEST_VOTE_RESULT,
+    RAFT_IO_READ_INDEX,
+    RAFT_IO_READ_INDEX_RESULT,
+    RAFT_IO_PRE_VOTE,
+    RAFT_IO_PRE_VOTE_RESULT,
+    RAFT_IO_TIMEOUT_NOW
 };
 
 struct raft_message
@@ -416,6 +537,11 @@ struct raft_message
         struct raft_request_vote_result request_vote_result;
         struct raft_append_entries append_entries;
         struct raft_append_entries_result append_entries_result;
+        struct raft_read_index read_index;
+        struct raft_read_index_result read_index_result;
+        struct raft_request_vote pre_vote;
+        struct raft_request_vote_result pre_vote_result;
+        struct raft_timeout_now timeout_now;
     };
 };
 
@@ -538,6 +664,31 @@ struct raft_io
                 void *data,
                 void (*cb)(void *data, int status));
 
+    /**
+     * Return true if messages to the server with the given ID are piling up
+     * faster than they can be delivered.
+     *
+     * While a server is congested the leader stops sending it new entries and
+     * heartbeats, and resumes once the backlog drains. This method is optional
+     * and can be set to NULL, in which case no server is ever considered
+     * congested.
+     */
+    bool (*congested)(const struct raft_io *io, unsigned server_id);
+
+    /**
+     * Asynchronously run the given @work function in a thread other than the
+     * one driving the other methods of this interface, and invoke @cb back in
+     * the driving thread once done.
+     *
+     * This method is optional and can be set to NULL, in which case it won't
+     * be possible to apply committed commands in the background (see
+     * @raft_set_apply_in_background).
+     */
+    int (*queue_work)(const struct raft_io *io,
+                      void *data,
+                      void (*work)(void *data),
+                      void (*cb)(void *data, int status));
+
     /**
      * Synchronously delete all log entries from the given index onwards.
      */
@@ -550,13 +701,25 @@ struct raft_io
  */
 struct raft_fsm
 {
-    int version; /* API version implemented by this instance. Currently 1. */
+    int version; /* API version implemented by this instance. Currently 2. */
     void *data;  /* Custom user data. */
 
     /**
      * Apply a committed RAFT_LOG_COMMAND entry to the state machine.
      */
     int (*apply)(struct raft_fsm *fsm, const struct raft_buffer *buf);
+
+    /**
+     * Apply a span of @n contiguous committed RAFT_LOG_COMMAND entries to the
+     * state machine, in order. Either all or none of the commands must be
+     * applied.
+     *
+     * This method is optional and is used in place of @apply only if
+     * @version is at least 2 and it's not NULL.
+     */
+    int (*apply_batch)(struct raft_fsm *fsm,
+                       const struct raft_buffer bufs[],
+                       unsigned n);
 };
 
 /**
@@ -590,10 +753,10 @@ enum {
     RAFT_EVENT_STATE_CHANGE = 0,
 
     /**
-     * Fired when a log command was committed and applied.
+     * Fired when one or more log commands were committed and applied.
      *
-     * The event data is a pointer to a @raft_index holding the index of the log
-     * entry that was applied.
+     * The event data is a pointer to a @raft_index holding the index of the
+     * last log entry that was applied.
      */
     RAFT_EVENT_COMMAND_APPLIED,
 
@@ -621,6 +784,45 @@ enum {
  */
 #define RAFT_EVENT_N (RAFT_EVENT_PROMOTION_ABORTED + 1)
 
+/**
+ * Request to append new FSM commands to the log, see @raft_apply.
+ */
+struct raft_apply
+{
+    void *data;       /* User data */
+    raft_index index; /* Index of the first command, set by raft_apply() */
+    unsigned n;       /* Number of commands */
+
+    /* Fields below are private */
+    struct raft_apply *next;
+    void (*cb)(struct raft_apply *req, int status);
+};
+
+/**
+ * Linearizable read request, see @raft_read_index.
+ */
+struct raft_read
+{
+    void *data;       /* User data */
+    raft_index index; /* Read index, valid once the callback is invoked */
+
+    /* Fields below are private */
+    struct raft_read *next;
+    void (*cb)(struct raft_read *req, int status);
+};
+
+/**
+ * Counters that a leader keeps for each follower in order to confirm its
+ * leadership when serving linearizable reads.
+ */
+struct raft_read_peer
+{
+    unsigned n_sent;       /* AppendEntries sent in the current term */
+    unsigned n_acked;      /* Successful AppendEntries results received */
+    unsigned target;       /* Results needed to confirm the current round */
+    unsigned lease_target; /* Results needed to confirm the lease probe */
+};
+
 /**
  * Hold and drive the state of a single raft server in a cluster.
  */
@@ -737,6 +939,53 @@ struct raft
     raft_index commit_index; /* Highest log entry known to be committed */
     raft_index last_applied; /* Highest log entry applied to the FSM */
 
+    /**
+     * Whether committed commands are applied to the FSM using the @queue_work
+     * method of the I/O backend, and whether a batch of them is currently
+     * being applied that way.
+     */
+    bool apply_in_background;
+    bool applying;
+
+    /**
+     * Whether a leader serves reads locally while holding a lease, and the
+     * margin in milliseconds by which the lease is shortened to tolerate clock
+     * drift between servers (see @raft_set_read_lease).
+     */
+    bool read_lease;
+    unsigned read_lease_drift;
+
+    /**
+     * Maximum number of entries that a leader lets pile up in its log without
+     * being applied before rejecting new ones, or 0 for no limit (see
+     * @raft_set_max_pending_entries).
+     */
+    unsigned max_pending_entries;
+
+    /**
+     * Whether followers whose election timeout elapses first run a PreVote
+     * round before starting a real election (see @raft_set_pre_vote).
+     */
+    bool pre_vote;
+
+    /**
+     * Whether a leader steps down when it doesn't hear from a majority of the
+     * cluster within an election timeout (see @raft_set_check_quorum).
+     */
+    bool check_quorum;
+
+    /**
+     * Whether entries are sent to learners only along with heartbeats (see
+     * @raft_set_lazy_learners).
+     */
+    bool lazy_learners;
+
+    /**
+     * ID of the last ReadIndex RPC sent to the leader when serving reads as
+     * follower. It's never reset, so stale results can't be mistaken.
+     */
+    unsigned long long read_id;
+
     /**
      * Current server state of this raft instance, along with a union defining
      * state-specific values.
@@ -750,6 +999,22 @@ struct raft
              * which is specific to followers.
              */
             unsigned current_leader_id;
+
+            /**
+             * Fields used to serve linearizable reads by asking the leader for
+             * its read index.
+             */
+            unsigned read_timer;               /* Time since RPC was sent */
+            struct raft_read *reads;           /* Waiting for the next RPC */
+            struct raft_read *reads_sent;      /* Waiting for the result */
+            struct raft_read *reads_confirmed; /* Waiting to be applied */
+
+            /**
+             * Time since an AppendEntries RPC from the leader was accepted
+             * with a commit index not greater than ours, used to bound the
+             * staleness of local reads.
+             */
+            unsigned commit_timer;
         } follower_state;
 
         struct
@@ -759,7 +1024,9 @@ struct raft
              * which is specific to candidates. This state is reinitialized
              * after the server starts a new election round.
              */
-            bool *votes; /* For each server, whether vote was granted */
+            bool *votes;      /* For each server, whether vote was granted */
+            bool in_pre_vote; /* Whether the votes are PreVote results */
+            bool disrupt_leader; /* Whether the leader asked to time out */
         } candidate_state;
 
         struct
@@ -771,15 +1038,65 @@ struct raft
              */
             raft_index *next_index;  /* For each server, next entry to send */
             raft_index *match_index; /* For each server, highest applied idx */
+            raft_index *match_sorted; /* Scratch space to compute quorums */
+            unsigned *last_contact;   /* For each server, clock of last reply */
 
             /**
              * Fields used to track the progress of pushing entries to the
-             * server being promoted (4.2.1 Catching up new servers).
+             * server being promoted (4.2.1 Catching up new servers). Rates
+             * are in entries per second, sampled once per heartbeat timeout
+             * and smoothed across samples.
              */
-            unsigned promotee_id;        /* ID of server being promoted, or 0 */
-            unsigned short round_number; /* Number of the current sync round */
-            raft_index round_index;      /* Target of the current round */
-            unsigned round_duration;     /* Duration of the current round */
+            unsigned promotee_id;       /* ID of server being promoted, or 0 */
+            raft_index catch_up_match;  /* Promotee match index at sample */
+            raft_index catch_up_last;   /* Leader last index at sample */
+            raft_index catch_up_sent;   /* Last index sent to the promotee */
+            unsigned catch_up_elapsed;  /* Time since the last sample */
+            unsigned catch_up_idle;     /* Time since the promotee progressed */
+            unsigned catch_up_samples;  /* Number of samples taken so far */
+            unsigned catch_up_apply_rate;  /* Promotee replication rate */
+            unsigned catch_up_append_rate; /* Leader append rate */
+
+            /**
+             * Fields used to track the progress of transferring leadership to
+             * another server (3.10 Leadership transfer extension).
+             */
+            unsigned transferee_id;     /* ID of target server, or 0 */
+            unsigned transfer_duration; /* Time since the transfer started */
+            bool transfer_sent;         /* Whether TimeoutNow was sent */
+
+            /**
+             * Fields used to serve linearizable reads (6.4 Processing
+             * read-only queries more efficiently).
+             */
+            struct raft_read_peer *read_peers; /* For each server, counters */
+            struct raft_read *reads;           /* Waiting for the next round */
+            struct raft_read *reads_round;     /* Confirming leadership */
+            struct raft_read *reads_confirmed; /* Waiting to be applied */
+
+            /**
+             * Requests submitted with raft_apply() whose commands haven't
+             * been applied yet, in log order.
+             */
+            struct raft_apply *applies;      /* Oldest request */
+            struct raft_apply *applies_tail; /* Newest request */
+
+            /**
+             * Fields used to hold a read lease (6.4.1 Using clocks to reduce
+             * messaging for read-only queries). Times are in milliseconds
+             * elapsed since the server was elected.
+             */
+            unsigned clock;       /* Time elapsed since the election */
+            unsigned lease_start; /* Start of the last confirmed probe */
+            unsigned lease_probe; /* Start of the current probe */
+            bool lease_valid;     /* Whether lease_start was ever set */
+            bool lease_probing;   /* Whether a probe is in progress */
+
+            /**
+             * Time at which learners were last sent entries, used when they
+             * are replicated to lazily.
+             */
+            unsigned learners_sent;
         } leader_state;
     };
 
@@ -800,6 +1117,23 @@ struct raft
      */
     unsigned election_timeout_rand;
 
+    /**
+     * How much this server should be favored in elections (see
+     * @raft_set_election_priority).
+     */
+    unsigned election_priority;
+
+    /**
+     * Fields used to adapt the election timeout to the observed interval
+     * between heartbeats (see @raft_set_adaptive_election_timeout). Intervals
+     * are smoothed like TCP round-trip times (RFC 6298).
+     */
+    bool election_adaptive;
+    unsigned election_timeout_min;      /* Lower bound of the timeout */
+    unsigned election_timeout_adaptive; /* Current timeout, 0 if unknown */
+    unsigned heartbeat_interval;        /* Smoothed heartbeat interval */
+    unsigned heartbeat_jitter;          /* Smoothed interval deviation */
+
     /**
      * For followers and candidates, time elapsed since the last election
      * started, in millisecond. For leaders time elapsed since the last
@@ -885,6 +1219,140 @@ void raft_set_rand(struct raft *r, int (*rand)());
  */
 void raft_set_election_timeout(struct raft *r, const unsigned election_timeout);
 
+/**
+ * Favor this server in elections.
+ *
+ * The randomized election timeout is normally drawn uniformly from
+ * [election_timeout, 2 * election_timeout). With a non-zero @priority the
+ * random part is divided by @priority + 1, so servers with higher priority
+ * tend to time out, and hence get elected, first. The timeout never drops
+ * below @election_timeout, so a healthy leader is never disrupted.
+ *
+ * Servers sharing the same high priority have a narrower window to draw from,
+ * so give it to one or two servers only, to keep split votes rare.
+ */
+void raft_set_election_priority(struct raft *r, unsigned priority);
+
+/**
+ * Adapt the election timeout to the measured network conditions.
+ *
+ * When enabled, followers measure the interval between consecutive
+ * AppendEntries RPCs from the leader, which accounts for both the heartbeat
+ * timeout and for network delays and their jitter. The election timeout is
+ * then set to twice the smoothed interval plus four times its smoothed
+ * deviation, so that a single lost heartbeat doesn't trigger an election, and
+ * clamped between @min and the configured election timeout. On low-latency
+ * networks this speeds up failover, while slow networks fall back to the
+ * configured value.
+ *
+ * This setting must be the same on all servers of the cluster. Read leases
+ * (see @raft_set_read_lease) rely on followers not timing out before the
+ * leader's lease expires, and a leader with adaptive timeouts enabled bounds
+ * its lease by @min instead of the configured election timeout.
+ *
+ * This must be called before @raft_start.
+ */
+void raft_set_adaptive_election_timeout(struct raft *r,
+                                        bool enabled,
+                                        unsigned min);
+
+/**
+ * Apply committed commands to the FSM in a background thread instead of the
+ * one driving the I/O backend, which must implement the @queue_work method.
+ * Only one batch of commands at a time is applied in the background, and
+ * @last_applied is updated in the driving thread once it completes.
+ *
+ * This must be called before @raft_start.
+ */
+void raft_set_apply_in_background(struct raft *r, bool enabled);
+
+/**
+ * Serve reads submitted with @raft_read_index locally, without waiting for a
+ * round of heartbeats, as long as the leader holds a lease.
+ *
+ * With every heartbeat the leader records the time it was sent, and once a
+ * majority of the cluster acknowledges it the lease is extended to that time
+ * plus the election timeout minus @drift milliseconds. Followers don't start
+ * elections nor grant votes for at least an election timeout after hearing
+ * from the leader, so no other leader can be elected before the lease
+ * expires, provided that clocks don't drift by more than @drift over that
+ * period.
+ *
+ * The guarantee only holds if the election timeout of every follower is at
+ * least the one of the leader, so timeouts must be configured the same way on
+ * all servers of the cluster. In particular if followers have adaptive
+ * election timeouts enabled (see @raft_set_adaptive_election_timeout), the
+ * leader must enable them with the same minimum too, which then bounds the
+ * lease, and @drift must be lower than that minimum.
+ *
+ * This must be called before @raft_start.
+ */
+void raft_set_read_lease(struct raft *r, bool enabled, unsigned drift);
+
+/**
+ * Limit the number of entries that can be waiting in the leader's log to be
+ * committed and applied. Once the limit is reached, @raft_accept and
+ * @raft_apply fail with #RAFT_ERR_OVERLOADED until the FSM catches up, giving
+ * clients a chance to back off instead of growing the log without bounds.
+ *
+ * The default is 0, meaning no limit.
+ */
+void raft_set_max_pending_entries(struct raft *r, unsigned n);
+
+/**
+ * Run a PreVote round before starting an election.
+ *
+ * When enabled, a follower whose election timeout elapses becomes candidate
+ * without incrementing its term or persisting anything, and asks the other
+ * servers whether they would vote for it in the next term. Servers that have
+ * a leader, or whose log is more up-to-date, refuse. Only once a majority
+ * agrees the candidate increments its term and starts the real election, so a
+ * server rejoining after a partition can't force the current leader to step
+ * down.
+ *
+ * From Section §9.6:
+ *
+ *   The Pre-Vote algorithm solves the issue of a partitioned server disrupting
+ *   the cluster when it rejoins. [...] a candidate would first ask other
+ *   servers whether its log was up-to-date enough to get their vote. Only if
+ *   the candidate believed it could get votes from a majority of the cluster
+ *   would it increment its term and start a normal election.
+ *
+ * This must be called before @raft_start.
+ */
+void raft_set_pre_vote(struct raft *r, bool enabled);
+
+/**
+ * Make the leader step down if it doesn't receive AppendEntries results from
+ * a majority of voting servers within an election timeout.
+ *
+ * An isolated leader would otherwise keep accepting entries that can't be
+ * committed until it hears from the new leader. Stepping down fails pending
+ * requests and reads right away, so clients can retry against the rest of
+ * the cluster.
+ *
+ * From Section §6.2:
+ *
+ *   If an election timeout elapses without a successful round of heartbeats to
+ *   a majority of its cluster, the leader steps down. This allows clients to
+ *   retry their requests with another server.
+ *
+ * This must be called before @raft_start.
+ */
+void raft_set_check_quorum(struct raft *r, bool enabled);
+
+/**
+ * Replicate new entries to learners only when sending heartbeats.
+ *
+ * Leaders always serve voting servers before learners, but by default every
+ * new entry is sent to learners right away. When this is enabled, learners
+ * get new entries in batches every heartbeat timeout instead, which bounds
+ * the work they cost to the leader regardless of the write rate, at the price
+ * of lagging behind by up to a heartbeat timeout. Learners being promoted are
+ * always replicated to right away.
+ */
+void raft_set_lazy_learners(struct raft *r, bool enabled);
+
 /**
  * If the most recent raft_* API call associated with the given raft instance
  * failed, return a human-readable description of the reason of the failure.
@@ -923,16 +1391,135 @@ int raft_accept(struct raft *r,
                 const struct raft_buffer bufs[],
                 const unsigned n);
 
+/**
+ * Same as @raft_accept, but invoke the @cb callback once the commands have been
+ * applied to the FSM.
+ *
+ * If this function returns 0, the index of the first new entry is stored in
+ * the @index field of @req. The callback is invoked with a status of 0 once
+ * all the @n commands have been applied, or with #RAFT_ERR_NOT_LEADER if
+ * leadership is lost before that, in which case the commands might or might
+ * not eventually be committed by the next leader.
+ */
+int raft_apply(struct raft *r,
+               struct raft_apply *req,
+               const struct raft_buffer bufs[],
+               const unsigned n,
+               void (*cb)(struct raft_apply *req, int status));
+
+/**
+ * Perform a linearizable read without appending anything to the log, using
+ * the ReadIndex protocol described in Section 6.4.
+ *
+ * If this server is the leader, the current commit index is recorded as read
+ * index and leadership is confirmed by a round of heartbeats acknowledged by a
+ * majority of the cluster. Once the FSM has applied all entries up to the read
+ * index the @cb callback is invoked with a status of 0, and the FSM can be
+ * queried. All reads submitted while a round is in progress are batched
+ * together in the next one.
+ *
+ * If read leases are enabled (see @raft_set_read_lease) and the leader holds a
+ * valid lease, no round is needed and the read is confirmed right away.
+ *
+ * Reads are held until the leader has committed an entry in its current term,
+ * since before that it doesn't know the latest commit index. If leadership is
+ * lost, pending reads fail with #RAFT_ERR_NOT_LEADER.
+ *
+ * If this server is a follower that knows the current leader, reads are
+ * batched in a ReadIndex RPC asking the leader for its read index, and the
+ * callback is invoked once the local FSM has applied entries up to it. If the
+ * leader doesn't answer within an election timeout, or a new leader is
+ * discovered, the RPC is sent again. Pending reads fail with
+ * #RAFT_ERR_NOT_LEADER if the follower starts an election.
+ */
+int raft_read_index(struct raft *r,
+                    struct raft_read *req,
+                    void (*cb)(struct raft_read *req, int status));
+
+/**
+ * Perform a read that tolerates returning data at most @max_staleness
+ * milliseconds older than the leader's.
+ *
+ * If this server is a follower which accepted an AppendEntries RPC at most
+ * @max_staleness milliseconds ago, whose log matched the leader's and whose
+ * commit index was up to date with it, and which has applied all entries it
+ * knows to be committed, the callback is invoked immediately with the last applied
+ * index as read index. Otherwise this is the same as @raft_read_index.
+ */
+int raft_read_stale(struct raft *r,
+                    struct raft_read *req,
+                    unsigned max_staleness,
+                    void (*cb)(struct raft_read *req, int status));
+
 /**
  * Add a new non-voting server to the cluster configuration.
  */
 int raft_add_server(struct raft *r, const unsigned id, const char *address);
 
+/**
+ * Add a new learner to the cluster configuration.
+ *
+ * A learner is a non-voting server that is meant to stay such, for example to
+ * serve reads with @raft_read_index or @raft_read_stale. Like other
+ * non-voting servers it receives all entries but it's not part of any
+ * majority, so it doesn't affect commit latency or availability. It can still
+ * be promoted with @raft_promote.
+ */
+int raft_add_learner(struct raft *r, const unsigned id, const char *address);
+
 /**
  * Promote the given new non-voting server to be a voting one.
  */
 int raft_promote(struct raft *r, const unsigned id);
 
+/**
+ * Replace the current configuration with the given one in a single step.
+ *
+ * If the set of voting servers changes, the leader first appends a joint
+ * configuration entry (C_old,new), where servers of both the current and the
+ * given configuration are present and both a majority of the old voting
+ * servers and a majority of the new ones are needed for elections and
+ * commitment. Once the joint configuration is committed the leader appends the
+ * given configuration (C_new), and the change is complete when that is
+ * committed. Voting servers of the current configuration which are absent from
+ * the new one are removed, and so are non-voting servers.
+ *
+ * From Section §4.3:
+ *
+ *   Once the joint consensus has been committed, the system then transitions
+ *   to the new configuration.
+ *
+ * The configuration must contain at least one voting server, otherwise
+ * #RAFT_ERR_EMPTY_CONFIGURATION is returned. New voting servers start with an
+ * empty log and the cluster can't commit new entries until a majority of them
+ * has caught up, so they should first be added as non-voting servers with
+ * @raft_add_server and be given some time to catch up.
+ *
+ * The @configuration object is copied and can be released after this function
+ * returns.
+ */
+int raft_change_configuration(struct raft *r,
+                              const struct raft_configuration *configuration);
+
+/**
+ * Transfer leadership to the voting server with the given ID.
+ *
+ * The leader stops accepting new entries, which fail with
+ * #RAFT_ERR_LEADERSHIP_TRANSFER, and replicates its log to the target server.
+ * Once the target has caught up, the leader sends it a TimeoutNow RPC, which
+ * makes it start an election right away instead of waiting for its election
+ * timeout. If the transfer doesn't complete within an election timeout, the
+ * leader resumes accepting entries.
+ *
+ * From Section §3.10:
+ *
+ *   Prior to the transfer, the leader's log must be up to date with the target
+ *   server [...] then the prior leader sends a TimeoutNow request to the target
+ *   server. This request has the same effect as the target server's election
+ *   timer firing.
+ */
+int raft_transfer_leadership(struct raft *r, const unsigned id);
+
 /**
  * Remove the given server from the cluster configuration.
  */
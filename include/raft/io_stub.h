@@ -58,6 +58,12 @@ void raft_io_stub_appended(struct raft_io *io,
  */
 void raft_io_stub_fault(struct raft_io *io, int delay, int repeat);
 
+/**
+ * Report the server with the given ID as congested, or clear any congestion if
+ * @id is 0.
+ */
+void raft_io_stub_congested(struct raft_io *io, unsigned id);
+
 /**
  * Convenience for getting the current term stored in the stub.
  */
@@ -1,11 +1,21 @@
 #ifndef RAFT_IO_UV_H
 #define RAFT_IO_UV_H
 
+#include <stdbool.h>
+
 #include <uv.h>
 
 #define RAFT_IO_UV_METADATA_SIZE (8 * 5)              /* Five 64-bit words */
 #define RAFT_IO_UV_MAX_SEGMENT_SIZE (8 * 1024 * 1024) /* 8 Megabytes */
 
+/**
+ * Default thresholds for the number of outstanding bytes queued for a single
+ * server. A server is reported as congested once the high watermark is reached
+ * and stops being so once the backlog drains down to the low watermark.
+ */
+#define RAFT_IO_UV_HIGH_WATERMARK (32 * 1024 * 1024) /* 32 Megabytes */
+#define RAFT_IO_UV_LOW_WATERMARK (8 * 1024 * 1024)   /* 8 Megabytes */
+
 struct raft_logger;
 struct raft_io;
 
@@ -67,15 +77,49 @@ struct raft_io_uv_transport
                    void (*cb)(void *data, int status));
 };
 
+/**
+ * Socket options applied by the TCP transport to the listening socket and to
+ * every connection. Zero values leave the kernel defaults in place.
+ */
+struct raft_io_uv_tcp_options
+{
+    bool nodelay;              /* Disable Nagle's algorithm (TCP_NODELAY) */
+    unsigned send_buffer_size; /* Size of the send buffer (SO_SNDBUF) */
+    unsigned recv_buffer_size; /* Size of the receive buffer (SO_RCVBUF) */
+    unsigned keepalive;        /* Idle seconds before keepalive probes */
+    unsigned user_timeout;     /* Milliseconds before dropping unacked data */
+};
+
 /**
  * Init a transport interface that uses TCP sockets.
+ *
+ * Server addresses have the form "host:port", where host is an IPv4 address,
+ * an IPv6 address enclosed in square brackets or a hostname. Hostnames are
+ * resolved asynchronously when connecting, and the result is cached until a
+ * connection attempt to that address fails. If the port is omitted, 8080 is
+ * used.
+ *
+ * If @options is #NULL, TCP_NODELAY is set and everything else is left to the
+ * kernel defaults.
  */
 int raft_io_uv_tcp_init(struct raft_io_uv_transport *t,
                         struct raft_logger *logger,
-                        struct uv_loop_s *loop);
+                        struct uv_loop_s *loop,
+                        const struct raft_io_uv_tcp_options *options);
 
 void raft_io_uv_tcp_close(struct raft_io_uv_transport *t);
 
+/**
+ * Init a transport interface that uses Unix domain sockets. Server addresses
+ * are interpreted as filesystem paths. This avoids the TCP/IP stack overhead
+ * when all servers run on the same host.
+ */
+int raft_io_uv_unix_init(struct raft_io_uv_transport *t,
+                         struct raft_logger *logger,
+                         struct uv_loop_s *loop);
+
+void raft_io_uv_unix_close(struct raft_io_uv_transport *t);
+
 /**
  * Configure the given @raft_io instance to use a libuv-based I/O
  * implementation.
@@ -151,4 +195,38 @@ int raft_io_uv_init(struct raft_io *io,
 
 void raft_io_uv_close(struct raft_io *io);
 
+/**
+ * Change the thresholds used to decide whether a server is congested. The
+ * @low watermark must be lower than the @high one.
+ */
+void raft_io_uv_set_watermarks(struct raft_io *io, size_t low, size_t high);
+
+/**
+ * Open @n additional connections to each server for AppendEntries messages
+ * carrying entries. All other messages, including heartbeats, use a dedicated
+ * connection, so they never queue up behind a large batch of entries. Entries
+ * for a server stick to one of the additional connections, so they arrive in
+ * order, and move to another one only if it gets disconnected while it has
+ * nothing outstanding. The default is 0, meaning that a single connection
+ * carries all messages.
+ */
+void raft_io_uv_set_stripes(struct raft_io *io, unsigned n);
+
+/**
+ * Protect outgoing messages with CRC32C checksums of their header and payload,
+ * which the receiving server verifies before processing them, dropping the
+ * connection on mismatch. Checksums are only sent to servers that advertise
+ * support for them. The default is false.
+ */
+void raft_io_uv_set_checksums(struct raft_io *io, bool enabled);
+
+/**
+ * Compress the entries data of outgoing AppendEntries messages with LZ4 when
+ * it's at least @threshold bytes long, and only if that makes it smaller. The
+ * receiving server decompresses it straight into the buffer that holds the
+ * entries. Compressed data is only sent to servers that advertise support for
+ * it. The default is 0, meaning that compression is disabled.
+ */
+void raft_io_uv_set_compression(struct raft_io *io, size_t threshold);
+
 #endif /* RAFT_IO_UV_H */
@@ -6,6 +6,7 @@
 #define RAFT_BINARY_H
 
 #include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 
 #if RAFT_COVERAGE
@@ -73,15 +74,20 @@ RAFT_INLINE void raft__put8(void **cursor, uint8_t value)
     *cursor += sizeof(uint8_t);
 }
 
+/* The cursor of the put and get functions below doesn't need to be aligned:
+ * words are copied with memcpy, which compiles to a plain load or store on
+ * platforms that support unaligned access. */
+
 RAFT_INLINE void raft__put32(void **cursor, uint32_t value)
 {
-    *(uint32_t *)(*cursor) = value;
+    memcpy(*cursor, &value, sizeof value);
     *cursor += sizeof(uint32_t);
 }
 
 RAFT_INLINE void raft__put64(void **cursor, uint64_t value)
 {
-    *(uint64_t *)(*cursor) = raft__flip64(value);
+    value = raft__flip64(value);
+    memcpy(*cursor, &value, sizeof value);
     *cursor += sizeof(uint64_t);
 }
 
@@ -94,14 +100,18 @@ RAFT_INLINE uint8_t raft__get8(const void **cursor)
 
 RAFT_INLINE uint32_t raft__get32(const void **cursor)
 {
-    uint32_t value = raft__flip32(*(uint32_t *)(*cursor));
+    uint32_t value;
+    memcpy(&value, *cursor, sizeof value);
+    value = raft__flip32(value);
     *cursor += sizeof(uint32_t);
     return value;
 }
 
 RAFT_INLINE uint64_t raft__get64(const void **cursor)
 {
-    uint64_t value = raft__flip64(*(uint64_t *)(*cursor));
+    uint64_t value;
+    memcpy(&value, *cursor, sizeof value);
+    value = raft__flip64(value);
     *cursor += sizeof(uint64_t);
     return value;
 }
@@ -12,4 +12,13 @@
  */
 unsigned raft__crc32(const void *buf, const size_t size, const unsigned init);
 
+/**
+ * Calculate the CRC32C (Castagnoli) checksum of the given data buffer, using
+ * the SSE4.2 crc32 instruction when the CPU supports it.
+ *
+ * The @init value is the checksum of the data preceding @buf, or 0, so the
+ * checksum of several buffers can be computed by chaining calls.
+ */
+unsigned raft__crc32c(const void *buf, const size_t size, const unsigned init);
+
 #endif /* RAFT_CHECKSUM_H */
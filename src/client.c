@@ -4,14 +4,21 @@
 #include "configuration.h"
 #include "log.h"
 #include "membership.h"
+#include "proposal.h"
+#include "read.h"
 #include "replication.h"
 #include "state.h"
 
-int raft_accept(struct raft *r,
-                const struct raft_buffer bufs[],
-                const unsigned n)
+/**
+ * Append the given commands to the log and start replicating them, setting
+ * @index to the index of the first one.
+ */
+static int raft_client__append(struct raft *r,
+                               const struct raft_buffer bufs[],
+                               const unsigned n,
+                               raft_index *index)
 {
-    raft_index index;
+    raft_index last_index;
     int rv;
 
     assert(r != NULL);
@@ -23,10 +30,25 @@ int raft_accept(struct raft *r,
         goto err;
     }
 
+    /* The target of a leadership transfer must be able to catch up with our
+     * log. */
+    if (r->leader_state.transferee_id != 0) {
+        rv = RAFT_ERR_LEADERSHIP_TRANSFER;
+        goto err;
+    }
+
     raft_debugf(r->logger, "client request: %d entries", n);
 
+    last_index = raft_log__last_index(&r->log);
+
+    if (r->max_pending_entries > 0 &&
+        last_index - r->last_applied >= r->max_pending_entries) {
+        rv = RAFT_ERR_OVERLOADED;
+        goto err;
+    }
+
     /* Index of the first entry being appended. */
-    index = raft_log__last_index(&r->log) + 1;
+    *index = last_index + 1;
 
     /* Append the new entries to the log. */
     rv = raft_log__append_commands(&r->log, r->current_term, bufs, n);
@@ -34,7 +56,7 @@ int raft_accept(struct raft *r,
         goto err;
     }
 
-    rv = raft_replication__trigger(r, index);
+    rv = raft_replication__trigger(r, *index);
     if (rv != 0) {
         goto err_after_log_append;
     }
@@ -42,7 +64,7 @@ int raft_accept(struct raft *r,
     return 0;
 
 err_after_log_append:
-    raft_log__discard(&r->log, index);
+    raft_log__discard(&r->log, *index);
 
 err:
     assert(rv != 0);
@@ -50,56 +72,48 @@ err:
     return rv;
 }
 
-static int raft_client__change_configuration(
-    struct raft *r,
-    const struct raft_configuration *configuration)
+int raft_accept(struct raft *r,
+                const struct raft_buffer bufs[],
+                const unsigned n)
 {
     raft_index index;
-    raft_term term = r->current_term;
-    int rv;
-
-    /* Index of the entry being appended. */
-    index = raft_log__last_index(&r->log) + 1;
 
-    /* Encode the new configuration and append it to the log. */
-    rv = raft_log__append_configuration(&r->log, term, configuration);
-    if (rv != 0) {
-        goto err;
-    }
+    return raft_client__append(r, bufs, n, &index);
+}
 
-    if (configuration->n != r->configuration.n) {
-        rv = raft_state__rebuild_next_and_match_indexes(r, configuration);
-        if (rv != 0) {
-            goto err;
-        }
-    }
+int raft_apply(struct raft *r,
+               struct raft_apply *req,
+               const struct raft_buffer bufs[],
+               const unsigned n,
+               void (*cb)(struct raft_apply *req, int status))
+{
+    raft_index index;
+    int rv;
 
-    /* Update the current configuration if we've created a new object. */
-    if (configuration != &r->configuration) {
-        raft_configuration_close(&r->configuration);
-        r->configuration = *configuration;
-    }
+    assert(req != NULL);
+    assert(cb != NULL);
 
-    /* Start writing the new log entry to disk and send it to the followers. */
-    rv = raft_replication__trigger(r, index);
+    rv = raft_client__append(r, bufs, n, &index);
     if (rv != 0) {
-        /* TODO: restore the old next/match indexes and configuration. */
-        goto err_after_log_append;
+        return rv;
     }
 
-    r->configuration_uncommitted_index = index;
+    req->index = index;
+    req->n = n;
+    req->cb = cb;
 
-    return 0;
-
-err_after_log_append:
-    raft_log__truncate(&r->log, index);
+    raft_proposal__push(r, req);
 
-err:
-    assert(rv != 0);
-    return rv;
+    return 0;
 }
 
-int raft_add_server(struct raft *r, const unsigned id, const char *address)
+/**
+ * Add a new non-voting server, possibly flagged as learner.
+ */
+static int raft_client__add_server(struct raft *r,
+                                   const unsigned id,
+                                   const char *address,
+                                   const bool learner)
 {
     struct raft_configuration configuration;
     int rv;
@@ -109,7 +123,8 @@ int raft_add_server(struct raft *r, const unsigned id, const char *address)
         return rv;
     }
 
-    raft_debugf(r->logger, "add server: id %d, address %s", id, address);
+    raft_debugf(r->logger, "add %s: id %d, address %s",
+                learner ? "learner" : "server", id, address);
 
     /* Make a copy of the current configuration, and add the new server to
      * it. */
@@ -125,7 +140,9 @@ int raft_add_server(struct raft *r, const unsigned id, const char *address)
         goto err_after_configuration_copy;
     }
 
-    rv = raft_client__change_configuration(r, &configuration);
+    configuration.servers[configuration.n - 1].learner = learner;
+
+    rv = raft_membership__change_configuration(r, &configuration);
     if (rv != 0) {
         goto err_after_configuration_copy;
     }
@@ -140,6 +157,16 @@ err:
     return rv;
 }
 
+int raft_add_server(struct raft *r, const unsigned id, const char *address)
+{
+    return raft_client__add_server(r, id, address, false);
+}
+
+int raft_add_learner(struct raft *r, const unsigned id, const char *address)
+{
+    return raft_client__add_server(r, id, address, true);
+}
+
 int raft_promote(struct raft *r, const unsigned id)
 {
     const struct raft_server *server;
@@ -171,26 +198,27 @@ int raft_promote(struct raft *r, const unsigned id)
     if (r->leader_state.match_index[server_index] == last_index) {
         /* The log of this non-voting server is already up-to-date, so we can
          * ask its promotion immediately. */
+        bool learner = server->learner;
+
         r->configuration.servers[server_index].voting = true;
+        r->configuration.servers[server_index].learner = false;
+        raft_configuration__update_voting(&r->configuration);
 
-        rv = raft_client__change_configuration(r, &r->configuration);
+        rv = raft_membership__change_configuration(r, &r->configuration);
         if (rv != 0) {
             r->configuration.servers[server_index].voting = false;
+            r->configuration.servers[server_index].learner = learner;
+            raft_configuration__update_voting(&r->configuration);
             return rv;
         }
 
         return 0;
     }
 
-    r->leader_state.promotee_id = server->id;
+    raft_membership__catch_up_start(r, server->id);
 
-    /* Initialize the first catch-up round. */
-    r->leader_state.round_number = 1;
-    r->leader_state.round_index = last_index;
-    r->leader_state.round_duration = 0;
-
-    /* Immediately initiate an AppendEntries request. */
-    rv = raft_replication__send_append_entries(r, server_index);
+    /* Immediately start streaming entries to the server. */
+    rv = raft_replication__catch_up(r, false);
     if (rv != 0) {
         /* This error is not fatal. */
         raft_warnf(r->logger,
@@ -206,6 +234,126 @@ err:
     return rv;
 }
 
+int raft_change_configuration(struct raft *r,
+                              const struct raft_configuration *configuration)
+{
+    struct raft_configuration next;
+    size_t i;
+    int rv;
+
+    assert(configuration != NULL);
+    assert(!raft_configuration__is_joint(configuration));
+
+    rv = raft_membership__can_change_configuration(r);
+    if (rv != 0) {
+        return rv;
+    }
+
+    if (raft_configuration__n_voting(configuration) == 0) {
+        rv = RAFT_ERR_EMPTY_CONFIGURATION;
+        goto err;
+    }
+
+    raft_debugf(r->logger, "change configuration: %u servers",
+                configuration->n);
+
+    raft_configuration_init(&next);
+
+    rv = raft_configuration__joint(&r->configuration, configuration, &next);
+    if (rv != 0) {
+        goto err_after_configuration_init;
+    }
+
+    /* If no server changes its voting status, only non-voting servers are
+     * being added or removed and quorums are not affected, so the new
+     * configuration can be used directly. */
+    for (i = 0; i < next.n; i++) {
+        if (next.servers[i].voting != next.servers[i].voting_old) {
+            break;
+        }
+    }
+    if (i == next.n) {
+        for (i = 0; i < next.n; i++) {
+            next.servers[i].voting_old = false;
+        }
+        raft_configuration__update_voting(&next);
+    }
+
+    rv = raft_membership__change_configuration(r, &next);
+    if (rv != 0) {
+        goto err_after_configuration_init;
+    }
+
+    return 0;
+
+err_after_configuration_init:
+    raft_configuration_close(&next);
+
+err:
+    assert(rv != 0);
+    return rv;
+}
+
+int raft_transfer_leadership(struct raft *r, const unsigned id)
+{
+    const struct raft_server *server;
+    size_t server_index;
+    int rv;
+
+    if (r->state != RAFT_STATE_LEADER) {
+        rv = RAFT_ERR_NOT_LEADER;
+        goto err;
+    }
+
+    if (r->leader_state.transferee_id != 0) {
+        rv = RAFT_ERR_LEADERSHIP_TRANSFER;
+        goto err;
+    }
+
+    server = raft_configuration__get(&r->configuration, id);
+    if (server == NULL || server->id == r->id || !server->voting) {
+        rv = RAFT_ERR_BAD_SERVER_ID;
+        goto err;
+    }
+
+    server_index = raft_configuration__index(&r->configuration, id);
+    assert(server_index < r->configuration.n);
+
+    r->leader_state.transferee_id = id;
+    r->leader_state.transfer_duration = 0;
+    r->leader_state.transfer_sent = false;
+
+    /* Once the transferee receives TimeoutNow, followers vote for it even if
+     * they heard from us recently, which voids the lease. */
+    raft_read__revoke_lease(r);
+
+    /* If the server is already up-to-date, this sends TimeoutNow right away,
+     * otherwise it gets sent once it has caught up. */
+    rv = raft_membership__transfer(r);
+    if (rv != 0) {
+        raft_membership__transfer_abort(r);
+        goto err;
+    }
+
+    if (!r->leader_state.transfer_sent) {
+        /* Immediately initiate an AppendEntries request. */
+        rv = raft_replication__send_append_entries(r, server_index);
+        if (rv != 0) {
+            /* This error is not fatal. */
+            raft_warnf(r->logger,
+                       "failed to send append entries to server %ld: %s (%d)",
+                       server->id, raft_strerror(rv), rv);
+        }
+    }
+
+    return 0;
+
+err:
+    assert(rv != 0);
+
+    return rv;
+}
+
 int raft_remove_server(struct raft *r, const unsigned id)
 {
     const struct raft_server *server;
@@ -239,7 +387,7 @@ int raft_remove_server(struct raft *r, const unsigned id)
         goto err_after_configuration_copy;
     }
 
-    rv = raft_client__change_configuration(r, &configuration);
+    rv = raft_membership__change_configuration(r, &configuration);
     if (rv != 0) {
         goto err_after_configuration_copy;
     }
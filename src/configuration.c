@@ -9,10 +9,90 @@
  */
 #define RAFT_CONFIGURATION__FORMAT 1
 
+/**
+ * Encoding format version of configurations that are joint or have learners,
+ * which have an additional byte per server with the flags below.
+ */
+#define RAFT_CONFIGURATION__FORMAT_FLAGS 2
+
+#define RAFT_CONFIGURATION__VOTING_OLD 1 /* Voting in C_old */
+#define RAFT_CONFIGURATION__LEARNER 2    /* Permanent non-voting server */
+#define RAFT_CONFIGURATION__REMOVED 4    /* Not part of C_new */
+
 void raft_configuration_init(struct raft_configuration *c)
 {
     c->servers = NULL;
     c->n = 0;
+    c->slots = NULL;
+    c->n_slots = 0;
+    c->ranks = NULL;
+    c->n_voting = 0;
+}
+
+/**
+ * Return the hash table slot where the lookup of the given server ID starts.
+ */
+static unsigned raft_configuration__hash(const unsigned id,
+                                         const unsigned n_slots)
+{
+    /* Knuth's multiplicative hash, spreading consecutive IDs apart. */
+    return (id * 2654435761U) & (n_slots - 1);
+}
+
+/**
+ * Allocate a zeroed array of @n servers, followed in the same block by their
+ * voting ranks and by an empty hash table sized for them. The table is kept at
+ * most half full, so probe sequences stay short.
+ *
+ * Using a single block keeps the table next to the servers, and makes adding
+ * or removing a server cost no extra allocation.
+ */
+static struct raft_server *raft_configuration__alloc(const unsigned n,
+                                                     unsigned **ranks,
+                                                     unsigned **slots,
+                                                     unsigned *n_slots)
+{
+    struct raft_server *servers;
+
+    assert(n > 0);
+
+    *n_slots = 1;
+    while (*n_slots < n * 2) {
+        *n_slots *= 2;
+    }
+
+    servers = raft_calloc(1, n * sizeof *servers + n * sizeof **ranks +
+                                 *n_slots * sizeof **slots);
+    if (servers == NULL) {
+        return NULL;
+    }
+
+    *ranks = (unsigned *)(servers + n);
+    *slots = *ranks + n;
+
+    return servers;
+}
+
+/**
+ * Insert all servers in the given hash table, which must be empty.
+ */
+static void raft_configuration__hash_servers(const struct raft_server *servers,
+                                             const unsigned n,
+                                             unsigned *slots,
+                                             const unsigned n_slots)
+{
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        unsigned j = raft_configuration__hash(servers[i].id, n_slots);
+
+        /* Linear probing. */
+        while (slots[j] != 0) {
+            j = (j + 1) & (n_slots - 1);
+        }
+
+        slots[j] = i + 1;
+    }
 }
 
 void raft_configuration_close(struct raft_configuration *c)
@@ -35,13 +115,29 @@ size_t raft_configuration__index(const struct raft_configuration *c,
                                  const unsigned id)
 {
     size_t i;
+    unsigned j;
 
     assert(c != NULL);
 
-    for (i = 0; i < c->n; i++) {
+    /* Configurations whose servers array was not built with
+     * raft_configuration_add() have no hash table. */
+    if (c->slots == NULL) {
+        for (i = 0; i < c->n; i++) {
+            if (c->servers[i].id == id) {
+                return i;
+            }
+        }
+        return c->n;
+    }
+
+    j = raft_configuration__hash(id, c->n_slots);
+
+    while (c->slots[j] != 0) {
+        i = c->slots[j] - 1;
         if (c->servers[i].id == id) {
             return i;
         }
+        j = (j + 1) & (c->n_slots - 1);
     }
 
     return c->n;
@@ -51,23 +147,16 @@ size_t raft_configuration__voting_index(const struct raft_configuration *c,
                                         const unsigned id)
 {
     size_t i;
-    size_t j = 0;
 
     assert(c != NULL);
 
-    for (i = 0; i < c->n; i++) {
-        if (c->servers[i].id == id) {
-            if (c->servers[i].voting) {
-                return j;
-            }
-            return c->n;
-        }
-        if (c->servers[i].voting) {
-            j++;
-        }
+    i = raft_configuration__index(c, id);
+
+    if (i == c->n || !raft_configuration__is_voting(&c->servers[i])) {
+        return c->n;
     }
 
-    return c->n;
+    return c->ranks[i];
 }
 
 const struct raft_server *raft_configuration__get(
@@ -93,9 +182,57 @@ const struct raft_server *raft_configuration__get(
 }
 
 size_t raft_configuration__n_voting(const struct raft_configuration *c)
+{
+    assert(c != NULL);
+
+    return c->n_voting;
+}
+
+void raft_configuration__update_voting(struct raft_configuration *c)
+{
+    size_t i;
+
+    assert(c != NULL);
+
+    c->n_voting = 0;
+
+    for (i = 0; i < c->n; i++) {
+        c->ranks[i] = c->n_voting;
+        if (raft_configuration__is_voting(&c->servers[i])) {
+            c->n_voting++;
+        }
+    }
+}
+
+bool raft_configuration__is_voting(const struct raft_server *server)
+{
+    assert(server != NULL);
+
+    return server->voting || server->voting_old;
+}
+
+bool raft_configuration__is_joint(const struct raft_configuration *c)
 {
     size_t i;
+
+    assert(c != NULL);
+
+    for (i = 0; i < c->n; i++) {
+        if (c->servers[i].voting_old) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool raft_configuration__is_majority(const struct raft_configuration *c,
+                                     size_t votes,
+                                     size_t votes_old)
+{
     size_t n = 0;
+    size_t n_old = 0;
+    size_t i;
 
     assert(c != NULL);
 
@@ -103,9 +240,25 @@ size_t raft_configuration__n_voting(const struct raft_configuration *c)
         if (c->servers[i].voting) {
             n++;
         }
+        if (c->servers[i].voting_old) {
+            n_old++;
+        }
     }
 
-    return n;
+    if (votes < n / 2 + 1) {
+        return false;
+    }
+
+    /* From Section §4.3:
+     *
+     *   Agreement (for elections and entry commitment) requires separate
+     *   majorities from both the old and new configurations.
+     */
+    if (n_old > 0 && votes_old < n_old / 2 + 1) {
+        return false;
+    }
+
+    return true;
 }
 
 int raft_configuration__copy(const struct raft_configuration *c1,
@@ -124,6 +277,82 @@ int raft_configuration__copy(const struct raft_configuration *c1,
         if (rv != 0) {
             return rv;
         }
+        c2->servers[c2->n - 1].voting_old = server->voting_old;
+        c2->servers[c2->n - 1].removed = server->removed;
+        c2->servers[c2->n - 1].learner = server->learner;
+    }
+
+    raft_configuration__update_voting(c2);
+
+    return 0;
+}
+
+int raft_configuration__joint(const struct raft_configuration *c_old,
+                              const struct raft_configuration *c_new,
+                              struct raft_configuration *joint)
+{
+    size_t i;
+    int rv;
+
+    assert(c_old != NULL);
+    assert(c_new != NULL);
+    assert(joint != NULL);
+    assert(!raft_configuration__is_joint(c_old));
+
+    rv = raft_configuration__copy(c_new, joint);
+    if (rv != 0) {
+        return rv;
+    }
+
+    for (i = 0; i < c_old->n; i++) {
+        const struct raft_server *server = &c_old->servers[i];
+        size_t j;
+
+        if (!server->voting) {
+            continue;
+        }
+
+        j = raft_configuration__index(joint, server->id);
+
+        if (j == joint->n) {
+            rv = raft_configuration_add(joint, server->id, server->address,
+                                        false);
+            if (rv != 0) {
+                return rv;
+            }
+            joint->servers[j].removed = true;
+        }
+
+        joint->servers[j].voting_old = true;
+    }
+
+    raft_configuration__update_voting(joint);
+
+    return 0;
+}
+
+int raft_configuration__leave_joint(const struct raft_configuration *joint,
+                                    struct raft_configuration *c_new)
+{
+    size_t i;
+    int rv;
+
+    assert(joint != NULL);
+    assert(c_new != NULL);
+
+    for (i = 0; i < joint->n; i++) {
+        const struct raft_server *server = &joint->servers[i];
+
+        if (server->removed) {
+            continue;
+        }
+
+        rv = raft_configuration_add(c_new, server->id, server->address,
+                                    server->voting);
+        if (rv != 0) {
+            return rv;
+        }
+        c_new->servers[c_new->n - 1].learner = server->learner;
     }
 
     return 0;
@@ -136,6 +365,9 @@ int raft_configuration_add(struct raft_configuration *c,
 {
     struct raft_server *servers;
     struct raft_server *server;
+    unsigned *ranks;
+    unsigned *slots;
+    unsigned n_slots;
     size_t i;
 
     assert(c != NULL);
@@ -153,7 +385,7 @@ int raft_configuration_add(struct raft_configuration *c,
     }
 
     /* Grow the servers array */
-    servers = raft_calloc(c->n + 1, sizeof *server);
+    servers = raft_configuration__alloc(c->n + 1, &ranks, &slots, &n_slots);
     if (servers == NULL) {
         return RAFT_ERR_NOMEM;
     }
@@ -179,6 +411,12 @@ int raft_configuration_add(struct raft_configuration *c,
 
     c->n++;
     c->servers = servers;
+    c->slots = slots;
+    c->n_slots = n_slots;
+    c->ranks = ranks;
+
+    raft_configuration__hash_servers(c->servers, c->n, c->slots, c->n_slots);
+    raft_configuration__update_voting(c);
 
     return 0;
 }
@@ -188,6 +426,9 @@ int raft_configuration_remove(struct raft_configuration *c, const unsigned id)
     size_t i;
     size_t j;
     struct raft_server *servers;
+    unsigned *ranks;
+    unsigned *slots;
+    unsigned n_slots;
 
     assert(c != NULL);
 
@@ -204,11 +445,15 @@ int raft_configuration_remove(struct raft_configuration *c, const unsigned id)
         raft_free(c->servers);
         c->n = 0;
         c->servers = NULL;
+        c->slots = NULL;
+        c->n_slots = 0;
+        c->ranks = NULL;
+        c->n_voting = 0;
         return 0;
     }
 
     /* Shrink the servers array. */
-    servers = raft_calloc(c->n - 1, sizeof *servers);
+    servers = raft_configuration__alloc(c->n - 1, &ranks, &slots, &n_slots);
     if (servers == NULL) {
         return RAFT_ERR_NOMEM;
     }
@@ -232,12 +477,38 @@ int raft_configuration_remove(struct raft_configuration *c, const unsigned id)
 
     c->servers = servers;
     c->n--;
+    c->slots = slots;
+    c->n_slots = n_slots;
+    c->ranks = ranks;
+
+    /* Positions after the removed server have shifted, rebuild the table and
+     * the ranks. */
+    raft_configuration__hash_servers(c->servers, c->n, c->slots, c->n_slots);
+    raft_configuration__update_voting(c);
 
     return 0;
 }
 
-static size_t raft_encode__configuration_size(
+/**
+ * Return true if the configuration needs the additional flags byte.
+ */
+static bool raft_encode__configuration_has_flags(
     const struct raft_configuration *c)
+{
+    size_t i;
+
+    for (i = 0; i < c->n; i++) {
+        if (c->servers[i].voting_old || c->servers[i].learner) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static size_t raft_encode__configuration_size(
+    const struct raft_configuration *c,
+    const bool flags)
 {
     size_t n = 0;
     size_t i;
@@ -257,6 +528,9 @@ static size_t raft_encode__configuration_size(
         n += sizeof(uint64_t) /* Server ID */;
         n += strlen(server->address) + 1;
         n++; /* Voting flag */
+        if (flags) {
+            n++; /* Flags */
+        }
     };
 
     return n;
@@ -266,6 +540,7 @@ int raft_configuration_encode(const struct raft_configuration *c,
                               struct raft_buffer *buf)
 {
     void *cursor;
+    bool flags;
     size_t i;
 
     assert(c != NULL);
@@ -276,7 +551,11 @@ int raft_configuration_encode(const struct raft_configuration *c,
         return RAFT_ERR_EMPTY_CONFIGURATION;
     }
 
-    buf->len = raft_encode__configuration_size(c);
+    /* Regular configurations keep using the original format, so they can still
+     * be decoded by older versions. */
+    flags = raft_encode__configuration_has_flags(c);
+
+    buf->len = raft_encode__configuration_size(c, flags);
     buf->base = raft_malloc(buf->len);
 
     if (buf->base == NULL) {
@@ -286,7 +565,8 @@ int raft_configuration_encode(const struct raft_configuration *c,
     cursor = buf->base;
 
     /* Encoding format version */
-    raft__put8(&cursor, RAFT_CONFIGURATION__FORMAT);
+    raft__put8(&cursor, flags ? RAFT_CONFIGURATION__FORMAT_FLAGS
+                              : RAFT_CONFIGURATION__FORMAT);
 
     /* Number of servers */
     raft__put64(&cursor, c->n);
@@ -302,6 +582,22 @@ int raft_configuration_encode(const struct raft_configuration *c,
         cursor += strlen(server->address) + 1;
 
         raft__put8(&cursor, server->voting);
+
+        if (flags) {
+            uint8_t server_flags = 0;
+
+            if (server->voting_old) {
+                server_flags |= RAFT_CONFIGURATION__VOTING_OLD;
+            }
+            if (server->removed) {
+                server_flags |= RAFT_CONFIGURATION__REMOVED;
+            }
+            if (server->learner) {
+                server_flags |= RAFT_CONFIGURATION__LEARNER;
+            }
+
+            raft__put8(&cursor, server_flags);
+        }
     };
 
     return 0;
@@ -311,6 +607,7 @@ int raft_configuration_decode(const struct raft_buffer *buf,
                               struct raft_configuration *c)
 {
     const void *cursor;
+    unsigned format;
     size_t i;
     size_t n;
 
@@ -329,7 +626,9 @@ int raft_configuration_decode(const struct raft_buffer *buf,
     cursor = buf->base;
 
     /* Check the encoding format version */
-    if (raft__get8(&cursor) != RAFT_CONFIGURATION__FORMAT) {
+    format = raft__get8(&cursor);
+    if (format != RAFT_CONFIGURATION__FORMAT &&
+        format != RAFT_CONFIGURATION__FORMAT_FLAGS) {
         return RAFT_ERR_MALFORMED;
     }
 
@@ -342,6 +641,7 @@ int raft_configuration_decode(const struct raft_buffer *buf,
         size_t address_len = 0;
         const char *address;
         bool voting;
+        uint8_t server_flags = 0;
         int rv;
 
         /* Server ID. */
@@ -363,11 +663,25 @@ int raft_configuration_decode(const struct raft_buffer *buf,
         /* Voting flag. */
         voting = raft__get8(&cursor);
 
+        /* Flags. */
+        if (format == RAFT_CONFIGURATION__FORMAT_FLAGS) {
+            server_flags = raft__get8(&cursor);
+        }
+
         rv = raft_configuration_add(c, id, address, voting);
         if (rv != 0) {
             return rv;
         }
+
+        c->servers[c->n - 1].voting_old =
+            (server_flags & RAFT_CONFIGURATION__VOTING_OLD) != 0;
+        c->servers[c->n - 1].removed =
+            (server_flags & RAFT_CONFIGURATION__REMOVED) != 0;
+        c->servers[c->n - 1].learner =
+            (server_flags & RAFT_CONFIGURATION__LEARNER) != 0;
     }
 
+    raft_configuration__update_voting(c);
+
     return 0;
 }
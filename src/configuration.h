@@ -16,8 +16,9 @@ size_t raft_configuration__index(const struct raft_configuration *c,
 
 /**
  * Return the index of the voting server with the given ID (relative to the sub
- * array of c->servers that has only voting servers). If there's no server with
- * the given ID, or if it's not flagged as voting, return the number of servers.
+ * array of c->servers that has only voting servers, see
+ * @raft_configuration__is_voting). If there's no server with the given ID, or
+ * if it's not voting, return the number of servers.
  */
 size_t raft_configuration__voting_index(const struct raft_configuration *c,
                                         const unsigned id);
@@ -34,6 +35,55 @@ const struct raft_server *raft_configuration__get(
  */
 size_t raft_configuration__n_voting(const struct raft_configuration *c);
 
+/**
+ * Refresh the cached position of each server among the voting ones, and the
+ * number of voting servers. Must be called after changing in place the voting
+ * flags of the servers of a configuration.
+ */
+void raft_configuration__update_voting(struct raft_configuration *c);
+
+/**
+ * Return true if the given server is voting, either in the configuration
+ * itself or, if it's a joint configuration, in C_old.
+ */
+bool raft_configuration__is_voting(const struct raft_server *server);
+
+/**
+ * Return true if the configuration is a joint one (C_old,new), that is if any
+ * of its servers is flagged as voting in C_old.
+ */
+bool raft_configuration__is_joint(const struct raft_configuration *c);
+
+/**
+ * Return true if @votes voting servers of the configuration form a majority.
+ *
+ * In a joint configuration, @votes counts the servers voting in C_new and
+ * @votes_old the ones voting in C_old, and a majority of both is needed.
+ * Otherwise @votes_old is ignored.
+ */
+bool raft_configuration__is_majority(const struct raft_configuration *c,
+                                     size_t votes,
+                                     size_t votes_old);
+
+/**
+ * Fill @joint with the joint configuration needed to transition from @c_old to
+ * @c_new.
+ *
+ * It contains all servers of @c_new, plus the voting servers of @c_old which
+ * are absent from @c_new, flagged as non-voting and removed. Servers that are
+ * voting in @c_old are flagged as such.
+ */
+int raft_configuration__joint(const struct raft_configuration *c_old,
+                              const struct raft_configuration *c_new,
+                              struct raft_configuration *joint);
+
+/**
+ * Fill @c_new with the C_new part of the given joint configuration, dropping
+ * the servers which are flagged as removed.
+ */
+int raft_configuration__leave_joint(const struct raft_configuration *joint,
+                                    struct raft_configuration *c_new);
+
 /**
  * Add all servers in c1 to c2.
  */
@@ -3,19 +3,76 @@
 #include "configuration.h"
 #include "log.h"
 
+/**
+ * Return the base election timeout, possibly adapted to the observed
+ * heartbeat intervals.
+ */
+static unsigned raft_election__timeout(struct raft *r)
+{
+    if (r->election_adaptive && r->election_timeout_adaptive != 0) {
+        return r->election_timeout_adaptive;
+    }
+    return r->election_timeout;
+}
+
 void raft_election__reset_timer(struct raft *r)
 {
+    unsigned timeout;
+
     assert(r != NULL);
 
-    /* [election_timeout, 2 * election_timeout) */
+    timeout = raft_election__timeout(r);
+
+    /* [timeout, 2 * timeout), with the random part shrinking as the priority
+     * grows. */
     r->election_timeout_rand =
-        r->election_timeout + (abs(r->rand()) % r->election_timeout);
+        timeout + (abs(r->rand()) % timeout) / (r->election_priority + 1);
 
     r->timer = 0;
 }
 
+void raft_election__observe_heartbeat(struct raft *r)
+{
+    unsigned interval = r->timer;
+    unsigned deviation;
+    unsigned timeout;
+
+    assert(r != NULL);
+    assert(r->state == RAFT_STATE_FOLLOWER);
+
+    if (!r->election_adaptive) {
+        return;
+    }
+
+    /* Same smoothing as TCP: alpha = 1/8 and beta = 1/4. */
+    if (r->election_timeout_adaptive == 0) {
+        r->heartbeat_interval = interval;
+        r->heartbeat_jitter = interval / 2;
+    } else {
+        deviation = interval > r->heartbeat_interval
+                        ? interval - r->heartbeat_interval
+                        : r->heartbeat_interval - interval;
+        r->heartbeat_jitter = (3 * r->heartbeat_jitter + deviation) / 4;
+        r->heartbeat_interval = (7 * r->heartbeat_interval + interval) / 8;
+    }
+
+    timeout = 2 * r->heartbeat_interval + 4 * r->heartbeat_jitter;
+
+    if (timeout < r->election_timeout_min) {
+        timeout = r->election_timeout_min;
+    }
+    if (timeout > r->election_timeout) {
+        timeout = r->election_timeout;
+    }
+
+    r->election_timeout_adaptive = timeout;
+
+    raft_election__reset_timer(r);
+}
+
 /**
- * Send a RequestVote RPC to the given server.
+ * Send a RequestVote RPC to the given server, or a PreVote one if we are in
+ * the pre-vote phase.
  */
 static int raft_election__send_request_vote(struct raft *r,
                                             const struct raft_server *server)
@@ -32,8 +89,17 @@ static int raft_election__send_request_vote(struct raft *r,
 
     /* TODO: account for snapshots */
 
-    message.type = RAFT_IO_REQUEST_VOTE;
-    message.request_vote.term = r->current_term;
+    /* The two message types share the same layout. A PreVote carries the
+     * term that we would use in the real election, which we haven't
+     * incremented yet. */
+    if (r->candidate_state.in_pre_vote) {
+        message.type = RAFT_IO_PRE_VOTE;
+        message.request_vote.term = r->current_term + 1;
+    } else {
+        message.type = RAFT_IO_REQUEST_VOTE;
+        message.request_vote.term = r->current_term;
+    }
+    message.request_vote.disrupt_leader = r->candidate_state.disrupt_leader;
     message.request_vote.candidate_id = r->id;
     message.request_vote.last_log_index = raft_log__last_index(&r->log);
     message.request_vote.last_log_term = raft_log__last_term(&r->log);
@@ -73,6 +139,12 @@ int raft_election__start(struct raft *r)
     assert(n_voting <= r->configuration.n);
     assert(voting_index < n_voting);
 
+    /* During the pre-vote phase neither the term nor the vote change, so
+     * there's nothing to persist. */
+    if (r->candidate_state.in_pre_vote) {
+        goto reset_timer;
+    }
+
     /* Increment current term */
     term = r->current_term + 1;
     rv = r->io->set_term(r->io, term);
@@ -90,6 +162,7 @@ int raft_election__start(struct raft *r)
     r->current_term = term;
     r->voted_for = r->id;
 
+reset_timer:
     /* Reset election timer. */
     raft_election__reset_timer(r);
 
@@ -107,7 +180,7 @@ int raft_election__start(struct raft *r)
         const struct raft_server *server = &r->configuration.servers[i];
         int rv;
 
-        if (server->id == r->id || !server->voting) {
+        if (server->id == r->id || !raft_configuration__is_voting(server)) {
             continue;
         }
 
@@ -127,41 +200,22 @@ err:
     return rv;
 }
 
-int raft_election__vote(struct raft *r,
-                        const struct raft_request_vote *args,
-                        bool *granted)
+/**
+ * Return true if the log of the requesting server is at least as up-to-date as
+ * ours.
+ */
+static bool raft_election__is_up_to_date(struct raft *r,
+                                         const struct raft_request_vote *args)
 {
-    const struct raft_server *local_server;
     raft_index local_last_log_index;
     raft_term local_last_log_term;
-    int rv;
-
-    assert(r != NULL);
-    assert(args != NULL);
-    assert(granted != NULL);
-
-    local_server = raft_configuration__get(&r->configuration, r->id);
-
-    *granted = false;
-
-    if (local_server == NULL || !local_server->voting) {
-        raft_debugf(r->logger,
-                    "local server is not voting -> not granting vote");
-        return 0;
-    }
-
-    if (r->voted_for != 0 && r->voted_for != args->candidate_id) {
-        raft_debugf(r->logger,
-                    "local server already voted -> not granting vote");
-        return 0;
-    }
 
     local_last_log_index = raft_log__last_index(&r->log);
 
     /* Our log is definitely not more up-to-date if it's empty! */
     if (local_last_log_index == 0) {
         raft_debugf(r->logger, "local log is empty -> granting vote");
-        goto grant_vote;
+        return true;
     }
 
     /* TODO: account for snapshots */
@@ -172,14 +226,14 @@ int raft_election__vote(struct raft *r,
         raft_debugf(
             r->logger,
             "local log last entry has higher last term -> not granting");
-        return 0;
+        return false;
     }
 
     if (args->last_log_term > local_last_log_term) {
         /* The requesting server has a more up-to-date log. */
         raft_debugf(r->logger,
                     "remote log last entry has higher term -> granting vote");
-        goto grant_vote;
+        return true;
     }
 
     /* The term of the last log entry is the same, so let's compare the length
@@ -190,15 +244,59 @@ int raft_election__vote(struct raft *r,
         /* Our log is shorter or equal to the one of the requester. */
         raft_debugf(r->logger,
                     "remote log equal or longer than local -> granting vote");
-        goto grant_vote;
+        return true;
     }
 
     raft_debugf(r->logger,
                 "remote log shorter than local -> not granting vote");
 
-    return 0;
+    return false;
+}
+
+/**
+ * Return true if the local server is voting.
+ */
+static bool raft_election__is_voting(struct raft *r)
+{
+    const struct raft_server *local_server;
+
+    local_server = raft_configuration__get(&r->configuration, r->id);
+
+    if (local_server == NULL || !raft_configuration__is_voting(local_server)) {
+        raft_debugf(r->logger,
+                    "local server is not voting -> not granting vote");
+        return false;
+    }
+
+    return true;
+}
+
+int raft_election__vote(struct raft *r,
+                        const struct raft_request_vote *args,
+                        bool *granted)
+{
+    int rv;
+
+    assert(r != NULL);
+    assert(args != NULL);
+    assert(granted != NULL);
+
+    *granted = false;
+
+    if (!raft_election__is_voting(r)) {
+        return 0;
+    }
+
+    if (r->voted_for != 0 && r->voted_for != args->candidate_id) {
+        raft_debugf(r->logger,
+                    "local server already voted -> not granting vote");
+        return 0;
+    }
+
+    if (!raft_election__is_up_to_date(r, args)) {
+        return 0;
+    }
 
-grant_vote:
     rv = r->io->set_vote(r->io, args->candidate_id);
     if (rv != 0) {
         return rv;
@@ -213,12 +311,36 @@ grant_vote:
     return 0;
 }
 
+void raft_election__pre_vote(struct raft *r,
+                             const struct raft_request_vote *args,
+                             bool *granted)
+{
+    assert(r != NULL);
+    assert(args != NULL);
+    assert(granted != NULL);
+
+    *granted = false;
+
+    if (!raft_election__is_voting(r)) {
+        return;
+    }
+
+    /* The candidate is asking for our vote in a term that we have already
+     * reached, where we might have voted for somebody else. */
+    if (args->term <= r->current_term) {
+        raft_debugf(r->logger, "local term is not lower -> not granting");
+        return;
+    }
+
+    *granted = raft_election__is_up_to_date(r, args);
+}
+
 bool raft_election__tally(struct raft *r, size_t votes_index)
 {
-    size_t n_voting = raft_configuration__n_voting(&r->configuration);
     size_t votes = 0;
+    size_t votes_old = 0;
     size_t i;
-    size_t half = n_voting / 2;
+    size_t j = 0;
 
     assert(r != NULL);
     assert(r->state == RAFT_STATE_CANDIDATE);
@@ -226,11 +348,27 @@ bool raft_election__tally(struct raft *r, size_t votes_index)
 
     r->candidate_state.votes[votes_index] = true;
 
-    for (i = 0; i < n_voting; i++) {
-        if (r->candidate_state.votes[i]) {
-            votes++;
+    /* Map the votes array, which has an entry for each voting server, to the
+     * servers in the configuration, to count votes in C_old and C_new
+     * separately. */
+    for (i = 0; i < r->configuration.n; i++) {
+        const struct raft_server *server = &r->configuration.servers[i];
+
+        if (!raft_configuration__is_voting(server)) {
+            continue;
         }
+
+        if (r->candidate_state.votes[j]) {
+            if (server->voting) {
+                votes++;
+            }
+            if (server->voting_old) {
+                votes_old++;
+            }
+        }
+
+        j++;
     }
 
-    return votes >= half + 1;
+    return raft_configuration__is_majority(&r->configuration, votes, votes_old);
 }
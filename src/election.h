@@ -34,6 +34,15 @@
  */
 void raft_election__reset_timer(struct raft *r);
 
+/**
+ * Update the adaptive election timeout with the time elapsed since the last
+ * AppendEntries RPC from the current leader, and reset the election timer.
+ *
+ * It must be called only by followers, and it does nothing unless adaptive
+ * election timeouts are enabled.
+ */
+void raft_election__observe_heartbeat(struct raft *r);
+
 /**
  * Start a new election round.
  *
@@ -52,6 +61,9 @@ void raft_election__reset_timer(struct raft *r);
  *   To begin an election, a follower increments its current term and
  *   transitions to candidate state.  It then votes for itself and issues
  *   RequestVote RPCs in parallel to each of the other servers in the cluster.
+ *
+ * If we are in the pre-vote phase, PreVote RPCs are sent instead, and neither
+ * the term nor the vote are changed.
  */
 int raft_election__start(struct raft *r);
 
@@ -72,6 +84,24 @@ int raft_election__vote(struct raft *r,
                         const struct raft_request_vote *args,
                         bool *granted);
 
+/**
+ * Decide whether we would grant our vote to the requesting server in the term
+ * carried by the given PreVote RPC, without changing our state.
+ *
+ * From Section §9.6:
+ *
+ *   A server would give its vote to a candidate under the same conditions as
+ *   normal: the candidate's log must be up-to-date, and the server must not
+ *   have received AppendEntries from a current leader in the last election
+ *   timeout.
+ *
+ * The latter condition is checked by the caller. The outcome of the decision
+ * is stored through the @granted pointer.
+ */
+void raft_election__pre_vote(struct raft *r,
+                             const struct raft_request_vote *args,
+                             bool *granted);
+
 /**
  * Update the votes array by adding the vote from the server at the given
  * index. Return true if with this vote the server has reached the majority of
@@ -0,0 +1,432 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "../include/raft.h"
+
+#include "assert.h"
+
+/**
+ * Size of the header that precedes every block handed out by the slab heap. It
+ * must be a multiple of 16, so blocks have the same alignment guarantees as the
+ * ones returned by malloc().
+ */
+#define RAFT_HEAP_SLAB__HEADER_SIZE 16
+
+/**
+ * Size of the blocks of the smallest size class.
+ */
+#define RAFT_HEAP_SLAB__MIN_SIZE 16
+
+/**
+ * Marker for blocks that don't belong to any size class and that are allocated
+ * and released directly using the backend heap.
+ */
+#define RAFT_HEAP_SLAB__LARGE RAFT_HEAP_SLAB_N_CLASSES
+
+/**
+ * Header preceding every block.
+ */
+struct raft_heap_slab__header
+{
+    size_t size;     /* Usable size of the block */
+    unsigned cls;    /* Size class, or RAFT_HEAP_SLAB__LARGE */
+    unsigned offset; /* Distance from the start of the backend allocation */
+};
+
+/**
+ * A free block, linked in the freelist of its size class.
+ */
+struct raft_heap_slab__node
+{
+    struct raft_heap_slab__node *next;
+};
+
+/**
+ * Freelist and statistics of a single size class.
+ */
+struct raft_heap_slab__class
+{
+    bool lock;                         /* Spinlock protecting this class */
+    struct raft_heap_slab__node *head; /* First free block */
+    unsigned n_cached;                 /* Number of free blocks */
+    unsigned max_cached;               /* Maximum number of free blocks */
+    unsigned long long n_alloc;        /* Number of blocks handed out */
+    unsigned long long n_free;         /* Number of blocks given back */
+    unsigned long long n_hits;         /* Allocations served by the freelist */
+};
+
+/**
+ * State of a slab heap, stored in the @data field of its @raft_heap.
+ */
+struct raft_heap_slab
+{
+    struct raft_heap *backend; /* Backend heap, or NULL for the stdlib */
+    struct raft_heap_slab__class classes[RAFT_HEAP_SLAB_N_CLASSES];
+    unsigned long long n_large;   /* Allocations above the largest class */
+    unsigned long long n_backend; /* Allocations that hit the backend heap */
+};
+
+static void raft_heap_slab__lock(struct raft_heap_slab__class *c)
+{
+    while (__atomic_test_and_set(&c->lock, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static void raft_heap_slab__unlock(struct raft_heap_slab__class *c)
+{
+    __atomic_clear(&c->lock, __ATOMIC_RELEASE);
+}
+
+static void *raft_heap_slab__backend_malloc(struct raft_heap_slab *s,
+                                            size_t size)
+{
+    __atomic_fetch_add(&s->n_backend, 1, __ATOMIC_RELAXED);
+
+    if (s->backend == NULL) {
+        return malloc(size);
+    }
+
+    return s->backend->malloc(s->backend->data, size);
+}
+
+static void *raft_heap_slab__backend_aligned_alloc(struct raft_heap_slab *s,
+                                                   size_t alignment,
+                                                   size_t size)
+{
+    __atomic_fetch_add(&s->n_backend, 1, __ATOMIC_RELAXED);
+
+    if (s->backend == NULL) {
+        return aligned_alloc(alignment, size);
+    }
+
+    return s->backend->aligned_alloc(s->backend->data, alignment, size);
+}
+
+static void raft_heap_slab__backend_free(struct raft_heap_slab *s, void *ptr)
+{
+    if (s->backend == NULL) {
+        free(ptr);
+        return;
+    }
+
+    s->backend->free(s->backend->data, ptr);
+}
+
+/**
+ * Return the size class that can serve a request of the given size, or
+ * #RAFT_HEAP_SLAB__LARGE if the request is too big.
+ */
+static unsigned raft_heap_slab__class_of(size_t size)
+{
+    unsigned cls;
+
+    if (size <= RAFT_HEAP_SLAB__MIN_SIZE) {
+        return 0;
+    }
+
+    /* Position of the highest bit of size - 1, minus log2(MIN_SIZE). */
+    cls = sizeof(unsigned long long) * 8 -
+          __builtin_clzll((unsigned long long)size - 1) - 4;
+
+    if (cls >= RAFT_HEAP_SLAB_N_CLASSES) {
+        return RAFT_HEAP_SLAB__LARGE;
+    }
+
+    return cls;
+}
+
+/**
+ * Return the header of the given block.
+ */
+static struct raft_heap_slab__header *raft_heap_slab__header_of(void *ptr)
+{
+    return (struct raft_heap_slab__header *)((char *)ptr -
+                                             RAFT_HEAP_SLAB__HEADER_SIZE);
+}
+
+/**
+ * Allocate a block that doesn't belong to any size class.
+ */
+static void *raft_heap_slab__malloc_large(struct raft_heap_slab *s,
+                                          size_t size)
+{
+    struct raft_heap_slab__header *header;
+
+    header =
+        raft_heap_slab__backend_malloc(s, RAFT_HEAP_SLAB__HEADER_SIZE + size);
+    if (header == NULL) {
+        return NULL;
+    }
+
+    header->size = size;
+    header->cls = RAFT_HEAP_SLAB__LARGE;
+    header->offset = RAFT_HEAP_SLAB__HEADER_SIZE;
+
+    __atomic_fetch_add(&s->n_large, 1, __ATOMIC_RELAXED);
+
+    return (char *)header + RAFT_HEAP_SLAB__HEADER_SIZE;
+}
+
+static void *raft_heap_slab__malloc(void *data, size_t size)
+{
+    struct raft_heap_slab *s = data;
+    struct raft_heap_slab__class *c;
+    struct raft_heap_slab__header *header;
+    struct raft_heap_slab__node *node;
+    unsigned cls;
+
+    cls = raft_heap_slab__class_of(size);
+    if (cls == RAFT_HEAP_SLAB__LARGE) {
+        return raft_heap_slab__malloc_large(s, size);
+    }
+
+    c = &s->classes[cls];
+
+    /* Try to pop a free block first. */
+    raft_heap_slab__lock(c);
+    node = c->head;
+    if (node != NULL) {
+        c->head = node->next;
+        c->n_cached--;
+        c->n_alloc++;
+        c->n_hits++;
+    }
+    raft_heap_slab__unlock(c);
+
+    if (node != NULL) {
+        return node;
+    }
+
+    /* The freelist is empty, let's get a new block from the backend. */
+    header = raft_heap_slab__backend_malloc(
+        s, RAFT_HEAP_SLAB__HEADER_SIZE + (RAFT_HEAP_SLAB__MIN_SIZE << cls));
+    if (header == NULL) {
+        return NULL;
+    }
+
+    header->size = RAFT_HEAP_SLAB__MIN_SIZE << cls;
+    header->cls = cls;
+    header->offset = RAFT_HEAP_SLAB__HEADER_SIZE;
+
+    raft_heap_slab__lock(c);
+    c->n_alloc++;
+    raft_heap_slab__unlock(c);
+
+    return (char *)header + RAFT_HEAP_SLAB__HEADER_SIZE;
+}
+
+static void raft_heap_slab__free(void *data, void *ptr)
+{
+    struct raft_heap_slab *s = data;
+    struct raft_heap_slab__class *c;
+    struct raft_heap_slab__header *header;
+    struct raft_heap_slab__node *node = ptr;
+    bool cached = false;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    header = raft_heap_slab__header_of(ptr);
+
+    if (header->cls == RAFT_HEAP_SLAB__LARGE) {
+        raft_heap_slab__backend_free(s, (char *)ptr - header->offset);
+        return;
+    }
+
+    assert(header->cls < RAFT_HEAP_SLAB_N_CLASSES);
+
+    c = &s->classes[header->cls];
+
+    raft_heap_slab__lock(c);
+    c->n_free++;
+    if (c->n_cached < c->max_cached) {
+        node->next = c->head;
+        c->head = node;
+        c->n_cached++;
+        cached = true;
+    }
+    raft_heap_slab__unlock(c);
+
+    if (!cached) {
+        raft_heap_slab__backend_free(s, header);
+    }
+}
+
+static void *raft_heap_slab__calloc(void *data, size_t nmemb, size_t size)
+{
+    void *ptr;
+
+    if (size != 0 && nmemb > (size_t)-1 / size) {
+        return NULL;
+    }
+
+    ptr = raft_heap_slab__malloc(data, nmemb * size);
+    if (ptr == NULL) {
+        return NULL;
+    }
+
+    memset(ptr, 0, nmemb * size);
+
+    return ptr;
+}
+
+static void *raft_heap_slab__realloc(void *data, void *ptr, size_t size)
+{
+    struct raft_heap_slab__header *header;
+    void *new_ptr;
+
+    if (ptr == NULL) {
+        return raft_heap_slab__malloc(data, size);
+    }
+
+    if (size == 0) {
+        raft_heap_slab__free(data, ptr);
+        return NULL;
+    }
+
+    header = raft_heap_slab__header_of(ptr);
+
+    /* If the block is already large enough, just keep it. */
+    if (header->cls != RAFT_HEAP_SLAB__LARGE && size <= header->size) {
+        return ptr;
+    }
+
+    new_ptr = raft_heap_slab__malloc(data, size);
+    if (new_ptr == NULL) {
+        return NULL;
+    }
+
+    memcpy(new_ptr, ptr, header->size < size ? header->size : size);
+
+    raft_heap_slab__free(data, ptr);
+
+    return new_ptr;
+}
+
+static void *raft_heap_slab__aligned_alloc(void *data,
+                                           size_t alignment,
+                                           size_t size)
+{
+    struct raft_heap_slab *s = data;
+    struct raft_heap_slab__header *header;
+    size_t len;
+    char *base;
+
+    /* Regular blocks are already aligned to the header size. */
+    if (alignment <= RAFT_HEAP_SLAB__HEADER_SIZE) {
+        return raft_heap_slab__malloc(data, size);
+    }
+
+    /* Reserve a full alignment unit in front of the block for the header, and
+     * round the total size up to a multiple of the alignment, as required by
+     * aligned_alloc(). */
+    len = alignment + size;
+    if (len % alignment != 0) {
+        len += alignment - (len % alignment);
+    }
+
+    base = raft_heap_slab__backend_aligned_alloc(s, alignment, len);
+    if (base == NULL) {
+        return NULL;
+    }
+
+    header = raft_heap_slab__header_of(base + alignment);
+    header->size = size;
+    header->cls = RAFT_HEAP_SLAB__LARGE;
+    header->offset = alignment;
+
+    __atomic_fetch_add(&s->n_large, 1, __ATOMIC_RELAXED);
+
+    return base + alignment;
+}
+
+int raft_heap_slab_init(struct raft_heap *h,
+                        struct raft_heap *backend,
+                        size_t max_cached)
+{
+    struct raft_heap_slab *s;
+    unsigned i;
+
+    assert(h != NULL);
+
+    if (max_cached == 0) {
+        max_cached = RAFT_HEAP_SLAB_DEFAULT_MAX_CACHED;
+    }
+
+    if (backend == NULL) {
+        s = malloc(sizeof *s);
+    } else {
+        s = backend->malloc(backend->data, sizeof *s);
+    }
+    if (s == NULL) {
+        return RAFT_ERR_NOMEM;
+    }
+
+    s->backend = backend;
+    s->n_large = 0;
+    s->n_backend = 0;
+
+    for (i = 0; i < RAFT_HEAP_SLAB_N_CLASSES; i++) {
+        struct raft_heap_slab__class *c = &s->classes[i];
+
+        c->lock = false;
+        c->head = NULL;
+        c->n_cached = 0;
+        c->max_cached = max_cached / (RAFT_HEAP_SLAB__MIN_SIZE << i);
+        c->n_alloc = 0;
+        c->n_free = 0;
+        c->n_hits = 0;
+    }
+
+    h->data = s;
+    h->malloc = raft_heap_slab__malloc;
+    h->free = raft_heap_slab__free;
+    h->calloc = raft_heap_slab__calloc;
+    h->realloc = raft_heap_slab__realloc;
+    h->aligned_alloc = raft_heap_slab__aligned_alloc;
+
+    return 0;
+}
+
+void raft_heap_slab_close(struct raft_heap *h)
+{
+    struct raft_heap_slab *s = h->data;
+    unsigned i;
+
+    for (i = 0; i < RAFT_HEAP_SLAB_N_CLASSES; i++) {
+        struct raft_heap_slab__class *c = &s->classes[i];
+
+        assert(c->n_alloc == c->n_free);
+
+        while (c->head != NULL) {
+            struct raft_heap_slab__node *node = c->head;
+            c->head = node->next;
+            raft_heap_slab__backend_free(s, raft_heap_slab__header_of(node));
+        }
+        c->n_cached = 0;
+    }
+
+    raft_heap_slab__backend_free(s, s);
+}
+
+void raft_heap_slab_stats(struct raft_heap *h,
+                          struct raft_heap_slab_stats *stats)
+{
+    struct raft_heap_slab *s = h->data;
+    unsigned i;
+
+    for (i = 0; i < RAFT_HEAP_SLAB_N_CLASSES; i++) {
+        struct raft_heap_slab__class *c = &s->classes[i];
+
+        raft_heap_slab__lock(c);
+        stats->classes[i].n_alloc = c->n_alloc;
+        stats->classes[i].n_free = c->n_free;
+        stats->classes[i].n_hits = c->n_hits;
+        stats->classes[i].n_cached = c->n_cached;
+        raft_heap_slab__unlock(c);
+    }
+
+    stats->n_large = __atomic_load_n(&s->n_large, __ATOMIC_RELAXED);
+    stats->n_backend = __atomic_load_n(&s->n_backend, __ATOMIC_RELAXED);
+}
@@ -97,6 +97,17 @@ struct raft_io_stub
         } flushed;
     } send;
 
+    /* ID of the server reported as congested, or 0 if none. */
+    unsigned congested;
+
+    /* Pending background work. */
+    struct
+    {
+        void *data;
+        void (*work)(void *data);
+        void (*cb)(void *data, int status);
+    } work;
+
     struct
     {
         int countdown; /* Trigger the fault when this counter gets to zero. */
@@ -434,6 +445,44 @@ static int raft_io_stub__send(const struct raft_io *io,
     return 0;
 }
 
+static bool raft_io_stub__congested(const struct raft_io *io,
+                                    const unsigned server_id)
+{
+    struct raft_io_stub *s;
+
+    s = io->data;
+
+    return s->congested != 0 && s->congested == server_id;
+}
+
+/**
+ * Queue up background work which will be run later, when raft_io_stub_flush()
+ * is invoked.
+ */
+static int raft_io_stub__queue_work(const struct raft_io *io,
+                                    void *data,
+                                    void (*work)(void *data),
+                                    void (*cb)(void *data, int status))
+{
+    struct raft_io_stub *s;
+
+    s = io->data;
+
+    if (raft_io_stub__fault_tick(s)) {
+        return RAFT_ERR_IO;
+    }
+
+    if (s->work.work != NULL) {
+        return RAFT_ERR_IO_BUSY;
+    }
+
+    s->work.data = data;
+    s->work.work = work;
+    s->work.cb = cb;
+
+    return 0;
+}
+
 int raft_io_stub_init(struct raft_io *io, struct raft_logger *logger)
 {
     struct raft_io_stub *stub;
@@ -456,6 +505,10 @@ int raft_io_stub_init(struct raft_io *io, struct raft_logger *logger)
     memset(&stub->append, 0, sizeof stub->append);
     memset(&stub->send, 0, sizeof stub->send);
 
+    stub->congested = 0;
+
+    memset(&stub->work, 0, sizeof stub->work);
+
     stub->fault.countdown = -1;
     stub->fault.n = -1;
 
@@ -469,6 +522,8 @@ int raft_io_stub_init(struct raft_io *io, struct raft_logger *logger)
     io->append = raft_io_stub__append;
     io->truncate = raft_io_stub__truncate;
     io->send = raft_io_stub__send;
+    io->congested = raft_io_stub__congested;
+    io->queue_work = raft_io_stub__queue_work;
 
     return 0;
 }
@@ -680,6 +735,21 @@ void raft_io_stub_flush(struct raft_io *io)
             case RAFT_IO_REQUEST_VOTE_RESULT:
                 sprintf(desc, "request vote result");
                 break;
+            case RAFT_IO_READ_INDEX:
+                sprintf(desc, "read index");
+                break;
+            case RAFT_IO_READ_INDEX_RESULT:
+                sprintf(desc, "read index result");
+                break;
+            case RAFT_IO_PRE_VOTE:
+                sprintf(desc, "pre vote");
+                break;
+            case RAFT_IO_PRE_VOTE_RESULT:
+                sprintf(desc, "pre vote result");
+                break;
+            case RAFT_IO_TIMEOUT_NOW:
+                sprintf(desc, "timeout now");
+                break;
         }
 
         __debugf(s, "io: flush to server %u: %s", src->server_id, desc);
@@ -690,6 +760,17 @@ void raft_io_stub_flush(struct raft_io *io)
     }
 
     s->send.pending.n_messages = 0;
+
+    if (s->work.work != NULL) {
+        void *data = s->work.data;
+        void (*cb)(void *data, int status) = s->work.cb;
+
+        s->work.work(data);
+
+        memset(&s->work, 0, sizeof s->work);
+
+        cb(data, 0);
+    }
 }
 
 void raft_io_stub_sent(struct raft_io *io,
@@ -735,6 +816,15 @@ void raft_io_stub_fault(struct raft_io *io, int delay, int repeat)
     s->fault.n = repeat;
 }
 
+void raft_io_stub_congested(struct raft_io *io, unsigned id)
+{
+    struct raft_io_stub *s;
+
+    s = io->data;
+
+    s->congested = id;
+}
+
 unsigned raft_io_stub_term(struct raft_io *io)
 {
     struct raft_io_stub *s;
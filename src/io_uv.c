@@ -258,6 +258,98 @@ static int raft_io_uv__send(const struct raft_io *io,
     return raft_io_uv_rpc__send(&uv->rpc, message, data, cb);
 }
 
+/**
+ * Background work submitted via raft_io->queue_work.
+ */
+struct raft_io_uv__work
+{
+    uv_work_t req;
+    struct raft_io_uv *uv;
+    void *data;
+    void (*work)(void *data);
+    void (*cb)(void *data, int status);
+};
+
+static void raft_io_uv__work_cb(uv_work_t *req)
+{
+    struct raft_io_uv__work *w = req->data;
+
+    w->work(w->data);
+}
+
+static void raft_io_uv__after_work_cb(uv_work_t *req, int status)
+{
+    struct raft_io_uv__work *w = req->data;
+    struct raft_io_uv *uv = w->uv;
+
+    w->cb(w->data, status == 0 ? 0 : RAFT_ERR_IO_ABORTED);
+
+    raft_free(w);
+
+    uv->n_active--;
+
+    raft_io_uv__maybe_stopped(uv);
+}
+
+static int raft_io_uv__queue_work(const struct raft_io *io,
+                                  void *data,
+                                  void (*work)(void *data),
+                                  void (*cb)(void *data, int status))
+{
+    struct raft_io_uv *uv;
+    struct raft_io_uv__work *w;
+    int rv;
+
+    uv = io->data;
+
+    /* Don't accept new work once we've been asked to stop. */
+    if (uv->stop.cb != NULL) {
+        rv = RAFT_ERR_IO_ABORTED;
+        goto err;
+    }
+
+    w = raft_malloc(sizeof *w);
+    if (w == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
+    w->req.data = w;
+    w->uv = uv;
+    w->data = data;
+    w->work = work;
+    w->cb = cb;
+
+    rv = uv_queue_work(uv->loop, &w->req, raft_io_uv__work_cb,
+                       raft_io_uv__after_work_cb);
+    if (rv != 0) {
+        raft_errorf(uv->logger, "uv_queue_work: %s", uv_strerror(rv));
+        rv = RAFT_ERR_IO;
+        goto err_after_work_alloc;
+    }
+
+    uv->n_active++;
+
+    return 0;
+
+err_after_work_alloc:
+    raft_free(w);
+
+err:
+    assert(rv != 0);
+    return rv;
+}
+
+static bool raft_io_uv__congested(const struct raft_io *io,
+                                  const unsigned server_id)
+{
+    struct raft_io_uv *uv;
+
+    uv = io->data;
+
+    return raft_io_uv_rpc__congested(&uv->rpc, server_id);
+}
+
 int raft_io_uv_init(struct raft_io *io,
                     struct raft_logger *logger,
                     struct uv_loop_s *loop,
@@ -293,6 +385,13 @@ int raft_io_uv_init(struct raft_io *io,
     uv->transport = transport;
 
     uv->last_tick = 0;
+    uv->n_active = 0;
+
+    uv->tick.data = NULL;
+    uv->tick.cb = NULL;
+
+    uv->stop.data = NULL;
+    uv->stop.cb = NULL;
 
     io->data = uv;
     io->start = raft_io_uv__start;
@@ -303,6 +402,8 @@ int raft_io_uv_init(struct raft_io *io,
     io->set_vote = raft_io_uv__set_vote;
     io->append = raft_io_uv__append;
     io->send = raft_io_uv__send;
+    io->congested = raft_io_uv__congested;
+    io->queue_work = raft_io_uv__queue_work;
 
     return 0;
 
@@ -328,3 +429,42 @@ void raft_io_uv_close(struct raft_io *io)
 
     raft_free(uv);
 }
+
+void raft_io_uv_set_watermarks(struct raft_io *io, size_t low, size_t high)
+{
+    struct raft_io_uv *uv;
+
+    assert(low < high);
+
+    uv = io->data;
+
+    uv->rpc.low_watermark = low;
+    uv->rpc.high_watermark = high;
+}
+
+void raft_io_uv_set_stripes(struct raft_io *io, unsigned n)
+{
+    struct raft_io_uv *uv;
+
+    uv = io->data;
+
+    uv->rpc.n_stripes = n;
+}
+
+void raft_io_uv_set_checksums(struct raft_io *io, bool enabled)
+{
+    struct raft_io_uv *uv;
+
+    uv = io->data;
+
+    uv->rpc.checksums = enabled;
+}
+
+void raft_io_uv_set_compression(struct raft_io *io, size_t threshold)
+{
+    struct raft_io_uv *uv;
+
+    uv = io->data;
+
+    uv->rpc.compression_threshold = threshold;
+}
@@ -3,6 +3,7 @@
 #include "assert.h"
 #include "binary.h"
 #include "io_uv_encoding.h"
+#include "lz4.h"
 
 /**
  * Size of the request preable.
@@ -16,7 +17,8 @@ size_t raft_io_uv_sizeof__request_vote()
     return sizeof(uint64_t) + /* Term. */
            sizeof(uint64_t) + /* Candidate ID. */
            sizeof(uint64_t) + /* Last log index. */
-           sizeof(uint64_t) /* Last log term. */;
+           sizeof(uint64_t) + /* Last log term. */
+           sizeof(uint64_t) /* Disrupt leader. */;
 }
 
 static size_t raft_io_uv_sizeof__request_vote_result()
@@ -25,16 +27,23 @@ static size_t raft_io_uv_sizeof__request_vote_result()
            sizeof(uint64_t) /* Vote granted. */;
 }
 
-static size_t raft_io_uv_sizeof__append_entries(
-    const struct raft_append_entries *p)
+/**
+ * Size of the fields of an AppendEntries header that precede the batch header.
+ */
+static size_t raft_io_uv_sizeof__append_entries_prefix()
 {
     return sizeof(uint64_t) + /* Leader's term. */
            sizeof(uint64_t) + /* Leader ID */
            sizeof(uint64_t) + /* Previous log entry index */
            sizeof(uint64_t) + /* Previous log entry term */
-           sizeof(uint64_t) + /* Leader's commit index */
-           sizeof(uint64_t) + /* Number of entries in the batch */
-           16 * p->n_entries /* One header per entry */;
+           sizeof(uint64_t) /* Leader's commit index */;
+}
+
+static size_t raft_io_uv_sizeof__append_entries(
+    const struct raft_append_entries *p)
+{
+    return raft_io_uv_sizeof__append_entries_prefix() +
+           raft_io_uv_sizeof__batch_header(p->n_entries);
 }
 
 static size_t raft_io_uv_sizeof__append_entries_result()
@@ -44,6 +53,60 @@ static size_t raft_io_uv_sizeof__append_entries_result()
            sizeof(uint64_t) /* Last log index. */;
 }
 
+static size_t raft_io_uv_sizeof__read_index()
+{
+    return sizeof(uint64_t) + /* Term. */
+           sizeof(uint64_t) /* Request ID. */;
+}
+
+static size_t raft_io_uv_sizeof__read_index_result()
+{
+    return sizeof(uint64_t) + /* Term. */
+           sizeof(uint64_t) + /* Request ID. */
+           sizeof(uint64_t) + /* Success. */
+           sizeof(uint64_t) /* Read index. */;
+}
+
+static size_t raft_io_uv_sizeof__timeout_now()
+{
+    return sizeof(uint64_t) + /* Term. */
+           sizeof(uint64_t) + /* Last log index. */
+           sizeof(uint64_t) /* Last log term. */;
+}
+
+/**
+ * Return the minimum size of the header of a message of the given type, or 0 if
+ * the type is unknown.
+ *
+ * RequestVote and PreVote messages sent by servers that predate the disrupt
+ * leader flag lack its word. For AppendEntries messages only the fields that
+ * precede the batch header and the number of entries are accounted for.
+ */
+static size_t raft_io_uv_sizeof__min_header(unsigned type)
+{
+    switch (type) {
+        case RAFT_IO_REQUEST_VOTE:
+        case RAFT_IO_PRE_VOTE:
+            return raft_io_uv_sizeof__request_vote() - sizeof(uint64_t);
+        case RAFT_IO_REQUEST_VOTE_RESULT:
+        case RAFT_IO_PRE_VOTE_RESULT:
+            return raft_io_uv_sizeof__request_vote_result();
+        case RAFT_IO_APPEND_ENTRIES:
+            return raft_io_uv_sizeof__append_entries_prefix() +
+                   raft_io_uv_sizeof__batch_header(0);
+        case RAFT_IO_APPEND_ENTRIES_RESULT:
+            return raft_io_uv_sizeof__append_entries_result();
+        case RAFT_IO_READ_INDEX:
+            return raft_io_uv_sizeof__read_index();
+        case RAFT_IO_READ_INDEX_RESULT:
+            return raft_io_uv_sizeof__read_index_result();
+        case RAFT_IO_TIMEOUT_NOW:
+            return raft_io_uv_sizeof__timeout_now();
+    }
+
+    return 0;
+}
+
 size_t raft_io_uv_sizeof__batch_header(size_t n)
 {
     return 8 + /* Number of entries in the batch, little endian */
@@ -59,6 +122,7 @@ static void raft_io_uv_encode__request_vote(const struct raft_request_vote *p,
     raft__put64(&cursor, p->candidate_id);
     raft__put64(&cursor, p->last_log_index);
     raft__put64(&cursor, p->last_log_term);
+    raft__put64(&cursor, p->disrupt_leader);
 }
 
 static void raft_io_uv_encode__request_vote_result(
@@ -71,11 +135,13 @@ static void raft_io_uv_encode__request_vote_result(
     raft__put64(&cursor, p->vote_granted);
 }
 
-static void raft_io_uv_encode__append_entries(
+/**
+ * Encode the fields of an AppendEntries header that precede the batch header.
+ */
+static void raft_io_uv_encode__append_entries_prefix(
     const struct raft_append_entries *p,
     void *buf)
 {
-    size_t i;
     void *cursor;
 
     cursor = buf;
@@ -85,12 +151,22 @@ static void raft_io_uv_encode__append_entries(
     raft__put64(&cursor, p->prev_log_index); /* Previous index. */
     raft__put64(&cursor, p->prev_log_term);  /* Previous term. */
     raft__put64(&cursor, p->leader_commit);  /* Commit index. */
+}
+
+void raft_io_uv_encode__batch_header(const struct raft_entry *entries,
+                                     unsigned n,
+                                     void *buf)
+{
+    size_t i;
+    void *cursor;
+
+    cursor = buf;
 
     /* Number of entries in the batch, little endian */
-    raft__put64(&cursor, p->n_entries);
+    raft__put64(&cursor, n);
 
-    for (i = 0; i < p->n_entries; i++) {
-        const struct raft_entry *entry = &p->entries[i];
+    for (i = 0; i < n; i++) {
+        const struct raft_entry *entry = &entries[i];
 
         /* Term in which the entry was created, little endian. */
         raft__put64(&cursor, entry->term);
@@ -116,46 +192,100 @@ static void raft_io_uv_encode__append_entries_result(
     raft__put64(&cursor, p->last_log_index);
 }
 
-int raft_io_uv_encode__message(const struct raft_message *message,
-                               uv_buf_t **bufs,
-                               unsigned *n_bufs)
+static void raft_io_uv_encode__read_index(const struct raft_read_index *p,
+                                          void *buf)
+{
+    void *cursor = buf;
+
+    raft__put64(&cursor, p->term);
+    raft__put64(&cursor, p->id);
+}
+
+static void raft_io_uv_encode__read_index_result(
+    const struct raft_read_index_result *p,
+    void *buf)
+{
+    void *cursor = buf;
+
+    raft__put64(&cursor, p->term);
+    raft__put64(&cursor, p->id);
+    raft__put64(&cursor, p->success);
+    raft__put64(&cursor, p->index);
+}
+
+static void raft_io_uv_encode__timeout_now(const struct raft_timeout_now *p,
+                                           void *buf)
+{
+    void *cursor = buf;
+
+    raft__put64(&cursor, p->term);
+    raft__put64(&cursor, p->last_log_index);
+    raft__put64(&cursor, p->last_log_term);
+}
+
+int raft_io_uv_encode__header(const struct raft_message *message,
+                              uv_buf_t *header)
 {
-    uv_buf_t header;
+    size_t size;
     void *cursor;
 
-    /* Figure out the length of the header for this request and allocate a
-     * buffer for it. */
-    header.len = RAFT_IO_UV__PREAMBLE_SIZE;
+    /* For AppendEntries messages the header buffer holds only the fields that
+     * precede the batch header, but the size in the preamble still accounts
+     * for the whole header. */
     switch (message->type) {
         case RAFT_IO_REQUEST_VOTE:
-            header.len += raft_io_uv_sizeof__request_vote();
+            size = raft_io_uv_sizeof__request_vote();
+            header->len = size;
             break;
         case RAFT_IO_REQUEST_VOTE_RESULT:
-            header.len += raft_io_uv_sizeof__request_vote_result();
+            size = raft_io_uv_sizeof__request_vote_result();
+            header->len = size;
             break;
         case RAFT_IO_APPEND_ENTRIES:
-            header.len +=
-                raft_io_uv_sizeof__append_entries(&message->append_entries);
+            size = raft_io_uv_sizeof__append_entries(&message->append_entries);
+            header->len = raft_io_uv_sizeof__append_entries_prefix();
             break;
         case RAFT_IO_APPEND_ENTRIES_RESULT:
-            header.len += raft_io_uv_sizeof__append_entries_result();
+            size = raft_io_uv_sizeof__append_entries_result();
+            header->len = size;
+            break;
+        case RAFT_IO_READ_INDEX:
+            size = raft_io_uv_sizeof__read_index();
+            header->len = size;
+            break;
+        case RAFT_IO_READ_INDEX_RESULT:
+            size = raft_io_uv_sizeof__read_index_result();
+            header->len = size;
+            break;
+        case RAFT_IO_PRE_VOTE:
+            size = raft_io_uv_sizeof__request_vote();
+            header->len = size;
+            break;
+        case RAFT_IO_PRE_VOTE_RESULT:
+            size = raft_io_uv_sizeof__request_vote_result();
+            header->len = size;
+            break;
+        case RAFT_IO_TIMEOUT_NOW:
+            size = raft_io_uv_sizeof__timeout_now();
+            header->len = size;
             break;
         default:
             return RAFT_ERR_IO_MALFORMED;
     };
 
-    header.base = raft_malloc(header.len);
-    if (header.base == NULL) {
-        goto oom;
+    header->len += RAFT_IO_UV__PREAMBLE_SIZE;
+
+    header->base = raft_malloc(header->len);
+    if (header->base == NULL) {
+        return RAFT_ERR_NOMEM;
     }
 
-    cursor = header.base;
+    cursor = header->base;
 
     /* Encode the request preamble, with message type and message size. */
     raft__put64(&cursor, message->type);
-    raft__put64(&cursor, header.len - RAFT_IO_UV__PREAMBLE_SIZE);
+    raft__put64(&cursor, size);
 
-    /* Encode the request header. */
     switch (message->type) {
         case RAFT_IO_REQUEST_VOTE:
             raft_io_uv_encode__request_vote(&message->request_vote, cursor);
@@ -165,45 +295,33 @@ int raft_io_uv_encode__message(const struct raft_message *message,
                 &message->request_vote_result, cursor);
             break;
         case RAFT_IO_APPEND_ENTRIES:
-            raft_io_uv_encode__append_entries(&message->append_entries, cursor);
+            raft_io_uv_encode__append_entries_prefix(&message->append_entries,
+                                                     cursor);
             break;
         case RAFT_IO_APPEND_ENTRIES_RESULT:
             raft_io_uv_encode__append_entries_result(
                 &message->append_entries_result, cursor);
             break;
+        case RAFT_IO_READ_INDEX:
+            raft_io_uv_encode__read_index(&message->read_index, cursor);
+            break;
+        case RAFT_IO_READ_INDEX_RESULT:
+            raft_io_uv_encode__read_index_result(&message->read_index_result,
+                                                 cursor);
+            break;
+        case RAFT_IO_PRE_VOTE:
+            raft_io_uv_encode__request_vote(&message->pre_vote, cursor);
+            break;
+        case RAFT_IO_PRE_VOTE_RESULT:
+            raft_io_uv_encode__request_vote_result(&message->pre_vote_result,
+                                                   cursor);
+            break;
+        case RAFT_IO_TIMEOUT_NOW:
+            raft_io_uv_encode__timeout_now(&message->timeout_now, cursor);
+            break;
     };
 
-    *n_bufs = 1;
-
-    /* For AppendEntries request we also send the entries payload. */
-    if (message->type == RAFT_IO_APPEND_ENTRIES) {
-        *n_bufs += message->append_entries.n_entries;
-    }
-
-    *bufs = raft_calloc(*n_bufs, sizeof **bufs);
-    if (*bufs == NULL) {
-        goto oom_after_header_alloc;
-    }
-
-    (*bufs)[0] = header;
-
-    if (message->type == RAFT_IO_APPEND_ENTRIES) {
-        unsigned i;
-        for (i = 0; i < message->append_entries.n_entries; i++) {
-            const struct raft_entry *entry =
-                &message->append_entries.entries[i];
-            (*bufs)[i + 1].base = entry->buf.base;
-            (*bufs)[i + 1].len = entry->buf.len;
-        }
-    }
-
     return 0;
-
-oom_after_header_alloc:
-    raft_free(header.base);
-
-oom:
-    return RAFT_ERR_NOMEM;
 }
 
 static void raft_io_uv_decode__request_vote(const uv_buf_t *buf,
@@ -217,6 +335,13 @@ static void raft_io_uv_decode__request_vote(const uv_buf_t *buf,
     p->candidate_id = raft__get64(&cursor);
     p->last_log_index = raft__get64(&cursor);
     p->last_log_term = raft__get64(&cursor);
+
+    /* Servers that predate the flag never disrupt leaders. */
+    if (buf->len >= raft_io_uv_sizeof__request_vote()) {
+        p->disrupt_leader = raft__get64(&cursor) != 0;
+    } else {
+        p->disrupt_leader = false;
+    }
 }
 
 static void raft_io_uv_decode__request_vote_result(
@@ -274,7 +399,7 @@ int raft_io_uv_decode__batch_header(const void *batch,
     return 0;
 
 err_after_alloc:
-    raft_free(entries);
+    raft_free(*entries);
 
 err:
     assert(rv != 0);
@@ -286,6 +411,8 @@ static int raft_io_uv_decode__append_entries(const uv_buf_t *buf,
                                              struct raft_append_entries *args)
 {
     const void *cursor;
+    const void *batch;
+    size_t n;
     int rv;
 
     assert(buf != NULL);
@@ -299,6 +426,15 @@ static int raft_io_uv_decode__append_entries(const uv_buf_t *buf,
     args->prev_log_term = raft__get64(&cursor);
     args->leader_commit = raft__get64(&cursor);
 
+    /* Check that the header has room for all the entry headers. */
+    batch = cursor;
+    n = raft__get64(&batch);
+    if (n > (buf->len - raft_io_uv_sizeof__append_entries_prefix() -
+             raft_io_uv_sizeof__batch_header(0)) /
+                16) {
+        return RAFT_ERR_IO_MALFORMED;
+    }
+
     rv = raft_io_uv_decode__batch_header(cursor, &args->entries,
                                          &args->n_entries);
     if (rv != 0) {
@@ -321,6 +457,43 @@ static void raft_io_uv_decode__append_entries_result(
     p->last_log_index = raft__get64(&cursor);
 }
 
+static void raft_io_uv_decode__read_index(const uv_buf_t *buf,
+                                          struct raft_read_index *p)
+{
+    const void *cursor;
+
+    cursor = buf->base;
+
+    p->term = raft__get64(&cursor);
+    p->id = raft__get64(&cursor);
+}
+
+static void raft_io_uv_decode__read_index_result(
+    const uv_buf_t *buf,
+    struct raft_read_index_result *p)
+{
+    const void *cursor;
+
+    cursor = buf->base;
+
+    p->term = raft__get64(&cursor);
+    p->id = raft__get64(&cursor);
+    p->success = raft__get64(&cursor);
+    p->index = raft__get64(&cursor);
+}
+
+static void raft_io_uv_decode__timeout_now(const uv_buf_t *buf,
+                                           struct raft_timeout_now *p)
+{
+    const void *cursor;
+
+    cursor = buf->base;
+
+    p->term = raft__get64(&cursor);
+    p->last_log_index = raft__get64(&cursor);
+    p->last_log_term = raft__get64(&cursor);
+}
+
 int raft_io_uv_decode__message(unsigned type,
                                const uv_buf_t *header,
                                struct raft_message *message,
@@ -333,6 +506,10 @@ int raft_io_uv_decode__message(unsigned type,
 
     *payload_len = 0;
 
+    if (header->len < raft_io_uv_sizeof__min_header(type)) {
+        return RAFT_ERR_IO_MALFORMED;
+    }
+
     /* Decode the header. */
     switch (type) {
         case RAFT_IO_REQUEST_VOTE:
@@ -353,6 +530,23 @@ int raft_io_uv_decode__message(unsigned type,
             raft_io_uv_decode__append_entries_result(
                 header, &message->append_entries_result);
             break;
+        case RAFT_IO_READ_INDEX:
+            raft_io_uv_decode__read_index(header, &message->read_index);
+            break;
+        case RAFT_IO_READ_INDEX_RESULT:
+            raft_io_uv_decode__read_index_result(header,
+                                                 &message->read_index_result);
+            break;
+        case RAFT_IO_PRE_VOTE:
+            raft_io_uv_decode__request_vote(header, &message->pre_vote);
+            break;
+        case RAFT_IO_PRE_VOTE_RESULT:
+            raft_io_uv_decode__request_vote_result(header,
+                                                   &message->pre_vote_result);
+            break;
+        case RAFT_IO_TIMEOUT_NOW:
+            raft_io_uv_decode__timeout_now(header, &message->timeout_now);
+            break;
         default:
             rv = RAFT_ERR_IO;
             break;
@@ -390,3 +584,87 @@ void raft_io_uv_decode__entries_batch(const struct raft_buffer *buf,
         }
     }
 }
+
+int raft_io_uv_encode__entries_compressed(const uv_buf_t *bufs,
+                                          unsigned n,
+                                          uv_buf_t *buf)
+{
+    void *data;
+    size_t size = 0;
+    size_t capacity;
+    void *cursor;
+    unsigned i;
+    int rv;
+
+    buf->base = NULL;
+    buf->len = 0;
+
+    for (i = 0; i < n; i++) {
+        size += bufs[i].len;
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    /* The compressor needs contiguous input, so entries data spread across
+     * several buffers gets copied first. */
+    if (n == 1) {
+        data = bufs[0].base;
+    } else {
+        data = raft_malloc(size);
+        if (data == NULL) {
+            rv = RAFT_ERR_NOMEM;
+            goto err;
+        }
+
+        cursor = data;
+        for (i = 0; i < n; i++) {
+            memcpy(cursor, bufs[i].base, bufs[i].len);
+            cursor += bufs[i].len;
+        }
+    }
+
+    buf->base = raft_malloc(size);
+    if (buf->base == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_data_alloc;
+    }
+
+    /* Only keep the compressed data if it's smaller than the original. */
+    capacity = size - 1;
+    buf->len = raft__lz4_compress(data, size, buf->base, capacity);
+    if (buf->len == 0) {
+        raft_free(buf->base);
+        buf->base = NULL;
+    }
+
+    if (data != bufs[0].base) {
+        raft_free(data);
+    }
+
+    return 0;
+
+err_after_data_alloc:
+    if (data != bufs[0].base) {
+        raft_free(data);
+    }
+
+err:
+    assert(rv != 0);
+
+    return rv;
+}
+
+int raft_io_uv_decode__entries_compressed(const uv_buf_t *buf,
+                                          struct raft_buffer *batch)
+{
+    int rv;
+
+    rv = raft__lz4_decompress(buf->base, buf->len, batch->base, batch->len);
+    if (rv != 0) {
+        return RAFT_ERR_IO_MALFORMED;
+    }
+
+    return 0;
+}
@@ -7,9 +7,13 @@
 
 #include "../include/raft.h"
 
-int raft_io_uv_encode__message(const struct raft_message *message,
-                               uv_buf_t **bufs,
-                               unsigned *n_bufs);
+/**
+ * Encode the preamble and header of the given message into a newly allocated
+ * buffer. For AppendEntries messages the batch header is left out, and must be
+ * sent right after this buffer, followed by the entries data.
+ */
+int raft_io_uv_encode__header(const struct raft_message *message,
+                              uv_buf_t *header);
 
 int raft_io_uv_decode__message(unsigned type,
                                const uv_buf_t *header,
@@ -48,4 +52,29 @@ void raft_io_uv_decode__entries_batch(const struct raft_buffer *buf,
  */
 size_t raft_io_uv_sizeof__batch_header(size_t n);
 
+/**
+ * Encode the batch header of the given entries into @buf, which must be at
+ * least raft_io_uv_sizeof__batch_header(n) bytes long.
+ */
+void raft_io_uv_encode__batch_header(const struct raft_entry *entries,
+                                     unsigned n,
+                                     void *buf);
+
+/**
+ * Compress the concatenation of the given entries data buffers into a newly
+ * allocated buffer, using the LZ4 block format. If compressing doesn't make the
+ * data smaller, @buf->base is set to NULL and nothing is allocated.
+ */
+int raft_io_uv_encode__entries_compressed(const uv_buf_t *bufs,
+                                          unsigned n,
+                                          uv_buf_t *buf);
+
+/**
+ * Decompress the entries data in @buf straight into @batch, the buffer that
+ * raft_io_uv_decode__entries_batch() will slice. The length of @batch must
+ * match the size of the original data.
+ */
+int raft_io_uv_decode__entries_compressed(const uv_buf_t *buf,
+                                          struct raft_buffer *batch);
+
 #endif /* RAFT_IO_UV_ENCODING_H */
@@ -1,21 +1,233 @@
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "assert.h"
 #include "binary.h"
+#include "checksum.h"
 #include "io_uv_encoding.h"
 #include "io_uv_rpc.h"
+#include "lz4.h"
 
 /**
- * Protocol version.
+ * Version of the handshake that the transport sends when connecting. This
+ * never changes, so servers running different releases can always connect.
  */
 #define RAFT_IO_UV_RPC__PROTOCOL 1
 
 /**
- * Retry to connect every second.
+ * Version of the RPC message format.
  *
- * TODO: implement an exponential backoff instead.
+ * When a server accepts a new connection, it sends back a hello message with
+ * its own version and the optional features it supports. The connecting
+ * server then uses the lowest of the two versions and only the features that
+ * both support. Servers that predate version 2 don't send any hello, so until
+ * one arrives messages are sent in the version 1 format, without optional
+ * features.
  */
-#define RAFT_IO_UV_RPC_CLIENT__CONNECT_RETRY_DELAY 1000
+#define RAFT_IO_UV_RPC__VERSION 2
+
+/**
+ * Optional features advertised in the hello message.
+ */
+#define RAFT_IO_UV_RPC__FEATURE_CHECKSUM (1 << 0) /* Verify message checksums */
+#define RAFT_IO_UV_RPC__FEATURE_COMPRESSION (1 << 1) /* Decompress entries */
+#define RAFT_IO_UV_RPC__FEATURES \
+    (RAFT_IO_UV_RPC__FEATURE_CHECKSUM | RAFT_IO_UV_RPC__FEATURE_COMPRESSION)
+
+/**
+ * Per-message flags, stored in the upper 32 bits of the type word of the
+ * preamble. A flag can be set only if the matching feature was negotiated.
+ *
+ * Each flag adds one word after the preamble, in the order of the flag bits.
+ */
+#define RAFT_IO_UV_RPC__FLAG_CHECKSUM (1 << 0)   /* Preamble has checksums */
+#define RAFT_IO_UV_RPC__FLAG_COMPRESSED (1 << 1) /* Entries data is LZ4 */
+#define RAFT_IO_UV_RPC__FLAGS \
+    (RAFT_IO_UV_RPC__FLAG_CHECKSUM | RAFT_IO_UV_RPC__FLAG_COMPRESSED)
+
+/**
+ * Size of the hello message, holding the version and the features bitmask.
+ */
+#define RAFT_IO_UV_RPC__HELLO_SIZE (sizeof(uint64_t) * 2)
+
+/**
+ * Delay before the first connection retry. It doubles after each consecutive
+ * failed attempt, up to the maximum below.
+ */
+#define RAFT_IO_UV_RPC_CLIENT__CONNECT_RETRY_DELAY 50
+
+/**
+ * Maximum delay between connection retries.
+ */
+#define RAFT_IO_UV_RPC_CLIENT__CONNECT_RETRY_MAX_DELAY 5000
+
+/**
+ * Maximum number of bytes of requests that are buffered while a server is not
+ * connected, to be written out as soon as the connection is established.
+ */
+#define RAFT_IO_UV_RPC_CLIENT__MAX_PENDING_BYTES (1024 * 1024)
+
+/**
+ * Maximum time in milliseconds that a request can stay buffered while a server
+ * is not connected. Once it's over, the request fails.
+ */
+#define RAFT_IO_UV_RPC_CLIENT__PENDING_TIMEOUT 5000
+
+/**
+ * Maximum number of bytes of queued requests that get coalesced into a single
+ * write. A request larger than this is still written out, on its own.
+ */
+#define RAFT_IO_UV_RPC_CLIENT__MAX_WRITE_SIZE (1024 * 1024)
+
+/**
+ * Maximum number of pending incoming connections. Each server might open
+ * several connections to us at once, one per stripe.
+ */
+#define RAFT_IO_UV_TCP__BACKLOG 64
+
+/**
+ * Maximum length of the host and port parts of a TCP address, including the
+ * terminating null byte.
+ */
+#define RAFT_IO_UV_TCP__MAX_HOST_LEN 256
+#define RAFT_IO_UV_TCP__MAX_PORT_LEN 6
+
+/**
+ * Port used when a TCP address doesn't specify one.
+ */
+#define RAFT_IO_UV_TCP__DEFAULT_PORT "8080"
+
+/**
+ * Size of the preamble of every message, holding its type and header length.
+ */
+#define RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE (sizeof(uint64_t) * 2)
+
+/**
+ * Size of each word following the preamble of messages with flags set.
+ *
+ * With the checksum flag, it holds the CRC32C of the header in its lower 32
+ * bits and the CRC32C of the uncompressed payload in its upper 32 bits.
+ *
+ * With the compressed flag, it holds the size of the compressed payload.
+ */
+#define RAFT_IO_UV_RPC_SERVER__EXTRA_SIZE sizeof(uint64_t)
+
+/**
+ * Initial size of the per-connection receive buffer. Small messages are read
+ * into it in bulk, so a single read can deliver many of them.
+ */
+#define RAFT_IO_UV_RPC_SERVER__BUF_SIZE (64 * 1024)
+
+/**
+ * Payloads larger than this are read directly into their final buffer instead
+ * of being copied out of the receive buffer.
+ */
+#define RAFT_IO_UV_RPC_SERVER__PAYLOAD_THRESHOLD (16 * 1024)
+
+/**
+ * Drop a reference to the given encoded entries, releasing them if it was the
+ * last one.
+ */
+static void raft_io_uv_rpc_entries__unref(struct raft_io_uv_rpc_entries *e)
+{
+    assert(e->refs > 0);
+
+    e->refs--;
+    if (e->refs == 0) {
+        if (e->compressed.base != NULL) {
+            raft_free(e->compressed.base);
+        }
+        raft_free(e);
+    }
+}
+
+/**
+ * Forget about the entries that were encoded last, so they won't be shared by
+ * requests submitted from now on.
+ */
+static void raft_io_uv_rpc__forget_entries(struct raft_io_uv_rpc *r)
+{
+    if (r->entries != NULL) {
+        raft_io_uv_rpc_entries__unref(r->entries);
+        r->entries = NULL;
+    }
+}
+
+/**
+ * Return a reference to the encoded form of the entries of the given
+ * AppendEntries message.
+ *
+ * When a leader replicates new entries it sends the very same entries array to
+ * all followers with the same next index, within the same loop iteration. The
+ * last encoded entries are kept around until the end of the loop iteration, and
+ * re-used if a request for the same entries array comes in, so the batch header
+ * and the buffers array are built only once.
+ *
+ * Since all requests are queued until the end of the loop iteration, the
+ * entries array can't be released and re-allocated in the meantime.
+ */
+static int raft_io_uv_rpc__encode_entries(struct raft_io_uv_rpc *r,
+                                          const struct raft_append_entries *args,
+                                          struct raft_io_uv_rpc_entries **entries)
+{
+    struct raft_io_uv_rpc_entries *e;
+    size_t header_len;
+    unsigned i;
+
+    if (r->entries != NULL && r->entries->key == args->entries &&
+        r->entries->n == args->n_entries) {
+        r->entries->refs++;
+        *entries = r->entries;
+        return 0;
+    }
+
+    header_len = raft_io_uv_sizeof__batch_header(args->n_entries);
+
+    /* Allocate the entries object, its buffers array and the batch header in
+     * one go. */
+    e = raft_malloc(sizeof *e + (1 + args->n_entries) * sizeof *e->bufs +
+                    header_len);
+    if (e == NULL) {
+        return RAFT_ERR_NOMEM;
+    }
+
+    e->refs = 1;
+    e->key = args->entries;
+    e->n = args->n_entries;
+    e->checksummed = false;
+    e->crc = 0;
+    e->compressed_tried = false;
+    e->compressed.base = NULL;
+    e->compressed.len = 0;
+    e->bufs = (uv_buf_t *)(e + 1);
+    e->n_bufs = 1 + args->n_entries;
+
+    e->bufs[0].base = (char *)(e->bufs + e->n_bufs);
+    e->bufs[0].len = header_len;
+
+    raft_io_uv_encode__batch_header(args->entries, args->n_entries,
+                                    e->bufs[0].base);
+
+    for (i = 0; i < args->n_entries; i++) {
+        e->bufs[i + 1].base = args->entries[i].buf.base;
+        e->bufs[i + 1].len = args->entries[i].buf.len;
+    }
+
+    /* Replace the last encoded entries with these ones. */
+    raft_io_uv_rpc__forget_entries(r);
+    r->entries = e;
+    e->refs++;
+
+    *entries = e;
+
+    return 0;
+}
 
 /**
  * Initialize the given request object, encoding the given @message.
@@ -24,23 +236,151 @@
  * successfully or not).
  */
 static int raft_io_uv_rpc_request__init(struct raft_io_uv_rpc_request *r,
+                                        struct raft_io_uv_rpc *rpc,
                                         const struct raft_message *message,
                                         void *data,
                                         void (*cb)(void *data,
                                                    const int status))
 {
+    unsigned i;
     int rv;
 
-    r->req.data = r;
+    r->client = NULL;
+    r->next = NULL;
     r->data = data;
     r->cb = cb;
+    r->entries = NULL;
 
-    rv = raft_io_uv_encode__message(message, &r->bufs, &r->n_bufs);
+    rv = raft_io_uv_encode__header(message, &r->header);
     if (rv != 0) {
-        return rv;
+        goto err;
+    }
+
+    r->len = r->header.len;
+
+    if (message->type == RAFT_IO_APPEND_ENTRIES) {
+        rv = raft_io_uv_rpc__encode_entries(rpc, &message->append_entries,
+                                            &r->entries);
+        if (rv != 0) {
+            goto err_after_header_encode;
+        }
+
+        for (i = 0; i < r->entries->n_bufs; i++) {
+            r->len += r->entries->bufs[i].len;
+        }
     }
 
     return 0;
+
+err_after_header_encode:
+    raft_free(r->header.base);
+
+err:
+    assert(rv != 0);
+
+    return rv;
+}
+
+/**
+ * Return the CRC32C of the data of the given encoded entries, excluding the
+ * batch header. It's calculated once and shared by all requests carrying the
+ * same entries.
+ */
+static unsigned raft_io_uv_rpc_entries__crc(struct raft_io_uv_rpc_entries *e)
+{
+    unsigned i;
+
+    if (!e->checksummed) {
+        e->crc = 0;
+        for (i = 1; i < e->n_bufs; i++) {
+            e->crc = raft__crc32c(e->bufs[i].base, e->bufs[i].len, e->crc);
+        }
+        e->checksummed = true;
+    }
+
+    return e->crc;
+}
+
+/**
+ * Return the compressed data of the given encoded entries, or NULL if it
+ * couldn't be made smaller. It's calculated once and shared by all requests
+ * carrying the same entries.
+ */
+static uv_buf_t *raft_io_uv_rpc_entries__compressed(
+    struct raft_io_uv_rpc_entries *e)
+{
+    int rv;
+
+    if (!e->compressed_tried) {
+        e->compressed_tried = true;
+
+        /* If we run out of memory, just send the entries uncompressed. */
+        rv = raft_io_uv_encode__entries_compressed(e->bufs + 1, e->n_bufs - 1,
+                                                   &e->compressed);
+        if (rv != 0) {
+            e->compressed.base = NULL;
+        }
+    }
+
+    if (e->compressed.base == NULL) {
+        return NULL;
+    }
+
+    return &e->compressed;
+}
+
+/**
+ * Set the flags in the preamble of the given request and fill the words that
+ * follow it. Entries data is compressed if it's at least @threshold bytes long,
+ * or never if @threshold is 0.
+ */
+static void raft_io_uv_rpc_request__prepare(struct raft_io_uv_rpc_request *r,
+                                            bool checksum,
+                                            size_t threshold)
+{
+    uint64_t *preamble = (uint64_t *)r->header.base;
+    uint64_t flags = 0;
+    unsigned header_crc;
+    unsigned payload_crc = 0;
+    size_t size;
+
+    r->n_extra = 0;
+    r->compressed = NULL;
+
+    if (checksum) {
+        flags |= RAFT_IO_UV_RPC__FLAG_CHECKSUM;
+
+        header_crc = raft__crc32c(
+            r->header.base + RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE,
+            r->header.len - RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE, 0);
+
+        /* For AppendEntries messages the batch header is part of the message
+         * header too. */
+        if (r->entries != NULL) {
+            header_crc = raft__crc32c(r->entries->bufs[0].base,
+                                      r->entries->bufs[0].len, header_crc);
+            payload_crc = raft_io_uv_rpc_entries__crc(r->entries);
+        }
+
+        r->extra[r->n_extra] = raft__flip64((uint64_t)header_crc |
+                                            ((uint64_t)payload_crc << 32));
+        r->n_extra++;
+    }
+
+    if (threshold > 0 && r->entries != NULL) {
+        size = r->len - r->header.len - r->entries->bufs[0].len;
+        if (size >= threshold) {
+            r->compressed = raft_io_uv_rpc_entries__compressed(r->entries);
+        }
+        if (r->compressed != NULL) {
+            flags |= RAFT_IO_UV_RPC__FLAG_COMPRESSED;
+            r->extra[r->n_extra] = raft__flip64(r->compressed->len);
+            r->n_extra++;
+        }
+    }
+
+    preamble[0] = raft__flip64((raft__flip64(preamble[0]) & 0xffffffff) |
+                               (flags << 32));
 }
 
 /**
@@ -48,15 +388,44 @@ static int raft_io_uv_rpc_request__init(struct raft_io_uv_rpc_request *r,
  */
 static void raft_io_uv_rpc_request__close(struct raft_io_uv_rpc_request *r)
 {
-    assert(r->bufs != NULL);
-    assert(r->bufs[0].base != NULL);
+    assert(r->header.base != NULL);
+
+    raft_free(r->header.base);
+
+    /* The entries payloads were passed to us but we don't own them, just drop
+     * our reference to their encoded form. */
+    if (r->entries != NULL) {
+        raft_io_uv_rpc_entries__unref(r->entries);
+    }
+}
+
+/**
+ * Invoke the callback of each request in the given list and release them.
+ */
+static void raft_io_uv_rpc_request__finish(struct raft_io_uv_rpc_request *head,
+                                           const int status)
+{
+    while (head != NULL) {
+        struct raft_io_uv_rpc_request *r = head;
+        struct raft_io_uv_rpc_client *c = r->client;
+
+        head = r->next;
+
+        /* Update the outstanding bytes of the client, clearing its congested
+         * flag once they drop below the low watermark. */
+        assert(c->n_bytes >= r->len);
+        c->n_bytes -= r->len;
+        if (c->congested && c->n_bytes <= c->rpc->low_watermark) {
+            c->congested = false;
+        }
 
-    /* Just release the first buffer. Further buffers are entry payloads, which
-     * we were passed but we don't own. */
-    raft_free(r->bufs[0].base);
+        if (r->cb != NULL) {
+            r->cb(r->data, status);
+        }
 
-    /* Release the buffers array. */
-    raft_free(r->bufs);
+        raft_io_uv_rpc_request__close(r);
+        raft_free(r);
+    }
 }
 
 /**
@@ -66,7 +435,8 @@ static void raft_io_uv_rpc_request__close(struct raft_io_uv_rpc_request *r)
 static int raft_io_uv_rpc_client__init(struct raft_io_uv_rpc_client *c,
                                        struct raft_io_uv_rpc *rpc,
                                        unsigned id,
-                                       const char *address)
+                                       const char *address,
+                                       unsigned stripe)
 {
     int rv;
 
@@ -75,6 +445,16 @@ static int raft_io_uv_rpc_client__init(struct raft_io_uv_rpc_client *c,
     c->req.data = c;
     c->stream = NULL;
     c->id = id;
+    c->stripe = stripe;
+    c->entries = false;
+    c->head = NULL;
+    c->tail = NULL;
+    c->n_bytes = 0;
+    c->congested = false;
+    c->n_attempts = 0;
+    c->version = 1;
+    c->features = 0;
+    c->hello_n = 0;
 
     /* Make a copy of the address string */
     c->address = raft_malloc(strlen(address) + 1);
@@ -97,6 +477,7 @@ err:
  */
 static void raft_io_uv_rpc_client__close(struct raft_io_uv_rpc_client *c)
 {
+    assert(c->head == NULL);
     assert(c->address != NULL);
     raft_free(c->address);
 }
@@ -113,8 +494,161 @@ static void raft_io_uv_rpc_client__connect_stream_close_cb(uv_handle_t *handle)
     raft_free(handle);
 }
 
-/* Forward declaration */
+/* Forward declarations */
 static void raft_io_uv_rpc_client__timer_cb(uv_timer_t *timer);
+static void raft_io_uv_rpc__flush_cb(uv_check_t *check);
+static void raft_io_uv_rpc_client__schedule(struct raft_io_uv_rpc_client *c);
+
+/**
+ * Drop a broken connection and schedule a new connection attempt.
+ */
+static void raft_io_uv_rpc_client__disconnect(struct raft_io_uv_rpc_client *c)
+{
+    assert(c->stream != NULL);
+
+    uv_close((uv_handle_t *)c->stream,
+             raft_io_uv_rpc_client__connect_stream_close_cb);
+    c->stream = NULL;
+
+    raft_io_uv_rpc_client__schedule(c);
+}
+
+/**
+ * Callback invoked to get a buffer for reading the hello message.
+ */
+static void raft_io_uv_rpc_client__alloc_cb(uv_handle_t *handle,
+                                            size_t suggested_size,
+                                            uv_buf_t *buf)
+{
+    struct raft_io_uv_rpc_client *c = handle->data;
+
+    (void)suggested_size;
+
+    /* Once the hello has been received, nothing else is expected. Any data
+     * still needs a buffer though, and will be treated as an error. */
+    if (c->hello_n == RAFT_IO_UV_RPC__HELLO_SIZE) {
+        buf->base = (char *)c->hello;
+        buf->len = sizeof c->hello;
+        return;
+    }
+
+    buf->base = (char *)c->hello + c->hello_n;
+    buf->len = RAFT_IO_UV_RPC__HELLO_SIZE - c->hello_n;
+}
+
+/**
+ * Callback invoked when data has been read from an outgoing connection, which
+ * happens only when the other server sends its hello message or closes the
+ * connection.
+ */
+static void raft_io_uv_rpc_client__read_cb(uv_stream_t *stream,
+                                           ssize_t nread,
+                                           const uv_buf_t *buf)
+{
+    struct raft_io_uv_rpc_client *c = stream->data;
+    unsigned version;
+
+    (void)buf;
+
+    if (nread == 0) {
+        return;
+    }
+
+    if (nread > 0 && c->hello_n < RAFT_IO_UV_RPC__HELLO_SIZE) {
+        c->hello_n += (size_t)nread;
+        if (c->hello_n < RAFT_IO_UV_RPC__HELLO_SIZE) {
+            return;
+        }
+
+        version = (unsigned)raft__flip64(c->hello[0]);
+        if (version > RAFT_IO_UV_RPC__VERSION) {
+            version = RAFT_IO_UV_RPC__VERSION;
+        }
+
+        c->version = version;
+        c->features = raft__flip64(c->hello[1]) & RAFT_IO_UV_RPC__FEATURES;
+
+        return;
+    }
+
+    if (nread > 0) {
+        raft_warnf(c->rpc->logger, "unexpected data from server %u", c->id);
+    } else {
+        raft_warnf(c->rpc->logger, "receive: %s", uv_strerror(nread));
+    }
+
+    raft_io_uv_rpc_client__disconnect(c);
+}
+
+/**
+ * Fail the buffered requests that have been waiting for a connection for too
+ * long. Requests are queued in submission order, so they can only expire from
+ * the head of the queue.
+ */
+static void raft_io_uv_rpc_client__expire(struct raft_io_uv_rpc_client *c)
+{
+    struct raft_io_uv_rpc_request *head = c->head;
+    struct raft_io_uv_rpc_request *tail = NULL;
+    uint64_t now = uv_now(c->rpc->loop);
+
+    while (c->head != NULL && now - c->head->time >= c->rpc->pending_timeout) {
+        tail = c->head;
+        c->head = tail->next;
+    }
+
+    if (tail == NULL) {
+        return;
+    }
+
+    if (c->head == NULL) {
+        c->tail = NULL;
+    }
+    tail->next = NULL;
+
+    raft_warnf(c->rpc->logger, "server %u unreachable: drop buffered requests",
+               c->id);
+
+    raft_io_uv_rpc_request__finish(head, RAFT_ERR_IO_CONNECT);
+}
+
+/**
+ * Schedule the next connection attempt.
+ *
+ * The delay grows exponentially with the number of consecutive failed
+ * attempts, and is then picked at random in its upper half, so servers that
+ * lost their connections at the same time don't all retry in lockstep. It's
+ * capped by the time left before the oldest buffered request expires.
+ */
+static void raft_io_uv_rpc_client__schedule(struct raft_io_uv_rpc_client *c)
+{
+    unsigned delay = c->rpc->connect_retry_delay;
+    unsigned max_delay = c->rpc->connect_retry_max_delay;
+    unsigned i;
+    int rv;
+
+    raft_io_uv_rpc_client__expire(c);
+
+    for (i = 0; i < c->n_attempts && delay < max_delay; i++) {
+        delay *= 2;
+    }
+    if (delay > max_delay) {
+        delay = max_delay;
+    }
+
+    c->n_attempts++;
+
+    delay = delay / 2 + (unsigned)rand() % (delay / 2 + 1);
+
+    if (c->head != NULL) {
+        uint64_t elapsed = uv_now(c->rpc->loop) - c->head->time;
+        if (delay > c->rpc->pending_timeout - elapsed) {
+            delay = (unsigned)(c->rpc->pending_timeout - elapsed);
+        }
+    }
+
+    rv = uv_timer_start(&c->timer, raft_io_uv_rpc_client__timer_cb, delay, 0);
+    assert(rv == 0);
+}
 
 /**
  * Callback invoked after a connection attempt completed (either successfully or
@@ -131,8 +665,25 @@ static void raft_io_uv_rpc_client__connect_cb(void *data, int status)
         return;
     }
 
-    /* The connection attempt was successful. We're good. */
+    /* The connection attempt was successful. Write out any request that was
+     * buffered while the stream was not yet writable, for example because
+     * the address of the server was being resolved. */
     if (status == 0) {
+        c->n_attempts = 0;
+        if (c->head != NULL) {
+            rv = uv_check_start(&c->rpc->flush, raft_io_uv_rpc__flush_cb);
+            assert(rv == 0);
+        }
+
+        /* Wait for the hello message of the other server. Reading also lets
+         * us notice right away if the connection gets closed. */
+        rv = uv_read_start(c->stream, raft_io_uv_rpc_client__alloc_cb,
+                           raft_io_uv_rpc_client__read_cb);
+        if (rv != 0) {
+            /* UNTESTED: we'll just keep using version 1 */
+            raft_warnf(c->rpc->logger, "start reading: %s", uv_strerror(rv));
+        }
+
         return;
     }
 
@@ -145,9 +696,7 @@ static void raft_io_uv_rpc_client__connect_cb(void *data, int status)
 
     c->stream = NULL;
 
-    rv = uv_timer_start(&c->timer, raft_io_uv_rpc_client__timer_cb,
-                        c->rpc->connect_retry_delay, 0);
-    assert(rv == 0);
+    raft_io_uv_rpc_client__schedule(c);
 }
 
 /**
@@ -159,6 +708,12 @@ static void raft_io_uv_rpc_client__connect(struct raft_io_uv_rpc_client *c)
 
     assert(c->stream == NULL);
 
+    /* Until the other server says otherwise, assume it only supports the first
+     * version of the protocol. */
+    c->version = 1;
+    c->features = 0;
+    c->hello_n = 0;
+
     /* Trigger a connection attempt. */
     rv = c->rpc->transport->connect(c->rpc->transport, c->id, c->address,
                                     &c->stream, c,
@@ -167,9 +722,7 @@ static void raft_io_uv_rpc_client__connect(struct raft_io_uv_rpc_client *c)
         assert(c->stream == NULL);
 
         /* Restart the timer, so we can retry. */
-        rv = uv_timer_start(&c->timer, raft_io_uv_rpc_client__timer_cb,
-                            c->rpc->connect_retry_delay, 0);
-        assert(rv == 0);
+        raft_io_uv_rpc_client__schedule(c);
 
         return;
     }
@@ -178,6 +731,13 @@ static void raft_io_uv_rpc_client__connect(struct raft_io_uv_rpc_client *c)
 
     c->stream->data = c;
     c->rpc->n_active++;
+
+    /* Write out any request that was buffered while we were disconnected. The
+     * OS will hold the data until the connection is established. */
+    if (c->head != NULL) {
+        rv = uv_check_start(&c->rpc->flush, raft_io_uv_rpc__flush_cb);
+        assert(rv == 0);
+    }
 }
 
 /**
@@ -189,10 +749,32 @@ static void raft_io_uv_rpc_client__timer_cb(uv_timer_t *timer)
 
     assert(c->stream == NULL);
 
+    raft_io_uv_rpc_client__expire(c);
+
     /* Retry to connect. */
     raft_io_uv_rpc_client__connect(c);
 }
 
+/**
+ * Connect right away if we're waiting to retry, for example because the server
+ * has just connected to us, which means that it's probably reachable again.
+ */
+static void raft_io_uv_rpc_client__reconnect(struct raft_io_uv_rpc_client *c)
+{
+    int rv;
+
+    if (c->stream != NULL) {
+        return;
+    }
+
+    rv = uv_timer_stop(&c->timer);
+    assert(rv == 0);
+
+    c->n_attempts = 0;
+
+    raft_io_uv_rpc_client__connect(c);
+}
+
 /**
  * Start the client by making the first connection attempt.
  */
@@ -269,6 +851,201 @@ static void raft_io_uv_rpc_client__stop(struct raft_io_uv_rpc_client *c)
 
     uv_close((struct uv_handle_s *)&c->timer,
              raft_io_uv_rpc_client__timer_close_cb);
+
+    /* Fail any request that was not yet written. */
+    raft_io_uv_rpc_request__finish(c->head, RAFT_ERR_IO_ABORTED);
+    c->head = NULL;
+    c->tail = NULL;
+}
+
+/**
+ * Return true if messages sent to the server must carry checksums.
+ */
+static bool raft_io_uv_rpc_client__checksum(struct raft_io_uv_rpc_client *c)
+{
+    return c->rpc->checksums && c->version >= 2 &&
+           (c->features & RAFT_IO_UV_RPC__FEATURE_CHECKSUM);
+}
+
+/**
+ * Return the minimum size of the entries data that gets compressed when sent
+ * to the server, or 0 if compression is disabled.
+ */
+static size_t raft_io_uv_rpc_client__compression(
+    struct raft_io_uv_rpc_client *c)
+{
+    if (c->version < 2 ||
+        !(c->features & RAFT_IO_UV_RPC__FEATURE_COMPRESSION)) {
+        return 0;
+    }
+
+    return c->rpc->compression_threshold;
+}
+
+/**
+ * Return the number of buffers needed to write the given prepared request.
+ * Extra words are inserted between the preamble and the rest of the header,
+ * which takes two more buffers, and compressed entries data takes a single
+ * buffer.
+ */
+static unsigned raft_io_uv_rpc_request__n_bufs(struct raft_io_uv_rpc_request *r)
+{
+    unsigned n = 1 + (r->n_extra > 0 ? 2 : 0);
+
+    if (r->entries == NULL) {
+        return n;
+    }
+
+    return n + (r->compressed != NULL ? 2 : r->entries->n_bufs);
+}
+
+static void raft_io_uv_rpc__write_cb(struct uv_write_s *req, int status)
+{
+    struct raft_io_uv_rpc_write *w = req->data;
+    struct raft_io_uv_rpc_client *c = w->head->client;
+
+    /* If the connection broke, for example because the other server was
+     * restarted, drop it and start connecting again. Unless we're stopping,
+     * or the stream was already replaced. */
+    if (status != 0 && c->stream == req->handle) {
+        raft_warnf(c->rpc->logger, "write: %s", uv_strerror(status));
+        raft_io_uv_rpc_client__disconnect(c);
+    }
+
+    raft_io_uv_rpc_request__finish(w->head, status);
+    raft_free(w);
+}
+
+/**
+ * Write out all queued requests, coalescing them into as few writes as
+ * possible.
+ */
+static void raft_io_uv_rpc_client__flush(struct raft_io_uv_rpc_client *c)
+{
+    bool checksum;
+    size_t threshold;
+
+    /* Keep requests buffered until the connection is re-established. A stream
+     * that is not writable belongs to an attempt that has already failed and
+     * whose callback will schedule the next one. */
+    if (c->stream == NULL || !uv_is_writable(c->stream)) {
+        return;
+    }
+
+    checksum = raft_io_uv_rpc_client__checksum(c);
+    threshold = raft_io_uv_rpc_client__compression(c);
+
+    while (c->head != NULL) {
+        struct raft_io_uv_rpc_request *head = c->head;
+        struct raft_io_uv_rpc_request *tail = c->head;
+        struct raft_io_uv_rpc_request *r;
+        struct raft_io_uv_rpc_write *w;
+        unsigned n_bufs;
+        size_t len = tail->len;
+        unsigned i;
+        int rv;
+
+        raft_io_uv_rpc_request__prepare(tail, checksum, threshold);
+        n_bufs = raft_io_uv_rpc_request__n_bufs(tail);
+
+        /* Pick as many requests as fit in a single write. */
+        while (tail->next != NULL &&
+               len + tail->next->len <= RAFT_IO_UV_RPC_CLIENT__MAX_WRITE_SIZE) {
+            tail = tail->next;
+            raft_io_uv_rpc_request__prepare(tail, checksum, threshold);
+            n_bufs += raft_io_uv_rpc_request__n_bufs(tail);
+            len += tail->len;
+        }
+
+        /* Detach the picked requests from the queue. */
+        c->head = tail->next;
+        if (c->head == NULL) {
+            c->tail = NULL;
+        }
+        tail->next = NULL;
+
+        /* Allocate the write object and its buffers array in one go. */
+        w = raft_malloc(sizeof *w + n_bufs * sizeof *w->bufs);
+        if (w == NULL) {
+            raft_io_uv_rpc_request__finish(head, RAFT_ERR_NOMEM);
+            continue;
+        }
+
+        w->req.data = w;
+        w->head = head;
+        w->bufs = (uv_buf_t *)(w + 1);
+        w->n_bufs = 0;
+
+        for (r = head; r != NULL; r = r->next) {
+            if (r->n_extra > 0) {
+                w->bufs[w->n_bufs].base = r->header.base;
+                w->bufs[w->n_bufs].len = RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE;
+                w->n_bufs++;
+
+                w->bufs[w->n_bufs].base = (char *)r->extra;
+                w->bufs[w->n_bufs].len = r->n_extra * sizeof *r->extra;
+                w->n_bufs++;
+
+                w->bufs[w->n_bufs].base =
+                    r->header.base + RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE;
+                w->bufs[w->n_bufs].len =
+                    r->header.len - RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE;
+                w->n_bufs++;
+            } else {
+                w->bufs[w->n_bufs] = r->header;
+                w->n_bufs++;
+            }
+
+            if (r->entries == NULL) {
+                continue;
+            }
+
+            if (r->compressed != NULL) {
+                w->bufs[w->n_bufs] = r->entries->bufs[0];
+                w->n_bufs++;
+                w->bufs[w->n_bufs] = *r->compressed;
+                w->n_bufs++;
+                continue;
+            }
+
+            for (i = 0; i < r->entries->n_bufs; i++) {
+                w->bufs[w->n_bufs] = r->entries->bufs[i];
+                w->n_bufs++;
+            }
+        }
+
+        assert(w->n_bufs == n_bufs);
+
+        rv = uv_write(&w->req, c->stream, w->bufs, w->n_bufs,
+                      raft_io_uv_rpc__write_cb);
+        if (rv != 0) {
+            /* UNTESTED: what are the error conditions? perhaps ENOMEM */
+            raft_free(w);
+            raft_io_uv_rpc_request__finish(head, RAFT_ERR_IO);
+        }
+    }
+}
+
+/**
+ * Callback invoked at the end of every loop iteration in which at least one
+ * request was queued.
+ */
+static void raft_io_uv_rpc__flush_cb(uv_check_t *check)
+{
+    struct raft_io_uv_rpc *r = check->data;
+    unsigned i;
+    int rv;
+
+    /* Requests submitted from now on won't share the entries encoded in this
+     * loop iteration. */
+    raft_io_uv_rpc__forget_entries(r);
+
+    for (i = 0; i < r->n_clients; i++) {
+        raft_io_uv_rpc_client__flush(r->clients[i]);
+    }
+
+    rv = uv_check_stop(&r->flush);
+    assert(rv == 0);
 }
 
 /**
@@ -281,29 +1058,38 @@ static int raft_io_uv_rpc_server__init(struct raft_io_uv_rpc_server *s,
                                        const char *address,
                                        struct uv_stream_s *stream)
 {
+    int rv;
+
     s->rpc = rpc;
     s->id = id;
 
     /* Make a copy of the address. */
     s->address = raft_malloc(strlen(address) + 1);
     if (s->address == NULL) {
-        return RAFT_ERR_NOMEM;
+        rv = RAFT_ERR_NOMEM;
+        goto err;
     }
     strcpy(s->address, address);
 
     s->stream = stream;
 
-    s->buf.base = NULL;
-    s->buf.len = 0;
-
-    s->preamble[0] = 0;
-    s->preamble[1] = 0;
+    s->buf.base = raft_malloc(RAFT_IO_UV_RPC_SERVER__BUF_SIZE);
+    if (s->buf.base == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_address_alloc;
+    }
+    s->buf.len = RAFT_IO_UV_RPC_SERVER__BUF_SIZE;
 
-    s->header.base = NULL;
-    s->header.len = 0;
+    s->start = 0;
+    s->end = 0;
 
     s->payload.base = NULL;
     s->payload.len = 0;
+    s->payload_n = 0;
+    s->payload_checksum = false;
+    s->payload_crc = 0;
+    s->payload_compressed = false;
+    s->payload_size = 0;
 
     s->aborted = false;
 
@@ -312,6 +1098,14 @@ static int raft_io_uv_rpc_server__init(struct raft_io_uv_rpc_server *s,
     rpc->n_active++;
 
     return 0;
+
+err_after_address_alloc:
+    raft_free(s->address);
+
+err:
+    assert(rv != 0);
+
+    return rv;
 }
 
 /**
@@ -320,9 +1114,14 @@ static int raft_io_uv_rpc_server__init(struct raft_io_uv_rpc_server *s,
 static void raft_io_uv_rpc_server__close(struct raft_io_uv_rpc_server *s)
 {
     raft_free(s->address);
-
-    if (s->header.base != NULL) {
-        raft_free(s->header.base);
+    raft_free(s->buf.base);
+
+    /* If we were in the middle of receiving a payload, release it along with
+     * the entries array that was decoded from the message header. */
+    if (s->payload.base != NULL) {
+        assert(s->message.type == RAFT_IO_APPEND_ENTRIES);
+        raft_free(s->payload.base);
+        raft_free(s->message.append_entries.entries);
     }
 }
 
@@ -343,6 +1142,7 @@ static void raft_io_uv_rpc_server__stream_close_cb(uv_handle_t *handle)
     if (s->aborted) {
         raft_io_uv_rpc__remove_server(s->rpc, s);
         raft_io_uv_rpc_server__close(s);
+        raft_free(s);
     } else {
         raft_io_uv_rpc__maybe_stopped(s->rpc);
     }
@@ -372,6 +1172,15 @@ static void raft_io_uv_rpc_server__abort(struct raft_io_uv_rpc_server *s)
     raft_io_uv_rpc_server__stop(s);
 }
 
+/**
+ * Return true if the payload currently being received is large enough to be
+ * read directly into its final buffer, bypassing the receive buffer.
+ */
+static bool raft_io_uv_rpc_server__direct(struct raft_io_uv_rpc_server *s)
+{
+    return s->payload.len > RAFT_IO_UV_RPC_SERVER__PAYLOAD_THRESHOLD;
+}
+
 /**
  * Callback invoked to initialy the read buffer for the next asynchronous read
  * on the socket.
@@ -384,71 +1193,280 @@ static void raft_io_uv_rpc_server__alloc_cb(uv_handle_t *handle,
 
     (void)suggested_size;
 
-    /* If this is the first read of the preamble, or of the header, or of the
-     * payload, then initialize the read buffer, according to the chunk of data
-     * that we expect next. */
-    if (s->buf.len == 0) {
-        assert(s->buf.base == NULL);
+    /* If we're receiving a large payload, read its remaining part straight
+     * into its final buffer. */
+    if (s->payload.base != NULL && raft_io_uv_rpc_server__direct(s)) {
+        assert(s->start == s->end);
+        buf->base = s->payload.base + s->payload_n;
+        buf->len = s->payload.len - s->payload_n;
+        return;
+    }
 
-        /* Check if we expect the preamble. */
-        if (s->header.len == 0) {
-            assert(s->preamble[0] == 0);
-            assert(s->preamble[1] == 0);
+    /* Otherwise fill the free tail of the receive buffer, which might end up
+     * containing several messages at once. */
+    assert(s->end < s->buf.len);
 
-            s->buf.base = (char *)s->preamble;
-            s->buf.len = sizeof s->preamble;
+    buf->base = s->buf.base + s->end;
+    buf->len = s->buf.len - s->end;
+}
 
-            goto out;
-        }
+/**
+ * Invoke the receive callback with the message that was just received and
+ * reset the payload state.
+ */
+static void raft_io_uv_rpc_server__recv(struct raft_io_uv_rpc_server *s)
+{
+    s->message.server_id = s->id;
+    s->message.server_address = s->address;
 
-        /* Check if we expect the header. */
-        if (s->payload.len == 0) {
-            assert(s->header.len > 0);
-            assert(s->header.base == NULL);
+    s->rpc->recv.cb(s->rpc->recv.data, &s->message);
 
-            s->header.base = raft_malloc(s->header.len);
-            if (s->header.base == NULL) {
-                /* Setting all buffer fields to 0 will make read_cb fail with
-                 * ENOBUFS. */
-                memset(buf, 0, sizeof *buf);
-                return;
-            }
+    s->payload.base = NULL;
+    s->payload.len = 0;
+    s->payload_n = 0;
+}
 
-            s->buf = s->header;
-            goto out;
+/**
+ * Called when the payload of the current message has been fully received.
+ */
+static int raft_io_uv_rpc_server__recv_payload(struct raft_io_uv_rpc_server *s)
+{
+    struct raft_buffer payload;
+    int rv;
+
+    assert(s->payload.base != NULL);
+    assert(s->payload_n == s->payload.len);
+
+    /* Decompress the entries data into the buffer that will be sliced into
+     * entries and owned by the receiver of the message. */
+    if (s->payload_compressed) {
+        payload.base = raft_malloc(s->payload_size);
+        if (payload.base == NULL) {
+            raft_warnf(s->rpc->logger, "alloc payload: %s",
+                       raft_strerror(RAFT_ERR_NOMEM));
+            return RAFT_ERR_NOMEM;
+        }
+        payload.len = s->payload_size;
+
+        rv = raft_io_uv_decode__entries_compressed(&s->payload, &payload);
+        if (rv != 0) {
+            raft_free(payload.base);
+            raft_warnf(s->rpc->logger, "decompress payload: %s",
+                       raft_strerror(rv));
+            return rv;
         }
 
-        /* We should be expecting the payload. */
-        assert(s->payload.len > 0);
+        raft_free(s->payload.base);
+        s->payload.base = payload.base;
+        s->payload.len = payload.len;
+        s->payload_n = payload.len;
+        s->payload_compressed = false;
+    }
 
-        s->payload.base = raft_malloc(s->payload.len);
-        if (s->payload.base == NULL) {
-            /* Setting all buffer fields to 0 will make read_cb fail with
-             * ENOBUFS. */
-            memset(buf, 0, sizeof *buf);
-            return;
-        }
+    payload.base = s->payload.base;
+    payload.len = s->payload.len;
 
-        s->buf = s->payload;
+    /* The payload is released when the connection gets closed. */
+    if (s->payload_checksum &&
+        raft__crc32c(payload.base, payload.len, 0) != s->payload_crc) {
+        raft_warnf(s->rpc->logger, "message payload checksum mismatch");
+        return RAFT_ERR_IO_CORRUPT;
     }
 
-out:
-    *buf = s->buf;
+    switch (s->message.type) {
+        case RAFT_IO_APPEND_ENTRIES:
+            raft_io_uv_decode__entries_batch(
+                &payload, s->message.append_entries.entries,
+                s->message.append_entries.n_entries);
+            break;
+        default:
+            /* We should never have read a payload in the first place */
+            assert(0);
+    }
+
+    raft_io_uv_rpc_server__recv(s);
+
+    return 0;
 }
 
-static void raft_io_uv_rpc_server__recv(struct raft_io_uv_rpc_server *s)
+/**
+ * Move as much payload data as possible from the receive buffer to the payload
+ * buffer of the current message. Return true if the payload is complete.
+ */
+static bool raft_io_uv_rpc_server__fill_payload(
+    struct raft_io_uv_rpc_server *s)
 {
-    s->rpc->recv.cb(s->rpc->recv.data, &s->message);
+    size_t n = s->end - s->start;
 
-    memset(s->preamble, 0, sizeof s->preamble);
+    if (n > s->payload.len - s->payload_n) {
+        n = s->payload.len - s->payload_n;
+    }
 
-    raft_free(s->header.base);
+    memcpy(s->payload.base + s->payload_n, s->buf.base + s->start, n);
 
-    s->header.base = NULL;
-    s->header.len = 0;
+    s->payload_n += n;
+    s->start += n;
 
-    s->payload.base = NULL;
-    s->payload.len = 0;
+    return s->payload_n == s->payload.len;
+}
+
+/**
+ * Parse as many complete messages as possible out of the receive buffer.
+ */
+static int raft_io_uv_rpc_server__parse(struct raft_io_uv_rpc_server *s)
+{
+    int rv;
+
+    while (!uv_is_closing((struct uv_handle_s *)s->stream)) {
+        const void *cursor;
+        size_t preamble_size = RAFT_IO_UV_RPC_SERVER__PREAMBLE_SIZE;
+        uint64_t word;
+        unsigned type;
+        unsigned flags;
+        uint64_t checksum = 0;
+        uint64_t compressed_len = 0;
+        unsigned i;
+        uv_buf_t header;
+        size_t payload_len;
+
+        /* If we're in the middle of a payload, consume it first. */
+        if (s->payload.base != NULL) {
+            if (!raft_io_uv_rpc_server__fill_payload(s)) {
+                break;
+            }
+            rv = raft_io_uv_rpc_server__recv_payload(s);
+            if (rv != 0) {
+                return rv;
+            }
+            continue;
+        }
+
+        /* Check if we have a full preamble. */
+        if (s->end - s->start < preamble_size) {
+            break;
+        }
+
+        /* The preamble is not necessarily 8-byte aligned in the read buffer,
+         * since the previous payload might have had any length, so read its
+         * words with raft__get64. */
+        cursor = s->buf.base + s->start;
+
+        word = raft__get64(&cursor);
+        type = (unsigned)(word & 0xffffffff);
+        flags = (unsigned)(word >> 32);
+        header.len = raft__get64(&cursor);
+
+        if ((flags & ~RAFT_IO_UV_RPC__FLAGS) != 0) {
+            raft_warnf(s->rpc->logger, "message has unknown flags %x", flags);
+            return RAFT_ERR_IO_MALFORMED;
+        }
+
+        /* Each flag adds one more word after the preamble. */
+        for (i = 0; i < 32; i++) {
+            if (flags & (1U << i)) {
+                preamble_size += RAFT_IO_UV_RPC_SERVER__EXTRA_SIZE;
+            }
+        }
+
+        if (s->end - s->start < preamble_size) {
+            break;
+        }
+
+        if (flags & RAFT_IO_UV_RPC__FLAG_CHECKSUM) {
+            checksum = raft__get64(&cursor);
+        }
+        if (flags & RAFT_IO_UV_RPC__FLAG_COMPRESSED) {
+            compressed_len = raft__get64(&cursor);
+        }
+
+        /* The length of the header must be greater than zero. */
+        if (header.len == 0) {
+            raft_warnf(s->rpc->logger, "message has zero length");
+            return RAFT_ERR_IO_MALFORMED;
+        }
+
+        /* Check if we have the full header. If the receive buffer is too small
+         * to ever hold it, grow it. */
+        if (s->end - s->start < preamble_size + header.len) {
+            size_t size = preamble_size + header.len;
+
+            if (size >= s->buf.len) {
+                void *base = raft_realloc(s->buf.base, size + 1);
+                if (base == NULL) {
+                    raft_warnf(s->rpc->logger, "grow receive buffer: %s",
+                               raft_strerror(RAFT_ERR_NOMEM));
+                    return RAFT_ERR_NOMEM;
+                }
+                s->buf.base = base;
+                s->buf.len = size + 1;
+            }
+
+            break;
+        }
+
+        header.base = s->buf.base + s->start + preamble_size;
+
+        /* Verify the header before decoding it, so a corrupted entries count
+         * can't trigger a huge allocation. */
+        if ((flags & RAFT_IO_UV_RPC__FLAG_CHECKSUM) &&
+            raft__crc32c(header.base, header.len, 0) !=
+                (unsigned)(checksum & 0xffffffff)) {
+            raft_warnf(s->rpc->logger, "message header checksum mismatch");
+            return RAFT_ERR_IO_CORRUPT;
+        }
+
+        rv = raft_io_uv_decode__message(type, &header, &s->message,
+                                        &payload_len);
+        if (rv != 0) {
+            raft_warnf(s->rpc->logger, "decode message: %s", raft_strerror(rv));
+            return rv;
+        }
+
+        s->start += preamble_size + header.len;
+
+        /* Compressed data can't be empty, nor much larger than the original
+         * data. */
+        if ((flags & RAFT_IO_UV_RPC__FLAG_COMPRESSED) &&
+            (payload_len == 0 || compressed_len == 0 ||
+             compressed_len > raft__lz4_bound(payload_len))) {
+            if (s->message.type == RAFT_IO_APPEND_ENTRIES) {
+                raft_free(s->message.append_entries.entries);
+            }
+            raft_warnf(s->rpc->logger, "bad compressed payload size");
+            return RAFT_ERR_IO_MALFORMED;
+        }
+
+        /* If the message has no payload, we're done. */
+        if (payload_len == 0) {
+            raft_io_uv_rpc_server__recv(s);
+            continue;
+        }
+
+        /* Allocate the payload buffer, which will be owned by the receiver of
+         * the message. Compressed data is received in a temporary buffer
+         * instead. */
+        assert(s->message.type == RAFT_IO_APPEND_ENTRIES);
+
+        s->payload_compressed = (flags & RAFT_IO_UV_RPC__FLAG_COMPRESSED) != 0;
+        s->payload_size = payload_len;
+        if (s->payload_compressed) {
+            payload_len = compressed_len;
+        }
+
+        s->payload.base = raft_malloc(payload_len);
+        if (s->payload.base == NULL) {
+            raft_free(s->message.append_entries.entries);
+            raft_warnf(s->rpc->logger, "alloc payload: %s",
+                       raft_strerror(RAFT_ERR_NOMEM));
+            return RAFT_ERR_NOMEM;
+        }
+        s->payload.len = payload_len;
+        s->payload_n = 0;
+        s->payload_checksum = (flags & RAFT_IO_UV_RPC__FLAG_CHECKSUM) != 0;
+        s->payload_crc = (unsigned)(checksum >> 32);
+    }
+
+    return 0;
 }
 
 /**
@@ -463,86 +1481,47 @@ static void raft_io_uv_rpc_server__read_cb(uv_stream_t *stream,
 
     (void)buf;
 
-    /* If the read was successful, let's check if we have received all the data
-     * we expected. */
+    /* If the read was successful, let's parse the messages that we have
+     * received so far. */
     if (nread > 0) {
         size_t n = (size_t)nread;
 
-        /* We shouldn't have read more data than the pending amount. */
-        assert(n <= s->buf.len);
-
-        /* Advance the read window */
-        s->buf.base += n;
-        s->buf.len -= n;
-
-        /* If there's more data to read in order to fill the current
-         * read buffer, just return, we'll be invoked again. */
-        if (s->buf.len > 0) {
-            goto out;
-        }
-
-        if (s->header.len == 0) {
-            /* If the header buffer is not set, it means that we've just
-             * completed reading the preamble. */
-            assert(s->header.base == NULL);
+        /* If we were reading a large payload directly into its final buffer,
+         * check if it's complete. */
+        if (s->payload.base != NULL && raft_io_uv_rpc_server__direct(s)) {
+            assert(n <= s->payload.len - s->payload_n);
 
-            s->header.len = raft__flip64(s->preamble[1]);
+            s->payload_n += n;
 
-            /* The length of the header must be greater than zero. */
-            if (s->header.len == 0) {
-                raft_warnf(s->rpc->logger, "message has zero length");
-                goto abort;
+            if (s->payload_n < s->payload.len) {
+                goto out;
             }
-        } else if (s->payload.len == 0) {
-            /* If the payload buffer is not set, it means we just completed
-             * reading the message header. */
-            unsigned type;
-
-            assert(s->header.base != NULL);
 
-            type = raft__flip64(s->preamble[0]);
-            assert(type > 0);
-
-            rv = raft_io_uv_decode__message(type, &s->header, &s->message,
-                                            &s->payload.len);
+            rv = raft_io_uv_rpc_server__recv_payload(s);
             if (rv != 0) {
-                raft_warnf(s->rpc->logger, "decode message: %s",
-                           raft_strerror(rv));
                 goto abort;
             }
 
-            s->message.server_id = s->id;
-            s->message.server_address = s->address;
+            goto out;
+        }
 
-            /* If the message has no payload, we're done. */
-            if (s->payload.len == 0) {
-                raft_io_uv_rpc_server__recv(s);
-            }
-        } else {
-            /* If we get here it means that we've just completed reading the
-             * payload. */
-            assert(s->payload.base != NULL);
-            assert(s->payload.len > 0);
-
-            switch (s->message.type) {
-                case RAFT_IO_APPEND_ENTRIES:
-                    raft_io_uv_decode__entries_batch(
-                        &s->payload, s->message.append_entries.entries,
-                        s->message.append_entries.n_entries);
-                    break;
-                default:
-                    /* We should never have read a payload in the first place */
-                    assert(0);
-            }
+        /* We shouldn't have read more data than the free space. */
+        assert(n <= s->buf.len - s->end);
 
-            raft_io_uv_rpc_server__recv(s);
+        s->end += n;
+
+        rv = raft_io_uv_rpc_server__parse(s);
+        if (rv != 0) {
+            goto abort;
         }
 
-        /* Mark that we're done with this chunk. When the alloc callback will
-         * trigger again it will notice that it needs to change the read
-         * buffer. */
-        assert(s->buf.len == 0);
-        s->buf.base = NULL;
+        /* Move any leftover partial message at the beginning of the buffer, so
+         * the next read has as much room as possible. */
+        if (s->start > 0) {
+            memmove(s->buf.base, s->buf.base + s->start, s->end - s->start);
+            s->end -= s->start;
+            s->start = 0;
+        }
 
         goto out;
     }
@@ -569,11 +1548,19 @@ out:
     return;
 }
 
+static void raft_io_uv_rpc_server__hello_cb(struct uv_write_s *req,
+                                            int status)
+{
+    (void)req;
+    (void)status;
+}
+
 /**
- * Start reading incoming requests.
+ * Start reading incoming requests and send our hello message.
  */
 static int raft_io_uv_rpc_server__start(struct raft_io_uv_rpc_server *s)
 {
+    uv_buf_t buf;
     int rv;
 
     rv = uv_read_start(s->stream, raft_io_uv_rpc_server__alloc_cb,
@@ -583,6 +1570,21 @@ static int raft_io_uv_rpc_server__start(struct raft_io_uv_rpc_server *s)
         return RAFT_ERR_IO;
     }
 
+    /* Tell the other server which protocol version and features we
+     * support. */
+    s->hello[0] = raft__flip64(RAFT_IO_UV_RPC__VERSION);
+    s->hello[1] = raft__flip64(RAFT_IO_UV_RPC__FEATURES);
+
+    buf.base = (char *)s->hello;
+    buf.len = sizeof s->hello;
+
+    rv = uv_write(&s->hello_req, s->stream, &buf, 1,
+                  raft_io_uv_rpc_server__hello_cb);
+    if (rv != 0) {
+        /* UNTESTED: the other server will just keep using version 1 */
+        raft_warnf(s->rpc->logger, "send hello: %s", uv_strerror(rv));
+    }
+
     return 0;
 }
 
@@ -594,24 +1596,32 @@ static int raft_io_uv_rpc__add_server(struct raft_io_uv_rpc *r,
                                       const char *address,
                                       struct uv_stream_s *stream)
 {
-    struct raft_io_uv_rpc_server *servers;
+    struct raft_io_uv_rpc_server **servers;
     struct raft_io_uv_rpc_server *server;
     unsigned n_servers;
     int rv;
 
+    /* Allocate the new connection separately, since its stream handle points
+     * to it and its address must not change when the array grows. */
+    server = raft_malloc(sizeof *server);
+    if (server == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
     /* Grow the servers array */
     n_servers = r->n_servers + 1;
     servers = raft_realloc(r->servers, n_servers * sizeof *servers);
     if (servers == NULL) {
         rv = RAFT_ERR_NOMEM;
-        goto err;
+        goto err_after_server_alloc;
     }
 
     r->servers = servers;
     r->n_servers = n_servers;
 
     /* Initialize the new connection */
-    server = &servers[n_servers - 1];
+    servers[n_servers - 1] = server;
 
     rv = raft_io_uv_rpc_server__init(server, r, id, address, stream);
     if (rv != 0) {
@@ -633,6 +1643,9 @@ err_after_servers_realloc:
     /* Simply pretend that the connection was not inserted at all */
     r->n_servers--;
 
+err_after_server_alloc:
+    raft_free(server);
+
 err:
     assert(rv != 0);
 
@@ -649,7 +1662,7 @@ static void raft_io_uv_rpc__remove_server(struct raft_io_uv_rpc *r,
     unsigned j;
 
     for (i = 0; i < r->n_servers; i++) {
-        if (&r->servers[i] == server) {
+        if (r->servers[i] == server) {
             break;
         }
     }
@@ -677,6 +1690,7 @@ static void raft_io_uv_rpc__connection_cb(void *data,
                                           struct uv_stream_s *stream)
 {
     struct raft_io_uv_rpc *r = data;
+    unsigned i;
     int rv;
 
     rv = raft_io_uv_rpc__add_server(r, id, address, stream);
@@ -684,6 +1698,14 @@ static void raft_io_uv_rpc__connection_cb(void *data,
         raft_warnf(r->logger, "add server: %s", raft_strerror(rv));
         uv_close((struct uv_handle_s *)stream,
                  raft_io_uv_rpc__connection_close_cb);
+        return;
+    }
+
+    /* The server is up, no need to wait for the retry timer to reconnect. */
+    for (i = 0; i < r->n_clients; i++) {
+        if (r->clients[i]->id == id) {
+            raft_io_uv_rpc_client__reconnect(r->clients[i]);
+        }
     }
 }
 
@@ -700,7 +1722,16 @@ int raft_io_uv_rpc__init(struct raft_io_uv_rpc *r,
     r->servers = NULL;
     r->n_clients = 0;
     r->n_servers = 0;
+    r->n_stripes = 0;
     r->connect_retry_delay = RAFT_IO_UV_RPC_CLIENT__CONNECT_RETRY_DELAY;
+    r->connect_retry_max_delay = RAFT_IO_UV_RPC_CLIENT__CONNECT_RETRY_MAX_DELAY;
+    r->max_pending_bytes = RAFT_IO_UV_RPC_CLIENT__MAX_PENDING_BYTES;
+    r->pending_timeout = RAFT_IO_UV_RPC_CLIENT__PENDING_TIMEOUT;
+    r->checksums = false;
+    r->compression_threshold = 0;
+    r->entries = NULL;
+    r->low_watermark = RAFT_IO_UV_LOW_WATERMARK;
+    r->high_watermark = RAFT_IO_UV_HIGH_WATERMARK;
     r->n_active = 1 /* The transport connection listener */;
 
     r->recv.data = NULL;
@@ -717,7 +1748,8 @@ void raft_io_uv_rpc__close(struct raft_io_uv_rpc *r)
     unsigned i;
 
     for (i = 0; i < r->n_clients; i++) {
-        raft_io_uv_rpc_client__close(&r->clients[i]);
+        raft_io_uv_rpc_client__close(r->clients[i]);
+        raft_free(r->clients[i]);
     }
 
     if (r->clients != NULL) {
@@ -725,7 +1757,8 @@ void raft_io_uv_rpc__close(struct raft_io_uv_rpc *r)
     }
 
     for (i = 0; i < r->n_servers; i++) {
-        raft_io_uv_rpc_server__close(&r->servers[i]);
+        raft_io_uv_rpc_server__close(r->servers[i]);
+        raft_free(r->servers[i]);
     }
 
     if (r->servers != NULL) {
@@ -750,9 +1783,26 @@ int raft_io_uv_rpc__start(struct raft_io_uv_rpc *r,
         return rv;
     }
 
+    rv = uv_check_init(r->loop, &r->flush);
+    assert(rv == 0); /* This should never fail */
+
+    r->flush.data = r;
+    r->n_active++;
+
     return 0;
 }
 
+/**
+ * Callback invoked when the flush handle has been closed.
+ */
+static void raft_io_uv_rpc__flush_close_cb(uv_handle_t *handle)
+{
+    struct raft_io_uv_rpc *r = handle->data;
+
+    r->n_active--;
+    raft_io_uv_rpc__maybe_stopped(r);
+}
+
 static void raft_io_uv_rpc__transport_stop_cb(void *data)
 {
     struct raft_io_uv_rpc *r = data;
@@ -775,57 +1825,70 @@ void raft_io_uv_rpc__stop(struct raft_io_uv_rpc *r,
     r->stop.cb = cb;
 
     for (i = 0; i < r->n_clients; i++) {
-        raft_io_uv_rpc_client__stop(&r->clients[i]);
+        raft_io_uv_rpc_client__stop(r->clients[i]);
     }
 
     for (i = 0; i < r->n_servers; i++) {
-        raft_io_uv_rpc_server__stop(&r->servers[i]);
+        raft_io_uv_rpc_server__stop(r->servers[i]);
     }
 
+    uv_close((struct uv_handle_s *)&r->flush, raft_io_uv_rpc__flush_close_cb);
+
+    raft_io_uv_rpc__forget_entries(r);
+
     r->transport->stop(r->transport, r, raft_io_uv_rpc__transport_stop_cb);
 
     raft_io_uv_rpc__maybe_stopped(r);
 }
 
 /**
- * Search a client object matching the given server ID. If not found, a new one
- * will be created and appended to the clients array.
+ * Search a client object matching the given server ID and stripe. If not found,
+ * a new one will be created and appended to the clients array.
  */
 static int raft_io_uv_rpc__get_client(struct raft_io_uv_rpc *r,
                                       const unsigned id,
                                       const char *address,
+                                      const unsigned stripe,
                                       struct raft_io_uv_rpc_client **client)
 {
-    struct raft_io_uv_rpc_client *clients;
+    struct raft_io_uv_rpc_client **clients;
     unsigned n_clients;
     unsigned i;
     int rv;
 
     for (i = 0; i < r->n_clients; i++) {
-        *client = &r->clients[i];
+        *client = r->clients[i];
 
-        if ((*client)->id == id) {
+        if ((*client)->id == id && (*client)->stripe == stripe) {
             /* TODO: handle a change in the address */
             assert(strcmp((*client)->address, address) == 0);
             return 0;
         }
     }
 
+    /* Allocate the new connection separately, since its address must not
+     * change once its handles are initialized. */
+    *client = raft_malloc(sizeof **client);
+    if (*client == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
     /* Grow the connections array */
     n_clients = r->n_clients + 1;
     clients = raft_realloc(r->clients, n_clients * sizeof *clients);
     if (clients == NULL) {
         rv = RAFT_ERR_NOMEM;
-        goto err;
+        goto err_after_client_alloc;
     }
 
     r->clients = clients;
     r->n_clients = n_clients;
 
     /* Initialize the new connection */
-    *client = &clients[n_clients - 1];
+    clients[n_clients - 1] = *client;
 
-    rv = raft_io_uv_rpc_client__init(*client, r, id, address);
+    rv = raft_io_uv_rpc_client__init(*client, r, id, address, stripe);
     if (rv != 0) {
         goto err_after_clients_realloc;
     }
@@ -839,22 +1902,70 @@ err_after_clients_realloc:
     /* Simply pretend that the connection was not inserted at all */
     r->n_clients--;
 
+err_after_client_alloc:
+    raft_free(*client);
+
 err:
     assert(rv != 0);
 
     return rv;
 }
 
-static void raft_io_uv_rpc__send_write_cb(struct uv_write_s *req, int status)
+/**
+ * Return the client object that should carry the given message.
+ *
+ * Control messages always go through stripe 0. AppendEntries messages carrying
+ * entries go through the stripe that carried the previous ones, so batches
+ * reach the follower in the order they were sent. Only if that stripe has
+ * nothing outstanding and has lost its connection, entries move to the
+ * connected stripe with the fewest outstanding bytes.
+ */
+static int raft_io_uv_rpc__pick_client(struct raft_io_uv_rpc *r,
+                                       const struct raft_message *message,
+                                       struct raft_io_uv_rpc_client **client)
 {
-    struct raft_io_uv_rpc_request *r = req->data;
+    struct raft_io_uv_rpc_client *current = NULL;
+    struct raft_io_uv_rpc_client *stripe;
+    unsigned i;
+    int rv;
+
+    if (r->n_stripes == 0 || message->type != RAFT_IO_APPEND_ENTRIES ||
+        message->append_entries.n_entries == 0) {
+        return raft_io_uv_rpc__get_client(r, message->server_id,
+                                          message->server_address, 0, client);
+    }
+
+    *client = NULL;
 
-    if (r->cb != NULL) {
-        r->cb(r->data, status);
+    for (i = 1; i <= r->n_stripes; i++) {
+        rv = raft_io_uv_rpc__get_client(r, message->server_id,
+                                        message->server_address, i, &stripe);
+        if (rv != 0) {
+            return rv;
+        }
+
+        if (stripe->entries) {
+            current = stripe;
+        }
+
+        if (*client == NULL ||
+            ((*client)->stream == NULL && stripe->stream != NULL) ||
+            (stripe->stream != NULL && stripe->n_bytes < (*client)->n_bytes)) {
+            *client = stripe;
+        }
+    }
+
+    if (current != NULL) {
+        if (current->stream != NULL || current->n_bytes > 0) {
+            *client = current;
+            return 0;
+        }
+        current->entries = false;
     }
 
-    raft_io_uv_rpc_request__close(r);
-    raft_free(r);
+    (*client)->entries = true;
+
+    return 0;
 }
 
 int raft_io_uv_rpc__send(struct raft_io_uv_rpc *r,
@@ -874,36 +1985,55 @@ int raft_io_uv_rpc__send(struct raft_io_uv_rpc *r,
     }
 
     /* Initialize the request object, encode the message. */
-    rv = raft_io_uv_rpc_request__init(request, message, data, cb);
+    rv = raft_io_uv_rpc_request__init(request, r, message, data, cb);
     if (rv != 0) {
         goto err_after_request_alloc;
     }
 
     /* Get the connection info for the target server, creating it if it doesn't
      * exist. */
-    rv = raft_io_uv_rpc__get_client(r, message->server_id,
-                                    message->server_address, &client);
+    rv = raft_io_uv_rpc__pick_client(r, message, &client);
     if (rv != 0) {
         goto err_after_request_encode;
     }
 
-    /* If there's no connection available, let's fail immediately. */
-    if (client->stream == NULL) {
+    /* If there's no connection available, buffer the request until the next
+     * connection attempt, unless too much data is already waiting. */
+    if (client->stream == NULL &&
+        client->n_bytes + request->len > r->max_pending_bytes) {
         rv = RAFT_ERR_IO_CONNECT;
         goto err_after_request_encode;
     }
 
-    rv = uv_write(&request->req, client->stream, request->bufs, request->n_bufs,
-                  raft_io_uv_rpc__send_write_cb);
-    if (rv != 0) {
-        /* UNTESTED: what are the error conditions? perhaps ENOMEM */
-        rv = RAFT_ERR_IO;
-        goto err_after_request_encode;
+    /* Queue the request, it will be written out along with any other request
+     * for the same server at the end of this loop iteration, or as soon as a
+     * connection is available. */
+    if (client->tail == NULL) {
+        client->head = request;
+    } else {
+        client->tail->next = request;
+    }
+    client->tail = request;
+
+    /* Account for the new outstanding bytes. */
+    request->client = client;
+    request->time = uv_now(r->loop);
+    client->n_bytes += request->len;
+    if (client->n_bytes >= r->high_watermark) {
+        client->congested = true;
     }
 
+    rv = uv_check_start(&r->flush, raft_io_uv_rpc__flush_cb);
+    assert(rv == 0); /* This should never fail, and it's a no-op if active. */
+
     return 0;
 
 err_after_request_encode:
+    /* The entries array might be released as soon as we return, so it must
+     * not be matched by later requests. */
+    if (request->entries != NULL && request->entries == r->entries) {
+        raft_io_uv_rpc__forget_entries(r);
+    }
     raft_io_uv_rpc_request__close(request);
 
 err_after_request_alloc:
@@ -915,18 +2045,58 @@ err:
     return rv;
 }
 
+bool raft_io_uv_rpc__congested(struct raft_io_uv_rpc *r, unsigned id)
+{
+    unsigned i;
+
+    for (i = 0; i < r->n_clients; i++) {
+        if (r->clients[i]->id == id && r->clients[i]->congested) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Stream handle used by a transport, either a TCP socket or a Unix socket,
+ * depending on how the transport was initialized.
+ */
+union raft_io_uv_tcp__handle {
+    struct uv_tcp_s tcp;
+    struct uv_pipe_s pipe;
+};
+
+/**
+ * Cached result of the resolution of an address containing a hostname.
+ */
+struct raft_io_uv_tcp_resolved
+{
+    char *address;                /* Address as passed to connect */
+    struct sockaddr_storage addr; /* The socket address it resolved to */
+};
+
+struct raft_io_uv_tcp_connect;
+
 /**
  * State for the default implementation of the @raft_io_uv_transport interface.
+ *
+ * The same code drives both TCP and Unix domain sockets: the two only differ
+ * in how handles are initialized, bound and connected, while the handshake and
+ * the streams handed to the RPC layer are identical.
  */
 struct raft_io_uv_tcp
 {
     struct raft_logger *logger;
     struct uv_loop_s *loop;
+    bool local; /* Whether to use Unix sockets instead of TCP */
+    struct raft_io_uv_tcp_options options; /* Applied to every TCP socket */
     struct
     {
         unsigned id;
         const char *address;
-        struct uv_tcp_s tcp;
+        union raft_io_uv_tcp__handle handle;
+        bool closed;
         void *data;
         void (*cb)(void *data,
                    unsigned id,
@@ -934,10 +2104,18 @@ struct raft_io_uv_tcp
                    uv_stream_t *stream);
     } listener;
     struct
+    {
+        /* Addresses containing hostnames that were successfully resolved.
+         * An entry is dropped when connecting to its address fails, so the
+         * hostname gets resolved again on the next attempt. */
+        struct raft_io_uv_tcp_resolved *entries;
+        unsigned n;
+    } cache;
+    struct raft_io_uv_tcp_connect *resolving; /* Pending name resolutions */
+    struct
     {
         /* Initial handshake buffer to send right away after a connection.
          * It contains the protocol version, our ID and our address. */
-        struct uv_write_s req;
         uv_buf_t buf;
     } handshake;
     struct
@@ -953,7 +2131,7 @@ struct raft_io_uv_tcp
 struct raft_io_uv_tcp_accept
 {
     struct raft_io_uv_tcp *tcp;
-    struct uv_tcp_s *client;
+    struct uv_stream_s *client;
     uv_buf_t buf;
     uint64_t preamble[3];
     unsigned id;
@@ -962,11 +2140,23 @@ struct raft_io_uv_tcp_accept
 };
 
 /**
- * Hold state for a single connection attempt.
+ * Hold state for a single connection attempt. Several attempts can be in
+ * progress at the same time, so each has its own handshake write request. The
+ * object is released once both requests have completed.
+ *
+ * If the address contains a hostname that is not cached, the attempt starts
+ * with an asynchronous name resolution.
  */
 struct raft_io_uv_tcp_connect
 {
+    struct raft_io_uv_tcp *tcp;
+    struct uv_stream_s *client;
+    struct uv_getaddrinfo_s getaddrinfo;
     struct uv_connect_s req;
+    struct uv_write_s write;
+    unsigned n_pending;
+    char *address; /* Copy of the address, only if it contains a hostname */
+    struct raft_io_uv_tcp_connect *next; /* Next pending name resolution */
     void *data;
     void (*cb)(void *data, int status);
 };
@@ -1102,132 +2292,454 @@ static void raft_io_uv_tcp__handshake_read_cb(uv_stream_t *stream,
         accept->tcp->listener.cb(accept->tcp->listener.data, accept->id,
                                  accept->address, stream);
 
-        raft_free(accept->address);
+        raft_free(accept->address);
+
+        goto done;
+    }
+
+    /* The if nread>0 condition above should always exit the function with a
+     * goto. */
+    assert(nread <= 0);
+
+    if (nread == 0) {
+        /* Empty read just ignore it. */
+        goto out;
+    }
+
+    /* TODO log the error */
+    assert(nread < 0);
+
+abort:
+    raft_io_uv_tcp__abort(accept);
+
+    return;
+
+done:
+    raft_free(accept);
+
+out:
+    return;
+}
+
+/**
+ * Apply the configured socket options to the given TCP handle. Failures are
+ * logged but not fatal, since the socket still works with kernel defaults.
+ */
+static void raft_io_uv_tcp__set_options(struct raft_io_uv_tcp *tcp,
+                                        struct uv_tcp_s *handle)
+{
+    struct raft_io_uv_tcp_options *o = &tcp->options;
+    uv_os_fd_t fd;
+    int value;
+    int rv;
+
+    rv = uv_tcp_nodelay(handle, o->nodelay);
+    if (rv != 0) {
+        raft_warnf(tcp->logger, "uv_tcp_nodelay: %s", uv_strerror(rv));
+    }
+
+    if (o->keepalive > 0) {
+        rv = uv_tcp_keepalive(handle, 1, o->keepalive);
+        if (rv != 0) {
+            raft_warnf(tcp->logger, "uv_tcp_keepalive: %s", uv_strerror(rv));
+        }
+    }
+
+    if (o->send_buffer_size > 0) {
+        value = (int)o->send_buffer_size;
+        rv = uv_send_buffer_size((uv_handle_t *)handle, &value);
+        if (rv != 0) {
+            raft_warnf(tcp->logger, "uv_send_buffer_size: %s", uv_strerror(rv));
+        }
+    }
+
+    if (o->recv_buffer_size > 0) {
+        value = (int)o->recv_buffer_size;
+        rv = uv_recv_buffer_size((uv_handle_t *)handle, &value);
+        if (rv != 0) {
+            raft_warnf(tcp->logger, "uv_recv_buffer_size: %s", uv_strerror(rv));
+        }
+    }
+
+#ifdef TCP_USER_TIMEOUT
+    if (o->user_timeout > 0) {
+        value = (int)o->user_timeout;
+        rv = uv_fileno((uv_handle_t *)handle, &fd);
+        if (rv == 0) {
+            rv = setsockopt(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, &value,
+                            sizeof value);
+            if (rv != 0) {
+                rv = -errno;
+            }
+        }
+        if (rv != 0) {
+            raft_warnf(tcp->logger, "TCP_USER_TIMEOUT: %s", uv_strerror(rv));
+        }
+    }
+#else
+    (void)fd;
+#endif
+}
+
+/**
+ * Allocate a new stream handle and initialize it as a TCP socket or a Unix
+ * socket, according to the kind of the transport.
+ */
+static int raft_io_uv_tcp__stream_init(struct raft_io_uv_tcp *tcp,
+                                       struct uv_stream_s **stream)
+{
+    union raft_io_uv_tcp__handle *handle;
+    int rv;
+
+    handle = raft_malloc(sizeof *handle);
+    if (handle == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
+    if (tcp->local) {
+        rv = uv_pipe_init(tcp->loop, &handle->pipe, 0);
+    } else {
+        rv = uv_tcp_init(tcp->loop, &handle->tcp);
+    }
+    if (rv != 0) {
+        /* UNTESTED: in the current libuv implementation this can't fail */
+        rv = RAFT_ERR_IO;
+        goto err_after_handle_alloc;
+    }
+
+    *stream = (struct uv_stream_s *)handle;
+
+    return 0;
+
+err_after_handle_alloc:
+    raft_free(handle);
+
+err:
+    assert(rv != 0);
+
+    return rv;
+}
+
+/**
+ * Callback invoked when the listening socket of the transport has received a
+ * new connection.
+ */
+static void raft_io_uv_tcp__listen_cb(uv_stream_t *server, int status)
+{
+    struct raft_io_uv_tcp *tcp = server->data;
+    struct raft_io_uv_tcp_accept *accept;
+    int rv;
+
+    if (status < 0) {
+        rv = -status;
+        goto err;
+    }
+
+    accept = raft_malloc(sizeof *accept);
+    if (accept == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+    accept->tcp = tcp;
+    accept->id = 0;
+    accept->address = NULL;
+    accept->buf.base = NULL;
+    accept->buf.len = 0;
+
+    rv = raft_io_uv_tcp__stream_init(tcp, &accept->client);
+    if (rv != 0) {
+        goto err_after_accept_alloc;
+    }
+
+    accept->client->data = accept;
+
+    rv = uv_accept(server, accept->client);
+    if (rv != 0) {
+        goto err_after_client_init;
+    }
+
+    if (!tcp->local) {
+        raft_io_uv_tcp__set_options(tcp, (struct uv_tcp_s *)accept->client);
+    }
+
+    rv = uv_read_start(accept->client, raft_io_uv_tcp__handshake_alloc_cb,
+                       raft_io_uv_tcp__handshake_read_cb);
+    if (rv != 0) {
+        goto err_after_client_init;
+    }
+
+    return;
+
+err_after_client_init:
+    uv_close((uv_handle_t *)accept->client, NULL);
+    raft_free(accept->client);
+
+err_after_accept_alloc:
+    raft_free(accept);
+
+err:
+    assert(rv != 0);
+    /* TODO: log the failure */
+}
+
+/**
+ * Split @address into its @host and @port parts.
+ *
+ * The host is either an IPv4 address, a hostname or an IPv6 address enclosed in
+ * square brackets, optionally followed by a colon and a port number.
+ */
+static int raft_io_uv_tcp__split_address(const char *address,
+                                         char *host,
+                                         char *port)
+{
+    const char *end;
+    const char *colon;
+    char *tail;
+    size_t n;
+    long value;
+
+    if (*address == '[') {
+        address++;
+        end = strchr(address, ']');
+        if (end == NULL || (end[1] != ':' && end[1] != '\0')) {
+            return RAFT_ERR_IO_CONNECT;
+        }
+        colon = end[1] == ':' ? end + 1 : NULL;
+    } else {
+        colon = strchr(address, ':');
+        end = colon != NULL ? colon : address + strlen(address);
+
+        /* IPv6 addresses must be enclosed in brackets. */
+        if (colon != NULL && strchr(colon + 1, ':') != NULL) {
+            return RAFT_ERR_IO_CONNECT;
+        }
+    }
+
+    n = (size_t)(end - address);
+    if (n == 0 || n >= RAFT_IO_UV_TCP__MAX_HOST_LEN) {
+        return RAFT_ERR_IO_CONNECT;
+    }
+    memcpy(host, address, n);
+    host[n] = '\0';
+
+    if (colon == NULL) {
+        strcpy(port, RAFT_IO_UV_TCP__DEFAULT_PORT);
+        return 0;
+    }
+
+    colon++;
+    if (*colon < '0' || *colon > '9' ||
+        strlen(colon) >= RAFT_IO_UV_TCP__MAX_PORT_LEN) {
+        return RAFT_ERR_IO_CONNECT;
+    }
+
+    value = strtol(colon, &tail, 10);
+    if (*tail != '\0' || value > 65535) {
+        return RAFT_ERR_IO_CONNECT;
+    }
+    strcpy(port, colon);
+
+    return 0;
+}
+
+/**
+ * Split @address into @host and @port and populate @addr accordingly.
+ *
+ * If the host is not a numeric IPv4 or IPv6 address, the family of @addr is
+ * set to AF_UNSPEC, and @host must be resolved.
+ */
+static int raft_io_uv_tcp__parse_address(const char *address,
+                                         char *host,
+                                         char *port,
+                                         struct sockaddr_storage *addr)
+{
+    int rv;
+
+    rv = raft_io_uv_tcp__split_address(address, host, port);
+    if (rv != 0) {
+        return rv;
+    }
+
+    if (uv_ip4_addr(host, atoi(port), (struct sockaddr_in *)addr) == 0) {
+        return 0;
+    }
+
+    if (uv_ip6_addr(host, atoi(port), (struct sockaddr_in6 *)addr) == 0) {
+        return 0;
+    }
+
+    addr->ss_family = AF_UNSPEC;
+
+    return 0;
+}
+
+/**
+ * Look up the cached resolution of the given address.
+ */
+static bool raft_io_uv_tcp__cache_get(struct raft_io_uv_tcp *tcp,
+                                      const char *address,
+                                      struct sockaddr_storage *addr)
+{
+    unsigned i;
+
+    for (i = 0; i < tcp->cache.n; i++) {
+        if (strcmp(tcp->cache.entries[i].address, address) == 0) {
+            *addr = tcp->cache.entries[i].addr;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Drop the cached resolution of the given address, if any.
+ */
+static void raft_io_uv_tcp__cache_del(struct raft_io_uv_tcp *tcp,
+                                      const char *address)
+{
+    unsigned i;
+
+    for (i = 0; i < tcp->cache.n; i++) {
+        if (strcmp(tcp->cache.entries[i].address, address) == 0) {
+            raft_free(tcp->cache.entries[i].address);
+            tcp->cache.n--;
+            tcp->cache.entries[i] = tcp->cache.entries[tcp->cache.n];
+            return;
+        }
+    }
+}
+
+/**
+ * Cache the resolution of the given address. This is best effort: if we run
+ * out of memory the address will just be resolved again next time.
+ */
+static void raft_io_uv_tcp__cache_put(struct raft_io_uv_tcp *tcp,
+                                      const char *address,
+                                      const struct sockaddr *addr,
+                                      size_t len)
+{
+    struct raft_io_uv_tcp_resolved *entries;
+    struct raft_io_uv_tcp_resolved *entry;
+
+    raft_io_uv_tcp__cache_del(tcp, address);
 
-        goto done;
+    entries = raft_realloc(tcp->cache.entries,
+                           (tcp->cache.n + 1) * sizeof *entries);
+    if (entries == NULL) {
+        return;
     }
+    tcp->cache.entries = entries;
 
-    /* The if nread>0 condition above should always exit the function with a
-     * goto. */
-    assert(nread <= 0);
+    entry = &entries[tcp->cache.n];
 
-    if (nread == 0) {
-        /* Empty read just ignore it. */
-        goto out;
+    entry->address = raft_malloc(strlen(address) + 1);
+    if (entry->address == NULL) {
+        return;
     }
+    strcpy(entry->address, address);
 
-    /* TODO log the error */
-    assert(nread < 0);
-
-abort:
-    raft_io_uv_tcp__abort(accept);
-
-    return;
-
-done:
-    raft_free(accept);
+    assert(len <= sizeof entry->addr);
+    memset(&entry->addr, 0, sizeof entry->addr);
+    memcpy(&entry->addr, addr, len);
 
-out:
-    return;
+    tcp->cache.n++;
 }
 
 /**
- * Callback invoked when the listening socket of the transport has received a
- * new connection.
+ * Bind the listening TCP socket to the given address.
  */
-static void raft_io_uv_tcp__listen_cb(uv_stream_t *server, int status)
+static int raft_io_uv_tcp__bind(struct raft_io_uv_tcp *tcp, const char *address)
 {
-    struct raft_io_uv_tcp *tcp = server->data;
-    struct raft_io_uv_tcp_accept *accept;
+    char host[RAFT_IO_UV_TCP__MAX_HOST_LEN];
+    char port[RAFT_IO_UV_TCP__MAX_PORT_LEN];
+    struct sockaddr_storage addr;
+    struct uv_getaddrinfo_s req;
+    struct addrinfo hints;
     int rv;
 
-    if (status < 0) {
-        rv = -status;
-        goto err;
-    }
-
-    accept = raft_malloc(sizeof *accept);
-    if (accept == NULL) {
-        rv = RAFT_ERR_NOMEM;
-        goto err;
+    rv = uv_tcp_init(tcp->loop, &tcp->listener.handle.tcp);
+    if (rv != 0) {
+        raft_warnf(tcp->logger, "uv_tcp_init: %s", uv_strerror(rv));
+        return RAFT_ERR_IO;
     }
-    accept->tcp = tcp;
-    accept->id = 0;
-    accept->address = NULL;
-    accept->buf.base = NULL;
-    accept->buf.len = 0;
 
-    accept->client = raft_malloc(sizeof *accept->client);
-    if (accept->client == NULL) {
-        rv = RAFT_ERR_NOMEM;
-        goto err_after_accept_alloc;
+    rv = raft_io_uv_tcp__parse_address(address, host, port, &addr);
+    if (rv != 0) {
+        return rv;
     }
 
-    accept->client->data = accept;
+    /* Binding happens only once at startup, so a hostname is resolved
+     * synchronously. */
+    if (addr.ss_family == AF_UNSPEC) {
+        memset(&hints, 0, sizeof hints);
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+
+        rv = uv_getaddrinfo(tcp->loop, &req, NULL, host, port, &hints);
+        if (rv != 0) {
+            raft_warnf(tcp->logger, "resolve %s: %s", host, uv_strerror(rv));
+            return RAFT_ERR_IO_CONNECT;
+        }
 
-    rv = uv_tcp_init(tcp->loop, accept->client);
-    if (rv != 0) {
-        goto err_after_client_alloc;
-    }
+        assert(req.addrinfo->ai_addrlen <= sizeof addr);
+        memcpy(&addr, req.addrinfo->ai_addr, req.addrinfo->ai_addrlen);
 
-    rv = uv_accept(server, (uv_stream_t *)accept->client);
-    if (rv != 0) {
-        goto err_after_client_init;
+        uv_freeaddrinfo(req.addrinfo);
     }
 
-    rv = uv_read_start((uv_stream_t *)accept->client,
-                       raft_io_uv_tcp__handshake_alloc_cb,
-                       raft_io_uv_tcp__handshake_read_cb);
+    rv = uv_tcp_bind(&tcp->listener.handle.tcp, (const struct sockaddr *)&addr,
+                     0);
     if (rv != 0) {
-        goto err_after_client_init;
+        /* UNTESTED: what are the error conditions? */
+        raft_warnf(tcp->logger, "uv_tcp_bind: %s", uv_strerror(rv));
+        return RAFT_ERR_IO;
     }
 
-    return;
-
-err_after_client_init:
-    uv_close((uv_handle_t *)accept->client, NULL);
-
-err_after_client_alloc:
-    raft_free(accept->client);
-
-err_after_accept_alloc:
-    raft_free(accept);
+    /* Accepted sockets inherit the buffer sizes of the listening one, which
+     * must be set before the connection is established in order for the
+     * window scaling factor to account for them. */
+    raft_io_uv_tcp__set_options(tcp, &tcp->listener.handle.tcp);
 
-err:
-    assert(rv != 0);
-    /* TODO: log the failure */
+    return 0;
 }
 
 /**
- * Split @address into @host and @port and populate @addr accordingly.
+ * Bind the listening Unix socket to the given path.
+ *
+ * A socket file left behind by a previous process that didn't shut down
+ * cleanly would make the bind fail with EADDRINUSE, so it gets removed first.
+ * Any other kind of file is left alone.
  */
-static int raft_io_uv_tcp__parse_address(const char *address,
-                                         struct sockaddr_in *addr)
+static int raft_io_uv_tcp__bind_local(struct raft_io_uv_tcp *tcp,
+                                      const char *address)
 {
-    char buf[256];
-    char *host;
-    char *port;
-    char *colon = ":";
+    struct stat st;
     int rv;
 
-    /* TODO: turn this poor man parsing into proper one */
-    strcpy(buf, address);
-    host = strtok(buf, colon);
-    port = strtok(NULL, ":");
-    if (port == NULL) {
-        port = "8080";
+    rv = uv_pipe_init(tcp->loop, &tcp->listener.handle.pipe, 0);
+    if (rv != 0) {
+        raft_warnf(tcp->logger, "uv_pipe_init: %s", uv_strerror(rv));
+        return RAFT_ERR_IO;
+    }
+
+    if (stat(address, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(address);
     }
 
-    rv = uv_ip4_addr(host, atoi(port), addr);
+    rv = uv_pipe_bind(&tcp->listener.handle.pipe, address);
     if (rv != 0) {
-        return RAFT_ERR_IO_CONNECT;
+        raft_warnf(tcp->logger, "uv_pipe_bind: %s", uv_strerror(rv));
+        return RAFT_ERR_IO;
     }
 
     return 0;
 }
 
 /**
- * Start accepting incoming TCP connections from other servers.
+ * Start accepting incoming connections from other servers.
  */
 static int raft_io_uv_tcp__start(struct raft_io_uv_transport *t,
                                  unsigned id,
@@ -1239,7 +2751,6 @@ static int raft_io_uv_tcp__start(struct raft_io_uv_transport *t,
                                             uv_stream_t *stream))
 {
     struct raft_io_uv_tcp *tcp;
-    struct sockaddr_in addr;
     int rv;
 
     tcp = t->data;
@@ -1258,42 +2769,49 @@ static int raft_io_uv_tcp__start(struct raft_io_uv_transport *t,
     tcp->listener.data = data;
     tcp->listener.cb = cb;
 
-    rv = uv_tcp_init(tcp->loop, &tcp->listener.tcp);
-    if (rv != 0) {
-        raft_warnf(tcp->logger, "uv_tcp_init: %s", uv_strerror(rv));
-        return RAFT_ERR_IO;
+    if (tcp->local) {
+        rv = raft_io_uv_tcp__bind_local(tcp, address);
+    } else {
+        rv = raft_io_uv_tcp__bind(tcp, address);
     }
-
-    rv = raft_io_uv_tcp__parse_address(tcp->listener.address, &addr);
     if (rv != 0) {
         return rv;
     }
 
-    rv = uv_tcp_bind(&tcp->listener.tcp, (const struct sockaddr *)&addr, 0);
+    rv = uv_listen((uv_stream_t *)&tcp->listener.handle,
+                   RAFT_IO_UV_TCP__BACKLOG, raft_io_uv_tcp__listen_cb);
     if (rv != 0) {
         /* UNTESTED: what are the error conditions? */
-        raft_warnf(tcp->logger, "uv_tcp_bind: %s", uv_strerror(rv));
+        raft_warnf(tcp->logger, "uv_listen: %s", uv_strerror(rv));
         return RAFT_ERR_IO;
     }
 
-    rv = uv_listen((uv_stream_t *)&tcp->listener.tcp, 1,
-                   raft_io_uv_tcp__listen_cb);
-    if (rv != 0) {
-        /* UNTESTED: what are the error conditions? */
-        raft_warnf(tcp->logger, "uv_tcp_listen: %s", uv_strerror(rv));
-        return RAFT_ERR_IO;
+    return 0;
+}
+
+/**
+ * Invoke the stop callback if we were asked to be stopped, the listener has
+ * been closed and there are no more pending name resolutions.
+ */
+static void raft_io_uv_tcp__maybe_stopped(struct raft_io_uv_tcp *tcp)
+{
+    if (tcp->stop.cb == NULL || !tcp->listener.closed ||
+        tcp->resolving != NULL) {
+        return;
     }
 
-    return 0;
+    raft_free(tcp->handshake.buf.base);
+
+    tcp->stop.cb(tcp->stop.data);
 }
 
 static void raft_io_uv_tcp__listener_close_cb(uv_handle_t *handle)
 {
     struct raft_io_uv_tcp *tcp = handle->data;
 
-    raft_free(tcp->handshake.buf.base);
+    tcp->listener.closed = true;
 
-    tcp->stop.cb(tcp->stop.data);
+    raft_io_uv_tcp__maybe_stopped(tcp);
 }
 
 static void raft_io_uv_tcp__stop(struct raft_io_uv_transport *t,
@@ -1301,21 +2819,220 @@ static void raft_io_uv_tcp__stop(struct raft_io_uv_transport *t,
                                  void (*cb)(void *data))
 {
     struct raft_io_uv_tcp *tcp = t->data;
+    struct raft_io_uv_tcp_connect *connect;
 
     tcp->stop.data = data;
     tcp->stop.cb = cb;
 
-    uv_close((struct uv_handle_s *)&tcp->listener.tcp,
+    /* Resolutions that have already started can't be cancelled, we'll wait
+     * for them to complete. */
+    for (connect = tcp->resolving; connect != NULL; connect = connect->next) {
+        uv_cancel((uv_req_t *)&connect->getaddrinfo);
+    }
+
+    uv_close((struct uv_handle_s *)&tcp->listener.handle,
              raft_io_uv_tcp__listener_close_cb);
 }
 
+/**
+ * Release the given connection attempt if both its connect and handshake write
+ * requests have completed.
+ */
+static void raft_io_uv_tcp__connect_done(struct raft_io_uv_tcp_connect *connect)
+{
+    assert(connect->n_pending > 0);
+
+    connect->n_pending--;
+    if (connect->n_pending == 0) {
+        raft_free(connect);
+    }
+}
+
 static void raft_io_uv_tcp__connect_cb(struct uv_connect_s *req, int status)
 {
     struct raft_io_uv_tcp_connect *connect = req->data;
 
+    /* The host might have moved to another address. */
+    if (status != 0 && connect->address != NULL) {
+        raft_io_uv_tcp__cache_del(connect->tcp, connect->address);
+    }
+
     connect->cb(connect->data, status);
 
-    raft_free(connect);
+    raft_io_uv_tcp__connect_done(connect);
+}
+
+static void raft_io_uv_tcp__handshake_cb(struct uv_write_s *req, int status)
+{
+    struct raft_io_uv_tcp_connect *connect = req->data;
+
+    (void)status;
+
+    raft_io_uv_tcp__connect_done(connect);
+}
+
+/**
+ * Queue the handshake on the stream of a connection attempt. It will be sent
+ * as soon as the connection is established.
+ */
+static void raft_io_uv_tcp__handshake(struct raft_io_uv_tcp_connect *connect)
+{
+    struct raft_io_uv_tcp *tcp = connect->tcp;
+    int rv;
+
+    rv = uv_write(&connect->write, connect->client, &tcp->handshake.buf, 1,
+                  raft_io_uv_tcp__handshake_cb);
+    if (rv != 0) {
+        /* UNTESTED: what are the error conditions? perhaps ENOMEM. Without a
+         * handshake the other server will drop the connection, and we'll
+         * notice it at the first write. */
+        raft_warnf(tcp->logger, "write: %s", uv_strerror(rv));
+        return;
+    }
+
+    connect->n_pending++;
+}
+
+/**
+ * Create the socket of the given TCP handle and apply the configured options to
+ * it. This must happen before connecting, since the buffer sizes determine the
+ * window scaling factor advertised in the SYN.
+ */
+static int raft_io_uv_tcp__open(struct raft_io_uv_tcp *tcp,
+                                struct uv_tcp_s *handle,
+                                int family)
+{
+    uv_os_sock_t sock;
+    int rv;
+
+    sock = socket(family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        /* UNTESTED: this should fail only because of lack of resources */
+        rv = -errno;
+        raft_warnf(tcp->logger, "socket: %s", uv_strerror(rv));
+        return rv;
+    }
+
+    rv = uv_tcp_open(handle, sock);
+    if (rv != 0) {
+        /* UNTESTED: the socket is brand new, this should not fail */
+        raft_warnf(tcp->logger, "uv_tcp_open: %s", uv_strerror(rv));
+        close(sock);
+        return rv;
+    }
+
+    raft_io_uv_tcp__set_options(tcp, handle);
+
+    return 0;
+}
+
+/**
+ * Connect the TCP stream of the given connection attempt to @addr.
+ */
+static int raft_io_uv_tcp__connect_addr(struct raft_io_uv_tcp_connect *connect,
+                                        const struct sockaddr *addr)
+{
+    struct raft_io_uv_tcp *tcp = connect->tcp;
+    int rv;
+
+    rv = raft_io_uv_tcp__open(tcp, (struct uv_tcp_s *)connect->client,
+                              addr->sa_family);
+    if (rv != 0) {
+        return rv;
+    }
+
+    rv = uv_tcp_connect(&connect->req, (struct uv_tcp_s *)connect->client, addr,
+                        raft_io_uv_tcp__connect_cb);
+    if (rv != 0) {
+        /* UNTESTED: since parsing succeed, this should fail only because of
+         * lack of system resources */
+        raft_warnf(tcp->logger, "connect: %s", uv_strerror(rv));
+        return rv;
+    }
+
+    raft_io_uv_tcp__handshake(connect);
+
+    return 0;
+}
+
+/**
+ * Remove the given connection attempt from the list of pending resolutions.
+ */
+static void raft_io_uv_tcp__unlink(struct raft_io_uv_tcp *tcp,
+                                   struct raft_io_uv_tcp_connect *connect)
+{
+    struct raft_io_uv_tcp_connect **cursor = &tcp->resolving;
+
+    while (*cursor != connect) {
+        assert(*cursor != NULL);
+        cursor = &(*cursor)->next;
+    }
+
+    *cursor = connect->next;
+}
+
+static void raft_io_uv_tcp__resolve_cb(struct uv_getaddrinfo_s *req,
+                                       int status,
+                                       struct addrinfo *res)
+{
+    struct raft_io_uv_tcp_connect *connect = req->data;
+    struct raft_io_uv_tcp *tcp = connect->tcp;
+
+    raft_io_uv_tcp__unlink(tcp, connect);
+
+    /* If we're being stopped, the stream handle has already been closed and
+     * released. */
+    if (tcp->stop.cb != NULL) {
+        status = UV_ECANCELED;
+    } else if (status != 0) {
+        raft_warnf(tcp->logger, "resolve %s: %s", connect->address,
+                   uv_strerror(status));
+    } else {
+        raft_io_uv_tcp__cache_put(tcp, connect->address, res->ai_addr,
+                                  res->ai_addrlen);
+        status = raft_io_uv_tcp__connect_addr(connect, res->ai_addr);
+    }
+
+    if (res != NULL) {
+        uv_freeaddrinfo(res);
+    }
+
+    if (status != 0) {
+        connect->cb(connect->data, status);
+        raft_io_uv_tcp__connect_done(connect);
+    }
+
+    raft_io_uv_tcp__maybe_stopped(tcp);
+}
+
+/**
+ * Start resolving the given host asynchronously. The connection attempt will
+ * proceed once done.
+ */
+static int raft_io_uv_tcp__resolve(struct raft_io_uv_tcp_connect *connect,
+                                   const char *host,
+                                   const char *port)
+{
+    struct raft_io_uv_tcp *tcp = connect->tcp;
+    struct addrinfo hints;
+    int rv;
+
+    memset(&hints, 0, sizeof hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    rv = uv_getaddrinfo(tcp->loop, &connect->getaddrinfo,
+                        raft_io_uv_tcp__resolve_cb, host, port, &hints);
+    if (rv != 0) {
+        /* UNTESTED: this should fail only because of lack of resources */
+        raft_warnf(tcp->logger, "resolve %s: %s", host, uv_strerror(rv));
+        return RAFT_ERR_IO_CONNECT;
+    }
+
+    connect->next = tcp->resolving;
+    tcp->resolving = connect;
+
+    return 0;
 }
 
 static int raft_io_uv_tcp__connect(struct raft_io_uv_transport *t,
@@ -1326,71 +3043,88 @@ static int raft_io_uv_tcp__connect(struct raft_io_uv_transport *t,
                                    void (*cb)(void *data, int status))
 {
     struct raft_io_uv_tcp *tcp = t->data;
-    struct uv_tcp_s *client;
+    struct uv_stream_s *client;
     struct raft_io_uv_tcp_connect *connect;
-    struct sockaddr_in addr;
+    char host[RAFT_IO_UV_TCP__MAX_HOST_LEN];
+    char port[RAFT_IO_UV_TCP__MAX_PORT_LEN];
+    struct sockaddr_storage addr;
     int rv;
 
     (void)id;
     (void)t;
 
-    connect = raft_malloc(sizeof *connect);
+    /* Allocate the connect object along with a copy of the address. */
+    connect = raft_malloc(sizeof *connect + strlen(address) + 1);
     if (connect == NULL) {
         /* UNTESTED: should be investigated */
         rv = RAFT_ERR_NOMEM;
         goto err;
     }
 
+    connect->tcp = tcp;
+    connect->getaddrinfo.data = connect;
     connect->req.data = connect;
+    connect->write.data = connect;
+    connect->n_pending = 1;
+    connect->address = NULL;
+    connect->next = NULL;
     connect->data = data;
     connect->cb = cb;
 
-    client = raft_malloc(sizeof *client);
-    if (client == NULL) {
+    rv = raft_io_uv_tcp__stream_init(tcp, &client);
+    if (rv != 0) {
         /* UNTESTED: should be investigated */
-        rv = RAFT_ERR_NOMEM;
         goto err_after_connect_alloc;
     }
 
-    rv = uv_tcp_init(tcp->loop, client);
-    if (rv != 0) {
-        /* UNTESTED: in the current libuv implementation this can't fail */
-        rv = RAFT_ERR_IO;
-        goto err_after_tcp_alloc;
+    connect->client = client;
+
+    if (tcp->local) {
+        uv_pipe_connect(&connect->req, (struct uv_pipe_s *)client, address,
+                        raft_io_uv_tcp__connect_cb);
+
+        /* Errors connecting a Unix socket, such as a missing path, are
+         * detected right away but reported asynchronously through the
+         * callback. In that case the handle is not writable and there's no
+         * point in queueing the handshake. */
+        if (uv_is_writable(client)) {
+            raft_io_uv_tcp__handshake(connect);
+        }
+
+        goto out;
     }
 
-    rv = raft_io_uv_tcp__parse_address(address, &addr);
+    rv = raft_io_uv_tcp__parse_address(address, host, port, &addr);
     if (rv != 0) {
         goto err_after_tcp_init;
     }
 
-    rv = uv_tcp_connect(&connect->req, client, (struct sockaddr *)&addr,
-                        raft_io_uv_tcp__connect_cb);
-    if (rv != 0) {
-        /* UNTESTED: since parsing succeed, this should fail only because of
-         * lack of system resources */
-        raft_warnf(tcp->logger, "connect: %s", uv_strerror(rv));
-        rv = RAFT_ERR_IO_CONNECT;
-        goto err_after_tcp_init;
+    if (addr.ss_family == AF_UNSPEC) {
+        connect->address = (char *)(connect + 1);
+        strcpy(connect->address, address);
+
+        if (!raft_io_uv_tcp__cache_get(tcp, address, &addr)) {
+            rv = raft_io_uv_tcp__resolve(connect, host, port);
+            if (rv != 0) {
+                goto err_after_tcp_init;
+            }
+            goto out;
+        }
     }
 
-    rv = uv_write(&tcp->handshake.req, (struct uv_stream_s *)client,
-                  &tcp->handshake.buf, 1, NULL);
+    rv = raft_io_uv_tcp__connect_addr(connect, (struct sockaddr *)&addr);
     if (rv != 0) {
-        /* UNTESTED: what are the error conditions? perhaps ENOMEM */
-        raft_warnf(tcp->logger, "write: %s", uv_strerror(rv));
-        rv = RAFT_ERR_IO;
+        rv = RAFT_ERR_IO_CONNECT;
         goto err_after_tcp_init;
     }
 
-    *stream = (struct uv_stream_s *)client;
+out:
+    *stream = client;
 
     return 0;
 
 err_after_tcp_init:
     uv_close((uv_handle_t *)client, NULL);
-
-err_after_tcp_alloc:
     raft_free(client);
 
 err_after_connect_alloc:
@@ -1404,9 +3138,11 @@ err:
     return rv;
 }
 
-int raft_io_uv_tcp_init(struct raft_io_uv_transport *t,
-                        struct raft_logger *logger,
-                        struct uv_loop_s *loop)
+static int raft_io_uv_tcp__init(struct raft_io_uv_transport *t,
+                                struct raft_logger *logger,
+                                struct uv_loop_s *loop,
+                                bool local,
+                                const struct raft_io_uv_tcp_options *options)
 {
     struct raft_io_uv_tcp *tcp;
 
@@ -1418,7 +3154,21 @@ int raft_io_uv_tcp_init(struct raft_io_uv_transport *t,
 
     tcp->logger = logger;
     tcp->loop = loop;
-    tcp->listener.tcp.data = tcp;
+    tcp->local = local;
+    tcp->listener.handle.tcp.data = tcp;
+    tcp->listener.closed = false;
+    tcp->cache.entries = NULL;
+    tcp->cache.n = 0;
+    tcp->resolving = NULL;
+    tcp->stop.data = NULL;
+    tcp->stop.cb = NULL;
+
+    if (options != NULL) {
+        tcp->options = *options;
+    } else {
+        memset(&tcp->options, 0, sizeof tcp->options);
+        tcp->options.nodelay = true;
+    }
 
     t->data = tcp;
     t->start = raft_io_uv_tcp__start;
@@ -1428,9 +3178,35 @@ int raft_io_uv_tcp_init(struct raft_io_uv_transport *t,
     return 0;
 }
 
+int raft_io_uv_tcp_init(struct raft_io_uv_transport *t,
+                        struct raft_logger *logger,
+                        struct uv_loop_s *loop,
+                        const struct raft_io_uv_tcp_options *options)
+{
+    return raft_io_uv_tcp__init(t, logger, loop, false, options);
+}
+
+int raft_io_uv_unix_init(struct raft_io_uv_transport *t,
+                         struct raft_logger *logger,
+                         struct uv_loop_s *loop)
+{
+    return raft_io_uv_tcp__init(t, logger, loop, true, NULL);
+}
+
 void raft_io_uv_tcp_close(struct raft_io_uv_transport *t)
 {
     struct raft_io_uv_tcp *tcp = t->data;
+    unsigned i;
+
+    for (i = 0; i < tcp->cache.n; i++) {
+        raft_free(tcp->cache.entries[i].address);
+    }
+    raft_free(tcp->cache.entries);
 
     raft_free(tcp);
 }
+
+void raft_io_uv_unix_close(struct raft_io_uv_transport *t)
+{
+    raft_io_uv_tcp_close(t);
+}
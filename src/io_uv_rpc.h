@@ -7,22 +7,61 @@
 
 #include "../include/raft.h"
 
+/**
+ * The encoded entries of an AppendEntries message, shared by all requests that
+ * carry the same entries array to different servers.
+ */
+struct raft_io_uv_rpc_entries
+{
+    unsigned refs;                 /* Number of references */
+    const struct raft_entry *key;  /* The entries array that was encoded */
+    unsigned n;                    /* Number of entries in the array */
+    uv_buf_t *bufs;                /* Batch header followed by entries data */
+    unsigned n_bufs;               /* Number of buffers */
+    bool checksummed;              /* Whether crc has been calculated */
+    unsigned crc;                  /* CRC32C of the entries data */
+    bool compressed_tried;         /* Whether compression was attempted */
+    uv_buf_t compressed;           /* Compressed entries data, if smaller */
+};
+
 /**
  * An outgoing RPC request from this server to another server.
  */
 struct raft_io_uv_rpc_request
 {
-    uv_write_t req;
-    uv_buf_t *bufs;
-    unsigned n_bufs;
+    struct raft_io_uv_rpc_client *client;   /* Client the request is queued on */
+    uv_buf_t header;                        /* Encoded message header */
+    struct raft_io_uv_rpc_entries *entries; /* Encoded entries, if any */
+    size_t len;                             /* Total size of the message */
+    uint64_t extra[2];                      /* Words after the preamble */
+    unsigned n_extra;                       /* Number of extra words */
+    uv_buf_t *compressed;                   /* Compressed entries, if used */
+    uint64_t time;                          /* Loop time when it was sent */
+    struct raft_io_uv_rpc_request *next; /* Next request in the queue */
     void *data;
     void (*cb)(void *data, const int status);
 };
 
+/**
+ * A single write of one or more queued requests to the same server.
+ */
+struct raft_io_uv_rpc_write
+{
+    uv_write_t req;                      /* Write request */
+    struct raft_io_uv_rpc_request *head; /* Requests being written */
+    uv_buf_t *bufs;                      /* Buffers of all requests */
+    unsigned n_bufs;                     /* Number of buffers */
+};
+
 struct raft_io_uv_rpc;
 
 /**
  * A connection from this server to another server, used to sent request.
+ *
+ * Stripe 0 carries all control messages. If striping is enabled, AppendEntries
+ * messages carrying entries go through one of stripes 1 to n_stripes, which
+ * are separate connections to the same server, so large batches never delay
+ * heartbeats and votes.
  */
 struct raft_io_uv_rpc_client
 {
@@ -32,6 +71,30 @@ struct raft_io_uv_rpc_client
     struct uv_stream_s *stream; /* Connection handle */
     unsigned id;                /* ID of the server */
     char *address;              /* Address of the other server */
+    unsigned stripe;            /* Index of the connection to the server */
+    bool entries;               /* Whether it's the stripe carrying entries */
+
+    /* Requests waiting to be written out at the end of the current loop
+     * iteration. */
+    struct raft_io_uv_rpc_request *head;
+    struct raft_io_uv_rpc_request *tail;
+
+    /* Number of bytes queued or being written. When they reach the high
+     * watermark the client is marked as congested, until they drop back to
+     * the low watermark. */
+    size_t n_bytes;
+    bool congested;
+
+    /* Number of consecutive failed connection attempts, used to compute the
+     * delay before the next one. */
+    unsigned n_attempts;
+
+    /* Protocol version and optional features negotiated with the server,
+     * updated when its hello message arrives. */
+    unsigned version;
+    uint64_t features;
+    uint64_t hello[2]; /* Receive buffer for the hello message */
+    size_t hello_n;    /* Number of hello bytes received so far */
 };
 
 /**
@@ -43,11 +106,18 @@ struct raft_io_uv_rpc_server
     unsigned id;                 /* ID of the server */
     char *address;               /* Address of the other server */
     struct uv_stream_s *stream;  /* Connection handle */
-    uv_buf_t buf;                /* Sliding buffer for reading incoming data */
-    uint64_t preamble[2];        /* Static buffer with the request preamble */
-    uv_buf_t header;             /* Dynamic buffer with the request header */
-    uv_buf_t payload;            /* Dynamic buffer with the request payload */
+    uv_buf_t buf;                /* Receive buffer, can hold many messages */
+    size_t start;                /* Offset of the first unparsed byte in buf */
+    size_t end;                  /* Offset past the last byte read in buf */
+    uv_buf_t payload;            /* Payload of the message being received */
+    size_t payload_n;            /* Number of payload bytes received so far */
     struct raft_message message; /* The message being received */
+    bool payload_checksum;       /* Whether the payload has a checksum */
+    unsigned payload_crc;        /* Expected CRC32C of the payload */
+    bool payload_compressed;     /* Whether the payload is compressed */
+    size_t payload_size;         /* Size of the payload once decompressed */
+    struct uv_write_s hello_req; /* Write request for our hello message */
+    uint64_t hello[2];           /* Our version and features */
     bool aborted;                /* Whether the connection has been aborted */
 };
 
@@ -59,11 +129,21 @@ struct raft_io_uv_rpc
     struct raft_logger *logger;             /* Logger to use */
     struct uv_loop_s *loop;                 /* Event loop to use */
     struct raft_io_uv_transport *transport; /* Outbound and inbound streams */
-    struct raft_io_uv_rpc_client *clients;  /* Outgoing connections */
-    struct raft_io_uv_rpc_server *servers;  /* Incoming connections */
+    struct raft_io_uv_rpc_client **clients; /* Outgoing connections */
+    struct raft_io_uv_rpc_server **servers; /* Incoming connections */
     unsigned n_clients;                     /* Length of the clients array */
     unsigned n_servers;                     /* Length of the servers array */
-    unsigned connect_retry_delay;           /* Connection retry delay */
+    unsigned n_stripes;                     /* Extra connections per server */
+    unsigned connect_retry_delay;           /* First connection retry delay */
+    unsigned connect_retry_max_delay;       /* Max connection retry delay */
+    size_t max_pending_bytes;               /* Buffer limit when disconnected */
+    unsigned pending_timeout;               /* Max time a request is buffered */
+    bool checksums;                         /* Whether to checksum messages */
+    size_t compression_threshold;           /* Min entries size to compress */
+    struct uv_check_s flush;                /* Flush queued requests */
+    struct raft_io_uv_rpc_entries *entries; /* Entries encoded last */
+    size_t low_watermark;                   /* Clear congestion below this */
+    size_t high_watermark;                  /* Flag congestion above this */
 
     /* Track the number of active asynchronous operations that need to be
      * completed before this backend can be considered fully stopped. */
@@ -121,4 +201,11 @@ int raft_io_uv_rpc__send(struct raft_io_uv_rpc *r,
                          void *data,
                          void (*cb)(void *data, int status));
 
+/**
+ * Return true if the outstanding bytes of any connection to the server with the
+ * given ID have crossed the high watermark and have not yet dropped to the low
+ * one.
+ */
+bool raft_io_uv_rpc__congested(struct raft_io_uv_rpc *r, unsigned id);
+
 #endif /* RAFT_IO_UV_RPC_H */
@@ -0,0 +1,287 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "lz4.h"
+
+/**
+ * Matches are at least this long.
+ */
+#define RAFT__LZ4_MIN_MATCH 4
+
+/**
+ * The last bytes of a block are always literals, and the last match must start
+ * at least this many bytes before the end of the block.
+ */
+#define RAFT__LZ4_LAST_LITERALS 5
+#define RAFT__LZ4_MF_LIMIT 12
+
+/**
+ * Matches are encoded with a 16-bit offset.
+ */
+#define RAFT__LZ4_MAX_OFFSET 65535
+
+/**
+ * Size of the hash table used to find matches, as a power of two.
+ */
+#define RAFT__LZ4_HASH_LOG 12
+
+/**
+ * Lengths greater or equal than this don't fit in a token nibble, and are
+ * followed by extra bytes.
+ */
+#define RAFT__LZ4_RUN_MASK 15
+
+static uint32_t raft__lz4_read32(const uint8_t *p)
+{
+    uint32_t value;
+
+    memcpy(&value, p, sizeof value);
+
+    return value;
+}
+
+static unsigned raft__lz4_hash(const uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - RAFT__LZ4_HASH_LOG);
+}
+
+/**
+ * Return the number of bytes needed to encode the extra part of a length.
+ */
+static size_t raft__lz4_sizeof_length(const size_t len)
+{
+    if (len < RAFT__LZ4_RUN_MASK) {
+        return 0;
+    }
+
+    return (len - RAFT__LZ4_RUN_MASK) / 255 + 1;
+}
+
+static uint8_t *raft__lz4_put_length(uint8_t *cursor, size_t len)
+{
+    len -= RAFT__LZ4_RUN_MASK;
+
+    while (len >= 255) {
+        *cursor++ = 255;
+        len -= 255;
+    }
+
+    *cursor++ = (uint8_t)len;
+
+    return cursor;
+}
+
+/**
+ * Append a sequence of @n_literals literals starting at @literals, followed by
+ * a match of @match_len bytes at the given @offset, or by no match at all if
+ * @match_len is 0.
+ *
+ * Return the new end of the output, or NULL if there is not enough room.
+ */
+static uint8_t *raft__lz4_put_sequence(uint8_t *cursor,
+                                       const uint8_t *end,
+                                       const uint8_t *literals,
+                                       const size_t n_literals,
+                                       const size_t offset,
+                                       const size_t match_len)
+{
+    size_t size;
+    uint8_t *token;
+
+    size = 1 + raft__lz4_sizeof_length(n_literals) + n_literals;
+    if (match_len > 0) {
+        size += 2 + raft__lz4_sizeof_length(match_len - RAFT__LZ4_MIN_MATCH);
+    }
+
+    if ((size_t)(end - cursor) < size) {
+        return NULL;
+    }
+
+    token = cursor++;
+
+    if (n_literals >= RAFT__LZ4_RUN_MASK) {
+        *token = RAFT__LZ4_RUN_MASK << 4;
+        cursor = raft__lz4_put_length(cursor, n_literals);
+    } else {
+        *token = (uint8_t)(n_literals << 4);
+    }
+
+    memcpy(cursor, literals, n_literals);
+    cursor += n_literals;
+
+    if (match_len == 0) {
+        return cursor;
+    }
+
+    *cursor++ = (uint8_t)(offset & 0xff);
+    *cursor++ = (uint8_t)(offset >> 8);
+
+    if (match_len - RAFT__LZ4_MIN_MATCH >= RAFT__LZ4_RUN_MASK) {
+        *token |= RAFT__LZ4_RUN_MASK;
+        cursor = raft__lz4_put_length(cursor, match_len - RAFT__LZ4_MIN_MATCH);
+    } else {
+        *token |= (uint8_t)(match_len - RAFT__LZ4_MIN_MATCH);
+    }
+
+    return cursor;
+}
+
+/**
+ * Read the extra part of a length, if any, adding it to @len.
+ */
+static int raft__lz4_get_length(const uint8_t **cursor,
+                                const uint8_t *end,
+                                size_t *len)
+{
+    uint8_t byte;
+
+    if (*len != RAFT__LZ4_RUN_MASK) {
+        return 0;
+    }
+
+    do {
+        if (*cursor == end) {
+            return -1;
+        }
+        byte = *(*cursor)++;
+        *len += byte;
+    } while (byte == 255);
+
+    return 0;
+}
+
+size_t raft__lz4_bound(const size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+size_t raft__lz4_compress(const void *src,
+                          const size_t size,
+                          void *dst,
+                          const size_t capacity)
+{
+    uint32_t table[1 << RAFT__LZ4_HASH_LOG];
+    const uint8_t *base = src;
+    const uint8_t *end = base + size;
+    const uint8_t *cursor = base;
+    const uint8_t *anchor = base;
+    uint8_t *out = dst;
+    uint8_t *out_end = out + capacity;
+
+    memset(table, 0, sizeof table);
+
+    /* Blocks that are too short only contain literals. */
+    while (size > RAFT__LZ4_MF_LIMIT && cursor < end - RAFT__LZ4_MF_LIMIT) {
+        const uint8_t *match_limit = end - RAFT__LZ4_LAST_LITERALS;
+        uint32_t sequence = raft__lz4_read32(cursor);
+        unsigned hash = raft__lz4_hash(sequence);
+        const uint8_t *ref = base + table[hash];
+        size_t len;
+
+        table[hash] = (uint32_t)(cursor - base);
+
+        if (ref >= cursor || cursor - ref > RAFT__LZ4_MAX_OFFSET ||
+            raft__lz4_read32(ref) != sequence) {
+            cursor++;
+            continue;
+        }
+
+        /* Extend the match backwards over the pending literals. */
+        while (cursor > anchor && ref > base && cursor[-1] == ref[-1]) {
+            cursor--;
+            ref--;
+        }
+
+        len = RAFT__LZ4_MIN_MATCH;
+        while (cursor + len < match_limit && cursor[len] == ref[len]) {
+            len++;
+        }
+
+        out = raft__lz4_put_sequence(out, out_end, anchor,
+                                     (size_t)(cursor - anchor),
+                                     (size_t)(cursor - ref), len);
+        if (out == NULL) {
+            return 0;
+        }
+
+        cursor += len;
+        anchor = cursor;
+    }
+
+    out = raft__lz4_put_sequence(out, out_end, anchor, (size_t)(end - anchor),
+                                 0, 0);
+    if (out == NULL) {
+        return 0;
+    }
+
+    return (size_t)(out - (uint8_t *)dst);
+}
+
+int raft__lz4_decompress(const void *src,
+                         const size_t size,
+                         void *dst,
+                         const size_t capacity)
+{
+    const uint8_t *cursor = src;
+    const uint8_t *end = cursor + size;
+    uint8_t *out = dst;
+    uint8_t *out_end = out + capacity;
+
+    while (cursor < end) {
+        uint8_t token = *cursor++;
+        size_t len = token >> 4;
+        size_t offset;
+        const uint8_t *ref;
+
+        if (raft__lz4_get_length(&cursor, end, &len) != 0) {
+            return -1;
+        }
+
+        if (len > (size_t)(end - cursor) || len > (size_t)(out_end - out)) {
+            return -1;
+        }
+
+        memcpy(out, cursor, len);
+        cursor += len;
+        out += len;
+
+        /* The last sequence has no match. */
+        if (cursor == end) {
+            break;
+        }
+
+        if (end - cursor < 2) {
+            return -1;
+        }
+
+        offset = (size_t)cursor[0] | ((size_t)cursor[1] << 8);
+        cursor += 2;
+
+        if (offset == 0 || offset > (size_t)(out - (uint8_t *)dst)) {
+            return -1;
+        }
+
+        len = token & RAFT__LZ4_RUN_MASK;
+        if (raft__lz4_get_length(&cursor, end, &len) != 0) {
+            return -1;
+        }
+        len += RAFT__LZ4_MIN_MATCH;
+
+        if (len > (size_t)(out_end - out)) {
+            return -1;
+        }
+
+        /* The match can overlap with the bytes being written. */
+        ref = out - offset;
+        while (len > 0) {
+            *out++ = *ref++;
+            len--;
+        }
+    }
+
+    if (out != out_end) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * Compress data using the LZ4 block format.
+ */
+
+#ifndef RAFT_LZ4_H
+#define RAFT_LZ4_H
+
+#include "../include/raft.h"
+
+/**
+ * Return the maximum size that compressing @size bytes of data can take.
+ */
+size_t raft__lz4_bound(const size_t size);
+
+/**
+ * Compress @size bytes of data from @src into @dst, which has room for
+ * @capacity bytes.
+ *
+ * Return the size of the compressed data, or 0 if it doesn't fit in @dst.
+ */
+size_t raft__lz4_compress(const void *src,
+                          const size_t size,
+                          void *dst,
+                          const size_t capacity);
+
+/**
+ * Decompress @size bytes of compressed data from @src into @dst, which must be
+ * exactly as big as the original data.
+ *
+ * Return 0 on success, or -1 if the data is malformed or its decompressed size
+ * doesn't match @capacity.
+ */
+int raft__lz4_decompress(const void *src,
+                         const size_t size,
+                         void *dst,
+                         const size_t capacity);
+
+#endif /* RAFT_LZ4_H */
@@ -4,6 +4,20 @@
 #include "configuration.h"
 #include "log.h"
 #include "membership.h"
+#include "replication.h"
+#include "state.h"
+
+/**
+ * Number of samples to take before deciding that the server being promoted
+ * can't keep up with the leader.
+ */
+#define RAFT_MEMBERSHIP__CATCH_UP_MIN_SAMPLES 10
+
+/**
+ * Number of election timeouts without any progress after which the server
+ * being promoted is considered unresponsive.
+ */
+#define RAFT_MEMBERSHIP__CATCH_UP_MAX_IDLE 10
 
 int raft_membership__can_change_configuration(struct raft *r)
 {
@@ -24,6 +38,18 @@ int raft_membership__can_change_configuration(struct raft *r)
         return rv;
     }
 
+    if (r->leader_state.transferee_id != 0) {
+        rv = RAFT_ERR_LEADERSHIP_TRANSFER;
+        return rv;
+    }
+
+    /* A committed joint configuration must be followed by C_new before any
+     * other change. */
+    if (raft_configuration__is_joint(&r->configuration)) {
+        rv = RAFT_ERR_CONFIGURATION_BUSY;
+        return rv;
+    }
+
     /* In order to become leader at all we are supposed to have committed at
      * least the initial configuration at index 1. */
     assert(r->configuration_index > 0);
@@ -32,60 +58,325 @@ int raft_membership__can_change_configuration(struct raft *r)
      * last log index. */
     assert(raft_log__last_index(&r->log) >= r->configuration_index);
 
-    /* No catch-up round should be in progress. */
-    assert(r->leader_state.round_number == 0);
-    assert(r->leader_state.round_index == 0);
-    assert(r->leader_state.round_duration == 0);
+    /* No catch-up should be in progress. */
+    assert(r->leader_state.catch_up_elapsed == 0);
+    assert(r->leader_state.catch_up_samples == 0);
+
+    return 0;
+}
+
+int raft_membership__change_configuration(
+    struct raft *r,
+    const struct raft_configuration *configuration)
+{
+    raft_index index;
+    raft_term term = r->current_term;
+    int rv;
+
+    /* Index of the entry being appended. */
+    index = raft_log__last_index(&r->log) + 1;
+
+    /* Encode the new configuration and append it to the log. */
+    rv = raft_log__append_configuration(&r->log, term, configuration);
+    if (rv != 0) {
+        goto err;
+    }
+
+    if (configuration != &r->configuration) {
+        rv = raft_state__rebuild_next_and_match_indexes(r, configuration);
+        if (rv != 0) {
+            goto err_after_log_append;
+        }
+    }
+
+    /* Update the current configuration if we've created a new object. */
+    if (configuration != &r->configuration) {
+        raft_configuration_close(&r->configuration);
+        r->configuration = *configuration;
+    }
+
+    /* Start writing the new log entry to disk and send it to the followers. */
+    rv = raft_replication__trigger(r, index);
+    if (rv != 0) {
+        /* TODO: restore the old next/match indexes and configuration. */
+        goto err_after_log_append;
+    }
+
+    r->configuration_uncommitted_index = index;
+
+    return 0;
+
+err_after_log_append:
+    raft_log__truncate(&r->log, index);
+
+err:
+    assert(rv != 0);
+    return rv;
+}
+
+int raft_membership__leave_joint(struct raft *r)
+{
+    struct raft_configuration configuration;
+    int rv;
+
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(r->configuration_uncommitted_index == 0);
+    assert(raft_configuration__is_joint(&r->configuration));
+
+    raft_configuration_init(&configuration);
+
+    rv = raft_configuration__leave_joint(&r->configuration, &configuration);
+    if (rv != 0) {
+        goto err_after_configuration_init;
+    }
+
+    rv = raft_membership__change_configuration(r, &configuration);
+    if (rv != 0) {
+        goto err_after_configuration_init;
+    }
 
     return 0;
+
+err_after_configuration_init:
+    raft_configuration_close(&configuration);
+
+    assert(rv != 0);
+    return rv;
 }
 
-bool raft_membership__update_catch_up_round(struct raft *r)
+void raft_membership__catch_up_start(struct raft *r, unsigned id)
 {
     size_t server_index;
-    raft_index match_index;
-    raft_index last_index;
-    bool is_up_to_date;
-    bool is_fast_enough;
 
     assert(r->state == RAFT_STATE_LEADER);
-    assert(r->leader_state.promotee_id != 0);
+    assert(r->leader_state.promotee_id == 0);
+
+    server_index = raft_configuration__index(&r->configuration, id);
+    assert(server_index < r->configuration.n);
+
+    r->leader_state.promotee_id = id;
+    r->leader_state.catch_up_match = r->leader_state.match_index[server_index];
+    r->leader_state.catch_up_last = raft_log__last_index(&r->log);
+    r->leader_state.catch_up_sent = 0;
+    r->leader_state.catch_up_elapsed = 0;
+    r->leader_state.catch_up_idle = 0;
+    r->leader_state.catch_up_samples = 0;
+    r->leader_state.catch_up_apply_rate = 0;
+    r->leader_state.catch_up_append_rate = 0;
+}
+
+void raft_membership__catch_up_reset(struct raft *r)
+{
+    r->leader_state.promotee_id = 0;
+    r->leader_state.catch_up_match = 0;
+    r->leader_state.catch_up_last = 0;
+    r->leader_state.catch_up_sent = 0;
+    r->leader_state.catch_up_elapsed = 0;
+    r->leader_state.catch_up_idle = 0;
+    r->leader_state.catch_up_samples = 0;
+    r->leader_state.catch_up_apply_rate = 0;
+    r->leader_state.catch_up_append_rate = 0;
+}
+
+/**
+ * Return the number of entries per second corresponding to @delta entries
+ * replicated or appended in @elapsed milliseconds.
+ */
+static unsigned raft_membership__rate(raft_index delta, unsigned elapsed)
+{
+    assert(elapsed > 0);
+
+    return (unsigned)(delta * 1000 / elapsed);
+}
+
+/**
+ * Blend a new rate sample into a smoothed rate, giving the new sample a weight
+ * of 1/4.
+ */
+static unsigned raft_membership__smooth(unsigned rate, unsigned sample)
+{
+    return (unsigned)(((uint64_t)rate * 3 + sample) / 4);
+}
+
+/**
+ * Return the index of the server being promoted in the current configuration.
+ */
+static size_t raft_membership__promotee_index(struct raft *r)
+{
+    size_t server_index;
 
     server_index = raft_configuration__index(&r->configuration,
                                              r->leader_state.promotee_id);
     assert(server_index < r->configuration.n);
 
-    match_index = r->leader_state.match_index[server_index];
+    return server_index;
+}
 
-    /* If the server did not reach the target index for this round, it did not
-     * catch up. */
-    if (match_index < r->leader_state.round_index) {
+bool raft_membership__update_catch_up(struct raft *r)
+{
+    raft_index match_index;
+    raft_index last_index;
+    raft_index lag;
+    unsigned apply_rate;
+    unsigned append_rate;
+    uint64_t projected;
+
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(r->leader_state.promotee_id != 0);
+
+    match_index =
+        r->leader_state.match_index[raft_membership__promotee_index(r)];
+    last_index = raft_log__last_index(&r->log);
+
+    r->leader_state.catch_up_idle = 0;
+
+    /* If the server's log is fully up-to-date it has obviously caught up. */
+    assert(match_index <= last_index);
+    lag = last_index - match_index;
+    if (lag == 0) {
+        return true;
+    }
+
+    /* Otherwise we need at least one sample of the replication and append
+     * rates to project how long it would take to close the gap. */
+    if (r->leader_state.catch_up_samples == 0) {
         return false;
     }
 
-    last_index = raft_log__last_index(&r->log);
+    apply_rate = r->leader_state.catch_up_apply_rate;
+    append_rate = r->leader_state.catch_up_append_rate;
 
-    is_up_to_date = match_index == last_index;
-    is_fast_enough = r->leader_state.round_duration < r->election_timeout;
+    if (apply_rate <= append_rate) {
+        return false;
+    }
 
-    /* If the server's log is fully up-to-date or the round that just terminated
-     * was fast enough, then the server as caught up. */
-    if (is_up_to_date || is_fast_enough) {
-        r->leader_state.round_number = 0;
-        r->leader_state.round_index = 0;
-        r->leader_state.round_duration = 0;
+    /* From Section 4.2.1:
+     *
+     *   If the last round lasts less than an election timeout, then the leader
+     *   adds the new server to the cluster, under the assumption that there are
+     *   not enough unreplicated entries to create a significant availability
+     *   gap.
+     *
+     * Instead of waiting for a round to complete, consider the server caught
+     * up as soon as the projected time to close the gap is under an election
+     * timeout. */
+    projected = lag * 1000 / (apply_rate - append_rate);
+
+    return projected < r->election_timeout;
+}
 
-        return true;
+bool raft_membership__catch_up_tick(struct raft *r, unsigned msec)
+{
+    raft_index match_index;
+    raft_index last_index;
+    unsigned elapsed;
+    unsigned apply_rate;
+    unsigned append_rate;
+    bool is_unresponsive;
+    bool is_too_slow;
+
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(r->leader_state.promotee_id != 0);
+
+    r->leader_state.catch_up_elapsed += msec;
+    r->leader_state.catch_up_idle += msec;
+
+    elapsed = r->leader_state.catch_up_elapsed;
+
+    /* Take a new sample once per heartbeat timeout. */
+    if (elapsed >= r->heartbeat_timeout) {
+        match_index =
+            r->leader_state.match_index[raft_membership__promotee_index(r)];
+        last_index = raft_log__last_index(&r->log);
+
+        apply_rate = raft_membership__rate(
+            match_index - r->leader_state.catch_up_match, elapsed);
+        append_rate = raft_membership__rate(
+            last_index - r->leader_state.catch_up_last, elapsed);
+
+        if (r->leader_state.catch_up_samples > 0) {
+            apply_rate = raft_membership__smooth(
+                r->leader_state.catch_up_apply_rate, apply_rate);
+            append_rate = raft_membership__smooth(
+                r->leader_state.catch_up_append_rate, append_rate);
+        }
+
+        r->leader_state.catch_up_match = match_index;
+        r->leader_state.catch_up_last = last_index;
+        r->leader_state.catch_up_elapsed = 0;
+        r->leader_state.catch_up_apply_rate = apply_rate;
+        r->leader_state.catch_up_append_rate = append_rate;
+        r->leader_state.catch_up_samples++;
     }
 
-    /* If we get here it means that this catch-up round is complete, but there
-     * are more entries to replicate, or it was not fast enough. Let's start a
-     * new round. */
-    r->leader_state.round_number++;
-    r->leader_state.round_index = last_index;
-    r->leader_state.round_duration = 0;
+    is_unresponsive = r->leader_state.catch_up_idle >=
+                      RAFT_MEMBERSHIP__CATCH_UP_MAX_IDLE * r->election_timeout;
+
+    /* A server which replicates entries slower than we append them will never
+     * catch up. */
+    is_too_slow = r->leader_state.catch_up_samples >=
+                      RAFT_MEMBERSHIP__CATCH_UP_MIN_SAMPLES &&
+                  r->leader_state.catch_up_append_rate > 0 &&
+                  r->leader_state.catch_up_apply_rate <=
+                      r->leader_state.catch_up_append_rate;
+
+    return is_unresponsive || is_too_slow;
+}
+
+int raft_membership__transfer(struct raft *r)
+{
+    struct raft_message message;
+    const struct raft_server *server;
+    size_t server_index;
+    int rv;
+
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(r->leader_state.transferee_id != 0);
+
+    if (r->leader_state.transfer_sent) {
+        return 0;
+    }
+
+    server_index = raft_configuration__index(&r->configuration,
+                                             r->leader_state.transferee_id);
+
+    /* The server might have been removed in the meantime. */
+    if (server_index == r->configuration.n) {
+        raft_membership__transfer_abort(r);
+        return 0;
+    }
+
+    server = &r->configuration.servers[server_index];
+
+    if (r->leader_state.match_index[server_index] !=
+        raft_log__last_index(&r->log)) {
+        return 0;
+    }
+
+    message.type = RAFT_IO_TIMEOUT_NOW;
+    message.server_id = server->id;
+    message.server_address = server->address;
+    message.timeout_now.term = r->current_term;
+    message.timeout_now.last_log_index = raft_log__last_index(&r->log);
+    message.timeout_now.last_log_term = raft_log__last_term(&r->log);
+
+    rv = r->io->send(r->io, &message, NULL, NULL);
+    if (rv != 0) {
+        return rv;
+    }
+
+    r->leader_state.transfer_sent = true;
+
+    return 0;
+}
+
+void raft_membership__transfer_abort(struct raft *r)
+{
+    assert(r->state == RAFT_STATE_LEADER);
 
-    return false;
+    r->leader_state.transferee_id = 0;
+    r->leader_state.transfer_duration = 0;
+    r->leader_state.transfer_sent = false;
 }
 
 int raft_membership__apply(struct raft *r,
@@ -14,17 +14,81 @@
  */
 int raft_membership__can_change_configuration(struct raft *r);
 
+/**
+ * Append a RAFT_LOG_CONFIGURATION entry with the given configuration to the
+ * log, make it the current one and start replicating it.
+ *
+ * If @configuration is not the current configuration object itself, the leader
+ * takes ownership of it on success.
+ *
+ * This function must be called only by leaders.
+ */
+int raft_membership__change_configuration(
+    struct raft *r,
+    const struct raft_configuration *configuration);
+
+/**
+ * Append the C_new configuration entry that completes the transition from the
+ * current joint configuration, which must have been committed.
+ *
+ * From Section §4.3:
+ *
+ *   Once the joint consensus has been committed, the system then transitions
+ *   to the new configuration.
+ *
+ * This function must be called only by leaders.
+ */
+int raft_membership__leave_joint(struct raft *r);
+
+/**
+ * Start tracking the progress that the non-voting server with the given ID is
+ * making in catching up with logs, before it gets promoted.
+ */
+void raft_membership__catch_up_start(struct raft *r, unsigned id);
+
+/**
+ * Stop tracking the progress of the server being promoted, if any.
+ */
+void raft_membership__catch_up_reset(struct raft *r);
+
 /**
  * Update the information about the progress that the non-voting server
- * currently being promoted is making in catching with logs.
+ * currently being promoted is making in catching with logs, after its match
+ * index has advanced.
  *
- * Return false if the server being promoted did not yet catch-up with logs, and
- * true if it did.
+ * Return true if the server's log is up-to-date, or if at the estimated
+ * replication and append rates its lag is projected to be closed within an
+ * election timeout. Return false otherwise.
  *
  * This function must be called only by leaders after a @raft_promote request
  * has been submitted.
  */
-bool raft_membership__update_catch_up_round(struct raft *r);
+bool raft_membership__update_catch_up(struct raft *r);
+
+/**
+ * Advance the catch-up timers of the server being promoted by the given number
+ * of milliseconds, sampling its replication rate and our append rate once per
+ * heartbeat timeout.
+ *
+ * Return true if the promotion should be aborted, because the server made no
+ * progress for too long or because it replicates entries slower than we
+ * append them.
+ */
+bool raft_membership__catch_up_tick(struct raft *r, unsigned msec);
+
+/**
+ * Send a TimeoutNow RPC to the server we are transferring leadership to, if
+ * its log has caught up with ours and we didn't send one already.
+ *
+ * This function must be called only by leaders after a
+ * @raft_transfer_leadership request has been submitted.
+ */
+int raft_membership__transfer(struct raft *r);
+
+/**
+ * Abort the leadership transfer in progress.
+ */
+void raft_membership__transfer_abort(struct raft *r);
 
 /**
  * Update the local configuration replacing it with the content of the given
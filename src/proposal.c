@@ -0,0 +1,70 @@
+#include "../include/raft.h"
+
+#include "assert.h"
+#include "proposal.h"
+
+void raft_proposal__init(struct raft *r)
+{
+    assert(r->state == RAFT_STATE_LEADER);
+
+    r->leader_state.applies = NULL;
+    r->leader_state.applies_tail = NULL;
+}
+
+void raft_proposal__clear(struct raft *r)
+{
+    struct raft_apply *head = r->leader_state.applies;
+
+    r->leader_state.applies = NULL;
+    r->leader_state.applies_tail = NULL;
+
+    while (head != NULL) {
+        struct raft_apply *req = head;
+
+        head = req->next;
+
+        req->next = NULL;
+        req->cb(req, RAFT_ERR_NOT_LEADER);
+    }
+}
+
+void raft_proposal__push(struct raft *r, struct raft_apply *req)
+{
+    assert(r->state == RAFT_STATE_LEADER);
+
+    req->next = NULL;
+
+    if (r->leader_state.applies_tail == NULL) {
+        r->leader_state.applies = req;
+    } else {
+        assert(r->leader_state.applies_tail->index < req->index);
+        r->leader_state.applies_tail->next = req;
+    }
+
+    r->leader_state.applies_tail = req;
+}
+
+void raft_proposal__applied(struct raft *r)
+{
+    if (r->state != RAFT_STATE_LEADER) {
+        return;
+    }
+
+    /* A leader never overwrites entries in its own log, so the entries of
+     * pending requests are still the ones that were appended for them. */
+    while (r->leader_state.applies != NULL) {
+        struct raft_apply *req = r->leader_state.applies;
+
+        if (req->index + req->n - 1 > r->last_applied) {
+            break;
+        }
+
+        r->leader_state.applies = req->next;
+        if (r->leader_state.applies == NULL) {
+            r->leader_state.applies_tail = NULL;
+        }
+
+        req->next = NULL;
+        req->cb(req, 0);
+    }
+}
@@ -0,0 +1,33 @@
+/**
+ * Track client requests submitted with @raft_apply until their commands are
+ * applied.
+ */
+
+#ifndef RAFT_PROPOSAL_H
+#define RAFT_PROPOSAL_H
+
+#include "../include/raft.h"
+
+/**
+ * Initialize the queue of pending requests of a newly elected leader.
+ */
+void raft_proposal__init(struct raft *r);
+
+/**
+ * Fail all pending requests, because leadership was lost.
+ */
+void raft_proposal__clear(struct raft *r);
+
+/**
+ * Append a request whose commands were just added to the log.
+ */
+void raft_proposal__push(struct raft *r, struct raft_apply *req);
+
+/**
+ * Complete all requests whose commands have been applied.
+ *
+ * It must be called whenever the last applied index changes.
+ */
+void raft_proposal__applied(struct raft *r);
+
+#endif /* RAFT_PROPOSAL_H */
@@ -7,9 +7,12 @@
 #include "configuration.h"
 #include "election.h"
 #include "log.h"
+#include "read.h"
 #include "rpc.h"
 #include "rpc_append_entries.h"
+#include "rpc_read_index.h"
 #include "rpc_request_vote.h"
+#include "rpc_timeout_now.h"
 #include "state.h"
 #include "tick.h"
 
@@ -55,9 +58,24 @@ int raft_init(struct raft *r,
 
     r->election_timeout = RAFT__DEFAULT_ELECTION_TIMEOUT;
     r->heartbeat_timeout = RAFT__DEFAULT_HEARTBEAT_TIMEOUT;
+    r->election_priority = 0;
+    r->election_adaptive = false;
+    r->election_timeout_min = 0;
+    r->election_timeout_adaptive = 0;
+    r->heartbeat_interval = 0;
+    r->heartbeat_jitter = 0;
 
     r->commit_index = 0;
     r->last_applied = 0;
+    r->apply_in_background = false;
+    r->applying = false;
+    r->read_lease = false;
+    r->read_lease_drift = 0;
+    r->read_id = 0;
+    r->max_pending_entries = 0;
+    r->pre_vote = false;
+    r->check_quorum = false;
+    r->lazy_learners = false;
 
     r->state = RAFT_STATE_UNAVAILABLE;
 
@@ -139,6 +157,31 @@ static void raft__recv_cb(void *data, struct raft_message *message)
                 r, message->server_id, message->server_address,
                 &message->request_vote_result);
             break;
+        case RAFT_IO_READ_INDEX:
+            rv = raft_rpc__recv_read_index(r, message->server_id,
+                                           message->server_address,
+                                           &message->read_index);
+            break;
+        case RAFT_IO_READ_INDEX_RESULT:
+            rv = raft_rpc__recv_read_index_result(
+                r, message->server_id, message->server_address,
+                &message->read_index_result);
+            break;
+        case RAFT_IO_PRE_VOTE:
+            rv = raft_rpc__recv_pre_vote(r, message->server_id,
+                                         message->server_address,
+                                         &message->pre_vote);
+            break;
+        case RAFT_IO_PRE_VOTE_RESULT:
+            rv = raft_rpc__recv_pre_vote_result(r, message->server_id,
+                                                message->server_address,
+                                                &message->pre_vote_result);
+            break;
+        case RAFT_IO_TIMEOUT_NOW:
+            rv = raft_rpc__recv_timeout_now(r, message->server_id,
+                                            message->server_address,
+                                            &message->timeout_now);
+            break;
         default:
             rv = RAFT_ERR_MALFORMED;
             break;
@@ -223,6 +266,8 @@ int raft_start(struct raft *r)
     }
 
     r->state = RAFT_STATE_FOLLOWER;
+    r->follower_state.current_leader_id = 0;
+    raft_read__init_follower(r);
 
     return 0;
 
@@ -274,6 +319,73 @@ void raft_set_election_timeout(struct raft *r, const unsigned election_timeout)
     raft_election__reset_timer(r);
 }
 
+void raft_set_election_priority(struct raft *r, unsigned priority)
+{
+    r->election_priority = priority;
+    raft_election__reset_timer(r);
+}
+
+void raft_set_adaptive_election_timeout(struct raft *r,
+                                        bool enabled,
+                                        unsigned min)
+{
+    assert(r->state == RAFT_STATE_UNAVAILABLE);
+    assert(!enabled || min > r->heartbeat_timeout);
+    assert(!enabled || min <= r->election_timeout);
+    assert(!enabled || !r->read_lease || r->read_lease_drift < min);
+
+    r->election_adaptive = enabled;
+    r->election_timeout_min = min;
+    r->election_timeout_adaptive = 0;
+}
+
+void raft_set_apply_in_background(struct raft *r, bool enabled)
+{
+    assert(r->state == RAFT_STATE_UNAVAILABLE);
+    assert(!enabled || r->io->queue_work != NULL);
+
+    r->apply_in_background = enabled;
+}
+
+void raft_set_read_lease(struct raft *r, bool enabled, unsigned drift)
+{
+    assert(r->state == RAFT_STATE_UNAVAILABLE);
+    assert(!enabled || drift < r->election_timeout);
+    assert(!enabled || !r->election_adaptive ||
+           drift < r->election_timeout_min);
+
+    r->read_lease = enabled;
+    r->read_lease_drift = drift;
+}
+
+void raft_set_max_pending_entries(struct raft *r, unsigned n)
+{
+    r->max_pending_entries = n;
+}
+
+void raft_set_pre_vote(struct raft *r, bool enabled)
+{
+    assert(r != NULL);
+    assert(r->state == RAFT_STATE_UNAVAILABLE);
+
+    r->pre_vote = enabled;
+}
+
+void raft_set_check_quorum(struct raft *r, bool enabled)
+{
+    assert(r != NULL);
+    assert(r->state == RAFT_STATE_UNAVAILABLE);
+
+    r->check_quorum = enabled;
+}
+
+void raft_set_lazy_learners(struct raft *r, bool enabled)
+{
+    assert(r != NULL);
+
+    r->lazy_learners = enabled;
+}
+
 const char *raft_state_name(struct raft *r)
 {
     return raft_state_names[r->state];
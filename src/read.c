@@ -0,0 +1,592 @@
+#include <limits.h>
+
+#include "../include/raft.h"
+
+#include "assert.h"
+#include "configuration.h"
+#include "log.h"
+#include "read.h"
+#include "replication.h"
+
+/**
+ * Invoke the callback of each read in the given list.
+ */
+static void raft_read__finish(struct raft_read *head, const int status)
+{
+    while (head != NULL) {
+        struct raft_read *req = head;
+
+        head = req->next;
+
+        req->next = NULL;
+        req->cb(req, status);
+    }
+}
+
+/**
+ * Return true if a majority of voting servers has acknowledged a heartbeat
+ * sent after the current round started, or after the current lease probe
+ * started if @lease is true.
+ */
+static bool raft_read__confirmed(struct raft *r, const bool lease)
+{
+    size_t votes = 0;
+    size_t votes_old = 0;
+    size_t i;
+
+    for (i = 0; i < r->configuration.n; i++) {
+        struct raft_server *server = &r->configuration.servers[i];
+        struct raft_read_peer *peer = &r->leader_state.read_peers[i];
+        unsigned target = lease ? peer->lease_target : peer->target;
+
+        if (!raft_configuration__is_voting(server)) {
+            continue;
+        }
+
+        if (server->id == r->id || peer->n_acked >= target) {
+            if (server->voting) {
+                votes++;
+            }
+            if (server->voting_old) {
+                votes_old++;
+            }
+        }
+    }
+
+    return raft_configuration__is_majority(&r->configuration, votes,
+                                           votes_old);
+}
+
+/**
+ * Move the reads of the current round to the confirmed list.
+ */
+static void raft_read__confirm(struct raft *r)
+{
+    struct raft_read *tail = r->leader_state.reads_round;
+
+    assert(tail != NULL);
+
+    while (tail->next != NULL) {
+        tail = tail->next;
+    }
+
+    tail->next = r->leader_state.reads_confirmed;
+    r->leader_state.reads_confirmed = r->leader_state.reads_round;
+    r->leader_state.reads_round = NULL;
+}
+
+/**
+ * Return true if the lease obtained with the last confirmed probe hasn't
+ * expired yet.
+ *
+ * With adaptive election timeouts, followers might time out as early as the
+ * configured minimum, which then bounds the lease.
+ *
+ * No lease is held during a leadership transfer, since the transferee can get
+ * elected without waiting for the followers' election timeout to expire.
+ */
+static bool raft_read__lease_held(struct raft *r)
+{
+    unsigned elapsed;
+    unsigned timeout;
+
+    if (!r->read_lease || !r->leader_state.lease_valid ||
+        r->leader_state.transferee_id != 0) {
+        return false;
+    }
+
+    elapsed = r->leader_state.clock - r->leader_state.lease_start;
+
+    timeout = r->election_adaptive ? r->election_timeout_min
+                                   : r->election_timeout;
+
+    return elapsed < timeout - r->read_lease_drift;
+}
+
+/**
+ * Extend the lease to the start of the current probe.
+ */
+static void raft_read__lease_extend(struct raft *r)
+{
+    assert(r->leader_state.lease_probing);
+
+    r->leader_state.lease_start = r->leader_state.lease_probe;
+    r->leader_state.lease_valid = true;
+    r->leader_state.lease_probing = false;
+}
+
+/**
+ * Confirm all reads waiting for a round using the lease, recording the current
+ * commit index as their read index.
+ */
+static void raft_read__lease_confirm(struct raft *r)
+{
+    struct raft_read *req;
+
+    while (r->leader_state.reads != NULL) {
+        req = r->leader_state.reads;
+        r->leader_state.reads = req->next;
+
+        req->index = r->commit_index;
+        req->next = r->leader_state.reads_confirmed;
+        r->leader_state.reads_confirmed = req;
+    }
+}
+
+/**
+ * Start a new round for all reads waiting for one, recording the current
+ * commit index as their read index and sending heartbeats.
+ *
+ * Since AppendEntries results don't carry any reference to the request they
+ * answer, a follower acknowledges the round once the number of successful
+ * results received from it in this term exceeds the number of AppendEntries
+ * sent to it before the round started: at least one of those results must
+ * then answer a heartbeat sent after the read index was recorded.
+ */
+static void raft_read__start_round(struct raft *r)
+{
+    struct raft_read *req;
+    size_t i;
+    int rv;
+
+    assert(r->leader_state.reads != NULL);
+    assert(r->leader_state.reads_round == NULL);
+
+    r->leader_state.reads_round = r->leader_state.reads;
+    r->leader_state.reads = NULL;
+
+    for (req = r->leader_state.reads_round; req != NULL; req = req->next) {
+        req->index = r->commit_index;
+    }
+
+    for (i = 0; i < r->configuration.n; i++) {
+        struct raft_read_peer *peer = &r->leader_state.read_peers[i];
+        peer->target = peer->n_sent + 1;
+    }
+
+    /* A single voter cluster has nothing to wait for. */
+    if (raft_read__confirmed(r, false)) {
+        raft_read__confirm(r);
+        return;
+    }
+
+    rv = raft_replication__trigger(r, 0);
+    if (rv != 0) {
+        /* Not critical, the next heartbeat will be acknowledged too. */
+        raft_warnf(r->logger, "send read heartbeats: %s (%d)",
+                   raft_strerror(rv), rv);
+    }
+}
+
+/**
+ * Complete all reads in the given confirmed list whose read index has been
+ * applied.
+ */
+static void raft_read__complete(struct raft *r, struct raft_read **confirmed)
+{
+    struct raft_read **cursor = confirmed;
+    struct raft_read *done = NULL;
+
+    while (*cursor != NULL) {
+        struct raft_read *req = *cursor;
+
+        if (req->index > r->last_applied) {
+            cursor = &req->next;
+            continue;
+        }
+
+        *cursor = req->next;
+        req->next = done;
+        done = req;
+    }
+
+    raft_read__finish(done, 0);
+}
+
+/**
+ * Send a ReadIndex RPC to the current leader for all reads waiting for one.
+ */
+static int raft_read__send(struct raft *r)
+{
+    const struct raft_server *server;
+    struct raft_message message;
+    int rv;
+
+    assert(r->state == RAFT_STATE_FOLLOWER);
+    assert(r->follower_state.reads != NULL);
+    assert(r->follower_state.reads_sent == NULL);
+
+    server = raft_configuration__get(&r->configuration,
+                                     r->follower_state.current_leader_id);
+    if (server == NULL) {
+        return RAFT_ERR_NOT_LEADER;
+    }
+
+    r->read_id++;
+
+    message.type = RAFT_IO_READ_INDEX;
+    message.server_id = server->id;
+    message.server_address = server->address;
+    message.read_index.term = r->current_term;
+    message.read_index.id = r->read_id;
+
+    rv = r->io->send(r->io, &message, NULL, NULL);
+    if (rv != 0) {
+        return rv;
+    }
+
+    r->follower_state.reads_sent = r->follower_state.reads;
+    r->follower_state.reads = NULL;
+    r->follower_state.read_timer = 0;
+
+    return 0;
+}
+
+/**
+ * Send again the ReadIndex RPC for the reads waiting for a result, along with
+ * any read that was waiting for the next RPC. Results of the former RPC will be
+ * ignored.
+ */
+static void raft_read__resend(struct raft *r)
+{
+    struct raft_read *tail = r->follower_state.reads_sent;
+    int rv;
+
+    if (tail != NULL) {
+        while (tail->next != NULL) {
+            tail = tail->next;
+        }
+        tail->next = r->follower_state.reads;
+        r->follower_state.reads = r->follower_state.reads_sent;
+        r->follower_state.reads_sent = NULL;
+    }
+
+    if (r->follower_state.reads == NULL ||
+        r->follower_state.current_leader_id == 0) {
+        return;
+    }
+
+    rv = raft_read__send(r);
+    if (rv != 0) {
+        /* Not critical, we'll try again at the next tick. */
+        raft_warnf(r->logger, "send read index: %s (%d)", raft_strerror(rv),
+                   rv);
+    }
+}
+
+void raft_read__init(struct raft *r)
+{
+    assert(r->state == RAFT_STATE_LEADER);
+
+    r->leader_state.read_peers = NULL;
+    r->leader_state.reads = NULL;
+    r->leader_state.reads_round = NULL;
+    r->leader_state.reads_confirmed = NULL;
+
+    r->leader_state.clock = 0;
+    r->leader_state.lease_start = 0;
+    r->leader_state.lease_probe = 0;
+    r->leader_state.lease_valid = false;
+    r->leader_state.lease_probing = false;
+}
+
+void raft_read__revoke_lease(struct raft *r)
+{
+    assert(r->state == RAFT_STATE_LEADER);
+
+    r->leader_state.lease_valid = false;
+    r->leader_state.lease_probing = false;
+}
+
+void raft_read__init_follower(struct raft *r)
+{
+    assert(r->state == RAFT_STATE_FOLLOWER);
+
+    r->follower_state.read_timer = 0;
+    r->follower_state.reads = NULL;
+    r->follower_state.reads_sent = NULL;
+    r->follower_state.reads_confirmed = NULL;
+    r->follower_state.commit_timer = UINT_MAX;
+}
+
+void raft_read__clear_follower(struct raft *r)
+{
+    struct raft_read *reads = r->follower_state.reads;
+    struct raft_read *reads_sent = r->follower_state.reads_sent;
+    struct raft_read *reads_confirmed = r->follower_state.reads_confirmed;
+
+    r->follower_state.reads = NULL;
+    r->follower_state.reads_sent = NULL;
+    r->follower_state.reads_confirmed = NULL;
+
+    raft_read__finish(reads, RAFT_ERR_NOT_LEADER);
+    raft_read__finish(reads_sent, RAFT_ERR_NOT_LEADER);
+    raft_read__finish(reads_confirmed, RAFT_ERR_NOT_LEADER);
+}
+
+void raft_read__clear(struct raft *r)
+{
+    struct raft_read *reads = r->leader_state.reads;
+    struct raft_read *reads_round = r->leader_state.reads_round;
+    struct raft_read *reads_confirmed = r->leader_state.reads_confirmed;
+
+    if (r->leader_state.read_peers != NULL) {
+        raft_free(r->leader_state.read_peers);
+    }
+
+    r->leader_state.read_peers = NULL;
+    r->leader_state.reads = NULL;
+    r->leader_state.reads_round = NULL;
+    r->leader_state.reads_confirmed = NULL;
+
+    raft_read__finish(reads, RAFT_ERR_NOT_LEADER);
+    raft_read__finish(reads_round, RAFT_ERR_NOT_LEADER);
+    raft_read__finish(reads_confirmed, RAFT_ERR_NOT_LEADER);
+}
+
+void raft_read__sent(struct raft *r, const size_t i)
+{
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(i < r->configuration.n);
+
+    r->leader_state.read_peers[i].n_sent++;
+}
+
+void raft_read__acked(struct raft *r, const size_t i)
+{
+    struct raft_read_peer *peer;
+
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(i < r->configuration.n);
+
+    peer = &r->leader_state.read_peers[i];
+    peer->n_acked++;
+
+    if (r->leader_state.lease_probing && peer->n_acked == peer->lease_target &&
+        raft_read__confirmed(r, true)) {
+        raft_read__lease_extend(r);
+    }
+
+    if (r->leader_state.reads_round == NULL ||
+        peer->n_acked != peer->target || !raft_read__confirmed(r, false)) {
+        return;
+    }
+
+    raft_read__confirm(r);
+    raft_read__process(r);
+}
+
+void raft_read__tick(struct raft *r, const unsigned msec_since_last_tick)
+{
+    assert(r->state == RAFT_STATE_FOLLOWER || r->state == RAFT_STATE_LEADER);
+
+    if (r->state == RAFT_STATE_LEADER) {
+        r->leader_state.clock += msec_since_last_tick;
+        return;
+    }
+
+    r->follower_state.read_timer += msec_since_last_tick;
+    if (r->follower_state.commit_timer < UINT_MAX - msec_since_last_tick) {
+        r->follower_state.commit_timer += msec_since_last_tick;
+    } else {
+        r->follower_state.commit_timer = UINT_MAX;
+    }
+
+    /* Retry if the leader didn't answer in time or if we failed to send the
+     * RPC in the first place. */
+    if ((r->follower_state.reads_sent != NULL &&
+         r->follower_state.read_timer > r->election_timeout) ||
+        (r->follower_state.reads != NULL &&
+         r->follower_state.reads_sent == NULL)) {
+        raft_read__resend(r);
+    }
+}
+
+void raft_read__leader_changed(struct raft *r)
+{
+    assert(r->state == RAFT_STATE_FOLLOWER);
+
+    if (r->follower_state.reads_sent != NULL ||
+        r->follower_state.reads != NULL) {
+        raft_read__resend(r);
+    }
+}
+
+void raft_read__result(struct raft *r,
+                       const struct raft_read_index_result *result)
+{
+    struct raft_read *reads;
+    struct raft_read *req;
+    int rv;
+
+    if (r->state != RAFT_STATE_FOLLOWER ||
+        r->follower_state.reads_sent == NULL || result->id != r->read_id) {
+        raft_debugf(r->logger, "no reads waiting for this result -> ignore");
+        return;
+    }
+
+    reads = r->follower_state.reads_sent;
+    r->follower_state.reads_sent = NULL;
+
+    if (!result->success) {
+        raft_read__finish(reads, RAFT_ERR_NOT_LEADER);
+    } else {
+        for (req = reads; req->next != NULL; req = req->next) {
+            req->index = result->index;
+        }
+        req->index = result->index;
+        req->next = r->follower_state.reads_confirmed;
+        r->follower_state.reads_confirmed = reads;
+    }
+
+    if (r->follower_state.reads != NULL) {
+        rv = raft_read__send(r);
+        if (rv != 0) {
+            raft_warnf(r->logger, "send read index: %s (%d)",
+                       raft_strerror(rv), rv);
+        }
+    }
+
+    raft_read__process(r);
+}
+
+void raft_read__heartbeat(struct raft *r)
+{
+    size_t i;
+
+    assert(r->state == RAFT_STATE_LEADER);
+
+    /* Only one probe at a time, its start time is what bounds the lease. No
+     * probe is started during a leadership transfer. */
+    if (!r->read_lease || r->leader_state.lease_probing ||
+        r->leader_state.transferee_id != 0) {
+        return;
+    }
+
+    r->leader_state.lease_probe = r->leader_state.clock;
+    r->leader_state.lease_probing = true;
+
+    for (i = 0; i < r->configuration.n; i++) {
+        struct raft_read_peer *peer = &r->leader_state.read_peers[i];
+        peer->lease_target = peer->n_sent + 1;
+    }
+
+    if (raft_read__confirmed(r, true)) {
+        raft_read__lease_extend(r);
+    }
+}
+
+void raft_read__process(struct raft *r)
+{
+    if (r->state == RAFT_STATE_FOLLOWER) {
+        raft_read__complete(r, &r->follower_state.reads_confirmed);
+        return;
+    }
+
+    if (r->state != RAFT_STATE_LEADER) {
+        return;
+    }
+
+    /* From Section 6.4:
+     *
+     *   If the leader has not yet marked an entry from its current term
+     *   committed, it waits until it has done so.
+     */
+    if (r->leader_state.reads != NULL &&
+        raft_log__term_of(&r->log, r->commit_index) == r->current_term) {
+        if (raft_read__lease_held(r)) {
+            raft_read__lease_confirm(r);
+        } else if (r->leader_state.reads_round == NULL) {
+            raft_read__start_round(r);
+        }
+    }
+
+    raft_read__complete(r, &r->leader_state.reads_confirmed);
+}
+
+/**
+ * Submit a read as follower, asking the leader for its read index.
+ */
+static int raft_read__submit(struct raft *r, struct raft_read *req)
+{
+    int rv;
+
+    assert(r->state == RAFT_STATE_FOLLOWER);
+
+    if (r->follower_state.current_leader_id == 0) {
+        return RAFT_ERR_NOT_LEADER;
+    }
+
+    req->next = r->follower_state.reads;
+    r->follower_state.reads = req;
+
+    /* Batch the read with the ones already waiting, if an RPC is in flight
+     * or a previous attempt to send one failed. */
+    if (r->follower_state.reads_sent != NULL || req->next != NULL) {
+        return 0;
+    }
+
+    rv = raft_read__send(r);
+    if (rv != 0) {
+        r->follower_state.reads = NULL;
+        return rv;
+    }
+
+    return 0;
+}
+
+int raft_read_index(struct raft *r,
+                    struct raft_read *req,
+                    void (*cb)(struct raft_read *req, int status))
+{
+    assert(r != NULL);
+    assert(req != NULL);
+    assert(cb != NULL);
+
+    req->index = 0;
+    req->cb = cb;
+
+    if (r->state == RAFT_STATE_FOLLOWER) {
+        return raft_read__submit(r, req);
+    }
+
+    if (r->state != RAFT_STATE_LEADER) {
+        return RAFT_ERR_NOT_LEADER;
+    }
+
+    req->next = r->leader_state.reads;
+    r->leader_state.reads = req;
+
+    raft_read__process(r);
+
+    return 0;
+}
+
+int raft_read_stale(struct raft *r,
+                    struct raft_read *req,
+                    unsigned max_staleness,
+                    void (*cb)(struct raft_read *req, int status))
+{
+    assert(r != NULL);
+    assert(req != NULL);
+    assert(cb != NULL);
+
+    /* The commit timer is reset only when an AppendEntries RPC from the
+     * leader is accepted and our commit index is at least the one it carries,
+     * which is the one of the leader at the time it was sent. The election
+     * timer can't be used, since it's reset also by rejected RPCs. */
+    if (r->state == RAFT_STATE_FOLLOWER &&
+        r->follower_state.current_leader_id != 0 &&
+        r->follower_state.commit_timer <= max_staleness &&
+        r->last_applied == r->commit_index) {
+        req->index = r->last_applied;
+        req->next = NULL;
+        req->cb = cb;
+
+        cb(req, 0);
+
+        return 0;
+    }
+
+    return raft_read_index(r, req, cb);
+}
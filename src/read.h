@@ -0,0 +1,86 @@
+/**
+ * Serve linearizable reads with the ReadIndex protocol or a leader lease, see
+ * @raft_read_index.
+ */
+
+#ifndef RAFT_READ_H
+#define RAFT_READ_H
+
+#include "../include/raft.h"
+
+/**
+ * Initialize the read state of a newly elected leader. The read counters array
+ * is allocated along with the next/match indexes.
+ */
+void raft_read__init(struct raft *r);
+
+/**
+ * Fail all pending reads and release the read state, because leadership was
+ * lost.
+ */
+void raft_read__clear(struct raft *r);
+
+/**
+ * Drop the read lease and any probe in progress, because leadership is being
+ * transferred. Reads go through a regular round until a new lease is obtained
+ * after the transfer is over.
+ */
+void raft_read__revoke_lease(struct raft *r);
+
+/**
+ * Initialize the read state of a server that just became follower.
+ */
+void raft_read__init_follower(struct raft *r);
+
+/**
+ * Fail all reads pending on a follower, because it's about to start an
+ * election or to shutdown.
+ */
+void raft_read__clear_follower(struct raft *r);
+
+/**
+ * Send again any pending ReadIndex RPC, because the follower discovered a new
+ * leader.
+ */
+void raft_read__leader_changed(struct raft *r);
+
+/**
+ * Handle the result of a ReadIndex RPC sent by this follower.
+ */
+void raft_read__result(struct raft *r,
+                       const struct raft_read_index_result *result);
+
+/**
+ * Record that an AppendEntries RPC was sent to the i'th server in the
+ * configuration.
+ */
+void raft_read__sent(struct raft *r, const size_t i);
+
+/**
+ * Record that a successful AppendEntries result for the current term was
+ * received from the i'th server in the configuration, possibly confirming
+ * leadership for the reads of the current round.
+ */
+void raft_read__acked(struct raft *r, const size_t i);
+
+/**
+ * Advance the clock used to track the read lease, or the timer used by
+ * followers to retry unanswered ReadIndex RPCs.
+ */
+void raft_read__tick(struct raft *r, const unsigned msec_since_last_tick);
+
+/**
+ * Start a new lease probe, if read leases are enabled and no probe is in
+ * progress. It must be called right before sending heartbeats.
+ */
+void raft_read__heartbeat(struct raft *r);
+
+/**
+ * Start a new read round or complete confirmed reads, if possible.
+ *
+ * It must be called whenever the commit index or the last applied index might
+ * have changed.
+ */
+void raft_read__process(struct raft *r);
+
+#endif /* RAFT_READ_H */
@@ -5,6 +5,8 @@
 #include "error.h"
 #include "log.h"
 #include "membership.h"
+#include "proposal.h"
+#include "read.h"
 #include "replication.h"
 #include "state.h"
 #include "watch.h"
@@ -17,6 +19,13 @@
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
+/* Maximum number of commands passed to the FSM in a single batch. */
+#define RAFT_REPLICATION__APPLY_BATCH 64
+
+/* Maximum number of entries sent to the server being promoted and not yet
+ * acknowledged by it. */
+#define RAFT_REPLICATION__CATCH_UP_WINDOW 1024
+
 /* Set to 1 to enable debug logging. */
 #if 0
 #define __logf(MSG, ...) raft__debugf(r, MSG, __VA_ARGS__)
@@ -24,15 +33,26 @@
 #define __logf(MSG, ...)
 #endif
 
+/**
+ * Entries acquired from the log once and shared by all the AppendEntries
+ * requests sent to followers with the same next index, so they carry the very
+ * same entries array and the I/O backend can encode them only once.
+ */
+struct raft_replication__batch
+{
+    struct raft *raft;          /* Instance that has acquired the entries */
+    raft_index index;           /* Index of the first entry in the batch. */
+    struct raft_entry *entries; /* Entries referenced by the batch. */
+    unsigned n;                 /* Length of the entries array. */
+    unsigned refs;              /* Number of references to the batch. */
+};
+
 /**
  * Hold context for a #RAFT_IO_APPEND_ENTRIES send request that was submitted.
  */
 struct raft_replication__send_append_entries
 {
-    struct raft *raft;          /* Instance that has submitted the request */
-    raft_index index;           /* Index of the first entry in the request. */
-    struct raft_entry *entries; /* Entries referenced in the request. */
-    unsigned n;                 /* Length of the entries array. */
+    struct raft_replication__batch *batch; /* Entries sent by the request. */
 };
 
 /**
@@ -56,23 +76,85 @@ struct raft_replication__follower_append
     raft_index leader_commit;   /* Commit index on the leader */
 };
 
+/**
+ * Acquire all entries from the given index onward, creating a new batch object
+ * with a single reference.
+ */
+static int raft_replication__batch_acquire(struct raft *r,
+                                           raft_index index,
+                                           struct raft_replication__batch **batch)
+{
+    int rv;
+
+    *batch = raft_malloc(sizeof **batch);
+    if (*batch == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
+    rv = raft_log__acquire(&r->log, index, &(*batch)->entries, &(*batch)->n);
+    if (rv != 0) {
+        goto err_after_alloc;
+    }
+
+    (*batch)->raft = r;
+    (*batch)->index = index;
+    (*batch)->refs = 1;
+
+    return 0;
+
+err_after_alloc:
+    raft_free(*batch);
+
+err:
+    assert(rv != 0);
+
+    return rv;
+}
+
+/**
+ * Drop a reference to the given batch, releasing its entries when no more
+ * references are left.
+ */
+static void raft_replication__batch_unref(struct raft_replication__batch *batch)
+{
+    struct raft *r = batch->raft;
+
+    assert(batch->refs > 0);
+
+    batch->refs--;
+    if (batch->refs > 0) {
+        return;
+    }
+
+    /* Tell the log that we're done referencing these entries. */
+    raft_log__release(&r->log, batch->index, batch->entries, batch->n);
+
+    raft_free(batch);
+}
+
 /**
  * Callback invoked after request to send an AppendEntries RPC has completed.
  */
 static void raft_replication__send_append_entries_cb(void *data, int status)
 {
     struct raft_replication__send_append_entries *request = data;
-    struct raft *r = request->raft;
+    struct raft *r = request->batch->raft;
 
     raft_debugf(r->logger, "send append entries completed: status %d", status);
 
-    /* Tell the log that we're done referencing these entries. */
-    raft_log__release(&r->log, request->index, request->entries, request->n);
+    raft_replication__batch_unref(request->batch);
 
     raft_free(request);
 }
 
-int raft_replication__send_append_entries(struct raft *r, size_t i)
+/**
+ * Send an AppendEntries RPC to the i'th server, carrying the entries of the
+ * given batch, which must start at the server's next index.
+ */
+static int raft_replication__send_batch(struct raft *r,
+                                        size_t i,
+                                        struct raft_replication__batch *batch)
 {
     struct raft_server *server = &r->configuration.servers[i];
     uint64_t next_index;
@@ -93,6 +175,8 @@ int raft_replication__send_append_entries(struct raft *r, size_t i)
 
     next_index = r->leader_state.next_index[i];
 
+    assert(batch->index == next_index);
+
     /* From Section §3.5:
      *
      *   When sending an AppendEntries RPC, the leader includes the index and
@@ -122,11 +206,8 @@ int raft_replication__send_append_entries(struct raft *r, size_t i)
         assert(args->prev_log_term > 0);
     }
 
-    rv = raft_log__acquire(&r->log, next_index, &args->entries,
-                           &args->n_entries);
-    if (rv != 0) {
-        goto err;
-    }
+    args->entries = batch->entries;
+    args->n_entries = batch->n;
 
     /* From Section §3.5:
      *
@@ -138,30 +219,19 @@ int raft_replication__send_append_entries(struct raft *r, size_t i)
      */
     args->leader_commit = r->commit_index;
 
-    /* Allocate a new raft_io_request slot in the queue of inflight I/O
-     * operations and fill the request fields. */
-    /*rv = raft_queue__push(r, &request_id);
-    if (rv != 0) {
-        goto err_after_entries_acquired;
-        }*/
-
     __logf("send %ld entries to server %ld (log size %ld)", args->n_entries, i,
            raft_log__n_entries(&r->log));
 
     message.type = RAFT_IO_APPEND_ENTRIES;
-    message.append_entries = *args;
     message.server_id = server->id;
     message.server_address = server->address;
 
     request = raft_malloc(sizeof *request);
     if (request == NULL) {
         rv = RAFT_ERR_NOMEM;
-        goto err_after_entries_acquired;
+        goto err;
     }
-    request->raft = r;
-    request->index = args->prev_log_index + 1;
-    request->entries = args->entries;
-    request->n = args->n_entries;
+    request->batch = batch;
 
     rv = r->io->send(r->io, &message, request,
                      raft_replication__send_append_entries_cb);
@@ -169,20 +239,41 @@ int raft_replication__send_append_entries(struct raft *r, size_t i)
         goto err_after_request_alloc;
     }
 
+    batch->refs++;
+
+    raft_read__sent(r, i);
+
     return 0;
 
 err_after_request_alloc:
     raft_free(request);
 
-err_after_entries_acquired:
-    raft_log__release(&r->log, next_index, args->entries, args->n_entries);
-
 err:
     assert(rv != 0);
 
     return rv;
 }
 
+int raft_replication__send_append_entries(struct raft *r, size_t i)
+{
+    struct raft_replication__batch *batch;
+    int rv;
+
+    assert(r->leader_state.next_index != NULL);
+
+    rv = raft_replication__batch_acquire(r, r->leader_state.next_index[i],
+                                         &batch);
+    if (rv != 0) {
+        return rv;
+    }
+
+    rv = raft_replication__send_batch(r, i, batch);
+
+    raft_replication__batch_unref(batch);
+
+    return rv;
+}
+
 static void raft_replication__leader_append_cb(void *data, int status)
 {
     struct raft_replication__leader_append *request = data;
@@ -239,7 +330,7 @@ static void raft_replication__leader_append_cb(void *data, int status)
     }
 
     /* Check if we can commit some new entries. */
-    raft_replication__quorum(r, last_index);
+    raft_replication__quorum(r);
 
     rv = raft_replication__apply(r);
     if (rv != 0) {
@@ -301,9 +392,189 @@ err:
     return rv;
 }
 
-int raft_replication__trigger(struct raft *r, const raft_index index)
+/**
+ * Return true if no AppendEntries should be sent to the i'th server in the
+ * configuration, either because it's ourselves or because the I/O backend
+ * reports that messages to it are piling up. A congested follower is simply
+ * left alone until its backlog drains: it will get the entries it missed with
+ * the first AppendEntries sent after that.
+ */
+static bool raft_replication__skip(struct raft *r, const size_t i)
+{
+    struct raft_server *server = &r->configuration.servers[i];
+
+    if (server->id == r->id) {
+        return true;
+    }
+
+    return r->io->congested != NULL && r->io->congested(r->io, server->id);
+}
+
+/**
+ * Return true if the i'th server should be sent AppendEntries along with the
+ * learners, after all other servers.
+ */
+static bool raft_replication__is_learner(struct raft *r, const size_t i)
+{
+    struct raft_server *server = &r->configuration.servers[i];
+
+    return server->learner && server->id != r->leader_state.promotee_id;
+}
+
+/**
+ * Return true if the i'th server belongs to the given replication group and
+ * should be sent AppendEntries.
+ */
+static bool raft_replication__in_group(struct raft *r,
+                                       const size_t i,
+                                       const bool learners)
+{
+    /* The server being promoted has its own pipeline, see
+     * raft_replication__catch_up(). */
+    if (r->configuration.servers[i].id == r->leader_state.promotee_id) {
+        return false;
+    }
+
+    if (raft_replication__is_learner(r, i) != learners) {
+        return false;
+    }
+
+    return !raft_replication__skip(r, i);
+}
+
+/**
+ * Send AppendEntries to all servers in the given replication group. Servers
+ * with the same next index are sent the same batch of entries, acquired from
+ * the log only once.
+ */
+static void raft_replication__trigger_group(struct raft *r, const bool learners)
 {
     size_t i;
+
+    for (i = 0; i < r->configuration.n; i++) {
+        struct raft_server *server = &r->configuration.servers[i];
+        struct raft_replication__batch *batch;
+        raft_index next_index;
+        size_t j;
+        int rv;
+
+        if (!raft_replication__in_group(r, i, learners)) {
+            continue;
+        }
+
+        next_index = r->leader_state.next_index[i];
+
+        /* Skip this follower if it was already served along with a previous
+         * one with the same next index. */
+        for (j = 0; j < i; j++) {
+            if (raft_replication__in_group(r, j, learners) &&
+                r->leader_state.next_index[j] == next_index) {
+                break;
+            }
+        }
+        if (j < i) {
+            continue;
+        }
+
+        rv = raft_replication__batch_acquire(r, next_index, &batch);
+        if (rv != 0) {
+            raft_warnf(r->logger, "failed to acquire entries: %s (%d)",
+                       raft_strerror(rv), rv);
+            continue;
+        }
+
+        for (j = i; j < r->configuration.n; j++) {
+            server = &r->configuration.servers[j];
+
+            if (!raft_replication__in_group(r, j, learners) ||
+                r->leader_state.next_index[j] != next_index) {
+                continue;
+            }
+
+            rv = raft_replication__send_batch(r, j, batch);
+            if (rv != 0) {
+                /* This is not a critical failure, let's just log it. */
+                raft_warnf(
+                    r->logger,
+                    "failed to send append entries to server %ld: %s (%d)",
+                    server->id, raft_strerror(rv), rv);
+            }
+        }
+
+        raft_replication__batch_unref(batch);
+    }
+}
+
+/**
+ * Send to the i'th server, which must be the one being promoted, all entries
+ * from its next index onward, and advance its next index past them without
+ * waiting for the result, so further entries can be streamed right away.
+ */
+static int raft_replication__pipeline(struct raft *r, const size_t i)
+{
+    raft_index last_index = raft_log__last_index(&r->log);
+    int rv;
+
+    assert(r->configuration.servers[i].id == r->leader_state.promotee_id);
+
+    rv = raft_replication__send_append_entries(r, i);
+    if (rv != 0) {
+        return rv;
+    }
+
+    r->leader_state.next_index[i] = last_index + 1;
+    r->leader_state.catch_up_sent = last_index;
+
+    return 0;
+}
+
+int raft_replication__catch_up(struct raft *r, const bool heartbeat)
+{
+    size_t i;
+    raft_index *next_index;
+    raft_index match_index;
+    raft_index sent;
+    raft_index in_flight;
+
+    assert(r->state == RAFT_STATE_LEADER);
+    assert(r->leader_state.promotee_id != 0);
+
+    i = raft_configuration__index(&r->configuration,
+                                  r->leader_state.promotee_id);
+    assert(i < r->configuration.n);
+
+    if (raft_replication__skip(r, i)) {
+        return 0;
+    }
+
+    next_index = &r->leader_state.next_index[i];
+    match_index = r->leader_state.match_index[i];
+
+    sent = r->leader_state.catch_up_sent;
+    in_flight = sent > match_index ? sent - match_index : 0;
+
+    if (in_flight > 0) {
+        bool is_idle = r->leader_state.catch_up_idle >= r->heartbeat_timeout;
+        bool is_full = in_flight >= RAFT_REPLICATION__CATCH_UP_WINDOW;
+
+        if (heartbeat && is_idle) {
+            /* Nothing got acknowledged for a while, some requests might have
+             * been lost: resend everything from the last acknowledged entry. */
+            *next_index = match_index + 1;
+        } else if (heartbeat || is_full ||
+                   *next_index > raft_log__last_index(&r->log)) {
+            /* Entries in flight act as heartbeats, and we don't want to pile
+             * up more than a window of unacknowledged entries. */
+            return 0;
+        }
+    }
+
+    return raft_replication__pipeline(r, i);
+}
+
+int raft_replication__trigger(struct raft *r, const raft_index index)
+{
+    unsigned elapsed;
     int rv;
 
     assert(r->state == RAFT_STATE_LEADER);
@@ -325,21 +596,25 @@ int raft_replication__trigger(struct raft *r, const raft_index index)
      */
     r->timer = 0;
 
-    /* Trigger replication. */
-    for (i = 0; i < r->configuration.n; i++) {
-        struct raft_server *server = &r->configuration.servers[i];
-        int rv;
+    /* Trigger replication, serving learners last so they never delay the
+     * servers whose acknowledgements matter for commitment. Lazy learners get
+     * entries only with heartbeats, or at least once every heartbeat timeout
+     * if the leader is never idle. */
+    raft_replication__trigger_group(r, false);
 
-        if (server->id == r->id) {
-            continue;
-        }
+    elapsed = r->leader_state.clock - r->leader_state.learners_sent;
 
-        rv = raft_replication__send_append_entries(r, i);
+    if (index == 0 || !r->lazy_learners || elapsed >= r->heartbeat_timeout) {
+        raft_replication__trigger_group(r, true);
+        r->leader_state.learners_sent = r->leader_state.clock;
+    }
+
+    if (r->leader_state.promotee_id != 0) {
+        rv = raft_replication__catch_up(r, index == 0);
         if (rv != 0) {
             /* This is not a critical failure, let's just log it. */
-            raft_warnf(r->logger,
-                       "failed to send append entries to server %ld: %s (%d)",
-                       server->id, raft_strerror(rv), rv);
+            raft_warnf(r->logger, "failed to send entries to server %u: %s (%d)",
+                       r->leader_state.promotee_id, raft_strerror(rv), rv);
         }
     }
 
@@ -365,6 +640,7 @@ static int raft_replication__trigger_promotion(struct raft *r)
     raft_term term = r->current_term;
     size_t server_index;
     struct raft_server *server;
+    bool learner;
     int rv;
 
     assert(r->state == RAFT_STATE_LEADER);
@@ -379,7 +655,10 @@ static int raft_replication__trigger_promotion(struct raft *r)
     assert(!server->voting);
 
     /* Update our current configuration. */
+    learner = server->learner;
     server->voting = true;
+    server->learner = false;
+    raft_configuration__update_voting(&r->configuration);
 
     /* Index of the entry being appended. */
     index = raft_log__last_index(&r->log) + 1;
@@ -396,7 +675,7 @@ static int raft_replication__trigger_promotion(struct raft *r)
         goto err_after_log_append;
     }
 
-    r->leader_state.promotee_id = 0;
+    raft_membership__catch_up_reset(r);
     r->configuration_uncommitted_index = raft_log__last_index(&r->log);
 
     return 0;
@@ -406,6 +685,8 @@ err_after_log_append:
 
 err:
     server->voting = false;
+    server->learner = learner;
+    raft_configuration__update_voting(&r->configuration);
 
     assert(rv != 0);
     return rv;
@@ -472,7 +753,11 @@ int raft_replication__update(struct raft *r,
                    *next_index);
 
         /* Retry, ignoring errors. */
-        raft_replication__send_append_entries(r, server_index);
+        if (server->id == r->leader_state.promotee_id) {
+            raft_replication__pipeline(r, server_index);
+        } else {
+            raft_replication__send_append_entries(r, server_index);
+        }
 
         return 0;
     }
@@ -495,24 +780,41 @@ int raft_replication__update(struct raft *r,
      *   [Rules for servers] Leaders:
      *
      *   If successful update nextIndex and matchIndex for follower.
+     *
+     * The next index of the server being promoted might be already past the
+     * acknowledged entries, if more of them are in flight.
      */
-    *next_index = result->last_log_index + 1;
+    *next_index = max(*next_index, result->last_log_index + 1);
     *match_index = result->last_log_index;
     raft_debugf(r->logger, "match/next idx for server %ld: %ld %ld",
                 server_index, *match_index, *next_index);
 
     /* If the server is currently being promoted and is catching with logs,
-     * update the information about the current catch-up round, and possibly
-     * proceed with the promotion. */
+     * update the information about its progress, and either proceed with the
+     * promotion or stream more entries to it. */
     is_being_promoted = r->leader_state.promotee_id != 0 &&
                         r->leader_state.promotee_id == server->id;
     if (is_being_promoted) {
-        int is_up_to_date = raft_membership__update_catch_up_round(r);
-        if (is_up_to_date) {
+        bool is_caught_up = raft_membership__update_catch_up(r);
+        if (is_caught_up) {
             rv = raft_replication__trigger_promotion(r);
             if (rv != 0) {
                 return rv;
             }
+        } else {
+            /* Ignore errors, we'll retry with the next result or tick. */
+            raft_replication__catch_up(r, false);
+        }
+    }
+
+    /* If we are transferring leadership to this server, it might now be up to
+     * date. */
+    if (r->leader_state.transferee_id == server->id) {
+        rv = raft_membership__transfer(r);
+        if (rv != 0) {
+            /* This error is not fatal, we'll retry with the next result. */
+            raft_warnf(r->logger, "failed to send timeout now: %s (%d)",
+                       raft_strerror(rv), rv);
         }
     }
 
@@ -836,95 +1138,368 @@ static void raft_replication__apply_configuration(struct raft *r,
         raft_state__convert_to_follower(r, r->current_term);
     }
 
+    /* If we are leader and the joint configuration we are using is now
+     * committed, move on to C_new. On failure the tick will retry. */
+    if (r->state == RAFT_STATE_LEADER &&
+        r->configuration_uncommitted_index == 0 &&
+        raft_configuration__is_joint(&r->configuration)) {
+        int rv = raft_membership__leave_joint(r);
+        if (rv != 0) {
+            raft_warnf(r->logger, "failed to leave joint configuration: %s",
+                       raft_strerror(rv));
+        }
+    }
+
     raft_watch__configuration_applied(r);
 }
 
 /**
- * Apply a RAFT_LOG_COMMAND entry that has been committed.
+ * Apply the given contiguous commands to the FSM, using its batch method if
+ * available. Set @n_applied to the number of commands that were successfully
+ * applied.
  */
-static int raft_replication__apply_command(struct raft *r,
-                                           const raft_index index,
-                                           const struct raft_buffer *buf)
+static int raft_replication__apply_bufs(struct raft_fsm *fsm,
+                                        const struct raft_buffer bufs[],
+                                        const unsigned n,
+                                        unsigned *n_applied)
 {
+    unsigned i;
     int rv;
 
-    rv = r->fsm->apply(r->fsm, buf);
-    if (rv != 0) {
+    if (fsm->version >= 2 && fsm->apply_batch != NULL) {
+        rv = fsm->apply_batch(fsm, bufs, n);
+        *n_applied = rv == 0 ? n : 0;
         return rv;
     }
 
-    raft_watch__command_applied(r, index);
+    for (i = 0; i < n; i++) {
+        rv = fsm->apply(fsm, &bufs[i]);
+        if (rv != 0) {
+            *n_applied = i;
+            return rv;
+        }
+    }
+
+    *n_applied = n;
 
     return 0;
 }
 
-int raft_replication__apply(struct raft *r)
+/**
+ * Return the number of contiguous RAFT_LOG_COMMAND entries that follow
+ * @last_applied and are committed, up to RAFT_REPLICATION__APPLY_BATCH.
+ */
+static unsigned raft_replication__n_commands(struct raft *r)
 {
     raft_index index;
+    unsigned n = 0;
+
+    for (index = r->last_applied + 1; index <= r->commit_index; index++) {
+        const struct raft_entry *entry = raft_log__get(&r->log, index);
+
+        if (entry->type != RAFT_LOG_COMMAND ||
+            n == RAFT_REPLICATION__APPLY_BATCH) {
+            break;
+        }
+
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Advance @last_applied after @n commands were applied to the FSM.
+ */
+static void raft_replication__applied(struct raft *r, const unsigned n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    r->last_applied += n;
+
+    raft_watch__command_applied(r, r->last_applied);
+    raft_proposal__applied(r);
+}
+
+/**
+ * Apply the next span of committed RAFT_LOG_COMMAND entries in the current
+ * thread.
+ */
+static int raft_replication__apply_commands(struct raft *r)
+{
+    struct raft_buffer bufs[RAFT_REPLICATION__APPLY_BATCH];
+    unsigned n;
+    unsigned n_applied;
+    unsigned i;
     int rv;
 
+    n = raft_replication__n_commands(r);
+    assert(n > 0);
+
+    for (i = 0; i < n; i++) {
+        bufs[i] = raft_log__get(&r->log, r->last_applied + 1 + i)->buf;
+    }
+
+    rv = raft_replication__apply_bufs(r->fsm, bufs, n, &n_applied);
+
+    raft_replication__applied(r, n_applied);
+
+    return rv;
+}
+
+/**
+ * State of a span of commands being applied in the background.
+ */
+struct raft_replication__apply
+{
+    struct raft *raft;          /* Instance applying the commands */
+    raft_index index;           /* Index of the first command */
+    struct raft_entry *entries; /* Entries acquired from the log */
+    unsigned n_entries;         /* Length of the entries array */
+    struct raft_buffer *bufs;   /* Commands to apply */
+    unsigned n;                 /* Number of commands to apply */
+    unsigned n_applied;         /* Number of commands actually applied */
+    int status;                 /* Result of applying the commands */
+};
+
+/**
+ * Called in the background thread to apply the commands of a request.
+ */
+static void raft_replication__apply_work(void *data)
+{
+    struct raft_replication__apply *request = data;
+    struct raft *r = request->raft;
+
+    request->status = raft_replication__apply_bufs(
+        r->fsm, request->bufs, request->n, &request->n_applied);
+}
+
+/**
+ * Called back in the driving thread once a request applied in the background
+ * has completed.
+ */
+static void raft_replication__apply_cb(void *data, int status)
+{
+    struct raft_replication__apply *request = data;
+    struct raft *r = request->raft;
+    int rv;
+
+    assert(r->applying);
+    assert(r->last_applied + 1 == request->index);
+
+    r->applying = false;
+
+    raft_log__release(&r->log, request->index, request->entries,
+                      request->n_entries);
+
+    if (status == 0) {
+        raft_replication__applied(r, request->n_applied);
+        status = request->status;
+    }
+
+    raft_free(request->bufs);
+    raft_free(request);
+
+    if (status != 0) {
+        raft_warnf(r->logger, "apply commands in background: %s (%d)",
+                   raft_strerror(status), status);
+        return;
+    }
+
+    /* Apply whatever got committed in the meantime. */
+    if (r->state == RAFT_STATE_LEADER || r->state == RAFT_STATE_FOLLOWER) {
+        rv = raft_replication__apply(r);
+        if (rv != 0) {
+            raft_warnf(r->logger, "apply committed entries: %s (%d)",
+                       raft_strerror(rv), rv);
+        }
+    }
+}
+
+/**
+ * Submit the next span of committed RAFT_LOG_COMMAND entries to be applied in
+ * the background.
+ */
+static int raft_replication__apply_commands_in_background(struct raft *r)
+{
+    struct raft_replication__apply *request;
+    unsigned i;
+    int rv;
+
+    assert(!r->applying);
+
+    request = raft_malloc(sizeof *request);
+    if (request == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
+    request->raft = r;
+    request->index = r->last_applied + 1;
+    request->n = raft_replication__n_commands(r);
+    request->n_applied = 0;
+    request->status = 0;
+
+    assert(request->n > 0);
+
+    /* Acquire the entries, so their payloads stay valid while the background
+     * thread is using them, regardless of what happens to the log. */
+    rv = raft_log__acquire(&r->log, request->index, &request->entries,
+                           &request->n_entries);
+    if (rv != 0) {
+        goto err_after_request_alloc;
+    }
+
+    assert(request->n <= request->n_entries);
+
+    request->bufs = raft_malloc(request->n * sizeof *request->bufs);
+    if (request->bufs == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_entries_acquired;
+    }
+
+    for (i = 0; i < request->n; i++) {
+        request->bufs[i] = request->entries[i].buf;
+    }
+
+    rv = r->io->queue_work(r->io, request, raft_replication__apply_work,
+                           raft_replication__apply_cb);
+    if (rv != 0) {
+        goto err_after_bufs_alloc;
+    }
+
+    r->applying = true;
+
+    return 0;
+
+err_after_bufs_alloc:
+    raft_free(request->bufs);
+
+err_after_entries_acquired:
+    raft_log__release(&r->log, request->index, request->entries,
+                      request->n_entries);
+
+err_after_request_alloc:
+    raft_free(request);
+
+err:
+    assert(rv != 0);
+    return rv;
+}
+
+int raft_replication__apply(struct raft *r)
+{
+    raft_index index;
+    int rv = 0;
+
     assert(r->state == RAFT_STATE_LEADER || r->state == RAFT_STATE_FOLLOWER);
     assert(r->last_applied <= r->commit_index);
 
-    if (r->last_applied == r->commit_index) {
-        /* Nothing to do. */
+    /* If a span of commands is being applied in the background, we'll resume
+     * from its end once it completes. */
+    if (r->applying) {
         return 0;
     }
 
-    for (index = r->last_applied + 1; index <= r->commit_index; index++) {
-        const struct raft_entry *entry = raft_log__get(&r->log, index);
+    while (r->last_applied < r->commit_index) {
+        const struct raft_entry *entry;
+
+        index = r->last_applied + 1;
+        entry = raft_log__get(&r->log, index);
 
         assert(entry->type == RAFT_LOG_COMMAND ||
                entry->type == RAFT_LOG_CONFIGURATION);
 
-        switch (entry->type) {
-            case RAFT_LOG_COMMAND:
-                rv = raft_replication__apply_command(r, index, &entry->buf);
-                break;
-            case RAFT_LOG_CONFIGURATION:
-                raft_replication__apply_configuration(r, index);
-                rv = 0;
-                break;
+        if (entry->type == RAFT_LOG_CONFIGURATION) {
+            raft_replication__apply_configuration(r, index);
+            r->last_applied = index;
+            continue;
+        }
+
+        if (r->apply_in_background) {
+            rv = raft_replication__apply_commands_in_background(r);
+            break;
         }
 
+        rv = raft_replication__apply_commands(r);
         if (rv != 0) {
             break;
         }
     }
 
+    /* Reads waiting for their read index to be applied might be served. */
+    raft_read__process(r);
+
     return rv;
 }
 
-void raft_replication__quorum(struct raft *r, const raft_index index)
+/**
+ * Return the highest index whose entry is replicated on a majority of voting
+ * servers, that is the median of their match indexes, or 0 if there are no
+ * voting servers. If @old is true, consider the servers voting in C_old.
+ */
+static raft_index raft_replication__quorum_index(struct raft *r, bool old)
 {
-    size_t votes = 0;
+    raft_index *sorted = r->leader_state.match_sorted;
+    size_t n = 0;
     size_t i;
 
+    /* Insertion sort in descending order: with typical cluster sizes this is
+     * just a handful of comparisons and needs no allocation. */
+    for (i = 0; i < r->configuration.n; i++) {
+        const struct raft_server *server = &r->configuration.servers[i];
+        raft_index match_index = r->leader_state.match_index[i];
+        size_t j;
+
+        if (!(old ? server->voting_old : server->voting)) {
+            continue;
+        }
+
+        for (j = n; j > 0 && sorted[j - 1] < match_index; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = match_index;
+        n++;
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    return sorted[n / 2];
+}
+
+void raft_replication__quorum(struct raft *r)
+{
+    raft_index index;
+
     assert(r->state == RAFT_STATE_LEADER);
 
+    index = raft_replication__quorum_index(r, false);
+
+    /* From Section §4.3:
+     *
+     *   Agreement (for elections and entry commitment) requires separate
+     *   majorities from both the old and new configurations.
+     */
+    if (raft_configuration__is_joint(&r->configuration)) {
+        index = min(index, raft_replication__quorum_index(r, true));
+    }
+
     if (index <= r->commit_index) {
         return;
     }
 
+    /* Entries of previous terms are only committed indirectly, if the quorum
+     * index has an older term none of the entries preceding it can be
+     * committed either. */
     if (raft_log__term_of(&r->log, index) != r->current_term) {
         return;
     }
 
-    for (i = 0; i < r->configuration.n; i++) {
-        struct raft_server *server = &r->configuration.servers[i];
-        if (!server->voting) {
-            continue;
-        }
-        if (r->leader_state.match_index[i] >= index) {
-            votes++;
-        }
-    }
-
-    if (votes > raft_configuration__n_voting(&r->configuration) / 2) {
-        r->commit_index = index;
-
-        __logf("new commit index %ld", r->commit_index);
-    }
+    r->commit_index = index;
 
-    return;
+    __logf("new commit index %ld", r->commit_index);
 }
@@ -17,6 +17,19 @@
  */
 int raft_replication__send_append_entries(struct raft *r, size_t i);
 
+/**
+ * Stream to the server being promoted the entries it's missing, without waiting
+ * for the results of the AppendEntries RPCs already in flight, as long as no
+ * more than a window of entries is unacknowledged.
+ *
+ * If @heartbeat is true and some entries are in flight, nothing is sent, unless
+ * the server hasn't acknowledged anything for a heartbeat timeout, in which
+ * case all entries after its match index are sent again.
+ *
+ * It must be called only by leaders, while a promotion is in progress.
+ */
+int raft_replication__catch_up(struct raft *r, const bool heartbeat);
+
 /**
  * Helper triggering I/O requests for newly appended log entries or heartbeat.
  *
@@ -72,8 +85,9 @@ int raft_replication__append(struct raft *r,
 int raft_replication__apply(struct raft *r);
 
 /**
- * Check if a quorum has been reached for the given log index, and update commit
- * index accordingly if so.
+ * Compute the highest log index replicated on a majority of voting servers,
+ * and make it the new commit index if possible, possibly advancing it by many
+ * entries at once.
  *
  * From Figure 3.1:
  *
@@ -82,6 +96,6 @@ int raft_replication__apply(struct raft *r);
  *   If there exists an N such that N > commitIndex, a majority of
  *   matchIndex[i] >= N, and log[N].term == currentTerm: set commitIndex = N
  */
-void raft_replication__quorum(struct raft *r, const raft_index index);
+void raft_replication__quorum(struct raft *r);
 
 #endif /* RAFT_REPLICATION_H */
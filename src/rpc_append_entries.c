@@ -2,7 +2,9 @@
 
 #include "assert.h"
 #include "configuration.h"
+#include "election.h"
 #include "log.h"
+#include "read.h"
 #include "replication.h"
 #include "rpc.h"
 #include "state.h"
@@ -81,8 +83,13 @@ int raft_rpc__recv_append_entries(struct raft *r,
     assert(r->state == RAFT_STATE_FOLLOWER);
 
     /* Update current leader because the term in this AppendEntries RPC is up to
-     * date. */
-    r->follower_state.current_leader_id = id;
+     * date. Otherwise the time since the last RPC is a heartbeat interval. */
+    if (r->follower_state.current_leader_id != id) {
+        r->follower_state.current_leader_id = id;
+        raft_read__leader_changed(r);
+    } else {
+        raft_election__observe_heartbeat(r);
+    }
 
     /* Reset the election timer. */
     r->timer = 0;
@@ -92,6 +99,13 @@ int raft_rpc__recv_append_entries(struct raft *r,
         return rv;
     }
 
+    /* If our log matches the leader's and we know about all entries it has
+     * committed, local reads are up to date as of now. Entries that are still
+     * being written will be confirmed by the next RPC. */
+    if (result->success && r->commit_index >= args->leader_commit) {
+        r->follower_state.commit_timer = 0;
+    }
+
     if (async) {
         return 0;
     }
@@ -133,6 +147,7 @@ int raft_rpc__recv_append_entries_result(
 {
     int match;
     const struct raft_server *server;
+    size_t i;
     int rv;
 
     assert(r != NULL);
@@ -184,6 +199,17 @@ int raft_rpc__recv_append_entries_result(
         return 0;
     }
 
+    i = raft_configuration__index(&r->configuration, id);
+
+    /* Any result for the current term shows that the server is reachable. */
+    r->leader_state.last_contact[i] = r->leader_state.clock;
+
+    /* A successful result for the current term might confirm our leadership
+     * for pending reads. */
+    if (result->success) {
+        raft_read__acked(r, i);
+    }
+
     /* Update the match/next indexes and possibly send further entries. */
     rv = raft_replication__update(r, server, result);
     if (rv != 0) {
@@ -191,7 +217,7 @@ int raft_rpc__recv_append_entries_result(
     }
 
     /* Commit entries if possible */
-    raft_replication__quorum(r, result->last_log_index);
+    raft_replication__quorum(r);
 
     rv = raft_replication__apply(r);
     if (rv != 0) {
@@ -0,0 +1,159 @@
+#include <string.h>
+
+#include "../include/raft.h"
+
+#include "assert.h"
+#include "read.h"
+#include "rpc.h"
+#include "rpc_read_index.h"
+
+/**
+ * Read submitted by the leader on behalf of a follower.
+ */
+struct raft_rpc__read
+{
+    struct raft_read req;
+    struct raft *raft;
+    unsigned server_id;
+    char *server_address;
+    unsigned long long id;
+};
+
+/**
+ * Send a ReadIndex result to the given server.
+ */
+static int raft_rpc__send_read_index_result(struct raft *r,
+                                            const unsigned id,
+                                            const char *address,
+                                            const unsigned long long read_id,
+                                            const bool success,
+                                            const raft_index index)
+{
+    struct raft_message message;
+
+    message.type = RAFT_IO_READ_INDEX_RESULT;
+    message.server_id = id;
+    message.server_address = address;
+    message.read_index_result.term = r->current_term;
+    message.read_index_result.id = read_id;
+    message.read_index_result.success = success;
+    message.read_index_result.index = index;
+
+    return r->io->send(r->io, &message, NULL, NULL);
+}
+
+static void raft_rpc__read_cb(struct raft_read *req, int status)
+{
+    struct raft_rpc__read *read = req->data;
+    struct raft *r = read->raft;
+    int rv;
+
+    /* If leadership was lost we don't reply, the follower will eventually
+     * retry with the new leader. */
+    if (status == 0) {
+        rv = raft_rpc__send_read_index_result(r, read->server_id,
+                                              read->server_address, read->id,
+                                              true, req->index);
+        if (rv != 0) {
+            raft_warnf(r->logger, "send read index result: %s (%d)",
+                       raft_strerror(rv), rv);
+        }
+    }
+
+    raft_free(read->server_address);
+    raft_free(read);
+}
+
+int raft_rpc__recv_read_index(struct raft *r,
+                              const unsigned id,
+                              const char *address,
+                              const struct raft_read_index *args)
+{
+    struct raft_rpc__read *read;
+    int match;
+    int rv;
+
+    assert(r != NULL);
+    assert(id > 0);
+    assert(args != NULL);
+
+    raft_debugf(r->logger, "received read index request from server %ld", id);
+
+    rv = raft_rpc__ensure_matching_terms(r, args->term, &match);
+    if (rv != 0) {
+        return rv;
+    }
+
+    if (match < 0 || r->state != RAFT_STATE_LEADER) {
+        raft_debugf(r->logger, "local server is not leader -> reject");
+        goto reject;
+    }
+
+    read = raft_malloc(sizeof *read);
+    if (read == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err;
+    }
+
+    read->server_address = raft_malloc(strlen(address) + 1);
+    if (read->server_address == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_read_alloc;
+    }
+    strcpy(read->server_address, address);
+
+    read->req.data = read;
+    read->raft = r;
+    read->server_id = id;
+    read->id = args->id;
+
+    rv = raft_read_index(r, &read->req, raft_rpc__read_cb);
+    if (rv != 0) {
+        goto err_after_address_alloc;
+    }
+
+    return 0;
+
+err_after_address_alloc:
+    raft_free(read->server_address);
+
+err_after_read_alloc:
+    raft_free(read);
+
+err:
+    assert(rv != 0);
+    return rv;
+
+reject:
+    return raft_rpc__send_read_index_result(r, id, address, args->id, false,
+                                            0);
+}
+
+int raft_rpc__recv_read_index_result(
+    struct raft *r,
+    const unsigned id,
+    const char *address,
+    const struct raft_read_index_result *result)
+{
+    int match;
+    int rv;
+
+    (void)address;
+
+    assert(r != NULL);
+    assert(id > 0);
+    assert(result != NULL);
+
+    raft_debugf(r->logger, "received read index result from server %ld", id);
+
+    rv = raft_rpc__ensure_matching_terms(r, result->term, &match);
+    if (rv != 0) {
+        return rv;
+    }
+
+    /* The result is valid regardless of its term: the ID tells that the
+     * leader confirmed its read index after the reads were submitted. */
+    raft_read__result(r, result);
+
+    return 0;
+}
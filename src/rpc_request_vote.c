@@ -33,9 +33,14 @@ int raft_rpc__recv_request_vote(struct raft *r,
      *   is receiving heartbeats. [...] If a server receives a RequestVote
      *   request within the minimum election timeout of hearing from a current
      *   leader, it does not update its term or grant its vote
+     *
+     * Unless the leader itself is transferring leadership to the candidate:
+     *
+     *   a server that receives a RequestVote request with this flag set may
+     *   grant its vote even if it believes a current leader exists.
      */
     if (r->state == RAFT_STATE_FOLLOWER &&
-        r->follower_state.current_leader_id != 0) {
+        r->follower_state.current_leader_id != 0 && !args->disrupt_leader) {
         raft_debugf(r->logger, "local server has a leader -> reject ");
         goto reply;
     }
@@ -104,8 +109,10 @@ int raft_rpc__recv_request_vote_result(
         return 0;
     }
 
-    /* Ignore responses if we are not candidate anymore */
-    if (r->state != RAFT_STATE_CANDIDATE) {
+    /* Ignore responses if we are not candidate anymore, or if we are running
+     * a new pre-vote round. */
+    if (r->state != RAFT_STATE_CANDIDATE ||
+        r->candidate_state.in_pre_vote) {
         raft_debugf(r->logger, "local server is not candidate -> ignore");
         return 0;
     }
@@ -161,3 +168,120 @@ int raft_rpc__recv_request_vote_result(
 
     return 0;
 }
+
+int raft_rpc__recv_pre_vote(struct raft *r,
+                            const unsigned id,
+                            const char *address,
+                            const struct raft_request_vote *args)
+{
+    struct raft_message message;
+    struct raft_request_vote_result *result = &message.pre_vote_result;
+    unsigned timeout;
+    int rv;
+
+    assert(r != NULL);
+    assert(id > 0);
+    assert(args != NULL);
+
+    result->vote_granted = false;
+
+    raft_debugf(r->logger, "received pre-vote request from server %ld", id);
+
+    /* Reject the request if we are the leader, or if we heard from one within
+     * the minimum election timeout. Unlike with RequestVote, our term is never
+     * changed.
+     *
+     * From Section §9.6:
+     *
+     *   A server only grants a pre-vote if it has not heard from a leader
+     *   within at least a baseline election timeout.
+     */
+    timeout = r->election_adaptive ? r->election_timeout_min
+                                   : r->election_timeout;
+    if (r->state == RAFT_STATE_LEADER ||
+        (r->state == RAFT_STATE_FOLLOWER &&
+         r->follower_state.current_leader_id != 0 && r->timer < timeout)) {
+        raft_debugf(r->logger, "local server has a leader -> reject ");
+        goto reply;
+    }
+
+    raft_election__pre_vote(r, args, &result->vote_granted);
+
+reply:
+    /* When granting, echo back the requested term so that the candidate can
+     * tell results of the current round from stale ones. */
+    result->term = result->vote_granted ? args->term : r->current_term;
+
+    message.type = RAFT_IO_PRE_VOTE_RESULT;
+    message.server_id = id;
+    message.server_address = address;
+
+    rv = r->io->send(r->io, &message, NULL, NULL);
+    if (rv != 0) {
+        return rv;
+    }
+
+    return 0;
+}
+
+int raft_rpc__recv_pre_vote_result(
+    struct raft *r,
+    const unsigned id,
+    const char *address,
+    const struct raft_request_vote_result *result)
+{
+    size_t votes_index;
+    int match;
+    int rv;
+
+    (void)address;
+
+    assert(r != NULL);
+    assert(id > 0);
+    assert(result != NULL);
+
+    raft_debugf(r->logger, "received pre-vote result from server %ld", id);
+
+    votes_index = raft_configuration__voting_index(&r->configuration, id);
+    if (votes_index == r->configuration.n) {
+        raft_infof(r->logger, "non-voting or unknown server -> reject");
+        return 0;
+    }
+
+    /* Ignore responses if the pre-vote phase is over */
+    if (r->state != RAFT_STATE_CANDIDATE ||
+        !r->candidate_state.in_pre_vote) {
+        raft_debugf(r->logger, "local server is not pre-voting -> ignore");
+        return 0;
+    }
+
+    /* A rejection from a server with a higher term means that our term is out
+     * of date, like for any other RPC. */
+    if (!result->vote_granted) {
+        if (result->term > r->current_term) {
+            rv = raft_rpc__ensure_matching_terms(r, result->term, &match);
+            if (rv != 0) {
+                return rv;
+            }
+        }
+        return 0;
+    }
+
+    if (result->term != r->current_term + 1) {
+        raft_debugf(r->logger, "pre-vote for another term -> ignore");
+        return 0;
+    }
+
+    /* Once a majority of servers would vote for us, start the real
+     * election. */
+    if (raft_election__tally(r, votes_index)) {
+        raft_debugf(r->logger, "pre-vote quorum reached -> start election");
+        r->candidate_state.in_pre_vote = false;
+        rv = raft_election__start(r);
+        if (rv != 0) {
+            return rv;
+        }
+    }
+
+    return 0;
+}
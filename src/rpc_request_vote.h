@@ -24,4 +24,21 @@ int raft_rpc__recv_request_vote_result(
     const char *address,
     const struct raft_request_vote_result *result);
 
+/**
+ * Process a PreVote RPC from the given server.
+ */
+int raft_rpc__recv_pre_vote(struct raft *r,
+                            const unsigned id,
+                            const char *address,
+                            const struct raft_request_vote *args);
+
+/**
+ * Process a PreVote RPC result from the given server.
+ */
+int raft_rpc__recv_pre_vote_result(
+    struct raft *r,
+    const unsigned id,
+    const char *address,
+    const struct raft_request_vote_result *result);
+
 #endif /* RAFT_RPC_REQUEST_VOTE_H */
@@ -0,0 +1,60 @@
+#include "../include/raft.h"
+
+#include "assert.h"
+#include "configuration.h"
+#include "log.h"
+#include "rpc.h"
+#include "rpc_timeout_now.h"
+#include "state.h"
+
+int raft_rpc__recv_timeout_now(struct raft *r,
+                               const unsigned id,
+                               const char *address,
+                               const struct raft_timeout_now *args)
+{
+    const struct raft_server *local_server;
+    int match;
+    int rv;
+
+    (void)address;
+
+    assert(r != NULL);
+    assert(id > 0);
+    assert(args != NULL);
+
+    raft_debugf(r->logger, "received timeout now from server %ld", id);
+
+    rv = raft_rpc__ensure_matching_terms(r, args->term, &match);
+    if (rv != 0) {
+        return rv;
+    }
+
+    if (match < 0) {
+        raft_debugf(r->logger, "local term is higher -> ignore");
+        return 0;
+    }
+
+    /* Only followers can start an election. */
+    if (r->state != RAFT_STATE_FOLLOWER) {
+        raft_debugf(r->logger, "local server is not follower -> ignore");
+        return 0;
+    }
+
+    local_server = raft_configuration__get(&r->configuration, r->id);
+    if (local_server == NULL || !raft_configuration__is_voting(local_server)) {
+        raft_debugf(r->logger, "local server is not voting -> ignore");
+        return 0;
+    }
+
+    /* The leader sends this request only once our log matches its own, but
+     * the message might be stale. */
+    if (raft_log__last_index(&r->log) != args->last_log_index ||
+        raft_log__last_term(&r->log) != args->last_log_term) {
+        raft_debugf(r->logger, "local log is not up-to-date -> ignore");
+        return 0;
+    }
+
+    raft_infof(r->logger, "leader asked to time out -> start election");
+
+    return raft_state__convert_to_candidate(r, true);
+}
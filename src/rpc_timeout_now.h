@@ -0,0 +1,18 @@
+/**
+ * TimeoutNow RPC handlers.
+ */
+
+#ifndef RAFT_RPC_TIMEOUT_NOW_H
+#define RAFT_RPC_TIMEOUT_NOW_H
+
+#include "../include/raft.h"
+
+/**
+ * Process a TimeoutNow RPC from the given server.
+ */
+int raft_rpc__recv_timeout_now(struct raft *r,
+                               const unsigned id,
+                               const char *address,
+                               const struct raft_timeout_now *args);
+
+#endif /* RAFT_RPC_TIMEOUT_NOW_H */
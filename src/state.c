@@ -3,6 +3,9 @@
 #include "configuration.h"
 #include "election.h"
 #include "log.h"
+#include "membership.h"
+#include "proposal.h"
+#include "read.h"
 #include "watch.h"
 
 const char *raft_state_names[] = {"unavailable", "follower", "candidate",
@@ -14,6 +17,9 @@ const char *raft_state_names[] = {"unavailable", "follower", "candidate",
 static void raft_state__clear_follower(struct raft *r)
 {
     r->follower_state.current_leader_id = 0;
+
+    /* Fail any pending read, since we won't hear from the leader anymore. */
+    raft_read__clear_follower(r);
 }
 
 /**
@@ -42,6 +48,23 @@ static void raft_state__clear_leader(struct raft *r)
         r->leader_state.match_index = NULL;
     }
 
+    if (r->leader_state.match_sorted != NULL) {
+        raft_free(r->leader_state.match_sorted);
+        r->leader_state.match_sorted = NULL;
+    }
+
+    if (r->leader_state.last_contact != NULL) {
+        raft_free(r->leader_state.last_contact);
+        r->leader_state.last_contact = NULL;
+    }
+
+    /* Fail any pending read, since we can't serve them anymore. */
+    raft_read__clear(r);
+
+    /* Same for pending client requests, which might or might not eventually be
+     * committed by the next leader. */
+    raft_proposal__clear(r);
+
     /* If a promotion request is in progress and we are waiting for the server
      * to be promoted to catch up with logs, then we need to abort the
      * promotion, because having lost leadership we're not in the position to
@@ -67,6 +90,7 @@ void raft_state__clear(struct raft *r)
 
     switch (r->state) {
         case RAFT_STATE_FOLLOWER:
+            raft_state__clear_follower(r);
             break;
         case RAFT_STATE_CANDIDATE:
             raft_state__clear_candidate(r);
@@ -149,6 +173,7 @@ int raft_state__convert_to_follower(struct raft *r, raft_term term)
     /* The current leader will be set next time that we receive an AppendEntries
      * RPC. */
     r->follower_state.current_leader_id = 0;
+    raft_read__init_follower(r);
 
     /* Notify watchers */
     raft_watch__state_change(r, prev_state);
@@ -156,7 +181,7 @@ int raft_state__convert_to_follower(struct raft *r, raft_term term)
     return 0;
 }
 
-int raft_state__convert_to_candidate(struct raft *r)
+int raft_state__convert_to_candidate(struct raft *r, bool disrupt_leader)
 {
     size_t n_voting = raft_configuration__n_voting(&r->configuration);
     int rv;
@@ -175,11 +200,20 @@ int raft_state__convert_to_candidate(struct raft *r)
         goto err;
     }
 
+    /* If enabled, first make sure that we can win the election. There's no
+     * point in doing so if the leader itself asked us to run. */
+    r->candidate_state.in_pre_vote = r->pre_vote && !disrupt_leader;
+    r->candidate_state.disrupt_leader = disrupt_leader;
+
     /* Start a new election round */
     rv = raft_election__start(r);
     if (rv != 0) {
+        /* The candidate state overlaps the follower one, which must be
+         * reinitialized. */
         r->state = RAFT_STATE_FOLLOWER;
         raft_free(r->candidate_state.votes);
+        r->follower_state.current_leader_id = 0;
+        raft_read__init_follower(r);
         return rv;
     }
 
@@ -194,18 +228,26 @@ err:
 }
 
 /**
- * Allocate the given next/match indexes.
+ * Allocate the given next/match indexes, the scratch space used to sort match
+ * indexes, the last contact times and the read counters.
  */
-static int raft_state__alloc_next_and_match_indexes(struct raft *r,
-                                                    size_t n_servers,
-                                                    raft_index **next_index,
-                                                    raft_index **match_index)
+static int raft_state__alloc_next_and_match_indexes(
+    struct raft *r,
+    size_t n_servers,
+    raft_index **next_index,
+    raft_index **match_index,
+    raft_index **match_sorted,
+    unsigned **last_contact,
+    struct raft_read_peer **read_peers)
 {
     int rv;
 
     assert(n_servers > 0);
     assert(next_index != NULL);
     assert(match_index != NULL);
+    assert(match_sorted != NULL);
+    assert(last_contact != NULL);
+    assert(read_peers != NULL);
 
     *next_index = raft_calloc(n_servers, sizeof **next_index);
     if (*next_index == NULL) {
@@ -216,11 +258,45 @@ static int raft_state__alloc_next_and_match_indexes(struct raft *r,
     *match_index = raft_calloc(n_servers, sizeof **match_index);
     if (*match_index == NULL) {
         rv = RAFT_ERR_NOMEM;
-        goto err;
+        goto err_after_next_index_alloc;
+    }
+
+    *match_sorted = raft_calloc(n_servers, sizeof **match_sorted);
+    if (*match_sorted == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_match_index_alloc;
+    }
+
+    *last_contact = raft_calloc(n_servers, sizeof **last_contact);
+    if (*last_contact == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_match_sorted_alloc;
+    }
+
+    *read_peers = raft_calloc(n_servers, sizeof **read_peers);
+    if (*read_peers == NULL) {
+        rv = RAFT_ERR_NOMEM;
+        goto err_after_last_contact_alloc;
     }
 
     return 0;
 
+err_after_last_contact_alloc:
+    raft_free(*last_contact);
+    *last_contact = NULL;
+
+err_after_match_sorted_alloc:
+    raft_free(*match_sorted);
+    *match_sorted = NULL;
+
+err_after_match_index_alloc:
+    raft_free(*match_index);
+    *match_index = NULL;
+
+err_after_next_index_alloc:
+    raft_free(*next_index);
+    *next_index = NULL;
+
 err:
     assert(rv != 0);
     return rv;
@@ -239,28 +315,43 @@ int raft_state__convert_to_leader(struct raft *r)
 
     raft_state__change(r, RAFT_STATE_LEADER);
 
-    /* Allocate the next_index and match_index arrays. */
-    rv = raft_state__alloc_next_and_match_indexes(r, r->configuration.n,
-                                                  &r->leader_state.next_index,
-                                                  &r->leader_state.match_index);
+    raft_read__init(r);
+    raft_proposal__init(r);
+
+    /* Allocate the next_index and match_index arrays. The scratch and last
+     * contact arrays are allocated after them, so make sure it's safe to clear
+     * the leader state if allocating them fails. */
+    r->leader_state.match_sorted = NULL;
+    r->leader_state.last_contact = NULL;
+    rv = raft_state__alloc_next_and_match_indexes(
+        r, r->configuration.n, &r->leader_state.next_index,
+        &r->leader_state.match_index, &r->leader_state.match_sorted,
+        &r->leader_state.last_contact, &r->leader_state.read_peers);
     if (rv != 0) {
         goto err;
     }
 
-    /* Initialize the next_index and match_index arrays. */
+    /* Initialize the next_index and match_index arrays. All servers are
+     * considered in contact at election time. */
     for (i = 0; i < r->configuration.n; i++) {
         r->leader_state.next_index[i] = raft_log__last_index(&r->log) + 1;
         r->leader_state.match_index[i] = 0;
+        r->leader_state.last_contact[i] = r->leader_state.clock;
     }
 
     /* Notify watchers */
     raft_watch__state_change(r, RAFT_STATE_CANDIDATE);
 
     /* Reset promotion state. */
-    r->leader_state.promotee_id = 0;
-    r->leader_state.round_number = 0;
-    r->leader_state.round_index = 0;
-    r->leader_state.round_duration = 0;
+    raft_membership__catch_up_reset(r);
+
+    /* Reset leadership transfer state. */
+    r->leader_state.transferee_id = 0;
+    r->leader_state.transfer_duration = 0;
+    r->leader_state.transfer_sent = false;
+
+    /* Learners haven't been sent anything yet. */
+    r->leader_state.learners_sent = 0;
 
     return 0;
 
@@ -273,8 +364,11 @@ int raft_state__rebuild_next_and_match_indexes(
     struct raft *r,
     const struct raft_configuration *configuration)
 {
-    raft_index *next_index;  /* New next index */
-    raft_index *match_index; /* New match index */
+    raft_index *next_index;
+    raft_index *match_index;
+    raft_index *match_sorted;
+    unsigned *last_contact;
+    struct raft_read_peer *read_peers;
     size_t i;
     int rv;
 
@@ -283,8 +377,9 @@ int raft_state__rebuild_next_and_match_indexes(
     assert(r->state == RAFT_STATE_LEADER);
 
     /* Allocate the new next_index and match_index arrays. */
-    rv = raft_state__alloc_next_and_match_indexes(r, configuration->n,
-                                                  &next_index, &match_index);
+    rv = raft_state__alloc_next_and_match_indexes(
+        r, configuration->n, &next_index, &match_index, &match_sorted,
+        &last_contact, &read_peers);
     if (rv != 0) {
         goto err;
     }
@@ -302,7 +397,9 @@ int raft_state__rebuild_next_and_match_indexes(
         }
 
         next_index[j] = r->leader_state.next_index[i];
-        match_index[j] = r->leader_state.match_index[j];
+        match_index[j] = r->leader_state.match_index[i];
+        last_contact[j] = r->leader_state.last_contact[i];
+        read_peers[j] = r->leader_state.read_peers[i];
     }
 
     /* The reset the next/match index value for servers that are present in the
@@ -322,13 +419,20 @@ int raft_state__rebuild_next_and_match_indexes(
 
         next_index[i] = raft_log__last_index(&r->log) + 1;
         match_index[i] = 0;
+        last_contact[i] = r->leader_state.clock;
     }
 
     raft_free(r->leader_state.next_index);
     raft_free(r->leader_state.match_index);
+    raft_free(r->leader_state.match_sorted);
+    raft_free(r->leader_state.last_contact);
+    raft_free(r->leader_state.read_peers);
 
     r->leader_state.next_index = next_index;
     r->leader_state.match_index = match_index;
+    r->leader_state.match_sorted = match_sorted;
+    r->leader_state.last_contact = last_contact;
+    r->leader_state.read_peers = read_peers;
 
     return 0;
 
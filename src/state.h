@@ -39,8 +39,12 @@ int raft_state__convert_to_follower(struct raft *r, raft_term term);
  * From Figure 3.1:
  *
  *   On conversion to candidate, start election:
+ *
+ * If @disrupt_leader is true, the election was requested by the current leader
+ * with a TimeoutNow RPC: the pre-vote phase is skipped and other servers grant
+ * their vote even if they have a leader.
  */
-int raft_state__convert_to_candidate(struct raft *r);
+int raft_state__convert_to_candidate(struct raft *r, bool disrupt_leader);
 
 /**
  * Convert from candidate to leader.
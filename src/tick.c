@@ -3,20 +3,17 @@
 #include "assert.h"
 #include "configuration.h"
 #include "election.h"
+#include "membership.h"
+#include "read.h"
 #include "replication.h"
 #include "state.h"
 #include "watch.h"
 
-/**
- * Number of milliseconds after which a server promotion will be aborted if the
- * server hasn't caught up with the logs yet.
- */
-#define RAFT_MAX_CATCH_UP_DURATION (30 * 1000)
-
 /**
  * Apply time-dependent rules for followers (Figure 3.1).
  */
-static int raft_tick__follower(struct raft *r)
+static int raft_tick__follower(struct raft *r,
+                               const unsigned msec_since_last_tick)
 {
     const struct raft_server *server;
     int rv;
@@ -24,6 +21,8 @@ static int raft_tick__follower(struct raft *r)
     assert(r != NULL);
     assert(r->state == RAFT_STATE_FOLLOWER);
 
+    raft_read__tick(r, msec_since_last_tick);
+
     server = raft_configuration__get(&r->configuration, r->id);
 
     /* If we have been removed from the configuration, or maybe we didn't
@@ -36,9 +35,11 @@ static int raft_tick__follower(struct raft *r)
      * to leader. If that is not us, we're either joining the cluster or we're
      * simply configured as non-voter, do nothing and wait for RPCs. */
     if (raft_configuration__n_voting(&r->configuration) == 1) {
-        if (server->voting) {
+        if (raft_configuration__is_voting(server)) {
             raft_debugf(r->logger, "tick: self elect and convert to leader");
-            rv = raft_state__convert_to_candidate(r);
+            /* There's nobody else to ask, so skip the pre-vote phase and run
+             * a real election, bumping the term and voting for ourselves. */
+            rv = raft_state__convert_to_candidate(r, true);
             if (rv != 0) {
                 return rv;
             }
@@ -65,10 +66,11 @@ static int raft_tick__follower(struct raft *r)
      *   If election timeout elapses without receiving AppendEntries RPC from
      *   current leader or granting vote to candidate, convert to candidate.
      */
-    if (r->timer > r->election_timeout_rand && server->voting) {
+    if (r->timer > r->election_timeout_rand &&
+        raft_configuration__is_voting(server)) {
         raft_infof(r->logger,
                    "tick: convert to candidate and start new election");
-        return raft_state__convert_to_candidate(r);
+        return raft_state__convert_to_candidate(r, false);
     }
 
     return 0;
@@ -94,50 +96,92 @@ static int raft_tick__candidate(struct raft *r)
      */
     if (r->timer > r->election_timeout_rand) {
         raft_infof(r->logger, "tick: start new election");
+        /* If an election requested by the leader failed, the next one must
+         * not disrupt whoever might have taken over. */
+        r->candidate_state.disrupt_leader = false;
         return raft_election__start(r);
     }
 
     return 0;
 }
 
+/**
+ * Return true if a majority of voting servers, including ourselves, replied to
+ * us within the last election timeout.
+ */
+static bool raft_tick__has_quorum_contact(struct raft *r)
+{
+    size_t contacts = 0;
+    size_t contacts_old = 0;
+    size_t i;
+
+    for (i = 0; i < r->configuration.n; i++) {
+        const struct raft_server *server = &r->configuration.servers[i];
+        unsigned elapsed;
+
+        if (!raft_configuration__is_voting(server)) {
+            continue;
+        }
+
+        elapsed = r->leader_state.clock - r->leader_state.last_contact[i];
+
+        if (server->id == r->id || elapsed < r->election_timeout) {
+            if (server->voting) {
+                contacts++;
+            }
+            if (server->voting_old) {
+                contacts_old++;
+            }
+        }
+    }
+
+    return raft_configuration__is_majority(&r->configuration, contacts,
+                                           contacts_old);
+}
+
 /**
  * Apply time-dependent rules for leaders (Figure 3.1).
  */
 static int raft_tick__leader(struct raft *r,
                              const unsigned msec_since_last_tick)
 {
+    int rv;
+
     assert(r != NULL);
     assert(r->state == RAFT_STATE_LEADER);
 
-    /* Check if we need to send heartbeats.
+    raft_read__tick(r, msec_since_last_tick);
+
+    /* Step down if we lost contact with the majority of the cluster. This
+     * fails all pending requests, so clients can retry elsewhere.
      *
-     * From Figure 3.1:
+     * From Section §6.2:
      *
-     *   Send empty AppendEntries RPC during idle periods to prevent election
-     *   timeouts.
+     *   If an election timeout elapses without a successful round of
+     *   heartbeats to a majority of its cluster, the leader steps down.
      */
-    if (r->timer > r->heartbeat_timeout) {
-        raft_replication__trigger(r, 0);
-        r->timer = 0;
+    if (r->check_quorum && !raft_tick__has_quorum_contact(r)) {
+        raft_warnf(r->logger, "tick: lost contact with majority -> step down");
+        rv = raft_state__convert_to_follower(r, r->current_term);
+        if (rv != 0) {
+            return rv;
+        }
+        return 0;
     }
 
-    /* If a server is being promoted, increment the timer of the current
-     * round or abort the promotion.
+    /* If a server is being promoted, update its catch-up estimates and abort
+     * the promotion if it can't keep up. This happens before sending
+     * heartbeats, since what we send to the server depends on how long it has
+     * been idle.
      *
      * From Section 4.2.1:
      *
-     *   The algorithm waits a fixed number of rounds (such as 10). If the last
-     *   round lasts less than an election timeout, then the leader adds the new
-     *   server to the cluster, under the assumption that there are not enough
-     *   unreplicated entries to create a significant availability
-     *   gap. Otherwise, the leader aborts the configuration change with an
-     *   error.
+     *   If the new server is unavailable or is so slow that it will never catch
+     *   up, the leader should also abort the change.
      */
     if (r->leader_state.promotee_id != 0) {
         unsigned id = r->leader_state.promotee_id;
         size_t server_index;
-        bool is_too_slow;
-        bool is_unresponsive;
 
         /* If a promotion is in progress, we expect that our configuration
          * contains an entry for the server being promoted, and that the server
@@ -146,23 +190,51 @@ static int raft_tick__leader(struct raft *r,
         assert(server_index < r->configuration.n);
         assert(!r->configuration.servers[server_index].voting);
 
-        r->leader_state.round_duration += msec_since_last_tick;
-
-        is_too_slow = (r->leader_state.round_number == 10 &&
-                       r->leader_state.round_duration > r->election_timeout);
-        is_unresponsive =
-            r->leader_state.round_duration > RAFT_MAX_CATCH_UP_DURATION;
+        if (raft_membership__catch_up_tick(r, msec_since_last_tick)) {
+            raft_membership__catch_up_reset(r);
+            raft_watch__promotion_aborted(r, id);
+        }
+    }
 
-        /* Abort the promotion if we are at the 10'th round and it's still
-         * taking too long, or if the server is unresponsive. */
-        if (is_too_slow || is_unresponsive) {
-            r->leader_state.promotee_id = 0;
+    /* Check if we need to send heartbeats.
+     *
+     * From Figure 3.1:
+     *
+     *   Send empty AppendEntries RPC during idle periods to prevent election
+     *   timeouts.
+     */
+    if (r->timer > r->heartbeat_timeout) {
+        raft_read__heartbeat(r);
+        raft_replication__trigger(r, 0);
+        r->timer = 0;
+    }
 
-            r->leader_state.round_index = 0;
-            r->leader_state.round_number = 0;
-            r->leader_state.round_duration = 0;
+    /* Abort a leadership transfer that didn't complete in time, and start
+     * accepting new entries again.
+     *
+     * From Section §3.10:
+     *
+     *   If the transfer does not complete within an election timeout, the
+     *   leader aborts the transfer and resumes accepting client requests.
+     */
+    if (r->leader_state.transferee_id != 0) {
+        r->leader_state.transfer_duration += msec_since_last_tick;
+        if (r->leader_state.transfer_duration > r->election_timeout) {
+            raft_warnf(r->logger, "tick: abort transfer to server %u",
+                       r->leader_state.transferee_id);
+            raft_membership__transfer_abort(r);
+        }
+    }
 
-            raft_watch__promotion_aborted(r, id);
+    /* Retry moving on to C_new, in case we failed to do it as soon as the joint
+     * configuration got committed or we were elected afterwards. */
+    if (r->configuration_uncommitted_index == 0 &&
+        raft_configuration__is_joint(&r->configuration)) {
+        rv = raft_membership__leave_joint(r);
+        if (rv != 0) {
+            raft_warnf(r->logger,
+                       "tick: failed to leave joint configuration: %s",
+                       raft_strerror(rv));
         }
     }
 
@@ -188,7 +260,7 @@ int raft__tick(struct raft *r, const unsigned msec_since_last_tick)
 
     switch (r->state) {
         case RAFT_STATE_FOLLOWER:
-            rv = raft_tick__follower(r);
+            rv = raft_tick__follower(r, msec_since_last_tick);
             break;
         case RAFT_STATE_CANDIDATE:
             rv = raft_tick__candidate(r);
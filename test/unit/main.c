@@ -5,6 +5,7 @@ extern MunitSuite raft_client_suites[];
 extern MunitSuite raft_configuration_suites[];
 extern MunitSuite raft_context_suites[];
 extern MunitSuite raft_election_suites[];
+extern MunitSuite raft_heap_slab_suites[];
 #if RAFT_IO_STUB
 extern MunitSuite raft_io_stub_suites[];
 #endif
@@ -15,9 +16,13 @@ extern MunitSuite raft_io_uv_store_suites[];
 #endif
 extern MunitSuite raft_log_suites[];
 extern MunitSuite raft_logger_suites[];
+extern MunitSuite raft_lz4_suites[];
+extern MunitSuite raft_read_suites[];
 extern MunitSuite raft_replication_suites[];
 extern MunitSuite raft_rpc_request_vote_suites[];
 extern MunitSuite raft_rpc_append_entries_suites[];
+extern MunitSuite raft_rpc_read_index_suites[];
+extern MunitSuite raft_rpc_timeout_now_suites[];
 extern MunitSuite raft_tick_suites[];
 extern MunitSuite raft_suites[];
 #if RAFT_IO_UV
@@ -30,6 +35,7 @@ static MunitSuite suites[] = {
     {"configuration", NULL, raft_configuration_suites, 1, 0},
     /*     {"context", NULL, raft_context_suites, 1, 0}, */
     {"election", NULL, raft_election_suites, 1, 0},
+    {"heap-slab", NULL, raft_heap_slab_suites, 1, 0},
 #if RAFT_IO_STUB
     {"io-stub", NULL, raft_io_stub_suites, 1, 0},
 #endif
@@ -40,9 +46,13 @@ static MunitSuite suites[] = {
 #endif
     {"log", NULL, raft_log_suites, 1, 0},
     /*     {"logger", NULL, raft_logger_suites, 1, 0}, */
+    {"lz4", NULL, raft_lz4_suites, 1, 0},
+    {"read", NULL, raft_read_suites, 1, 0},
     {"replication", NULL, raft_replication_suites, 1, 0},
     {"rpc-request-vote", NULL, raft_rpc_request_vote_suites, 1, 0},
     {"rpc-append-entries", NULL, raft_rpc_append_entries_suites, 1, 0},
+    {"rpc-read-index", NULL, raft_rpc_read_index_suites, 1, 0},
+    {"rpc-timeout-now", NULL, raft_rpc_timeout_now_suites, 1, 0},
     {"tick", NULL, raft_tick_suites, 1, 0},
     {"raft", NULL, raft_suites, 1, 0},
 #if RAFT_IO_UV
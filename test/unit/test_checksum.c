@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "../../src/checksum.h"
 
 #include "../lib/munit.h"
@@ -58,11 +60,62 @@ static MunitTest crc32_tests[] = {
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
+/**
+ * raft__crc32c
+ */
+
+/* The checksum matches the standard check value. */
+static MunitResult test_crc32c_check(const MunitParameter params[], void *data)
+{
+    const char *buf = "123456789";
+
+    (void)data;
+    (void)params;
+
+    munit_assert_uint32(raft__crc32c(buf, strlen(buf), 0), ==, 0xe3069283);
+
+    return MUNIT_OK;
+}
+
+/* Chaining calls over consecutive buffers, of any size and alignment, gives the
+ * same result as a single call. */
+static MunitResult test_crc32c_chain(const MunitParameter params[], void *data)
+{
+    uint8_t buf[1024];
+    unsigned crc1;
+    unsigned crc2;
+    size_t i;
+
+    (void)data;
+    (void)params;
+
+    for (i = 0; i < sizeof buf; i++) {
+        buf[i] = (uint8_t)(i * 7);
+    }
+
+    crc1 = raft__crc32c(buf, sizeof buf, 0);
+
+    for (i = 0; i < 64; i++) {
+        crc2 = raft__crc32c(buf, i + 3, 0);
+        crc2 = raft__crc32c(buf + i + 3, sizeof buf - i - 3, crc2);
+        munit_assert_uint32(crc1, ==, crc2);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitTest crc32c_tests[] = {
+    {"/check", test_crc32c_check, NULL, NULL, 0, NULL},
+    {"/chain", test_crc32c_chain, NULL, NULL, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
 /**
  * Test suite
  */
 
 MunitSuite raft_checksum_suites[] = {
     {"/crc32", crc32_tests, NULL, 1, 0},
+    {"/crc32c", crc32c_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
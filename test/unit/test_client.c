@@ -25,8 +25,21 @@ struct fixture
     struct raft_io io;
     struct raft_fsm fsm;
     struct raft raft;
+    struct
+    {
+        unsigned n;
+        int status;
+    } apply_cb;
 };
 
+static void __apply_cb(struct raft_apply *req, int status)
+{
+    struct fixture *f = req->data;
+
+    f->apply_cb.n++;
+    f->apply_cb.status = status;
+}
+
 static int __rand()
 {
     return munit_rand_uint32();
@@ -51,6 +64,9 @@ static void *setup(const MunitParameter params[], void *user_data)
 
     raft_set_rand(&f->raft, __rand);
 
+    f->apply_cb.n = 0;
+    f->apply_cb.status = -1;
+
     return f;
 }
 
@@ -192,13 +208,22 @@ static void tear_down(void *data)
     }
 
 /**
- * Assert that the state of the current catch up round matches the given values.
+ * Assert the ID of the server being promoted and the number of catch-up samples
+ * taken so far.
  */
-#define __assert_catch_up_round(F, PROMOTEED_ID, NUMBER, DURATION)            \
-    {                                                                         \
-        munit_assert_int(f->raft.leader_state.promotee_id, ==, PROMOTEED_ID); \
-        munit_assert_int(F->raft.leader_state.round_number, ==, NUMBER);      \
-        munit_assert_int(F->raft.leader_state.round_duration, ==, DURATION);  \
+#define __assert_catch_up(F, PROMOTEE_ID, SAMPLES)                           \
+    {                                                                        \
+        munit_assert_int(F->raft.leader_state.promotee_id, ==, PROMOTEE_ID); \
+        munit_assert_int(F->raft.leader_state.catch_up_samples, ==, SAMPLES); \
+    }
+
+/**
+ * Submit a request to append a new entry and complete the associated I/O.
+ */
+#define __accept_entry_and_flush(F)   \
+    {                                 \
+        __accept_entry(F);            \
+        raft_io_stub_flush(&F->io);   \
     }
 
 /**
@@ -335,11 +360,141 @@ static MunitResult test_accept_send_entries(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* If too many entries are waiting to be applied, new ones are rejected. */
+static MunitResult test_accept_overloaded(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+    struct raft_buffer buf;
+    int rv;
+
+    (void)params;
+
+    raft_set_max_pending_entries(&f->raft, 2);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_leader(&f->raft);
+
+    __accept_entry(f);
+    raft_io_stub_flush(&f->io);
+    __accept_entry(f);
+    raft_io_stub_flush(&f->io);
+
+    test_fsm_encode_set_x(123, &buf);
+
+    rv = raft_accept(&f->raft, &buf, 1);
+    munit_assert_int(rv, ==, RAFT_ERR_OVERLOADED);
+
+    /* Once the entries are applied, new ones are accepted again. */
+    __handle_append_entries_response(f, 2, 2, true, 3);
+
+    munit_assert_int(f->raft.last_applied, ==, 3);
+
+    rv = raft_accept(&f->raft, &buf, 1);
+    munit_assert_int(rv, ==, 0);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
 static MunitTest accept_tests[] = {
     {"/not-leader", test_accept_not_leader, setup, tear_down, 0, NULL},
     {"/oom", test_accept_oom, setup, tear_down, 0, accept_oom_params},
     {"/io-err", test_accept_io_err, setup, tear_down, 0, NULL},
     {"/send-entries", test_accept_send_entries, setup, tear_down, 0, NULL},
+    {"/overloaded", test_accept_overloaded, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_apply
+ */
+
+/* The callback is invoked once all the commands have been applied. */
+static MunitResult test_apply_applied(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    struct raft_apply req1;
+    struct raft_apply req2;
+    struct raft_buffer bufs[2];
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_leader(&f->raft);
+
+    req1.data = f;
+    req2.data = f;
+
+    test_fsm_encode_set_x(1, &bufs[0]);
+    rv = raft_apply(&f->raft, &req1, bufs, 1, __apply_cb);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(req1.index, ==, 2);
+
+    raft_io_stub_flush(&f->io);
+
+    test_fsm_encode_set_x(2, &bufs[0]);
+    test_fsm_encode_set_x(3, &bufs[1]);
+    rv = raft_apply(&f->raft, &req2, bufs, 2, __apply_cb);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(req2.index, ==, 3);
+
+    raft_io_stub_flush(&f->io);
+
+    /* Only the first request is completed if not all the commands of the
+     * second one are committed. */
+    __handle_append_entries_response(f, 2, 2, true, 3);
+
+    munit_assert_int(f->apply_cb.n, ==, 1);
+    munit_assert_int(f->apply_cb.status, ==, 0);
+
+    __handle_append_entries_response(f, 2, 2, true, 4);
+
+    munit_assert_int(f->apply_cb.n, ==, 2);
+    munit_assert_int(f->apply_cb.status, ==, 0);
+    munit_assert_ptr_null(f->raft.leader_state.applies);
+
+    return MUNIT_OK;
+}
+
+/* If leadership is lost, pending requests fail. */
+static MunitResult test_apply_step_down(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+    struct raft_apply req;
+    struct raft_buffer buf;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_leader(&f->raft);
+
+    req.data = f;
+
+    test_fsm_encode_set_x(1, &buf);
+    rv = raft_apply(&f->raft, &req, &buf, 1, __apply_cb);
+    munit_assert_int(rv, ==, 0);
+
+    raft_io_stub_flush(&f->io);
+
+    __handle_append_entries_response(f, 2, 3, false, 1);
+
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+
+    munit_assert_int(f->apply_cb.n, ==, 1);
+    munit_assert_int(f->apply_cb.status, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+static MunitTest apply_tests[] = {
+    {"/applied", test_apply_applied, setup, tear_down, 0, NULL},
+    {"/step-down", test_apply_step_down, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -468,12 +623,63 @@ static MunitResult test_add_server_committed(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* Add a learner, which is a non-voting server that can still be promoted. */
+static MunitResult test_add_server_learner(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+    const struct raft_server *server;
+    struct raft_configuration configuration;
+    const struct raft_entry *entry;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_leader(&f->raft);
+
+    rv = raft_add_learner(&f->raft, 3, "3");
+    munit_assert_int(rv, ==, 0);
+
+    server = &f->raft.configuration.servers[2];
+    munit_assert_int(server->id, ==, 3);
+    munit_assert_false(server->voting);
+    munit_assert_true(server->learner);
+
+    /* The learner flag is persisted in the configuration entry. */
+    entry = raft_log__get(&f->raft.log, 2);
+    munit_assert_int(entry->type, ==, RAFT_LOG_CONFIGURATION);
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_decode(&entry->buf, &configuration);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_true(configuration.servers[2].learner);
+    raft_configuration_close(&configuration);
+
+    __assert_io(f, 1, 2);
+
+    __handle_append_entries_response(f, 2, 2, true, 2);
+    __handle_append_entries_response(f, 3, 2, true, 2);
+
+    /* Promoting the learner turns it into a regular voting server. */
+    __promote(f, 3);
+
+    server = &f->raft.configuration.servers[2];
+    munit_assert_true(server->voting);
+    munit_assert_false(server->learner);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
 static MunitTest add_server_tests[] = {
     {"/not-leader", test_add_server_not_leader, setup, tear_down, 0, NULL},
     {"/busy", test_add_server_busy, setup, tear_down, 0, NULL},
     {"/dup-id", test_add_server_dup_id, setup, tear_down, 0, NULL},
     {"/submit", test_add_server_submit, setup, tear_down, 0, NULL},
     {"/committed", test_add_server_committed, setup, tear_down, 0, NULL},
+    {"/learner", test_add_server_learner, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -588,9 +794,9 @@ static MunitResult test_promote_up_to_date(const MunitParameter params[],
     return MUNIT_OK;
 }
 
-/* Promoting a server whose log is not up-to-date results in catch-up rounds to
- * start. When the server has caught up, the configuration change request gets
- * submitted. */
+/* Promoting a server whose log is not up-to-date results in entries being
+ * streamed to it. When the server has caught up, the configuration change
+ * request gets submitted. */
 static MunitResult test_promote_catch_up(const MunitParameter params[],
                                          void *data)
 {
@@ -615,7 +821,7 @@ static MunitResult test_promote_catch_up(const MunitParameter params[],
 
     /* At this point the server has caught up, but the configuration is
        uncommitted. */
-    __assert_catch_up_round(f, 0, 0, 0);
+    __assert_catch_up(f, 0, 0);
     munit_assert_int(f->raft.configuration_uncommitted_index, ==, 2);
     server = raft_configuration__get(&f->raft.configuration, 3);
     munit_assert_true(server->voting);
@@ -626,50 +832,171 @@ static MunitResult test_promote_catch_up(const MunitParameter params[],
     __handle_append_entries_response(f, 3, f->raft.current_term, true, 2);
 
     /* The promotion is completed. */
-    __assert_catch_up_round(f, 0, 0, 0);
+    __assert_catch_up(f, 0, 0);
     munit_assert_int(f->raft.configuration_uncommitted_index, ==, 0);
 
     return MUNIT_OK;
 }
 
-/* Promoting a server whose log is not up-to-date results in catch-up rounds to
- * start. If new entries are appended after a round is started, a new round is
- * initiated once the former one completes. */
-static MunitResult test_promote_new_round(const MunitParameter params[],
-                                          void *data)
+/* Entries appended while the server being promoted is catching up are sent to
+ * it right away, without waiting for the entries in flight to be
+ * acknowledged. */
+static MunitResult test_promote_pipeline(const MunitParameter params[],
+                                         void *data)
 {
     struct fixture *f = data;
 
     (void)params;
-    return 0;
 
     test_bootstrap_and_start(&f->raft, 3, 1, 2);
     test_become_leader(&f->raft);
 
     __promote(f, 3);
+    __assert_io(f, 0, 1);
 
-    /* Now that the catch-up round started, submit a new entry. */
+    /* The new entry is sent to server 3 too, and its next index is advanced
+     * past it. */
     __accept_entry(f);
+    __assert_io(f, 1, 2);
+    munit_assert_int(f->raft.leader_state.next_index[2], ==, 3);
 
-    /* Let more than election_timeout milliseconds elapse. */
-    __tick(f, f->raft.election_timeout + 100);
-
-    __assert_catch_up_round(f, 3, 1, f->raft.election_timeout + 100);
+    /* Acknowledging the first entry does not trigger a new AppendEntries,
+     * since the second one is still in flight. */
+    __handle_append_entries_response(f, 3, f->raft.current_term, true, 1);
+    __assert_io(f, 0, 0);
+    munit_assert_int(f->raft.leader_state.next_index[2], ==, 3);
+    __assert_catch_up(f, 3, 0);
 
-    /* Simulate the server being promoted sending an AppendEntries result,
-     * acknowledging all entries except the last one. */
+    /* Once the second entry is acknowledged the server is up-to-date. */
+    __handle_append_entries_response(f, 3, f->raft.current_term, true, 2);
+    __assert_catch_up(f, 0, 0);
+    __assert_configuration_indexes(f, 1, 3);
     __assert_io(f, 1, 2);
+
+    return MUNIT_OK;
+}
+
+/* The server being promoted is considered caught up as soon as it's projected
+ * to close its lag within an election timeout, even if the leader keeps
+ * appending new entries. */
+static MunitResult test_promote_projected(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+    unsigned i;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 2);
+    test_become_leader(&f->raft);
+
+    for (i = 0; i < 10; i++) {
+        __accept_entry_and_flush(f);
+    }
+
+    __promote(f, 3);
+    raft_io_stub_flush(&f->io);
+
+    /* No sample was taken yet, so there's no projection. */
     __handle_append_entries_response(f, 3, f->raft.current_term, true, 1);
+    __assert_catch_up(f, 3, 0);
+
+    /* The server replicates 10 entries per second, and no new entries were
+     * appended. */
+    __tick(f, f->raft.heartbeat_timeout);
+    __assert_catch_up(f, 3, 1);
+    munit_assert_int(f->raft.leader_state.catch_up_apply_rate, ==, 10);
+    munit_assert_int(f->raft.leader_state.catch_up_append_rate, ==, 0);
+
+    /* With 10 entries left, the projected time to catch up is exactly one
+     * election timeout, which is too long. */
+    __accept_entry_and_flush(f);
+    __handle_append_entries_response(f, 3, f->raft.current_term, true, 2);
+    __assert_catch_up(f, 3, 1);
+
+    /* Both rates get updated with the new sample. */
+    __tick(f, f->raft.heartbeat_timeout);
+    __assert_catch_up(f, 3, 2);
+    munit_assert_int(f->raft.leader_state.catch_up_apply_rate, ==, 10);
+    munit_assert_int(f->raft.leader_state.catch_up_append_rate, ==, 2);
+
+    /* With one entry left, the server is considered caught up. */
+    __handle_append_entries_response(f, 3, f->raft.current_term, true, 11);
+    __assert_catch_up(f, 0, 0);
+    __assert_configuration_indexes(f, 1, 13);
+    __assert_io(f, 1, 2);
+
+    return MUNIT_OK;
+}
 
-    /* The first round has completed and a new one has started. */
-    __assert_catch_up_round(f, 3, 2, 0);
+/* A server which doesn't acknowledge any entry for ten election timeouts is not
+ * promoted. */
+static MunitResult test_promote_unresponsive(const MunitParameter params[],
+                                             void *data)
+{
+    struct fixture *f = data;
+    unsigned i;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 2);
+    test_become_leader(&f->raft);
+
+    __promote(f, 3);
+
+    for (i = 0; i < 9; i++) {
+        __tick(f, f->raft.election_timeout);
+        raft_io_stub_flush(&f->io);
+    }
+
+    __assert_catch_up(f, 3, 9);
+
+    __tick(f, f->raft.election_timeout);
+    __assert_catch_up(f, 0, 0);
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* A server which replicates entries slower than the leader appends them is not
+ * promoted. */
+static MunitResult test_promote_too_slow(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+    unsigned i;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 2);
+    test_become_leader(&f->raft);
+
+    __promote(f, 3);
+    raft_io_stub_flush(&f->io);
+
+    /* The server acknowledges one entry per heartbeat timeout, while two new
+     * entries get appended. */
+    for (i = 0; i < 9; i++) {
+        __accept_entry_and_flush(f);
+        __accept_entry_and_flush(f);
+        __handle_append_entries_response(f, 3, f->raft.current_term, true,
+                                         i + 1);
+        __tick(f, f->raft.heartbeat_timeout);
+        raft_io_stub_flush(&f->io);
+    }
+
+    __assert_catch_up(f, 3, 9);
+
+    __accept_entry_and_flush(f);
+    __tick(f, f->raft.heartbeat_timeout);
+    __assert_catch_up(f, 0, 0);
 
     return MUNIT_OK;
 }
 
-/* Promoting a server whose log is not up-to-date results in catch-up rounds to
- * start. Once a round takes less than election_timeout, a request to append the
- * new configuration is made and eventually committed . */
+/* Promoting a server whose log is not up-to-date results in entries being
+ * streamed to it. Once it has caught up, a request to append the new
+ * configuration is made and eventually committed. */
 static MunitResult test_promote_committed(const MunitParameter params[],
                                           void *data)
 {
@@ -685,33 +1012,31 @@ static MunitResult test_promote_committed(const MunitParameter params[],
     __promote(f, 3);
     __assert_io(f, 0, 1);
 
-    /* Now that the catch-up round started, submit a new entry. */
+    /* Now that the catch-up started, submit a new entry. */
     __accept_entry(f);
     __assert_io(f, 1, 2);
 
-    /* Let more than election_timeout milliseconds elapse. */
+    /* Let more than election_timeout milliseconds elapse. Since server 3 did
+     * not acknowledge anything, the entries in flight get sent again along
+     * with the heartbeat. */
     __tick(f, f->raft.election_timeout + 100);
-    __assert_io(f, 0, 2); /* Heartbeat */
+    __assert_io(f, 0, 2);
 
     /* Simulate the server being promoted sending an AppendEntries result,
-     * acknowledging all entries except the last one. */
+     * acknowledging all entries except the last one. Its replication rate is
+     * not faster than our append rate, so it's not considered caught up. */
     __handle_append_entries_response(f, 3, f->raft.current_term, true, 1);
+    __assert_catch_up(f, 3, 1);
 
-    /* The first round has completed and a new one has started. */
-    __assert_catch_up_round(f, 3, 2, 0);
-
-    /* Make a new client request, so even when this second round that just
-     * started completes, the server being promoted will still be missing
-     * entries. */
+    /* Make a new client request, which gets streamed to server 3 as well. */
     __accept_entry(f);
     __assert_io(f, 1, 2);
 
-    /* Simulate the server being promoted completing the second round within the
-     * election timeout. */
+    /* Simulate the server being promoted acknowledging all entries. */
     __handle_append_entries_response(f, 3, f->raft.current_term, true, 3);
 
-    /* No round is pending, but the promotion is still in progress. */
-    __assert_catch_up_round(f, 0, 0, 0);
+    /* The server has caught up, but the promotion is still in progress. */
+    __assert_catch_up(f, 0, 0);
     __assert_configuration_indexes(f, 1, 4);
 
     /* Notify the leader that the AppendEntries RPC for changing the
@@ -720,7 +1045,7 @@ static MunitResult test_promote_committed(const MunitParameter params[],
     __handle_append_entries_response(f, 2, f->raft.current_term, true, 4);
 
     /* The promotion has been completed. */
-    __assert_catch_up_round(f, 0, 0, 0);
+    __assert_catch_up(f, 0, 0);
     __assert_configuration_indexes(f, 4, 0);
 
     entry = raft_log__get(&f->raft.log, 4);
@@ -751,7 +1076,7 @@ static MunitResult test_promote_step_down(const MunitParameter params[],
      * configuration change request is submitted immediately. */
     __promote(f, 3);
 
-    __assert_catch_up_round(f, 0, 0, 0);
+    __assert_catch_up(f, 0, 0);
     __assert_configuration_indexes(f, 1, 2);
 
     server = raft_configuration__get(&f->raft.configuration, 3);
@@ -812,6 +1137,7 @@ static MunitResult test_promote_follower(const MunitParameter params[],
     munit_assert_int(rv, ==, 0);
 
     configuration.servers[2].voting = true;
+    raft_configuration__update_voting(&configuration);
 
     rv = raft_configuration_encode(&configuration, &buf);
     munit_assert_int(rv, ==, 0);
@@ -852,7 +1178,10 @@ static MunitTest promote_tests[] = {
     {"/in-progress", test_promote_in_progress, setup, tear_down, 0, NULL},
     {"/up-to-date", test_promote_up_to_date, setup, tear_down, 0, NULL},
     {"/catch-up", test_promote_catch_up, setup, tear_down, 0, NULL},
-    {"/new-round", test_promote_new_round, setup, tear_down, 0, NULL},
+    {"/pipeline", test_promote_pipeline, setup, tear_down, 0, NULL},
+    {"/projected", test_promote_projected, setup, tear_down, 0, NULL},
+    {"/unresponsive", test_promote_unresponsive, setup, tear_down, 0, NULL},
+    {"/too-slow", test_promote_too_slow, setup, tear_down, 0, NULL},
     {"/committed", test_promote_committed, setup, tear_down, 0, NULL},
     {"/step-down", test_promote_step_down, setup, tear_down, 0, NULL},
     {"/follower", test_promote_follower, setup, tear_down, 0, NULL},
@@ -1032,14 +1361,473 @@ static MunitTest remove_server_tests[] = {
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
+/**
+ * raft_transfer_leadership
+ */
+
+/**
+ * Assert that a TimeoutNow RPC was sent to the given server.
+ */
+#define __assert_timeout_now(F, ID, SENT)                       \
+    {                                                           \
+        struct raft_message *messages;                          \
+        unsigned n;                                             \
+        unsigned i;                                             \
+        bool sent = false;                                      \
+                                                                \
+        raft_io_stub_flush(&F->io);                             \
+        raft_io_stub_sent(&F->io, &messages, &n);               \
+        for (i = 0; i < n; i++) {                               \
+            if (messages[i].type == RAFT_IO_TIMEOUT_NOW) {      \
+                munit_assert_int(messages[i].server_id, ==, ID); \
+                sent = true;                                    \
+            }                                                   \
+        }                                                       \
+        munit_assert_int(sent, ==, SENT);                       \
+    }
+
+/* If the raft instance is not in leader state, an error is returned. */
+static MunitResult test_transfer_not_leader(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    rv = raft_transfer_leadership(&f->raft, 2);
+    munit_assert_int(rv, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+/* The target must be a voting server other than ourselves. */
+static MunitResult test_transfer_bad_id(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 2);
+    test_become_leader(&f->raft);
+
+    rv = raft_transfer_leadership(&f->raft, 1);
+    munit_assert_int(rv, ==, RAFT_ERR_BAD_SERVER_ID);
+
+    rv = raft_transfer_leadership(&f->raft, 3);
+    munit_assert_int(rv, ==, RAFT_ERR_BAD_SERVER_ID);
+
+    rv = raft_transfer_leadership(&f->raft, 4);
+    munit_assert_int(rv, ==, RAFT_ERR_BAD_SERVER_ID);
+
+    return MUNIT_OK;
+}
+
+/* If the target is up-to-date, TimeoutNow is sent right away, and new entries
+ * are rejected. */
+static MunitResult test_transfer_up_to_date(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    struct raft_buffer buf;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __handle_append_entries_response(f, 2, f->raft.current_term, true, 1);
+
+    rv = raft_transfer_leadership(&f->raft, 2);
+    munit_assert_int(rv, ==, 0);
+
+    __assert_timeout_now(f, 2, true);
+
+    test_fsm_encode_set_x(123, &buf);
+    rv = raft_accept(&f->raft, &buf, 1);
+    munit_assert_int(rv, ==, RAFT_ERR_LEADERSHIP_TRANSFER);
+    raft_free(buf.base);
+
+    rv = raft_transfer_leadership(&f->raft, 3);
+    munit_assert_int(rv, ==, RAFT_ERR_LEADERSHIP_TRANSFER);
+
+    return MUNIT_OK;
+}
+
+/* If the target is behind, TimeoutNow is sent once it catches up. */
+static MunitResult test_transfer_catch_up(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __accept_entry(f);
+    __assert_io(f, 1, 2);
+
+    rv = raft_transfer_leadership(&f->raft, 2);
+    munit_assert_int(rv, ==, 0);
+
+    __assert_timeout_now(f, 2, false);
+
+    __handle_append_entries_response(f, 2, f->raft.current_term, true, 2);
+
+    __assert_timeout_now(f, 2, true);
+
+    return MUNIT_OK;
+}
+
+/* If the transfer doesn't complete within an election timeout, it's aborted
+ * and new entries are accepted again. */
+static MunitResult test_transfer_timeout(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __handle_append_entries_response(f, 2, f->raft.current_term, true, 1);
+
+    rv = raft_transfer_leadership(&f->raft, 2);
+    munit_assert_int(rv, ==, 0);
+
+    __assert_timeout_now(f, 2, true);
+
+    __tick(f, f->raft.election_timeout + 1);
+    raft_io_stub_flush(&f->io);
+
+    __assert_state(f, RAFT_STATE_LEADER);
+    munit_assert_int(f->raft.leader_state.transferee_id, ==, 0);
+
+    __accept_entry(f);
+    __assert_io(f, 1, 2);
+
+    return MUNIT_OK;
+}
+
+static MunitTest transfer_tests[] = {
+    {"/not-leader", test_transfer_not_leader, setup, tear_down, 0, NULL},
+    {"/bad-id", test_transfer_bad_id, setup, tear_down, 0, NULL},
+    {"/up-to-date", test_transfer_up_to_date, setup, tear_down, 0, NULL},
+    {"/catch-up", test_transfer_catch_up, setup, tear_down, 0, NULL},
+    {"/timeout", test_transfer_timeout, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_change_configuration
+ */
+
+/**
+ * Submit a request to change the configuration to one with the given voting
+ * servers, and check that it returns no error.
+ */
+#define __change_configuration(F, IDS, N)                         \
+    {                                                             \
+        struct raft_configuration configuration;                  \
+        char address[4];                                          \
+        unsigned i;                                               \
+        int rv;                                                   \
+                                                                  \
+        raft_configuration_init(&configuration);                  \
+        for (i = 0; i < N; i++) {                                 \
+            sprintf(address, "%u", IDS[i]);                       \
+            rv = raft_configuration_add(&configuration, IDS[i],   \
+                                        address, true);           \
+            munit_assert_int(rv, ==, 0);                          \
+        }                                                         \
+                                                                  \
+        rv = raft_change_configuration(&F->raft, &configuration); \
+        munit_assert_int(rv, ==, 0);                              \
+                                                                  \
+        raft_configuration_close(&configuration);                 \
+    }
+
+/**
+ * Assert the voting flags of the server with the given ID in the current
+ * configuration.
+ */
+#define __assert_voting(F, ID, VOTING, VOTING_OLD)                      \
+    {                                                                   \
+        const struct raft_server *server;                               \
+                                                                        \
+        server = raft_configuration__get(&F->raft.configuration, ID);   \
+        munit_assert_ptr_not_null(server);                              \
+        munit_assert_int(server->voting, ==, VOTING);                   \
+        munit_assert_int(server->voting_old, ==, VOTING_OLD);           \
+    }
+
+/* Trying to change the configuration on a server which is not the leader
+ * results in an error. */
+static MunitResult test_change_configuration_not_leader(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration configuration;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "1", true);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_change_configuration(&f->raft, &configuration);
+    munit_assert_int(rv, ==, RAFT_ERR_NOT_LEADER);
+
+    raft_configuration_close(&configuration);
+
+    return MUNIT_OK;
+}
+
+/* A configuration without voting servers is rejected. */
+static MunitResult test_change_configuration_no_voters(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration configuration;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_leader(&f->raft);
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "1", false);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_change_configuration(&f->raft, &configuration);
+    munit_assert_int(rv, ==, RAFT_ERR_EMPTY_CONFIGURATION);
+
+    raft_configuration_close(&configuration);
+
+    return MUNIT_OK;
+}
+
+/* Replacing a voting server goes through a joint configuration, which is
+ * followed by the new one as soon as it gets committed. */
+static MunitResult test_change_configuration_joint(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    unsigned ids[] = {1, 2, 4};
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __change_configuration(f, ids, 3);
+
+    /* The joint configuration is effective and uncommitted. */
+    munit_assert_int(f->raft.configuration.n, ==, 4);
+    munit_assert_true(raft_configuration__is_joint(&f->raft.configuration));
+    __assert_voting(f, 1, true, true);
+    __assert_voting(f, 2, true, true);
+    __assert_voting(f, 3, false, true);
+    __assert_voting(f, 4, true, false);
+    __assert_configuration_indexes(f, 1, 2);
+
+    __assert_io(f, 1, 3);
+
+    /* Another change can't be submitted in the meantime. */
+    munit_assert_int(raft_add_server(&f->raft, 5, "5"), ==,
+                     RAFT_ERR_CONFIGURATION_BUSY);
+
+    /* Server 2 votes both in C_old and C_new, so a majority of both is
+     * reached and the leader appends C_new. */
+    __handle_append_entries_response(f, 2, 2, true, 2);
+
+    munit_assert_int(f->raft.configuration.n, ==, 3);
+    munit_assert_false(raft_configuration__is_joint(&f->raft.configuration));
+    munit_assert_ptr_null(raft_configuration__get(&f->raft.configuration, 3));
+    __assert_voting(f, 4, true, false);
+    __assert_configuration_indexes(f, 2, 3);
+
+    __assert_io(f, 1, 2);
+
+    __handle_append_entries_response(f, 4, 2, true, 3);
+
+    __assert_configuration_indexes(f, 3, 0);
+
+    return MUNIT_OK;
+}
+
+/* While the joint configuration is in effect, entries are committed only when
+ * a majority of both the old and the new voting servers replicated them. */
+static MunitResult test_change_configuration_dual_majority(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    unsigned ids[] = {1, 4, 5};
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __change_configuration(f, ids, 3);
+
+    munit_assert_int(f->raft.configuration.n, ==, 5);
+
+    __assert_io(f, 1, 4);
+
+    /* A majority of C_new alone is not enough. */
+    __handle_append_entries_response(f, 4, 2, true, 2);
+    __assert_configuration_indexes(f, 1, 2);
+
+    /* Neither is a majority of C_old alone. */
+    __handle_append_entries_response(f, 2, 2, true, 2);
+    munit_assert_int(f->raft.commit_index, ==, 2);
+    __assert_configuration_indexes(f, 2, 3);
+
+    /* Servers 2 and 3 are gone, once C_new is in effect. */
+    munit_assert_int(f->raft.configuration.n, ==, 3);
+    munit_assert_ptr_null(raft_configuration__get(&f->raft.configuration, 2));
+    munit_assert_ptr_null(raft_configuration__get(&f->raft.configuration, 3));
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* If only non-voting servers are added or removed, the new configuration is
+ * used right away, without going through a joint one. */
+static MunitResult test_change_configuration_non_voting(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration configuration;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_leader(&f->raft);
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "1", true);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 2, "2", true);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 3, "3", false);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_change_configuration(&f->raft, &configuration);
+    munit_assert_int(rv, ==, 0);
+
+    raft_configuration_close(&configuration);
+
+    munit_assert_int(f->raft.configuration.n, ==, 3);
+    munit_assert_false(raft_configuration__is_joint(&f->raft.configuration));
+    __assert_voting(f, 3, false, false);
+    __assert_configuration_indexes(f, 1, 2);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* A voting server demoted to non-voting is kept once the joint configuration
+ * is committed, while a voting server absent from C_new is dropped. */
+static MunitResult test_change_configuration_demote(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration configuration;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 4, 1, 4);
+    test_become_leader(&f->raft);
+
+    raft_configuration_init(&configuration);
+    rv = raft_configuration_add(&configuration, 1, "1", true);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 2, "2", true);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&configuration, 3, "3", false);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_change_configuration(&f->raft, &configuration);
+    munit_assert_int(rv, ==, 0);
+
+    raft_configuration_close(&configuration);
+
+    /* Both servers 3 and 4 vote only in C_old, but only 4 is removed. */
+    munit_assert_true(raft_configuration__is_joint(&f->raft.configuration));
+    __assert_voting(f, 3, false, true);
+    __assert_voting(f, 4, false, true);
+    munit_assert_false(
+        raft_configuration__get(&f->raft.configuration, 3)->removed);
+    munit_assert_true(
+        raft_configuration__get(&f->raft.configuration, 4)->removed);
+
+    __assert_io(f, 1, 3);
+
+    __handle_append_entries_response(f, 2, 2, true, 2);
+    __handle_append_entries_response(f, 3, 2, true, 2);
+    __assert_configuration_indexes(f, 2, 3);
+
+    /* Server 3 is still there, as non-voting. */
+    munit_assert_int(f->raft.configuration.n, ==, 3);
+    munit_assert_false(raft_configuration__is_joint(&f->raft.configuration));
+    __assert_voting(f, 3, false, false);
+    munit_assert_ptr_null(raft_configuration__get(&f->raft.configuration, 4));
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+static MunitTest change_configuration_tests[] = {
+    {"/not-leader", test_change_configuration_not_leader, setup, tear_down, 0,
+     NULL},
+    {"/no-voters", test_change_configuration_no_voters, setup, tear_down, 0,
+     NULL},
+    {"/joint", test_change_configuration_joint, setup, tear_down, 0, NULL},
+    {"/dual-majority", test_change_configuration_dual_majority, setup,
+     tear_down, 0, NULL},
+    {"/non-voting", test_change_configuration_non_voting, setup, tear_down, 0,
+     NULL},
+    {"/demote", test_change_configuration_demote, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
 /**
  * Test suite
  */
 
 MunitSuite raft_client_suites[] = {
     {"/accept", accept_tests, NULL, 1, 0},
+    {"/apply", apply_tests, NULL, 1, 0},
     {"/add-server", add_server_tests, NULL, 1, 0},
     {"/promote", promote_tests, NULL, 1, 0},
     {"/remove-server", remove_server_tests, NULL, 1, 0},
+    {"/transfer-leadership", transfer_tests, NULL, 1, 0},
+    {"/change-configuration", change_configuration_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
@@ -1,3 +1,5 @@
+#include <stdio.h>
+
 #include "../../src/binary.h"
 #include "../../src/configuration.h"
 
@@ -132,9 +134,49 @@ static MunitResult test_index_no_match(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* Lookups keep working as servers are added and removed, including IDs that
+ * hash to the same slot. */
+static MunitResult test_index_many(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    char address[16];
+    unsigned id;
+    size_t i;
+
+    (void)params;
+
+    for (id = 1; id <= 64; id++) {
+        sprintf(address, "%u", id);
+        __add(f, id * 1024, address, id % 2 == 0);
+    }
+
+    /* Remove every third server. */
+    for (id = 3; id <= 64; id += 3) {
+        __remove(f, id * 1024);
+    }
+
+    munit_assert_int(f->configuration.n, ==, 64 - 21);
+
+    for (id = 1; id <= 64; id++) {
+        i = raft_configuration__index(&f->configuration, id * 1024);
+        if (id % 3 == 0) {
+            munit_assert_int(i, ==, f->configuration.n);
+            continue;
+        }
+        munit_assert_int(i, <, f->configuration.n);
+        munit_assert_int(f->configuration.servers[i].id, ==, id * 1024);
+    }
+
+    i = raft_configuration__index(&f->configuration, 1);
+    munit_assert_int(i, ==, f->configuration.n);
+
+    return MUNIT_OK;
+}
+
 static MunitTest index_tests[] = {
     {"/match", test_index_match, setup, tear_down, 0, NULL},
     {"/no-match", test_index_no_match, setup, tear_down, 0, NULL},
+    {"/many", test_index_many, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -222,10 +264,42 @@ static MunitResult test_voting_index_non_voting(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* The index of a voting server is updated when servers before it are removed
+ * or their voting flags change. */
+static MunitResult test_voting_index_update(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    size_t i;
+
+    (void)params;
+
+    __add(f, 1, "192.168.1.1:666", true);
+    __add(f, 2, "192.168.1.2:666", true);
+    __add(f, 3, "192.168.1.3:666", true);
+
+    __remove(f, 1);
+
+    i = raft_configuration__voting_index(&f->configuration, 3);
+    munit_assert_int(i, ==, 1);
+
+    f->configuration.servers[0].voting = false;
+    raft_configuration__update_voting(&f->configuration);
+
+    i = raft_configuration__voting_index(&f->configuration, 3);
+    munit_assert_int(i, ==, 0);
+
+    i = raft_configuration__voting_index(&f->configuration, 2);
+    munit_assert_int(i, ==, f->configuration.n);
+
+    return MUNIT_OK;
+}
+
 static MunitTest voting_index_tests[] = {
     {"/match", test_voting_index_match, setup, tear_down, 0, NULL},
     {"/no-match", test_voting_index_no_match, setup, tear_down, 0, NULL},
     {"/non-voting", test_voting_index_non_voting, setup, tear_down, 0, NULL},
+    {"/update", test_voting_index_update, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -273,8 +347,35 @@ static MunitResult test_n_voting_filter(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* Servers voting only in C_old are counted too, once the flags are
+ * updated. */
+static MunitResult test_n_voting_old(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    size_t n;
+
+    (void)params;
+
+    __add(f, 1, "192.168.1.1:666", true);
+    __add(f, 2, "192.168.1.2:666", false);
+
+    f->configuration.servers[1].voting_old = true;
+    raft_configuration__update_voting(&f->configuration);
+
+    n = raft_configuration__n_voting(&f->configuration);
+    munit_assert_int(n, ==, 2);
+
+    __remove(f, 1);
+
+    n = raft_configuration__n_voting(&f->configuration);
+    munit_assert_int(n, ==, 1);
+
+    return MUNIT_OK;
+}
+
 static MunitTest n_voting_tests[] = {
     {"/filter", test_n_voting_filter, setup, tear_down, 0, NULL},
+    {"/old", test_n_voting_old, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -336,6 +437,136 @@ static MunitTest copy_tests[] = {
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
+/**
+ * raft_configuration__joint
+ */
+
+/* Replace a voting server and drop a non-voting one. */
+static MunitResult test_joint_replace(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration c_new;
+    struct raft_configuration joint;
+    struct raft_configuration final;
+    int rv;
+
+    (void)params;
+
+    __add(f, 1, "1", true);
+    __add(f, 2, "2", true);
+    __add(f, 3, "3", false);
+
+    raft_configuration_init(&c_new);
+    rv = raft_configuration_add(&c_new, 1, "1", true);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_configuration_add(&c_new, 4, "4", true);
+    munit_assert_int(rv, ==, 0);
+
+    raft_configuration_init(&joint);
+    rv = raft_configuration__joint(&f->configuration, &c_new, &joint);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_true(raft_configuration__is_joint(&joint));
+    munit_assert_int(joint.n, ==, 3);
+    munit_assert_int(raft_configuration__n_voting(&joint), ==, 3);
+
+    munit_assert_int(joint.servers[0].id, ==, 1);
+    munit_assert_true(joint.servers[0].voting);
+    munit_assert_true(joint.servers[0].voting_old);
+
+    munit_assert_int(joint.servers[1].id, ==, 4);
+    munit_assert_true(joint.servers[1].voting);
+    munit_assert_false(joint.servers[1].voting_old);
+
+    munit_assert_int(joint.servers[2].id, ==, 2);
+    munit_assert_false(joint.servers[2].voting);
+    munit_assert_true(joint.servers[2].voting_old);
+    munit_assert_true(joint.servers[2].removed);
+
+    munit_assert_false(joint.servers[0].removed);
+    munit_assert_false(joint.servers[1].removed);
+
+    /* Leaving the joint configuration yields C_new. */
+    raft_configuration_init(&final);
+    rv = raft_configuration__leave_joint(&joint, &final);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_false(raft_configuration__is_joint(&final));
+    munit_assert_int(final.n, ==, 2);
+    munit_assert_int(final.servers[0].id, ==, 1);
+    munit_assert_int(final.servers[1].id, ==, 4);
+
+    raft_configuration_close(&final);
+    raft_configuration_close(&joint);
+    raft_configuration_close(&c_new);
+
+    return MUNIT_OK;
+}
+
+static MunitTest joint_tests[] = {
+    {"/replace", test_joint_replace, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_configuration__is_majority
+ */
+
+/* A regular configuration needs a simple majority of voting servers. */
+static MunitResult test_is_majority_regular(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    __add(f, 1, "1", true);
+    __add(f, 2, "2", true);
+    __add(f, 3, "3", true);
+    __add(f, 4, "4", false);
+
+    munit_assert_false(
+        raft_configuration__is_majority(&f->configuration, 1, 0));
+    munit_assert_true(
+        raft_configuration__is_majority(&f->configuration, 2, 0));
+
+    return MUNIT_OK;
+}
+
+/* A joint configuration needs a majority of both C_old and C_new. */
+static MunitResult test_is_majority_joint(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    __add(f, 1, "1", true);
+    __add(f, 2, "2", true);
+    __add(f, 3, "3", false);
+    __add(f, 4, "4", false);
+
+    f->configuration.servers[2].voting_old = true;
+    f->configuration.servers[3].voting_old = true;
+    raft_configuration__update_voting(&f->configuration);
+
+    munit_assert_false(
+        raft_configuration__is_majority(&f->configuration, 2, 1));
+    munit_assert_false(
+        raft_configuration__is_majority(&f->configuration, 1, 2));
+    munit_assert_true(
+        raft_configuration__is_majority(&f->configuration, 2, 2));
+
+    return MUNIT_OK;
+}
+
+static MunitTest is_majority_tests[] = {
+    {"/regular", test_is_majority_regular, setup, tear_down, 0, NULL},
+    {"/joint", test_is_majority_joint, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
 /**
  * raft_configuration_add
  */
@@ -672,11 +903,98 @@ static MunitResult test_encode_two_servers(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* Encode a joint configuration, which uses a new format version with the C_old
+ * voting flag. */
+static MunitResult test_encode_joint(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration configuration;
+    struct raft_buffer buf;
+    uint8_t *bytes;
+    int rv;
+
+    (void)params;
+
+    __add(f, 1, "1", true);
+    __add(f, 2, "2", false);
+
+    f->configuration.servers[1].voting_old = true;
+    f->configuration.servers[1].removed = true;
+    raft_configuration__update_voting(&f->configuration);
+
+    rv = raft_configuration_encode(&f->configuration, &buf);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(buf.len, ==,
+                     1 + 8 + /* Version and n of servers */
+                         (8 + strlen("1") + 1 + 1 + 1) * 2); /* Servers */
+
+    bytes = buf.base;
+
+    munit_assert_int(bytes[0], ==, 2);
+
+    raft_configuration_init(&configuration);
+
+    rv = raft_configuration_decode(&buf, &configuration);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(configuration.n, ==, 2);
+    munit_assert_true(configuration.servers[0].voting);
+    munit_assert_false(configuration.servers[0].voting_old);
+    munit_assert_false(configuration.servers[1].voting);
+    munit_assert_true(configuration.servers[1].voting_old);
+    munit_assert_false(configuration.servers[0].removed);
+    munit_assert_true(configuration.servers[1].removed);
+
+    raft_configuration_close(&configuration);
+    raft_free(buf.base);
+
+    return MUNIT_OK;
+}
+
+/* Learners also need the format with flags. */
+static MunitResult test_encode_learner(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration configuration;
+    struct raft_buffer buf;
+    int rv;
+
+    (void)params;
+
+    __add(f, 1, "1", true);
+    __add(f, 2, "2", false);
+
+    f->configuration.servers[1].learner = true;
+
+    rv = raft_configuration_encode(&f->configuration, &buf);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(((uint8_t *)buf.base)[0], ==, 2);
+
+    raft_configuration_init(&configuration);
+
+    rv = raft_configuration_decode(&buf, &configuration);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_false(configuration.servers[0].learner);
+    munit_assert_true(configuration.servers[1].learner);
+    munit_assert_false(configuration.servers[1].voting_old);
+
+    raft_configuration_close(&configuration);
+    raft_free(buf.base);
+
+    return MUNIT_OK;
+}
+
 static MunitTest encode_tests[] = {
     {"/oom", test_encode_oom, setup, tear_down, 0, NULL},
     {"/empty", test_encode_empty, setup, tear_down, 0, NULL},
     {"/one", test_encode_one_server, setup, tear_down, 0, NULL},
     {"/two", test_encode_two_servers, setup, tear_down, 0, NULL},
+    {"/joint", test_encode_joint, setup, tear_down, 0, NULL},
+    {"/learner", test_encode_learner, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -860,6 +1178,8 @@ MunitSuite raft_configuration_suites[] = {
     {"/get", get_tests, NULL, 1, 0},
     {"/n_voting", n_voting_tests, NULL, 1, 0},
     {"/copy", copy_tests, NULL, 1, 0},
+    {"/joint", joint_tests, NULL, 1, 0},
+    {"/is-majority", is_majority_tests, NULL, 1, 0},
     {"/add", add_tests, NULL, 1, 0},
     {"/remove", remove_tests, NULL, 1, 0},
     {"/encode", encode_tests, NULL, 1, 0},
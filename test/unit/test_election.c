@@ -77,8 +77,39 @@ static MunitResult test_reset_timer_range(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* Always return the same large random value. */
+static int __rand_max()
+{
+    return 999;
+}
+
+/* A higher priority shrinks the random part of the timeout. */
+static MunitResult test_reset_timer_priority(const MunitParameter params[],
+                                             void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    raft_set_rand(&f->raft, __rand_max);
+
+    raft_election__reset_timer(&f->raft);
+    munit_assert_int(f->raft.election_timeout_rand, ==, 1999);
+
+    raft_set_election_priority(&f->raft, 1);
+    munit_assert_int(f->raft.election_timeout_rand, ==, 1499);
+
+    raft_set_election_priority(&f->raft, 9);
+    munit_assert_int(f->raft.election_timeout_rand, ==, 1099);
+
+    return MUNIT_OK;
+}
+
 static MunitTest reset_timer_tests[] = {
     {"/range", test_reset_timer_range, setup, tear_down, 0, NULL},
+    {"/priority", test_reset_timer_priority, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -251,6 +282,164 @@ static MunitTest vote_tests[] = {
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
+/**
+ * raft_election__tally
+ */
+
+/* In a joint configuration a candidate needs the votes of a majority of both
+ * C_old and C_new. */
+static MunitResult test_tally_joint(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_configuration *configuration = &f->raft.configuration;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    /* Turn the configuration into a joint one replacing server 3 with 4. */
+    rv = raft_configuration_add(configuration, 4, "4", true);
+    munit_assert_int(rv, ==, 0);
+    configuration->servers[0].voting_old = true;
+    configuration->servers[1].voting_old = true;
+    configuration->servers[2].voting_old = true;
+    configuration->servers[2].voting = false;
+    raft_configuration__update_voting(configuration);
+
+    test_become_candidate(&f->raft);
+
+    /* Our vote plus the one of server 3 form a majority of C_old only. */
+    munit_assert_false(raft_election__tally(&f->raft, 2));
+
+    /* With the vote of server 4 there's a majority of C_new as well. */
+    munit_assert_true(raft_election__tally(&f->raft, 3));
+
+    return MUNIT_OK;
+}
+
+static MunitTest tally_tests[] = {
+    {"/joint", test_tally_joint, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_election__observe_heartbeat
+ */
+
+/* The election timeout converges towards the observed heartbeat interval. */
+static MunitResult test_observe_heartbeat_adapt(const MunitParameter params[],
+                                                void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    raft_set_adaptive_election_timeout(&f->raft, true, 150);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    raft_set_rand(&f->raft, __rand_max);
+
+    /* The first sample initializes the smoothed interval and deviation. */
+    f->raft.timer = 100;
+    raft_election__observe_heartbeat(&f->raft);
+
+    munit_assert_int(f->raft.heartbeat_interval, ==, 100);
+    munit_assert_int(f->raft.heartbeat_jitter, ==, 50);
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 400);
+    munit_assert_int(f->raft.election_timeout_rand, ==, 599);
+    munit_assert_int(f->raft.timer, ==, 0);
+
+    /* A steady interval lowers the deviation. */
+    f->raft.timer = 100;
+    raft_election__observe_heartbeat(&f->raft);
+
+    munit_assert_int(f->raft.heartbeat_interval, ==, 100);
+    munit_assert_int(f->raft.heartbeat_jitter, ==, 37);
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 348);
+
+    return MUNIT_OK;
+}
+
+/* The adapted timeout stays within the configured bounds. */
+static MunitResult test_observe_heartbeat_clamp(const MunitParameter params[],
+                                                void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    raft_set_adaptive_election_timeout(&f->raft, true, 500);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    f->raft.timer = 100;
+    raft_election__observe_heartbeat(&f->raft);
+
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 500);
+
+    f->raft.timer = 5000;
+    raft_election__observe_heartbeat(&f->raft);
+
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 1000);
+
+    return MUNIT_OK;
+}
+
+/* Nothing happens if adaptive election timeouts are disabled. */
+static MunitResult test_observe_heartbeat_disabled(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    f->raft.timer = 100;
+    raft_election__observe_heartbeat(&f->raft);
+
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 0);
+    munit_assert_int(f->raft.timer, ==, 100);
+
+    return MUNIT_OK;
+}
+
+/* Heartbeats from the current leader feed the adaptive timeout. */
+static MunitResult test_observe_heartbeat_append_entries(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    raft_set_adaptive_election_timeout(&f->raft, true, 150);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    /* The first heartbeat from a new leader is not a sample. */
+    test_receive_heartbeat(&f->raft, 2);
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 0);
+
+    f->raft.timer = 100;
+    test_receive_heartbeat(&f->raft, 2);
+    munit_assert_int(f->raft.election_timeout_adaptive, ==, 400);
+
+    return MUNIT_OK;
+}
+
+static MunitTest observe_heartbeat_tests[] = {
+    {"/adapt", test_observe_heartbeat_adapt, setup, tear_down, 0, NULL},
+    {"/clamp", test_observe_heartbeat_clamp, setup, tear_down, 0, NULL},
+    {"/disabled", test_observe_heartbeat_disabled, setup, tear_down, 0, NULL},
+    {"/append-entries", test_observe_heartbeat_append_entries, setup,
+     tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
 /**
  * Suite
  */
@@ -258,5 +447,7 @@ MunitSuite raft_election_suites[] = {
     {"/reset-timer", reset_timer_tests, NULL, 1, 0},
     {"/start", start_tests, NULL, 1, 0},
     {"/vote", vote_tests, NULL, 1, 0},
+    {"/tally", tally_tests, NULL, 1, 0},
+    {"/observe-heartbeat", observe_heartbeat_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
@@ -0,0 +1,423 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../../include/raft.h"
+
+#include "../lib/heap.h"
+#include "../lib/munit.h"
+
+/**
+ * Helpers
+ */
+
+struct fixture
+{
+    struct raft_heap heap;
+    struct raft_heap slab;
+};
+
+static void *setup(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    int rv;
+
+    (void)user_data;
+
+    test_heap_setup(params, &f->heap);
+
+    rv = raft_heap_slab_init(&f->slab, &f->heap, 0);
+    munit_assert_int(rv, ==, 0);
+
+    return f;
+}
+
+static void tear_down(void *data)
+{
+    struct fixture *f = data;
+
+    raft_heap_slab_close(&f->slab);
+
+    test_heap_tear_down(&f->heap);
+
+    free(f);
+}
+
+/**
+ * Allocate a block of the given size using the fixture's slab heap.
+ */
+#define __malloc(F, SIZE) F->slab.malloc(F->slab.data, SIZE)
+
+/**
+ * Release a block using the fixture's slab heap.
+ */
+#define __free(F, PTR) F->slab.free(F->slab.data, PTR)
+
+/**
+ * Assert the statistics of the given size class.
+ */
+#define __assert_class(F, CLS, N_ALLOC, N_FREE, N_HITS, N_CACHED)   \
+    {                                                               \
+        struct raft_heap_slab_stats stats;                          \
+                                                                    \
+        raft_heap_slab_stats(&F->slab, &stats);                     \
+                                                                    \
+        munit_assert_int(stats.classes[CLS].n_alloc, ==, N_ALLOC);  \
+        munit_assert_int(stats.classes[CLS].n_free, ==, N_FREE);    \
+        munit_assert_int(stats.classes[CLS].n_hits, ==, N_HITS);    \
+        munit_assert_int(stats.classes[CLS].n_cached, ==, N_CACHED); \
+    }
+
+/**
+ * Assert the number of large allocations and of backend allocations.
+ */
+#define __assert_backend(F, N_LARGE, N_BACKEND)        \
+    {                                                  \
+        struct raft_heap_slab_stats stats;             \
+                                                       \
+        raft_heap_slab_stats(&F->slab, &stats);        \
+                                                       \
+        munit_assert_int(stats.n_large, ==, N_LARGE);  \
+        munit_assert_int(stats.n_backend, ==, N_BACKEND); \
+    }
+
+/**
+ * raft_heap_slab_init
+ */
+
+/* Out of memory when allocating the slab state. */
+static MunitResult test_init_oom(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_heap slab;
+    int rv;
+
+    (void)params;
+
+    test_heap_fault_config(&f->heap, 0, 1);
+    test_heap_fault_enable(&f->heap);
+
+    rv = raft_heap_slab_init(&slab, &f->heap, 0);
+    munit_assert_int(rv, ==, RAFT_ERR_NOMEM);
+
+    return MUNIT_OK;
+}
+
+static MunitTest init_tests[] = {
+    {"/oom", test_init_oom, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_heap_slab__malloc
+ */
+
+/* A released block is reused by the next allocation of the same class. */
+static MunitResult test_malloc_reuse(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    void *ptr1;
+    void *ptr2;
+
+    (void)params;
+
+    ptr1 = __malloc(f, 100);
+    munit_assert_ptr_not_null(ptr1);
+
+    __assert_class(f, 3, 1, 0, 0, 0);
+
+    __free(f, ptr1);
+
+    __assert_class(f, 3, 1, 1, 0, 1);
+
+    /* A request for a different size in the same class hits the cache. */
+    ptr2 = __malloc(f, 128);
+    munit_assert_ptr_equal(ptr1, ptr2);
+
+    __assert_class(f, 3, 2, 1, 1, 0);
+    __assert_backend(f, 0, 1);
+
+    __free(f, ptr2);
+
+    return MUNIT_OK;
+}
+
+/* Requests are rounded up to the closest power of two. */
+static MunitResult test_malloc_classes(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    void *ptr;
+    size_t sizes[] = {0, 1, 16, 17, 32, 33, 1024 * 1024};
+    unsigned classes[] = {0, 0, 0, 1, 1, 2, 16};
+    unsigned i;
+
+    (void)params;
+
+    for (i = 0; i < sizeof sizes / sizeof *sizes; i++) {
+        struct raft_heap_slab_stats stats;
+
+        ptr = __malloc(f, sizes[i]);
+        munit_assert_ptr_not_null(ptr);
+
+        /* The whole class size is usable. */
+        memset(ptr, 0xff, 16 << classes[i]);
+
+        raft_heap_slab_stats(&f->slab, &stats);
+        munit_assert_int(stats.classes[classes[i]].n_alloc, >, 0);
+
+        __free(f, ptr);
+    }
+
+    __assert_backend(f, 0, 4);
+
+    return MUNIT_OK;
+}
+
+/* Requests above the largest class go straight to the backend. */
+static MunitResult test_malloc_large(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    void *ptr;
+
+    (void)params;
+
+    ptr = __malloc(f, 1024 * 1024 + 1);
+    munit_assert_ptr_not_null(ptr);
+
+    __free(f, ptr);
+
+    ptr = __malloc(f, 1024 * 1024 + 1);
+    munit_assert_ptr_not_null(ptr);
+
+    __free(f, ptr);
+
+    __assert_backend(f, 2, 2);
+
+    return MUNIT_OK;
+}
+
+/* The backend fails to allocate a new block. */
+static MunitResult test_malloc_oom(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    void *ptr;
+
+    (void)params;
+
+    test_heap_fault_config(&f->heap, 0, 1);
+    test_heap_fault_enable(&f->heap);
+
+    ptr = __malloc(f, 64);
+    munit_assert_ptr_null(ptr);
+
+    __assert_class(f, 2, 0, 0, 0, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitTest malloc_tests[] = {
+    {"/reuse", test_malloc_reuse, setup, tear_down, 0, NULL},
+    {"/classes", test_malloc_classes, setup, tear_down, 0, NULL},
+    {"/large", test_malloc_large, setup, tear_down, 0, NULL},
+    {"/oom", test_malloc_oom, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_heap_slab__free
+ */
+
+/* Blocks exceeding the cache limit of their class are released. */
+static MunitResult test_free_max_cached(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+    struct raft_heap slab;
+    void *ptrs[3];
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    /* Cache at most two blocks of the smallest class. */
+    rv = raft_heap_slab_init(&slab, &f->heap, 32);
+    munit_assert_int(rv, ==, 0);
+
+    for (i = 0; i < 3; i++) {
+        ptrs[i] = slab.malloc(slab.data, 8);
+        munit_assert_ptr_not_null(ptrs[i]);
+    }
+
+    for (i = 0; i < 3; i++) {
+        slab.free(slab.data, ptrs[i]);
+    }
+
+    {
+        struct raft_heap_slab_stats stats;
+
+        raft_heap_slab_stats(&slab, &stats);
+
+        munit_assert_int(stats.classes[0].n_free, ==, 3);
+        munit_assert_int(stats.classes[0].n_cached, ==, 2);
+    }
+
+    raft_heap_slab_close(&slab);
+
+    return MUNIT_OK;
+}
+
+/* Releasing NULL is a no-op. */
+static MunitResult test_free_null(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    __free(f, NULL);
+
+    __assert_class(f, 0, 0, 0, 0, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitTest free_tests[] = {
+    {"/max-cached", test_free_max_cached, setup, tear_down, 0, NULL},
+    {"/null", test_free_null, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_heap_slab__calloc
+ */
+
+/* Recycled blocks are zeroed. */
+static MunitResult test_calloc_zero(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    uint8_t *ptr;
+    unsigned i;
+
+    (void)params;
+
+    ptr = __malloc(f, 64);
+    memset(ptr, 0xff, 64);
+    __free(f, ptr);
+
+    ptr = f->slab.calloc(f->slab.data, 8, 8);
+    munit_assert_ptr_not_null(ptr);
+
+    for (i = 0; i < 64; i++) {
+        munit_assert_int(ptr[i], ==, 0);
+    }
+
+    __free(f, ptr);
+
+    __assert_class(f, 2, 2, 2, 1, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitTest calloc_tests[] = {
+    {"/zero", test_calloc_zero, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_heap_slab__realloc
+ */
+
+/* Shrinking or growing within the same class keeps the block. */
+static MunitResult test_realloc_same_class(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+    void *ptr1;
+    void *ptr2;
+
+    (void)params;
+
+    ptr1 = __malloc(f, 40);
+    ptr2 = f->slab.realloc(f->slab.data, ptr1, 64);
+    munit_assert_ptr_equal(ptr1, ptr2);
+
+    ptr2 = f->slab.realloc(f->slab.data, ptr1, 8);
+    munit_assert_ptr_equal(ptr1, ptr2);
+
+    __free(f, ptr2);
+
+    return MUNIT_OK;
+}
+
+/* Growing beyond the class moves the data to a bigger block. */
+static MunitResult test_realloc_grow(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    char *ptr;
+
+    (void)params;
+
+    ptr = __malloc(f, 16);
+    strcpy(ptr, "hello");
+
+    ptr = f->slab.realloc(f->slab.data, ptr, 1000);
+    munit_assert_ptr_not_null(ptr);
+    munit_assert_string_equal(ptr, "hello");
+
+    __assert_class(f, 0, 1, 1, 0, 1);
+    __assert_class(f, 6, 1, 0, 0, 0);
+
+    __free(f, ptr);
+
+    return MUNIT_OK;
+}
+
+static MunitTest realloc_tests[] = {
+    {"/same-class", test_realloc_same_class, setup, tear_down, 0, NULL},
+    {"/grow", test_realloc_grow, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_heap_slab__aligned_alloc
+ */
+
+/* The returned block honors the requested alignment. */
+static MunitResult test_aligned_alloc_align(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    void *ptr;
+
+    (void)params;
+
+    ptr = f->slab.aligned_alloc(f->slab.data, 4096, 4096);
+    munit_assert_ptr_not_null(ptr);
+    munit_assert_int((uintptr_t)ptr % 4096, ==, 0);
+
+    memset(ptr, 0, 4096);
+
+    __free(f, ptr);
+
+    __assert_backend(f, 1, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitTest aligned_alloc_tests[] = {
+    {"/align", test_aligned_alloc_align, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Test suite
+ */
+
+MunitSuite raft_heap_slab_suites[] = {
+    {"/init", init_tests, NULL, 1, 0},
+    {"/malloc", malloc_tests, NULL, 1, 0},
+    {"/free", free_tests, NULL, 1, 0},
+    {"/calloc", calloc_tests, NULL, 1, 0},
+    {"/realloc", realloc_tests, NULL, 1, 0},
+    {"/aligned-alloc", aligned_alloc_tests, NULL, 1, 0},
+    {NULL, NULL, NULL, 0, 0},
+};
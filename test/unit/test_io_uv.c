@@ -48,6 +48,12 @@ struct fixture
     {
         bool invoked;
     } stop_cb;
+    struct
+    {
+        bool done;    /* Set by the work function */
+        bool invoked; /* Set by the completion callback */
+        int status;
+    } work;
 };
 
 static void __tick_cb(void *data, const unsigned elapsed)
@@ -89,6 +95,21 @@ static void __stop_cb(void *data)
     f->stop_cb.invoked = true;
 }
 
+static void __work(void *data)
+{
+    struct fixture *f = data;
+
+    f->work.done = true;
+}
+
+static void __work_cb(void *data, const int status)
+{
+    struct fixture *f = data;
+
+    f->work.invoked = true;
+    f->work.status = status;
+}
+
 static void *setup(const MunitParameter params[], void *user_data)
 {
     struct fixture *f = munit_malloc(sizeof *f);
@@ -104,7 +125,7 @@ static void *setup(const MunitParameter params[], void *user_data)
 
     f->dir = test_dir_setup(params);
 
-    rv = raft_io_uv_tcp_init(&f->transport, &f->logger, &f->loop);
+    rv = raft_io_uv_tcp_init(&f->transport, &f->logger, &f->loop, NULL);
     munit_assert_int(rv, ==, 0);
 
     rv = raft_io_uv_init(&f->io, &f->logger, &f->loop, f->dir, &f->transport);
@@ -124,6 +145,10 @@ static void *setup(const MunitParameter params[], void *user_data)
 
     f->stop_cb.invoked = false;
 
+    f->work.done = false;
+    f->work.invoked = false;
+    f->work.status = -1;
+
     return f;
 }
 
@@ -251,8 +276,7 @@ static MunitResult test_start_recv(const MunitParameter params[], void *data)
     struct raft_message message;
     uint8_t handshake[sizeof(uint64_t) * 3 /* Preamble */ + 16 /* Address */];
     void *cursor = handshake;
-    uv_buf_t *bufs;
-    unsigned n_bufs;
+    uv_buf_t header;
     int rv;
 
     (void)params;
@@ -271,13 +295,11 @@ static MunitResult test_start_recv(const MunitParameter params[], void *data)
     message.server_id = 1;
     message.server_address = "127.0.0.1:9000";
 
-    rv = raft_io_uv_encode__message(&message, &bufs, &n_bufs);
+    rv = raft_io_uv_encode__header(&message, &header);
     munit_assert_int(rv, ==, 0);
-    munit_assert_int(n_bufs, ==, 1);
 
-    test_tcp_send(&f->tcp, bufs[0].base, bufs[0].len);
-    raft_free(bufs[0].base);
-    raft_free(bufs);
+    test_tcp_send(&f->tcp, header.base, header.len);
+    raft_free(header.base);
 
     /* Run the loop and check that the tick callback was called. */
     test_uv_run(&f->loop, 2);
@@ -510,6 +532,41 @@ static MunitTest send_tests[] = {
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
+/**
+ * raft_io_uv__queue_work
+ */
+
+/* The work function runs in the threadpool and the callback in the loop. */
+static MunitResult test_queue_work_run(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    rv = f->io.queue_work(&f->io, f, __work, __work_cb);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_false(f->work.invoked);
+
+    for (i = 0; i < 10 && !f->work.invoked; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_true(f->work.done);
+    munit_assert_true(f->work.invoked);
+    munit_assert_int(f->work.status, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitTest queue_work_tests[] = {
+    {"/run", test_queue_work_run, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
 /**
  * Test suite
  */
@@ -523,5 +580,6 @@ MunitSuite raft_io_uv_suites[] = {
     {"/set-vote", set_vote_tests, NULL, 1, 0},
     {"/append", append_tests, NULL, 1, 0},
     {"/send", send_tests, NULL, 1, 0},
+    {"/queue-work", queue_work_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
@@ -2,6 +2,7 @@
 #include "../../src/io_uv_encoding.h"
 #include "../../src/io_uv_rpc.h"
 
+#include "../lib/fs.h"
 #include "../lib/heap.h"
 #include "../lib/logger.h"
 #include "../lib/munit.h"
@@ -20,14 +21,18 @@ struct fixture
     struct uv_loop_s loop;
     struct raft_io_uv_transport transport;
     struct raft_io_uv_rpc rpc;
+    char *dir;          /* Only used by the Unix socket fixture */
+    char address[256]; /* Only used by the Unix socket fixture */
     struct
     {
         bool invoked;
+        unsigned n;
         int status;
     } send_cb;
     struct
     {
         bool invoked;
+        unsigned n;
         struct raft_message *message;
     } recv_cb;
     struct
@@ -41,6 +46,7 @@ static void __send_cb(void *data, int status)
     struct fixture *f = data;
 
     f->send_cb.status = status;
+    f->send_cb.n++;
 }
 
 static void __recv_cb(void *data, struct raft_message *message)
@@ -49,6 +55,7 @@ static void __recv_cb(void *data, struct raft_message *message)
 
     f->recv_cb.message = message;
     f->recv_cb.invoked = true;
+    f->recv_cb.n++;
 }
 
 static void __stop_cb(void *data)
@@ -70,7 +77,7 @@ static void *setup(const MunitParameter params[], void *user_data)
     test_tcp_setup(params, &f->tcp);
     test_uv_setup(params, &f->loop);
 
-    rv = raft_io_uv_tcp_init(&f->transport, &f->logger, &f->loop);
+    rv = raft_io_uv_tcp_init(&f->transport, &f->logger, &f->loop, NULL);
     munit_assert_int(rv, ==, 0);
 
     rv = raft_io_uv_rpc__init(&f->rpc, &f->logger, &f->loop, &f->transport);
@@ -80,9 +87,54 @@ static void *setup(const MunitParameter params[], void *user_data)
     munit_assert_int(rv, ==, 0);
 
     f->send_cb.invoked = true;
+    f->send_cb.n = 0;
     f->send_cb.status = -1;
 
     f->recv_cb.invoked = false;
+    f->recv_cb.n = 0;
+    f->recv_cb.message = NULL;
+
+    f->stop_cb.invoked = false;
+
+    f->dir = NULL;
+
+    return f;
+}
+
+/**
+ * Setup a fixture whose RPC endpoint uses the Unix socket transport, listening
+ * on a socket file in a temporary directory.
+ */
+static void *setup_unix(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+    int rv;
+
+    (void)user_data;
+
+    test_heap_setup(params, &f->heap);
+    test_logger_setup(params, &f->logger, 1);
+    test_tcp_setup(params, &f->tcp);
+    test_uv_setup(params, &f->loop);
+
+    f->dir = test_dir_setup(params);
+    sprintf(f->address, "%s/raft.sock", f->dir);
+
+    rv = raft_io_uv_unix_init(&f->transport, &f->logger, &f->loop);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_io_uv_rpc__init(&f->rpc, &f->logger, &f->loop, &f->transport);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_io_uv_rpc__start(&f->rpc, 1, f->address, f, __recv_cb);
+    munit_assert_int(rv, ==, 0);
+
+    f->send_cb.invoked = true;
+    f->send_cb.n = 0;
+    f->send_cb.status = -1;
+
+    f->recv_cb.invoked = false;
+    f->recv_cb.n = 0;
     f->recv_cb.message = NULL;
 
     f->stop_cb.invoked = false;
@@ -114,6 +166,10 @@ static void tear_down(void *data)
     raft_io_uv_rpc__close(&f->rpc);
     raft_io_uv_tcp_close(&f->transport);
 
+    if (f->dir != NULL) {
+        test_dir_tear_down(f->dir);
+    }
+
     test_uv_tear_down(&f->loop);
     test_tcp_tear_down(&f->tcp);
     test_logger_tear_down(&f->logger);
@@ -171,6 +227,61 @@ static void tear_down(void *data)
         free(buf);                                                     \
     }
 
+/**
+ * Encode the given message the same way raft_io_uv_rpc__send does: a buffer
+ * with the preamble and the header and, for AppendEntries messages, a buffer
+ * with the batch header followed by the entries data buffers.
+ */
+static uv_buf_t *__encode(const struct raft_message *message, unsigned *n_bufs)
+{
+    const struct raft_append_entries *args = &message->append_entries;
+    uv_buf_t *bufs;
+    unsigned i;
+    int rv;
+
+    if (message->type != RAFT_IO_APPEND_ENTRIES) {
+        *n_bufs = 1;
+    } else {
+        *n_bufs = 2 + args->n_entries;
+    }
+
+    bufs = munit_calloc(*n_bufs, sizeof *bufs);
+
+    rv = raft_io_uv_encode__header(message, &bufs[0]);
+    munit_assert_int(rv, ==, 0);
+
+    if (message->type != RAFT_IO_APPEND_ENTRIES) {
+        return bufs;
+    }
+
+    bufs[1].len = raft_io_uv_sizeof__batch_header(args->n_entries);
+    bufs[1].base = munit_malloc(bufs[1].len);
+
+    raft_io_uv_encode__batch_header(args->entries, args->n_entries,
+                                    bufs[1].base);
+
+    for (i = 0; i < args->n_entries; i++) {
+        bufs[2 + i].base = args->entries[i].buf.base;
+        bufs[2 + i].len = args->entries[i].buf.len;
+    }
+
+    return bufs;
+}
+
+/**
+ * Release the buffers allocated by __encode. The entries data is not touched.
+ */
+static void __encode_release(uv_buf_t *bufs, unsigned n_bufs)
+{
+    raft_free(bufs[0].base);
+
+    if (n_bufs > 1) {
+        free(bufs[1].base);
+    }
+
+    free(bufs);
+}
+
 /**
  * Receive the given message sent over the given socket and check that no error
  * occurs.
@@ -180,17 +291,64 @@ static void tear_down(void *data)
         uv_buf_t *bufs;                                            \
         unsigned n_bufs;                                           \
         unsigned i;                                                \
-        int rv;                                                    \
                                                                    \
-        rv = raft_io_uv_encode__message(&MESSAGE, &bufs, &n_bufs); \
-        munit_assert_int(rv, ==, 0);                               \
+        bufs = __encode(&MESSAGE, &n_bufs);                        \
                                                                    \
         for (i = 0; i < n_bufs; i++) {                             \
             test_tcp_send(&F->tcp, bufs[i].base, bufs[i].len);     \
+        }                                                          \
+                                                                   \
+        for (i = 2; i < n_bufs; i++) {                             \
             raft_free(bufs[i].base);                               \
         }                                                          \
                                                                    \
-        raft_free(bufs);                                           \
+        __encode_release(bufs, n_bufs);                            \
+    }
+
+/**
+ * Like __recv, but send the entries data of the given AppendEntries message
+ * compressed. If CORRUPT is true, garble the compressed data.
+ */
+#define __recv_compressed(F, MESSAGE, CORRUPT)                           \
+    {                                                                    \
+        uv_buf_t *bufs;                                                  \
+        unsigned n_bufs;                                                 \
+        uv_buf_t compressed;                                             \
+        uint64_t extra[3];                                               \
+        void *cursor = extra;                                            \
+        size_t prefix;                                                   \
+        unsigned i;                                                      \
+        int rv;                                                          \
+                                                                         \
+        bufs = __encode(&MESSAGE, &n_bufs);                              \
+        prefix = bufs[0].len - sizeof(uint64_t) * 2;                     \
+                                                                         \
+        rv = raft_io_uv_encode__entries_compressed(bufs + 2, n_bufs - 2, \
+                                                   &compressed);         \
+        munit_assert_int(rv, ==, 0);                                     \
+        munit_assert_ptr_not_null(compressed.base);                      \
+                                                                         \
+        if (CORRUPT) {                                                   \
+            memset(compressed.base, 0xff, compressed.len);               \
+        }                                                                \
+                                                                         \
+        /* Type with the compressed flag, size and compressed size */    \
+        raft__put64(&cursor, MESSAGE.type | (2ULL << 32));               \
+        raft__put64(&cursor, prefix + bufs[1].len);                      \
+        raft__put64(&cursor, compressed.len);                            \
+                                                                         \
+        test_tcp_send(&F->tcp, extra, sizeof extra);                     \
+        test_tcp_send(&F->tcp, bufs[0].base + sizeof(uint64_t) * 2,      \
+                      prefix);                                           \
+        test_tcp_send(&F->tcp, bufs[1].base, bufs[1].len);               \
+        test_tcp_send(&F->tcp, compressed.base, compressed.len);         \
+                                                                         \
+        for (i = 2; i < n_bufs; i++) {                                   \
+            raft_free(bufs[i].base);                                     \
+        }                                                                \
+                                                                         \
+        __encode_release(bufs, n_bufs);                                  \
+        raft_free(compressed.base);                                      \
     }
 
 /**
@@ -263,9 +421,10 @@ static MunitResult test_send_second(const MunitParameter params[], void *data)
     /* Issue a second request */
     __send(f, message);
 
-    /* This time only one iteration is needed, as the connection was already
-     * established. */
-    n_handles = test_uv_run(&f->loop, 1);
+    /* This time the connection is already established: the request gets
+     * written at the end of the first iteration and completed in the second
+     * one. */
+    n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1); /* Only the listener handles is left */
 
     /* The second request succeeded as well. */
@@ -274,6 +433,173 @@ static MunitResult test_send_second(const MunitParameter params[], void *data)
     return MUNIT_OK;
 }
 
+/**
+ * Requests queued in the same loop iteration are written out together.
+ */
+static MunitResult test_send_coalesce(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES_RESULT);
+
+    __send(f, message);
+    __send(f, message);
+    __send(f, message);
+
+    /* No request gets completed before the loop runs. */
+    munit_assert_int(f->send_cb.n, ==, 0);
+
+    n_handles = test_uv_run(&f->loop, 3);
+    munit_assert_int(n_handles, ==, 1);
+
+    /* All requests succeeded. */
+    munit_assert_int(f->send_cb.n, ==, 3);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    return MUNIT_OK;
+}
+
+/**
+ * A server is reported as congested once the bytes queued for it reach the high
+ * watermark, and stops being so once they drop back to the low watermark.
+ */
+static MunitResult test_send_congested(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    /* Unknown servers are never congested. */
+    munit_assert_false(raft_io_uv_rpc__congested(&f->rpc, 1));
+
+    f->rpc.low_watermark = 0;
+    f->rpc.high_watermark = 64;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES_RESULT);
+
+    /* A single message is below the high watermark. */
+    __send(f, message);
+    munit_assert_false(raft_io_uv_rpc__congested(&f->rpc, 1));
+
+    /* The second one crosses it. */
+    __send(f, message);
+    munit_assert_true(raft_io_uv_rpc__congested(&f->rpc, 1));
+
+    n_handles = test_uv_run(&f->loop, 3);
+    munit_assert_int(n_handles, ==, 1);
+
+    /* All bytes were written, the congestion is gone. */
+    munit_assert_int(f->send_cb.n, ==, 2);
+    munit_assert_false(raft_io_uv_rpc__congested(&f->rpc, 1));
+
+    return MUNIT_OK;
+}
+
+/**
+ * With striping enabled, AppendEntries messages carrying entries go through a
+ * separate connection than control messages, and keep using the same stripe
+ * while it has outstanding bytes.
+ */
+static MunitResult test_send_striped(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    struct raft_io_uv_rpc_client *client;
+    unsigned i;
+
+    (void)params;
+
+    f->rpc.n_stripes = 2;
+
+    entries[0].buf.base = raft_malloc(16);
+    entries[0].buf.len = 16;
+
+    entries[1].buf.base = raft_malloc(8);
+    entries[1].buf.len = 8;
+
+    /* A heartbeat goes through the control connection. */
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = NULL;
+    message.append_entries.n_entries = 0;
+
+    __send(f, message);
+
+    munit_assert_int(f->rpc.n_clients, ==, 1);
+    client = f->rpc.clients[0];
+    munit_assert_int(client->stripe, ==, 0);
+    munit_assert_ptr_equal(client->head, client->tail);
+
+    /* Entries go through the first stripe. */
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    __send(f, message);
+
+    munit_assert_int(f->rpc.n_clients, ==, 3);
+    client = f->rpc.clients[1];
+    munit_assert_int(client->stripe, ==, 1);
+    munit_assert_ptr_not_null(client->head);
+    munit_assert_ptr_equal(client->head, client->tail);
+
+    /* The control connection was not touched. */
+    client = f->rpc.clients[0];
+    munit_assert_ptr_equal(client->head, client->tail);
+
+    /* The flush check handle doesn't wake up a blocking loop iteration, so
+     * run a non-blocking one first. */
+    uv_run(&f->loop, UV_RUN_NOWAIT);
+
+    for (i = 0; i < 10 && f->send_cb.n < 2; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    /* Both requests succeeded. */
+    munit_assert_int(f->send_cb.n, ==, 2);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    /* Once all stripes are connected, further entries still go through the
+     * first one, even if the other one has fewer outstanding bytes. */
+    for (i = 0; i < 10 && f->rpc.clients[2]->stream == NULL; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+    munit_assert_ptr_not_null(f->rpc.clients[2]->stream);
+
+    __send(f, message);
+    __send(f, message);
+
+    client = f->rpc.clients[1];
+    munit_assert_ptr_not_null(client->head);
+    munit_assert_ptr_not_equal(client->head, client->tail);
+
+    client = f->rpc.clients[2];
+    munit_assert_int(client->n_bytes, ==, 0);
+    munit_assert_ptr_null(client->head);
+
+    uv_run(&f->loop, UV_RUN_NOWAIT);
+
+    for (i = 0; i < 10 && f->send_cb.n < 4; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->send_cb.n, ==, 4);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    raft_free(entries[0].buf.base);
+    raft_free(entries[1].buf.base);
+
+    return MUNIT_OK;
+}
+
 /**
  * Send a request vote result message.
  */
@@ -338,6 +664,56 @@ static MunitResult test_send_append_entries(const MunitParameter params[],
 
     return MUNIT_OK;
 }
+/**
+ * Requests carrying the same entries array in the same loop iteration share
+ * the same encoded entries.
+ */
+static MunitResult test_send_append_entries_shared(
+    const MunitParameter params[],
+    void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    int n_handles;
+
+    (void)params;
+
+    entries[0].buf.base = raft_malloc(16);
+    entries[0].buf.len = 16;
+
+    entries[1].buf.base = raft_malloc(8);
+    entries[1].buf.len = 8;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    __send(f, message);
+    __send(f, message);
+
+    /* The encoded entries are referenced by both requests and by the rpc
+     * object itself. */
+    munit_assert_ptr_not_null(f->rpc.entries);
+    munit_assert_int(f->rpc.entries->refs, ==, 3);
+
+    n_handles = test_uv_run(&f->loop, 3);
+    munit_assert_int(n_handles, ==, 1); /* Only the listener handles is left */
+
+    /* The encoded entries were dropped at the end of the loop iteration. */
+    munit_assert_ptr_null(f->rpc.entries);
+
+    /* Both requests succeeded. */
+    munit_assert_int(f->send_cb.n, ==, 2);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    raft_free(entries[0].buf.base);
+    raft_free(entries[1].buf.base);
+
+    return MUNIT_OK;
+}
+
 /**
  * Send an append entries message with zero entries (i.e. a heartbeat).
  */
@@ -419,7 +795,7 @@ static MunitResult test_send_connect_error(const MunitParameter params[],
 }
 
 /**
- * The message has an invalid IPv4 address.
+ * The message has a malformed address.
  */
 
 static MunitResult test_send_bad_address(const MunitParameter params[],
@@ -433,10 +809,11 @@ static MunitResult test_send_bad_address(const MunitParameter params[],
 
     __message(f, message, RAFT_IO_REQUEST_VOTE);
 
-    message.server_address = "1";
+    message.server_address = "[::1";
 
-    /* The first attempt fails but we trigger a re-connection attempt. */
-    __assert_send_error(f, message, RAFT_ERR_IO_CONNECT);
+    /* The first attempt fails, but the request is buffered and we trigger a
+     * re-connection attempt. */
+    __send(f, message);
 
     /* The connection still fails and the timer is still active. */
     n_handles = test_uv_run(&f->loop, 1);
@@ -528,8 +905,13 @@ static MunitResult test_send_oom_async(const MunitParameter params[],
 static MunitTest send_tests[] = {
     {"/first", test_send_first, setup, tear_down, 0, NULL},
     {"/second", test_send_second, setup, tear_down, 0, NULL},
+    {"/coalesce", test_send_coalesce, setup, tear_down, 0, NULL},
+    {"/congested", test_send_congested, setup, tear_down, 0, NULL},
+    {"/striped", test_send_striped, setup, tear_down, 0, NULL},
     {"/vote-result", test_send_vote_result, setup, tear_down, 0, NULL},
     {"/append-entries", test_send_append_entries, setup, tear_down, 0, NULL},
+    {"/append-entries-shared", test_send_append_entries_shared, setup,
+     tear_down, 0, NULL},
     {"/heartbeat", test_send_heartbeat, setup, tear_down, 0, NULL},
     {"/append-result", test_send_append_result, setup, tear_down, 0, NULL},
     {"/connect-error", test_send_connect_error, setup, tear_down, 0, NULL},
@@ -629,122 +1011,187 @@ static MunitResult test_recv_bad_type(const MunitParameter params[], void *data)
 }
 
 /**
- * Receive the very first message over the connection.
+ * A message whose header is too short for its type causes the connection to be
+ * aborted.
  */
-static MunitResult test_recv_first(const MunitParameter params[], void *data)
+static MunitResult test_recv_bad_header(const MunitParameter params[],
+                                        void *data)
 {
     struct fixture *f = data;
-    struct raft_message message;
+    uint64_t buf[3];
+    void *cursor = buf;
     int n_handles;
 
     (void)params;
 
-    __message(f, message, RAFT_IO_REQUEST_VOTE);
+    __conn(f);
 
-    message.request_vote.term = 3;
-    message.request_vote.candidate_id = 2;
-    message.request_vote.last_log_index = 123;
-    message.request_vote.last_log_term = 2;
+    raft__put64(&cursor, RAFT_IO_REQUEST_VOTE); /* Message type */
+    raft__put64(&cursor, 8);                    /* Message size */
+    raft__put64(&cursor, 1);                    /* Term */
 
-    __conn(f);
-    __recv(f, message, socket);
+    test_tcp_send(&f->tcp, buf, sizeof buf);
 
     n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1);
 
-    munit_assert_true(f->recv_cb.invoked);
-    munit_assert_ptr_not_null(f->recv_cb.message);
-
-    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE);
-    munit_assert_int(f->recv_cb.message->request_vote.term, ==, 3);
-    munit_assert_int(f->recv_cb.message->request_vote.candidate_id, ==, 2);
-    munit_assert_int(f->recv_cb.message->request_vote.last_log_index, ==, 123);
-    munit_assert_int(f->recv_cb.message->request_vote.last_log_term, ==, 2);
+    munit_assert_false(f->recv_cb.invoked);
 
     return MUNIT_OK;
 }
 
 /**
- * Receive the a first message then another one.
+ * An AppendEntries message whose header is too short for the number of entries
+ * it declares causes the connection to be aborted.
  */
-static MunitResult test_recv_second(const MunitParameter params[], void *data)
+static MunitResult test_recv_bad_batch(const MunitParameter params[],
+                                       void *data)
 {
     struct fixture *f = data;
-    struct raft_message message;
+    uint64_t buf[8];
+    void *cursor = buf;
     int n_handles;
 
     (void)params;
 
-    __message(f, message, RAFT_IO_REQUEST_VOTE);
-
     __conn(f);
-    __recv(f, message, socket);
-    __recv(f, message, socket);
+
+    raft__put64(&cursor, RAFT_IO_APPEND_ENTRIES); /* Message type */
+    raft__put64(&cursor, 48);                     /* Message size */
+    raft__put64(&cursor, 1);                      /* Term */
+    raft__put64(&cursor, 2);                      /* Leader ID */
+    raft__put64(&cursor, 1);                      /* Previous index */
+    raft__put64(&cursor, 1);                      /* Previous term */
+    raft__put64(&cursor, 1);                      /* Commit index */
+    raft__put64(&cursor, 1000);                   /* Number of entries */
+
+    test_tcp_send(&f->tcp, buf, sizeof buf);
 
     n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1);
 
+    munit_assert_false(f->recv_cb.invoked);
+
     return MUNIT_OK;
 }
 
 /**
- * Receive an RequestVote result message.
+ * A RequestVote message sent by a server that predates the disrupt leader flag
+ * has one word less, and the flag is not read from the bytes that follow.
  */
-static MunitResult test_recv_vote_result(const MunitParameter params[],
-                                         void *data)
+static MunitResult test_recv_request_vote_legacy(const MunitParameter params[],
+                                                 void *data)
 {
     struct fixture *f = data;
-    struct raft_message message;
+    uint64_t buf[7];
+    void *cursor = buf;
     int n_handles;
 
     (void)params;
 
-    __message(f, message, RAFT_IO_REQUEST_VOTE_RESULT);
+    __conn(f);
 
-    message.request_vote_result.term = 3;
-    message.request_vote_result.vote_granted = true;
+    raft__put64(&cursor, RAFT_IO_REQUEST_VOTE); /* Message type */
+    raft__put64(&cursor, 32);                   /* Message size */
+    raft__put64(&cursor, 3);                    /* Term */
+    raft__put64(&cursor, 2);                    /* Candidate ID */
+    raft__put64(&cursor, 123);                  /* Last log index */
+    raft__put64(&cursor, 2);                    /* Last log term */
+    raft__put64(&cursor, RAFT_IO_REQUEST_VOTE); /* Start of next message */
 
-    __conn(f);
-    __recv(f, message, socket);
+    test_tcp_send(&f->tcp, buf, sizeof buf);
 
     n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1);
 
-    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE_RESULT);
+    munit_assert_true(f->recv_cb.invoked);
 
-    munit_assert_int(f->recv_cb.message->request_vote_result.term, ==, 3);
-    munit_assert_true(f->recv_cb.message->request_vote_result.vote_granted);
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(f->recv_cb.message->request_vote.term, ==, 3);
+    munit_assert_int(f->recv_cb.message->request_vote.last_log_term, ==, 2);
+    munit_assert_false(f->recv_cb.message->request_vote.disrupt_leader);
 
     return MUNIT_OK;
 }
 
 /**
- * Receive an AppendEntries message with two entries.
+ * A message with flags that we don't know about causes the connection to be
+ * aborted.
  */
-static MunitResult test_recv_append_entries(const MunitParameter params[],
-                                            void *data)
+static MunitResult test_recv_bad_flags(const MunitParameter params[],
+                                       void *data)
 {
     struct fixture *f = data;
-    struct raft_message message;
-    struct raft_entry entries[2];
+    uint64_t buf[3];
+    void *cursor = buf;
     int n_handles;
 
     (void)params;
 
-    entries[0].type = RAFT_LOG_COMMAND;
-    entries[0].buf.base = raft_malloc(16);
-    entries[0].buf.len = 16;
-    strcpy(entries[0].buf.base, "hello");
+    __conn(f);
 
-    entries[1].type = RAFT_LOG_COMMAND;
-    entries[1].buf.base = raft_malloc(8);
-    entries[1].buf.len = 8;
-    strcpy(entries[1].buf.base, "world");
+    raft__put64(&cursor, RAFT_IO_REQUEST_VOTE | (1ULL << 40)); /* Type */
+    raft__put64(&cursor, 8); /* Message size */
 
-    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+    test_tcp_send(&f->tcp, buf, sizeof buf);
 
-    message.append_entries.entries = entries;
-    message.append_entries.n_entries = 2;
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_false(f->recv_cb.invoked);
+
+    return MUNIT_OK;
+}
+
+/**
+ * A message whose header doesn't match its checksum causes the connection to
+ * be aborted.
+ */
+static MunitResult test_recv_bad_checksum(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+    uint64_t buf[4];
+    void *cursor = buf;
+    int n_handles;
+
+    (void)params;
+
+    __conn(f);
+
+    raft__put64(&cursor, RAFT_IO_REQUEST_VOTE | (1ULL << 32)); /* Type */
+    raft__put64(&cursor, 8);          /* Message size */
+    raft__put64(&cursor, 0xdeadbeef); /* Checksums */
+    raft__put64(&cursor, 0);          /* Header */
+
+    test_tcp_send(&f->tcp, buf, sizeof buf);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_false(f->recv_cb.invoked);
+
+    return MUNIT_OK;
+}
+
+/**
+ * Receive the very first message over the connection.
+ */
+static MunitResult test_recv_first(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.request_vote.term = 3;
+    message.request_vote.candidate_id = 2;
+    message.request_vote.last_log_index = 123;
+    message.request_vote.last_log_term = 2;
+    message.request_vote.disrupt_leader = false;
 
     __conn(f);
     __recv(f, message, socket);
@@ -755,22 +1202,19 @@ static MunitResult test_recv_append_entries(const MunitParameter params[],
     munit_assert_true(f->recv_cb.invoked);
     munit_assert_ptr_not_null(f->recv_cb.message);
 
-    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_APPEND_ENTRIES);
-    munit_assert_int(f->recv_cb.message->append_entries.n_entries, ==, 2);
-
-    munit_assert_string_equal(
-        f->recv_cb.message->append_entries.entries[0].buf.base, "hello");
-    munit_assert_string_equal(
-        f->recv_cb.message->append_entries.entries[1].buf.base, "world");
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(f->recv_cb.message->request_vote.term, ==, 3);
+    munit_assert_int(f->recv_cb.message->request_vote.candidate_id, ==, 2);
+    munit_assert_int(f->recv_cb.message->request_vote.last_log_index, ==, 123);
+    munit_assert_int(f->recv_cb.message->request_vote.last_log_term, ==, 2);
 
     return MUNIT_OK;
 }
 
 /**
- * Receive an AppendEntries message with no entries (i.e. an heartbeat).
+ * Receive the a first message then another one.
  */
-static MunitResult test_recv_heartbeat(const MunitParameter params[],
-                                       void *data)
+static MunitResult test_recv_second(const MunitParameter params[], void *data)
 {
     struct fixture *f = data;
     struct raft_message message;
@@ -778,13 +1222,11 @@ static MunitResult test_recv_heartbeat(const MunitParameter params[],
 
     (void)params;
 
-    __message(f, message, RAFT_IO_APPEND_ENTRIES);
-
-    message.append_entries.entries = NULL;
-    message.append_entries.n_entries = 0;
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
 
     __conn(f);
     __recv(f, message, socket);
+    __recv(f, message, socket);
 
     n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1);
@@ -793,14 +1235,17 @@ static MunitResult test_recv_heartbeat(const MunitParameter params[],
 }
 
 /**
- * Receive an AppendEntries result message.
+ * Receive several messages sent back to back, which get parsed out of the
+ * same read buffer.
  */
-static MunitResult test_recv_append_result(const MunitParameter params[],
-                                           void *data)
+static MunitResult test_recv_many(const MunitParameter params[], void *data)
 {
     struct fixture *f = data;
     struct raft_message message;
+    char *buf;
+    size_t size;
     int n_handles;
+    unsigned i;
 
     (void)params;
 
@@ -808,7 +1253,59 @@ static MunitResult test_recv_append_result(const MunitParameter params[],
 
     message.append_entries_result.term = 3;
     message.append_entries_result.success = true;
-    message.append_entries_result.last_log_index = 123;
+
+    __conn(f);
+
+    /* Encode all messages into a single buffer and send it at once. */
+    buf = munit_malloc(50 * 40);
+    size = 0;
+
+    for (i = 0; i < 50; i++) {
+        uv_buf_t header;
+        int rv;
+
+        message.append_entries_result.last_log_index = i;
+
+        rv = raft_io_uv_encode__header(&message, &header);
+        munit_assert_int(rv, ==, 0);
+        munit_assert_int(size + header.len, <=, 50 * 40);
+
+        memcpy(buf + size, header.base, header.len);
+        size += header.len;
+
+        raft_free(header.base);
+    }
+
+    test_tcp_send(&f->tcp, buf, size);
+
+    free(buf);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_int(f->recv_cb.n, ==, 50);
+    munit_assert_int(f->recv_cb.message->append_entries_result.last_log_index,
+                     ==, 49);
+
+    return MUNIT_OK;
+}
+
+/**
+ * Receive an RequestVote result message.
+ */
+static MunitResult test_recv_vote_result(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE_RESULT);
+
+    message.request_vote_result.term = 3;
+    message.request_vote_result.vote_granted = true;
 
     __conn(f);
     __recv(f, message, socket);
@@ -816,64 +1313,1023 @@ static MunitResult test_recv_append_result(const MunitParameter params[],
     n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1);
 
-    munit_assert_int(f->recv_cb.message->type, ==,
-                     RAFT_IO_APPEND_ENTRIES_RESULT);
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE_RESULT);
 
-    munit_assert_int(f->recv_cb.message->append_entries_result.term, ==, 3);
-    munit_assert_true(f->recv_cb.message->append_entries_result.success);
-    munit_assert_int(f->recv_cb.message->append_entries_result.last_log_index,
-                     ==, 123);
+    munit_assert_int(f->recv_cb.message->request_vote_result.term, ==, 3);
+    munit_assert_true(f->recv_cb.message->request_vote_result.vote_granted);
 
     return MUNIT_OK;
 }
 
-static char *recv_oom_heap_fault_delay[] = {"2", "3", "4", "5", "6", "7", NULL};
-static char *recv_oom_heap_fault_repeat[] = {"1", NULL};
+/**
+ * Receive a ReadIndex result message.
+ */
+static MunitResult test_recv_read_index_result(const MunitParameter params[],
+                                               void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_read_index_result *result;
+    int n_handles;
 
-static MunitParameterEnum recv_oom_params[] = {
-    {TEST_HEAP_FAULT_DELAY, recv_oom_heap_fault_delay},
-    {TEST_HEAP_FAULT_REPEAT, recv_oom_heap_fault_repeat},
-    {NULL, NULL},
-};
+    (void)params;
+
+    __message(f, message, RAFT_IO_READ_INDEX_RESULT);
+
+    message.read_index_result.term = 3;
+    message.read_index_result.id = 7;
+    message.read_index_result.success = true;
+    message.read_index_result.index = 123;
+
+    __conn(f);
+    __recv(f, message, socket);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_READ_INDEX_RESULT);
+
+    result = &f->recv_cb.message->read_index_result;
+    munit_assert_int(result->term, ==, 3);
+    munit_assert_int(result->id, ==, 7);
+    munit_assert_true(result->success);
+    munit_assert_int(result->index, ==, 123);
+
+    return MUNIT_OK;
+}
 
 /**
- * Out of memory conditions.
+ * Receive a PreVote message.
  */
-static MunitResult test_recv_oom(const MunitParameter params[], void *data)
+static MunitResult test_recv_pre_vote(const MunitParameter params[],
+                                      void *data)
 {
     struct fixture *f = data;
     struct raft_message message;
+    struct raft_request_vote *args;
     int n_handles;
 
     (void)params;
 
-    __message(f, message, RAFT_IO_REQUEST_VOTE);
+    __message(f, message, RAFT_IO_PRE_VOTE);
+
+    message.pre_vote.term = 3;
+    message.pre_vote.candidate_id = 2;
+    message.pre_vote.last_log_index = 123;
+    message.pre_vote.last_log_term = 2;
+    message.pre_vote.disrupt_leader = false;
 
     __conn(f);
+    __recv(f, message, socket);
 
-    test_heap_fault_enable(&f->heap);
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_PRE_VOTE);
+
+    args = &f->recv_cb.message->pre_vote;
+    munit_assert_int(args->term, ==, 3);
+    munit_assert_int(args->candidate_id, ==, 2);
+    munit_assert_int(args->last_log_index, ==, 123);
+    munit_assert_int(args->last_log_term, ==, 2);
+
+    return MUNIT_OK;
+}
 
+/**
+ * Receive an AppendEntries message with two entries.
+ */
+static MunitResult test_recv_append_entries(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    int n_handles;
+
+    (void)params;
+
+    entries[0].type = RAFT_LOG_COMMAND;
+    entries[0].buf.base = raft_malloc(16);
+    entries[0].buf.len = 16;
+    strcpy(entries[0].buf.base, "hello");
+
+    entries[1].type = RAFT_LOG_COMMAND;
+    entries[1].buf.base = raft_malloc(8);
+    entries[1].buf.len = 8;
+    strcpy(entries[1].buf.base, "world");
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    __conn(f);
     __recv(f, message, socket);
 
-    n_handles = test_uv_run(&f->loop, 1);
+    n_handles = test_uv_run(&f->loop, 2);
     munit_assert_int(n_handles, ==, 1);
 
-    munit_assert_false(f->recv_cb.invoked);
+    munit_assert_true(f->recv_cb.invoked);
+    munit_assert_ptr_not_null(f->recv_cb.message);
+
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_APPEND_ENTRIES);
+    munit_assert_int(f->recv_cb.message->append_entries.n_entries, ==, 2);
+
+    munit_assert_string_equal(
+        f->recv_cb.message->append_entries.entries[0].buf.base, "hello");
+    munit_assert_string_equal(
+        f->recv_cb.message->append_entries.entries[1].buf.base, "world");
 
     return MUNIT_OK;
 }
 
-static MunitTest recv_tests[] = {
-    {"/bad-proto", test_recv_bad_proto, setup, tear_down, 0, NULL},
-    {"/bad-size", test_recv_bad_size, setup, tear_down, 0, NULL},
-    {"/bad-type", test_recv_bad_type, setup, tear_down, 0, NULL},
-    {"/first", test_recv_first, setup, tear_down, 0, NULL},
-    {"/second", test_recv_second, setup, tear_down, 0, NULL},
-    {"/vote-result", test_recv_vote_result, setup, tear_down, 0, NULL},
-    {"/append-entries", test_recv_append_entries, setup, tear_down, 0, NULL},
-    {"/heartbeat", test_recv_heartbeat, setup, tear_down, 0, NULL},
-    {"/append-result", test_recv_append_result, setup, tear_down, 0, NULL},
-    {"/oom", test_recv_oom, setup, tear_down, 0, recv_oom_params},
+/**
+ * Put in the given buffer an AppendEntries message with a single entry holding
+ * the given data.
+ */
+static void *__put_append_entries(void *cursor, const char *data)
+{
+    size_t len = strlen(data);
+
+    raft__put64(&cursor, RAFT_IO_APPEND_ENTRIES); /* Message type */
+    raft__put64(&cursor, 64);                     /* Message size */
+    raft__put64(&cursor, 2);                      /* Term */
+    raft__put64(&cursor, 1);                      /* Leader ID */
+    raft__put64(&cursor, 0);                      /* Previous log index */
+    raft__put64(&cursor, 0);                      /* Previous log term */
+    raft__put64(&cursor, 0);                      /* Leader commit */
+    raft__put64(&cursor, 1);                      /* Number of entries */
+    raft__put64(&cursor, 2);                      /* Entry term */
+    raft__put8(&cursor, RAFT_LOG_COMMAND);        /* Entry type */
+    cursor += 3;                                  /* Unused */
+    raft__put32(&cursor, len);                    /* Entry data size */
+
+    memcpy(cursor, data, len);
+
+    return cursor + len;
+}
+
+/**
+ * A message following an entries payload whose size is not a multiple of 8 is
+ * parsed from an unaligned position of the receive buffer.
+ */
+static MunitResult test_recv_unaligned(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_append_entries *args;
+    uint64_t buf[21];
+    void *cursor = buf;
+    int n_handles;
+
+    (void)params;
+
+    __conn(f);
+
+    cursor = __put_append_entries(cursor, "hello");
+    cursor = __put_append_entries(cursor, "abc");
+    munit_assert_ptr_equal(cursor, (char *)buf + sizeof buf);
+
+    test_tcp_send(&f->tcp, buf, sizeof buf);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_int(f->recv_cb.n, ==, 2);
+
+    args = &f->recv_cb.message->append_entries;
+    munit_assert_int(args->term, ==, 2);
+    munit_assert_int(args->leader_id, ==, 1);
+    munit_assert_int(args->n_entries, ==, 1);
+    munit_assert_int(args->entries[0].buf.len, ==, 3);
+    munit_assert_memory_equal(3, args->entries[0].buf.base, "abc");
+
+    return MUNIT_OK;
+}
+
+/**
+ * Receive an AppendEntries message whose entries data is compressed.
+ */
+static MunitResult test_recv_compressed(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    char *buf;
+    int n_handles;
+
+    (void)params;
+
+    entries[0].type = RAFT_LOG_COMMAND;
+    entries[0].buf.base = raft_malloc(256);
+    entries[0].buf.len = 256;
+    memset(entries[0].buf.base, 'x', 256);
+
+    entries[1].type = RAFT_LOG_COMMAND;
+    entries[1].buf.base = raft_malloc(8);
+    entries[1].buf.len = 8;
+    strcpy(entries[1].buf.base, "world");
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    __conn(f);
+    __recv_compressed(f, message, false);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_true(f->recv_cb.invoked);
+    munit_assert_int(f->recv_cb.message->append_entries.n_entries, ==, 2);
+
+    buf = f->recv_cb.message->append_entries.entries[0].buf.base;
+    munit_assert_int(buf[0], ==, 'x');
+    munit_assert_int(buf[255], ==, 'x');
+
+    munit_assert_string_equal(
+        f->recv_cb.message->append_entries.entries[1].buf.base, "world");
+
+    return MUNIT_OK;
+}
+
+/**
+ * Compressed entries data that can't be decompressed causes the connection to
+ * be aborted.
+ */
+static MunitResult test_recv_bad_compressed(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[1];
+    int n_handles;
+
+    (void)params;
+
+    entries[0].type = RAFT_LOG_COMMAND;
+    entries[0].buf.base = raft_malloc(256);
+    entries[0].buf.len = 256;
+    memset(entries[0].buf.base, 'x', 256);
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 1;
+
+    __conn(f);
+    __recv_compressed(f, message, true);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_false(f->recv_cb.invoked);
+
+    return MUNIT_OK;
+}
+
+/**
+ * Receive an AppendEntries message whose header doesn't fit in the default
+ * read buffer and whose payload is large enough to be read directly into its
+ * final buffer.
+ */
+static MunitResult test_recv_append_entries_large(const MunitParameter params[],
+                                                  void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry *entries;
+    unsigned n = 5000;
+    unsigned i;
+    int n_handles;
+
+    (void)params;
+
+    entries = munit_malloc(n * sizeof *entries);
+
+    for (i = 0; i < n; i++) {
+        entries[i].type = RAFT_LOG_COMMAND;
+        entries[i].buf.base = raft_malloc(8);
+        entries[i].buf.len = 8;
+        *(uint64_t *)entries[i].buf.base = i;
+    }
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = n;
+
+    __conn(f);
+    __recv(f, message, socket);
+
+    free(entries);
+
+    /* The message might span several reads. */
+    for (i = 0; i < 10 && !f->recv_cb.invoked; i++) {
+        n_handles = test_uv_run(&f->loop, 1);
+        munit_assert_int(n_handles, ==, 1);
+    }
+
+    munit_assert_int(f->recv_cb.n, ==, 1);
+    munit_assert_int(f->recv_cb.message->append_entries.n_entries, ==, n);
+
+    for (i = 0; i < n; i++) {
+        struct raft_entry *entry =
+            &f->recv_cb.message->append_entries.entries[i];
+        munit_assert_int(*(uint64_t *)entry->buf.base, ==, i);
+    }
+
+    return MUNIT_OK;
+}
+
+/**
+ * Receive an AppendEntries message with no entries (i.e. an heartbeat).
+ */
+static MunitResult test_recv_heartbeat(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.append_entries.entries = NULL;
+    message.append_entries.n_entries = 0;
+
+    __conn(f);
+    __recv(f, message, socket);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    return MUNIT_OK;
+}
+
+/**
+ * Receive an AppendEntries result message.
+ */
+static MunitResult test_recv_append_result(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES_RESULT);
+
+    message.append_entries_result.term = 3;
+    message.append_entries_result.success = true;
+    message.append_entries_result.last_log_index = 123;
+
+    __conn(f);
+    __recv(f, message, socket);
+
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_int(f->recv_cb.message->type, ==,
+                     RAFT_IO_APPEND_ENTRIES_RESULT);
+
+    munit_assert_int(f->recv_cb.message->append_entries_result.term, ==, 3);
+    munit_assert_true(f->recv_cb.message->append_entries_result.success);
+    munit_assert_int(f->recv_cb.message->append_entries_result.last_log_index,
+                     ==, 123);
+
+    return MUNIT_OK;
+}
+
+static char *recv_oom_heap_fault_delay[] = {"2", "3", "4", "5", "6", "7", NULL};
+static char *recv_oom_heap_fault_repeat[] = {"1", NULL};
+
+static MunitParameterEnum recv_oom_params[] = {
+    {TEST_HEAP_FAULT_DELAY, recv_oom_heap_fault_delay},
+    {TEST_HEAP_FAULT_REPEAT, recv_oom_heap_fault_repeat},
+    {NULL, NULL},
+};
+
+/**
+ * Out of memory conditions.
+ */
+static MunitResult test_recv_oom(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    int n_handles;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    __conn(f);
+
+    test_heap_fault_enable(&f->heap);
+
+    __recv(f, message, socket);
+
+    n_handles = test_uv_run(&f->loop, 1);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_false(f->recv_cb.invoked);
+
+    return MUNIT_OK;
+}
+
+static MunitTest recv_tests[] = {
+    {"/bad-proto", test_recv_bad_proto, setup, tear_down, 0, NULL},
+    {"/bad-size", test_recv_bad_size, setup, tear_down, 0, NULL},
+    {"/bad-type", test_recv_bad_type, setup, tear_down, 0, NULL},
+    {"/bad-header", test_recv_bad_header, setup, tear_down, 0, NULL},
+    {"/bad-batch", test_recv_bad_batch, setup, tear_down, 0, NULL},
+    {"/bad-flags", test_recv_bad_flags, setup, tear_down, 0, NULL},
+    {"/bad-checksum", test_recv_bad_checksum, setup, tear_down, 0, NULL},
+    {"/first", test_recv_first, setup, tear_down, 0, NULL},
+    {"/second", test_recv_second, setup, tear_down, 0, NULL},
+    {"/many", test_recv_many, setup, tear_down, 0, NULL},
+    {"/vote-result", test_recv_vote_result, setup, tear_down, 0, NULL},
+    {"/read-index-result", test_recv_read_index_result, setup, tear_down, 0,
+     NULL},
+    {"/pre-vote", test_recv_pre_vote, setup, tear_down, 0, NULL},
+    {"/request-vote-legacy", test_recv_request_vote_legacy, setup, tear_down,
+     0, NULL},
+    {"/append-entries", test_recv_append_entries, setup, tear_down, 0, NULL},
+    {"/append-entries-large", test_recv_append_entries_large, setup, tear_down,
+     0, NULL},
+    {"/unaligned", test_recv_unaligned, setup, tear_down, 0, NULL},
+    {"/compressed", test_recv_compressed, setup, tear_down, 0, NULL},
+    {"/bad-compressed", test_recv_bad_compressed, setup, tear_down, 0, NULL},
+    {"/heartbeat", test_recv_heartbeat, setup, tear_down, 0, NULL},
+    {"/append-result", test_recv_append_result, setup, tear_down, 0, NULL},
+    {"/oom", test_recv_oom, setup, tear_down, 0, recv_oom_params},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Unix socket transport
+ */
+
+/* A message sent to our own socket path is delivered to the receive callback
+ * of the same endpoint. */
+static MunitResult test_unix_loopback(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    unsigned i;
+
+    (void)params;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_address = f->address;
+    message.request_vote.term = 3;
+    message.request_vote.candidate_id = 1;
+    message.request_vote.last_log_index = 123;
+    message.request_vote.last_log_term = 2;
+    message.request_vote.disrupt_leader = false;
+
+    __send(f, message);
+
+    for (i = 0; i < 10 && !f->recv_cb.invoked; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    munit_assert_true(f->recv_cb.invoked);
+    munit_assert_ptr_not_null(f->recv_cb.message);
+
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(f->recv_cb.message->server_id, ==, 1);
+    munit_assert_string_equal(f->recv_cb.message->server_address, f->address);
+    munit_assert_int(f->recv_cb.message->request_vote.term, ==, 3);
+    munit_assert_int(f->recv_cb.message->request_vote.last_log_index, ==, 123);
+
+    return MUNIT_OK;
+}
+
+/* Connecting to a path with no listening socket fails asynchronously, and the
+ * connection is retried. */
+static MunitResult test_unix_connect_error(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    char address[256];
+    int n_handles;
+
+    (void)params;
+
+    sprintf(address, "%s/missing.sock", f->dir);
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_address = address;
+
+    f->rpc.connect_retry_delay = 1;
+
+    __send(f, message);
+
+    /* We keep retrying indefinitely, backing off after each failure. */
+    n_handles = test_uv_run(&f->loop, 2);
+    munit_assert_int(n_handles, ==, 1);
+
+    munit_assert_int(f->rpc.n_clients, ==, 1);
+    munit_assert_int(f->rpc.clients[0]->n_attempts, >=, 1);
+
+    /* The request is still buffered. */
+    munit_assert_int(f->send_cb.n, ==, 0);
+
+    return MUNIT_OK;
+}
+
+/* Requests buffered while the other server is unreachable fail once they have
+ * been waiting for longer than the pending timeout. */
+static MunitResult test_unix_pending_timeout(const MunitParameter params[],
+                                             void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    char address[256];
+    unsigned i;
+
+    (void)params;
+
+    sprintf(address, "%s/missing.sock", f->dir);
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_address = address;
+
+    f->rpc.connect_retry_delay = 1;
+    f->rpc.pending_timeout = 20;
+
+    __send(f, message);
+    __send(f, message);
+
+    for (i = 0; i < 100 && f->send_cb.n < 2; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->send_cb.n, ==, 2);
+    munit_assert_int(f->send_cb.status, ==, RAFT_ERR_IO_CONNECT);
+
+    munit_assert_ptr_null(f->rpc.clients[0]->head);
+    munit_assert_int(f->rpc.clients[0]->n_bytes, ==, 0);
+
+    /* New requests get buffered again. */
+    __send(f, message);
+
+    munit_assert_ptr_not_null(f->rpc.clients[0]->head);
+
+    return MUNIT_OK;
+}
+
+/* State of a second RPC endpoint, used to simulate a server that comes up. */
+struct peer
+{
+    struct raft_io_uv_transport transport;
+    struct raft_io_uv_rpc rpc;
+    bool stopped;
+    struct raft_message *message;
+};
+
+static void __peer_recv_cb(void *data, struct raft_message *message)
+{
+    struct peer *p = data;
+
+    p->message = message;
+}
+
+static void __peer_stop_cb(void *data)
+{
+    struct peer *p = data;
+
+    p->stopped = true;
+}
+
+/* A request sent while the other server is down is buffered, and delivered as
+ * soon as that server connects to us, without waiting for the retry timer. */
+static MunitResult test_unix_reconnect(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct peer peer;
+    char address[256];
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    sprintf(address, "%s/peer.sock", f->dir);
+
+    /* Server 2 is not up yet and the retry delay is very long. */
+    f->rpc.connect_retry_delay = 60 * 1000;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_id = 2;
+    message.server_address = address;
+    message.request_vote.term = 7;
+
+    __send(f, message);
+
+    test_uv_run(&f->loop, 1);
+
+    munit_assert_int(f->send_cb.n, ==, 0);
+
+    /* Server 2 comes up and sends us a message. */
+    rv = raft_io_uv_unix_init(&peer.transport, &f->logger, &f->loop);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_io_uv_rpc__init(&peer.rpc, &f->logger, &f->loop,
+                              &peer.transport);
+    munit_assert_int(rv, ==, 0);
+
+    peer.stopped = false;
+    peer.message = NULL;
+
+    rv = raft_io_uv_rpc__start(&peer.rpc, 2, address, &peer, __peer_recv_cb);
+    munit_assert_int(rv, ==, 0);
+
+    message.server_id = 1;
+    message.server_address = f->address;
+
+    rv = raft_io_uv_rpc__send(&peer.rpc, &message, NULL, NULL);
+    munit_assert_int(rv, ==, 0);
+
+    for (i = 0; i < 20 && peer.message == NULL; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    /* The buffered request was delivered. */
+    munit_assert_ptr_not_null(peer.message);
+    munit_assert_int(peer.message->type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(peer.message->server_id, ==, 1);
+    munit_assert_int(peer.message->request_vote.term, ==, 7);
+
+    munit_assert_int(f->send_cb.n, ==, 1);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    raft_io_uv_rpc__stop(&peer.rpc, &peer, __peer_stop_cb);
+
+    for (i = 0; i < 20 && !peer.stopped; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_true(peer.stopped);
+
+    raft_io_uv_rpc__close(&peer.rpc);
+    raft_io_uv_unix_close(&peer.transport);
+
+    return MUNIT_OK;
+}
+
+/* Once the hello message of the other server has been received, messages are
+ * sent with checksums, which get verified by the receiving end. */
+static MunitResult test_unix_checksum(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    char buf1[8] = "hello";
+    char buf2[8] = "world";
+    unsigned i;
+
+    (void)params;
+
+    f->rpc.checksums = true;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_address = f->address;
+    message.request_vote.term = 3;
+
+    __send(f, message);
+
+    for (i = 0; i < 10 && f->recv_cb.n < 1; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->recv_cb.n, ==, 1);
+
+    /* The hello message has arrived. */
+    for (i = 0; i < 10 && f->rpc.clients[0]->version < 2; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->rpc.clients[0]->version, ==, 2);
+    munit_assert_int(f->rpc.clients[0]->features, ==, 3);
+
+    entries[0].type = RAFT_LOG_COMMAND;
+    entries[0].buf.base = buf1;
+    entries[0].buf.len = sizeof buf1;
+
+    entries[1].type = RAFT_LOG_COMMAND;
+    entries[1].buf.base = buf2;
+    entries[1].buf.len = sizeof buf2;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.server_address = f->address;
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    __send(f, message);
+
+    /* Nothing else wakes up the loop, so run the flush check without blocking
+     * in poll. */
+    uv_run(&f->loop, UV_RUN_NOWAIT);
+
+    for (i = 0; i < 10 && f->recv_cb.n < 2; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->recv_cb.n, ==, 2);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_APPEND_ENTRIES);
+    munit_assert_int(f->recv_cb.message->append_entries.n_entries, ==, 2);
+
+    munit_assert_string_equal(
+        f->recv_cb.message->append_entries.entries[0].buf.base, "hello");
+    munit_assert_string_equal(
+        f->recv_cb.message->append_entries.entries[1].buf.base, "world");
+
+    return MUNIT_OK;
+}
+
+/* Large entries data is sent compressed, and decompressed by the receiving
+ * end. */
+static MunitResult test_unix_compression(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct raft_entry entries[2];
+    char buf1[1024];
+    char buf2[8] = "world";
+    unsigned i;
+
+    (void)params;
+
+    f->rpc.checksums = true;
+    f->rpc.compression_threshold = 512;
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_address = f->address;
+
+    __send(f, message);
+
+    /* Wait for the connection and the hello message. */
+    for (i = 0; i < 10 && f->recv_cb.n < 1; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+    for (i = 0; i < 10 && f->rpc.clients[0]->version < 2; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->rpc.clients[0]->features, ==, 3);
+
+    memset(buf1, 'x', sizeof buf1);
+
+    entries[0].type = RAFT_LOG_COMMAND;
+    entries[0].buf.base = buf1;
+    entries[0].buf.len = sizeof buf1;
+
+    entries[1].type = RAFT_LOG_COMMAND;
+    entries[1].buf.base = buf2;
+    entries[1].buf.len = sizeof buf2;
+
+    __message(f, message, RAFT_IO_APPEND_ENTRIES);
+
+    message.server_address = f->address;
+    message.append_entries.entries = entries;
+    message.append_entries.n_entries = 2;
+
+    __send(f, message);
+
+    /* Nothing else wakes up the loop, so run the flush check without blocking
+     * in poll. */
+    uv_run(&f->loop, UV_RUN_NOWAIT);
+
+    for (i = 0; i < 10 && f->recv_cb.n < 2; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_int(f->recv_cb.n, ==, 2);
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_APPEND_ENTRIES);
+    munit_assert_int(f->recv_cb.message->append_entries.n_entries, ==, 2);
+
+    munit_assert_memory_equal(
+        sizeof buf1, f->recv_cb.message->append_entries.entries[0].buf.base,
+        buf1);
+    munit_assert_string_equal(
+        f->recv_cb.message->append_entries.entries[1].buf.base, "world");
+
+    return MUNIT_OK;
+}
+
+static MunitTest unix_tests[] = {
+    {"/loopback", test_unix_loopback, setup_unix, tear_down, 0, NULL},
+    {"/connect-error", test_unix_connect_error, setup_unix, tear_down, 0,
+     NULL},
+    {"/pending-timeout", test_unix_pending_timeout, setup_unix, tear_down, 0,
+     NULL},
+    {"/reconnect", test_unix_reconnect, setup_unix, tear_down, 0, NULL},
+    {"/checksum", test_unix_checksum, setup_unix, tear_down, 0, NULL},
+    {"/compression", test_unix_compression, setup_unix, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * TCP transport
+ */
+
+/* Stop the given peer endpoint and release its resources. */
+static void __peer_stop(struct fixture *f, struct peer *peer)
+{
+    unsigned i;
+
+    raft_io_uv_rpc__stop(&peer->rpc, peer, __peer_stop_cb);
+
+    for (i = 0; i < 20 && !peer->stopped; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_true(peer->stopped);
+
+    raft_io_uv_rpc__close(&peer->rpc);
+    raft_io_uv_tcp_close(&peer->transport);
+}
+
+/* Addresses can use hostnames, both for listening and for connecting, and
+ * socket options are applied to outgoing sockets before they connect. */
+static MunitResult test_tcp_hostname(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_io_uv_tcp_options options;
+    struct raft_message message;
+    struct peer peer;
+    uv_os_fd_t fd;
+    int size;
+    socklen_t len;
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    options.nodelay = true;
+    options.send_buffer_size = 256 * 1024;
+    options.recv_buffer_size = 256 * 1024;
+    options.keepalive = 10;
+    options.user_timeout = 5000;
+
+    rv = raft_io_uv_tcp_init(&peer.transport, &f->logger, &f->loop, &options);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_io_uv_rpc__init(&peer.rpc, &f->logger, &f->loop,
+                              &peer.transport);
+    munit_assert_int(rv, ==, 0);
+
+    peer.stopped = false;
+    peer.message = NULL;
+
+    rv = raft_io_uv_rpc__start(&peer.rpc, 2, "localhost:9001", &peer,
+                               __peer_recv_cb);
+    munit_assert_int(rv, ==, 0);
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_address = "localhost:9000";
+    message.request_vote.term = 5;
+
+    rv = raft_io_uv_rpc__send(&peer.rpc, &message, NULL, NULL);
+    munit_assert_int(rv, ==, 0);
+
+    for (i = 0; i < 50 && !f->recv_cb.invoked; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_true(f->recv_cb.invoked);
+    munit_assert_int(f->recv_cb.message->type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(f->recv_cb.message->server_id, ==, 2);
+    munit_assert_string_equal(f->recv_cb.message->server_address,
+                              "localhost:9001");
+    munit_assert_int(f->recv_cb.message->request_vote.term, ==, 5);
+
+    /* The buffer sizes were set on the outgoing socket. */
+    rv = uv_fileno((uv_handle_t *)peer.rpc.clients[0]->stream, &fd);
+    munit_assert_int(rv, ==, 0);
+
+    len = sizeof size;
+    rv = getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, &len);
+    munit_assert_int(rv, ==, 0);
+    munit_assert_int(size, >=, 128 * 1024);
+
+    __peer_stop(f, &peer);
+
+    return MUNIT_OK;
+}
+
+/* IPv6 addresses are enclosed in square brackets. */
+static MunitResult test_tcp_ipv6(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+    struct peer peer;
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    rv = raft_io_uv_tcp_init(&peer.transport, &f->logger, &f->loop, NULL);
+    munit_assert_int(rv, ==, 0);
+
+    rv = raft_io_uv_rpc__init(&peer.rpc, &f->logger, &f->loop,
+                              &peer.transport);
+    munit_assert_int(rv, ==, 0);
+
+    peer.stopped = false;
+    peer.message = NULL;
+
+    rv = raft_io_uv_rpc__start(&peer.rpc, 2, "[::1]:9001", &peer,
+                               __peer_recv_cb);
+    munit_assert_int(rv, ==, 0);
+
+    __message(f, message, RAFT_IO_REQUEST_VOTE);
+
+    message.server_id = 2;
+    message.server_address = "[::1]:9001";
+    message.request_vote.term = 5;
+
+    __send(f, message);
+
+    for (i = 0; i < 50 && peer.message == NULL; i++) {
+        test_uv_run(&f->loop, 1);
+    }
+
+    munit_assert_ptr_not_null(peer.message);
+    munit_assert_int(peer.message->type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(peer.message->server_id, ==, 1);
+    munit_assert_int(peer.message->request_vote.term, ==, 5);
+
+    munit_assert_int(f->send_cb.status, ==, 0);
+
+    __peer_stop(f, &peer);
+
+    return MUNIT_OK;
+}
+
+/* Malformed addresses are rejected when starting to listen. */
+static MunitResult test_tcp_bad_address(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+    const char *addresses[] = {"127.0.0.1:99999", "127.0.0.1:", "::1:9001",
+                               "[::1", "[::1]x", ":9001", NULL};
+    unsigned i;
+
+    (void)params;
+
+    for (i = 0; addresses[i] != NULL; i++) {
+        struct peer peer;
+        int rv;
+
+        rv = raft_io_uv_tcp_init(&peer.transport, &f->logger, &f->loop, NULL);
+        munit_assert_int(rv, ==, 0);
+
+        rv = peer.transport.start(&peer.transport, 2, addresses[i], NULL, NULL);
+        munit_assert_int(rv, ==, RAFT_ERR_IO_CONNECT);
+
+        peer.stopped = false;
+        peer.transport.stop(&peer.transport, &peer, __peer_stop_cb);
+
+        test_uv_run(&f->loop, 1);
+        munit_assert_true(peer.stopped);
+
+        raft_io_uv_tcp_close(&peer.transport);
+    }
+
+    return MUNIT_OK;
+}
+
+static MunitTest tcp_tests[] = {
+    {"/hostname", test_tcp_hostname, setup, tear_down, 0, NULL},
+    {"/ipv6", test_tcp_ipv6, setup, tear_down, 0, NULL},
+    {"/bad-address", test_tcp_bad_address, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -884,5 +2340,7 @@ static MunitTest recv_tests[] = {
 MunitSuite raft_io_uv_rpc_suites[] = {
     {"/send", send_tests, NULL, 1, 0},
     {"/recv", recv_tests, NULL, 1, 0},
+    {"/unix", unix_tests, NULL, 1, 0},
+    {"/tcp", tcp_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
@@ -0,0 +1,208 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../../src/lz4.h"
+
+#include "../lib/munit.h"
+
+/**
+ * Helpers
+ */
+
+/**
+ * Compress the given data and check that decompressing it gives back the
+ * original bytes. Return the compressed size.
+ */
+static size_t __round_trip(const void *src, size_t size)
+{
+    size_t capacity = raft__lz4_bound(size);
+    void *compressed = munit_malloc(capacity);
+    void *decompressed = munit_malloc(size + 1);
+    size_t n;
+    int rv;
+
+    n = raft__lz4_compress(src, size, compressed, capacity);
+    munit_assert_int(n, >, 0);
+    munit_assert_int(n, <=, capacity);
+
+    rv = raft__lz4_decompress(compressed, n, decompressed, size);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_memory_equal(size, decompressed, src);
+
+    free(compressed);
+    free(decompressed);
+
+    return n;
+}
+
+/**
+ * raft__lz4_compress
+ */
+
+/* Repetitive data shrinks. */
+static MunitResult test_compress_repetitive(const MunitParameter params[],
+                                            void *data)
+{
+    char buf[4096];
+    size_t n;
+    unsigned i;
+
+    (void)data;
+    (void)params;
+
+    for (i = 0; i < sizeof buf; i++) {
+        buf[i] = "set key%d value"[i % 15];
+    }
+
+    n = __round_trip(buf, sizeof buf);
+    munit_assert_int(n, <, sizeof buf / 10);
+
+    return MUNIT_OK;
+}
+
+/* A run of the same byte is encoded as a match overlapping its own output. */
+static MunitResult test_compress_run(const MunitParameter params[], void *data)
+{
+    uint8_t buf[1000];
+    size_t n;
+
+    (void)data;
+    (void)params;
+
+    memset(buf, 'x', sizeof buf);
+
+    n = __round_trip(buf, sizeof buf);
+    munit_assert_int(n, <, 20);
+
+    return MUNIT_OK;
+}
+
+/* Data that is too short to contain matches is stored as literals. */
+static MunitResult test_compress_short(const MunitParameter params[],
+                                       void *data)
+{
+    size_t n;
+
+    (void)data;
+    (void)params;
+
+    n = __round_trip("hello", 5);
+    munit_assert_int(n, ==, 6);
+
+    n = __round_trip("", 0);
+    munit_assert_int(n, ==, 1);
+
+    return MUNIT_OK;
+}
+
+/* Random data round-trips, and can't be compressed below its original size. */
+static MunitResult test_compress_random(const MunitParameter params[],
+                                        void *data)
+{
+    uint8_t buf[8192];
+    uint8_t out[8192];
+    size_t n;
+
+    (void)data;
+    (void)params;
+
+    munit_rand_memory(sizeof buf, buf);
+
+    __round_trip(buf, sizeof buf);
+
+    n = raft__lz4_compress(buf, sizeof buf, out, sizeof out);
+    munit_assert_int(n, ==, 0);
+
+    return MUNIT_OK;
+}
+
+static MunitTest compress_tests[] = {
+    {"/repetitive", test_compress_repetitive, NULL, NULL, 0, NULL},
+    {"/run", test_compress_run, NULL, NULL, 0, NULL},
+    {"/short", test_compress_short, NULL, NULL, 0, NULL},
+    {"/random", test_compress_random, NULL, NULL, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft__lz4_decompress
+ */
+
+/* The decompressed size must match the expected one. */
+static MunitResult test_decompress_bad_size(const MunitParameter params[],
+                                            void *data)
+{
+    uint8_t src[] = {0x50, 'h', 'e', 'l', 'l', 'o'};
+    char dst[8];
+    int rv;
+
+    (void)data;
+    (void)params;
+
+    rv = raft__lz4_decompress(src, sizeof src, dst, 4);
+    munit_assert_int(rv, ==, -1);
+
+    rv = raft__lz4_decompress(src, sizeof src, dst, 6);
+    munit_assert_int(rv, ==, -1);
+
+    rv = raft__lz4_decompress(src, sizeof src, dst, 5);
+    munit_assert_int(rv, ==, 0);
+
+    return MUNIT_OK;
+}
+
+/* A match can't point before the start of the output. */
+static MunitResult test_decompress_bad_offset(const MunitParameter params[],
+                                              void *data)
+{
+    uint8_t src[] = {0x10, 'a', 0x02, 0x00, 0x00};
+    char dst[8];
+    int rv;
+
+    (void)data;
+    (void)params;
+
+    rv = raft__lz4_decompress(src, sizeof src, dst, 5);
+    munit_assert_int(rv, ==, -1);
+
+    return MUNIT_OK;
+}
+
+/* The data ends in the middle of a sequence. */
+static MunitResult test_decompress_truncated(const MunitParameter params[],
+                                             void *data)
+{
+    uint8_t src[] = {0xf0, 0xff};
+    uint8_t literals[] = {0x50, 'h', 'e'};
+    char dst[300];
+    int rv;
+
+    (void)data;
+    (void)params;
+
+    rv = raft__lz4_decompress(src, sizeof src, dst, sizeof dst);
+    munit_assert_int(rv, ==, -1);
+
+    rv = raft__lz4_decompress(literals, sizeof literals, dst, 5);
+    munit_assert_int(rv, ==, -1);
+
+    return MUNIT_OK;
+}
+
+static MunitTest decompress_tests[] = {
+    {"/bad-size", test_decompress_bad_size, NULL, NULL, 0, NULL},
+    {"/bad-offset", test_decompress_bad_offset, NULL, NULL, 0, NULL},
+    {"/truncated", test_decompress_truncated, NULL, NULL, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Test suite
+ */
+
+MunitSuite raft_lz4_suites[] = {
+    {"/compress", compress_tests, NULL, 1, 0},
+    {"/decompress", decompress_tests, NULL, 1, 0},
+    {NULL, NULL, NULL, 0, 0},
+};
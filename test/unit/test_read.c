@@ -0,0 +1,870 @@
+#include <stdio.h>
+
+#include "../../include/raft.h"
+
+#include "../../src/configuration.h"
+#include "../../src/log.h"
+
+#include "../lib/fsm.h"
+#include "../lib/heap.h"
+#include "../lib/io.h"
+#include "../lib/logger.h"
+#include "../lib/munit.h"
+#include "../lib/raft.h"
+
+/**
+ * Helpers
+ */
+
+struct fixture
+{
+    TEST_RAFT_FIXTURE_FIELDS;
+    struct raft_read req;
+    struct
+    {
+        unsigned n;
+        int status;
+    } read_cb;
+};
+
+static void __read_cb(struct raft_read *req, int status)
+{
+    struct fixture *f = req->data;
+
+    f->read_cb.n++;
+    f->read_cb.status = status;
+}
+
+/**
+ * Setup and tear down
+ */
+
+static void *setup(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+
+    (void)user_data;
+
+    TEST_RAFT_FIXTURE_SETUP(f);
+
+    f->req.data = f;
+    f->read_cb.n = 0;
+    f->read_cb.status = -1;
+
+    return f;
+}
+
+static void tear_down(void *data)
+{
+    struct fixture *f = data;
+
+    TEST_RAFT_FIXTURE_TEAR_DOWN(f);
+
+    free(f);
+}
+
+/**
+ * Submit a read request and check that no error occurs.
+ */
+#define __read_index(F)                                        \
+    {                                                          \
+        int rv;                                                \
+                                                               \
+        rv = raft_read_index(&F->raft, &F->req, __read_cb);    \
+        munit_assert_int(rv, ==, 0);                           \
+    }
+
+/**
+ * Dispatch a successful AppendEntries result from the given server.
+ */
+#define __append_entries_result(F, ID)                                     \
+    {                                                                      \
+        struct raft_message message;                                       \
+        char address[4];                                                   \
+                                                                           \
+        sprintf(address, "%d", ID);                                        \
+                                                                           \
+        message.type = RAFT_IO_APPEND_ENTRIES_RESULT;                      \
+        message.server_id = ID;                                            \
+        message.server_address = address;                                  \
+        message.append_entries_result.term = F->raft.current_term;         \
+        message.append_entries_result.success = true;                      \
+        message.append_entries_result.last_log_index =                     \
+            F->raft.commit_index > 1 ? F->raft.commit_index : 2;           \
+                                                                           \
+        raft_io_stub_dispatch(&F->io, &message);                           \
+    }
+
+/**
+ * Dispatch an empty AppendEntries from the given leader.
+ */
+#define __append_entries(F, ID, PREV_LOG_INDEX)                       \
+    {                                                                 \
+        struct raft_message message;                                  \
+        char address[4];                                              \
+                                                                      \
+        sprintf(address, "%d", ID);                                   \
+                                                                      \
+        message.type = RAFT_IO_APPEND_ENTRIES;                        \
+        message.server_id = ID;                                       \
+        message.server_address = address;                             \
+        message.append_entries.term = F->raft.current_term;           \
+        message.append_entries.leader_id = ID;                        \
+        message.append_entries.prev_log_index = PREV_LOG_INDEX;       \
+        message.append_entries.prev_log_term = 1;                     \
+        message.append_entries.leader_commit = 1;                     \
+        message.append_entries.entries = NULL;                        \
+        message.append_entries.n_entries = 0;                         \
+                                                                      \
+        raft_io_stub_dispatch(&F->io, &message);                      \
+    }
+
+/**
+ * Dispatch a heartbeat from the given leader.
+ */
+#define __heartbeat(F, ID) __append_entries(F, ID, 1)
+
+/**
+ * Dispatch a ReadIndex result from the given leader.
+ */
+#define __read_index_result(F, ID, READ_ID, SUCCESS, INDEX)       \
+    {                                                             \
+        struct raft_message message;                              \
+        char address[4];                                          \
+                                                                  \
+        sprintf(address, "%d", ID);                               \
+                                                                  \
+        message.type = RAFT_IO_READ_INDEX_RESULT;                 \
+        message.server_id = ID;                                   \
+        message.server_address = address;                         \
+        message.read_index_result.term = F->raft.current_term;    \
+        message.read_index_result.id = READ_ID;                   \
+        message.read_index_result.success = SUCCESS;              \
+        message.read_index_result.index = INDEX;                  \
+                                                                  \
+        raft_io_stub_dispatch(&F->io, &message);                  \
+    }
+
+/**
+ * Assert that a ReadIndex RPC with the given ID was sent to the given server.
+ */
+#define __assert_read_index_sent(F, ID, READ_ID)                       \
+    {                                                                  \
+        struct raft_message *messages;                                 \
+        unsigned n;                                                    \
+        unsigned j;                                                    \
+        bool found = false;                                            \
+                                                                       \
+        raft_io_stub_flush(&F->io);                                    \
+        raft_io_stub_sent(&F->io, &messages, &n);                      \
+                                                                       \
+        for (j = 0; j < n; j++) {                                      \
+            if (messages[j].type == RAFT_IO_READ_INDEX) {              \
+                munit_assert_int(messages[j].server_id, ==, ID);       \
+                munit_assert_int(messages[j].read_index.id, ==, READ_ID); \
+                found = true;                                          \
+            }                                                          \
+        }                                                              \
+                                                                       \
+        munit_assert_true(found);                                      \
+    }
+
+/**
+ * Become leader of a 3-server cluster and commit an entry in the new term.
+ */
+#define __become_leader_and_commit(F)                          \
+    {                                                          \
+        test_bootstrap_and_start(&F->raft, 3, 1, 3);           \
+        __become_leader_and_commit_started(F);                 \
+    }
+
+/**
+ * Same as __become_leader_and_commit, for an already started instance.
+ */
+#define __become_leader_and_commit_started(F)                  \
+    {                                                          \
+        struct raft_buffer buf;                                \
+        int rv;                                                \
+                                                               \
+        test_become_leader(&F->raft);                          \
+                                                               \
+        test_fsm_encode_set_x(123, &buf);                      \
+        rv = raft_accept(&F->raft, &buf, 1);                   \
+        munit_assert_int(rv, ==, 0);                           \
+                                                               \
+        raft_io_stub_flush(&F->io);                            \
+                                                               \
+        __append_entries_result(F, 2);                         \
+                                                               \
+        munit_assert_int(F->raft.commit_index, ==, 2);         \
+        munit_assert_int(F->raft.last_applied, ==, 2);         \
+    }
+
+/**
+ * Return the number of successful results that the server with the given ID
+ * must still send to confirm the current round.
+ */
+static unsigned __missing_acks(struct fixture *f, unsigned id)
+{
+    size_t i = raft_configuration__index(&f->raft.configuration, id);
+    struct raft_read_peer *peer = &f->raft.leader_state.read_peers[i];
+
+    return peer->target - peer->n_acked;
+}
+
+/**
+ * Return the number of successful results that the server with the given ID
+ * must still send to confirm the current lease probe.
+ */
+static unsigned __missing_lease_acks(struct fixture *f, unsigned id)
+{
+    size_t i = raft_configuration__index(&f->raft.configuration, id);
+    struct raft_read_peer *peer = &f->raft.leader_state.read_peers[i];
+
+    return peer->lease_target - peer->n_acked;
+}
+
+/**
+ * Enable read leases with a drift of 100 milliseconds, become leader and
+ * obtain a lease by having server 2 acknowledge a heartbeat.
+ */
+#define __become_leader_with_lease(F)                            \
+    {                                                            \
+        unsigned missing;                                        \
+        unsigned j;                                              \
+                                                                 \
+        raft_set_read_lease(&F->raft, true, 100);                \
+        test_bootstrap_and_start(&F->raft, 3, 1, 3);             \
+        __become_leader_and_commit_started(F);                   \
+                                                                 \
+        raft_io_stub_advance(&F->io, F->raft.heartbeat_timeout + 1); \
+        munit_assert_true(F->raft.leader_state.lease_probing);   \
+                                                                 \
+        raft_io_stub_flush(&F->io);                              \
+                                                                 \
+        missing = __missing_lease_acks(F, 2);                    \
+        for (j = 0; j < missing; j++) {                          \
+            __append_entries_result(F, 2);                       \
+        }                                                        \
+                                                                 \
+        munit_assert_true(F->raft.leader_state.lease_valid);     \
+    }
+
+/**
+ * raft_read_index
+ */
+
+/* If the raft instance is not in leader state, an error is returned. */
+static MunitResult test_not_leader(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    rv = raft_read_index(&f->raft, &f->req, __read_cb);
+    munit_assert_int(rv, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+/* Reads are held until an entry of the current term is committed. */
+static MunitResult test_wait_commit(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_buffer buf;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __read_index(f);
+
+    munit_assert_ptr_equal(f->raft.leader_state.reads, &f->req);
+    munit_assert_ptr_null(f->raft.leader_state.reads_round);
+
+    test_fsm_encode_set_x(123, &buf);
+    rv = raft_accept(&f->raft, &buf, 1);
+    munit_assert_int(rv, ==, 0);
+
+    raft_io_stub_flush(&f->io);
+
+    /* Committing the entry starts the round. */
+    __append_entries_result(f, 2);
+
+    munit_assert_ptr_null(f->raft.leader_state.reads);
+    munit_assert_ptr_equal(f->raft.leader_state.reads_round, &f->req);
+    munit_assert_int(f->req.index, ==, 2);
+    munit_assert_int(f->read_cb.n, ==, 0);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* The read completes once a majority acknowledges a heartbeat sent after the
+ * read index was recorded, without writing anything to the log. */
+static MunitResult test_confirm(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+    unsigned missing;
+    unsigned i;
+
+    (void)params;
+
+    __become_leader_and_commit(f);
+
+    __read_index(f);
+
+    /* Heartbeats are sent to both followers, nothing gets appended. */
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+    munit_assert_int(n, ==, 2);
+    munit_assert_int(messages[0].append_entries.n_entries, ==, 0);
+    munit_assert_int(raft_log__last_index(&f->raft.log), ==, 2);
+
+    /* Results for requests sent before the round don't count. */
+    missing = __missing_acks(f, 3);
+    munit_assert_int(missing, >, 0);
+
+    for (i = 0; i < missing - 1; i++) {
+        __append_entries_result(f, 3);
+        munit_assert_int(f->read_cb.n, ==, 0);
+    }
+
+    __append_entries_result(f, 3);
+
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, 0);
+    munit_assert_int(f->req.index, ==, 2);
+
+    return MUNIT_OK;
+}
+
+/* Reads submitted while a round is in progress are batched in the next one. */
+static MunitResult test_batch(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_read req1;
+    struct raft_read req2;
+    unsigned missing;
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    __become_leader_and_commit(f);
+
+    __read_index(f);
+
+    req1.data = f;
+    req2.data = f;
+
+    rv = raft_read_index(&f->raft, &req1, __read_cb);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_read_index(&f->raft, &req2, __read_cb);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_ptr_equal(f->raft.leader_state.reads_round, &f->req);
+
+    raft_io_stub_flush(&f->io);
+
+    missing = __missing_acks(f, 2);
+    for (i = 0; i < missing; i++) {
+        __append_entries_result(f, 2);
+    }
+
+    /* The first read is done and the other two started a new round. */
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_ptr_not_null(f->raft.leader_state.reads_round);
+    munit_assert_ptr_null(f->raft.leader_state.reads);
+
+    raft_io_stub_flush(&f->io);
+
+    missing = __missing_acks(f, 2);
+    for (i = 0; i < missing; i++) {
+        __append_entries_result(f, 2);
+    }
+
+    munit_assert_int(f->read_cb.n, ==, 3);
+
+    return MUNIT_OK;
+}
+
+/* Pending reads fail when leadership is lost. */
+static MunitResult test_step_down(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+
+    (void)params;
+
+    __become_leader_and_commit(f);
+
+    __read_index(f);
+
+    raft_io_stub_flush(&f->io);
+
+    /* Receive a result carrying a higher term. */
+    message.type = RAFT_IO_APPEND_ENTRIES_RESULT;
+    message.server_id = 2;
+    message.server_address = "2";
+    message.append_entries_result.term = f->raft.current_term + 1;
+    message.append_entries_result.success = false;
+    message.append_entries_result.last_log_index = 2;
+
+    raft_io_stub_dispatch(&f->io, &message);
+
+    munit_assert_int(f->raft.state, ==, RAFT_STATE_FOLLOWER);
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+static MunitTest read_index_tests[] = {
+    {"/not-leader", test_not_leader, setup, tear_down, 0, NULL},
+    {"/wait-commit", test_wait_commit, setup, tear_down, 0, NULL},
+    {"/confirm", test_confirm, setup, tear_down, 0, NULL},
+    {"/batch", test_batch, setup, tear_down, 0, NULL},
+    {"/step-down", test_step_down, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Read leases
+ */
+
+/* While the lease is held reads complete immediately, without heartbeats. */
+static MunitResult test_lease_local(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+
+    (void)params;
+
+    __become_leader_with_lease(f);
+
+    __read_index(f);
+
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, 0);
+    munit_assert_int(f->req.index, ==, 2);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+    munit_assert_int(n, ==, 0);
+
+    return MUNIT_OK;
+}
+
+/* Without acknowledgements the lease expires after the election timeout minus
+ * the drift, measured from when the confirmed heartbeat was sent. */
+static MunitResult test_lease_expired(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    unsigned duration;
+
+    (void)params;
+
+    __become_leader_with_lease(f);
+
+    duration = f->raft.election_timeout - 100;
+
+    raft_io_stub_advance(&f->io, duration - 1);
+    raft_io_stub_flush(&f->io);
+
+    __read_index(f);
+    munit_assert_int(f->read_cb.n, ==, 1);
+
+    raft_io_stub_advance(&f->io, 1);
+    raft_io_stub_flush(&f->io);
+
+    /* The lease is gone, a regular round is needed. */
+    __read_index(f);
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_ptr_equal(f->raft.leader_state.reads_round, &f->req);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* With adaptive election timeouts the lease is bounded by their minimum. */
+static MunitResult test_lease_adaptive(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    unsigned duration;
+
+    (void)params;
+
+    raft_set_adaptive_election_timeout(&f->raft, true, 500);
+
+    __become_leader_with_lease(f);
+
+    duration = 500 - 100;
+
+    raft_io_stub_advance(&f->io, duration - 1);
+    raft_io_stub_flush(&f->io);
+
+    __read_index(f);
+    munit_assert_int(f->read_cb.n, ==, 1);
+
+    raft_io_stub_advance(&f->io, 1);
+    raft_io_stub_flush(&f->io);
+
+    /* The lease is gone, a regular round is needed. */
+    __read_index(f);
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_ptr_equal(f->raft.leader_state.reads_round, &f->req);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* A leadership transfer revokes the lease, and reads must be confirmed by a
+ * quorum again. */
+static MunitResult test_lease_transfer(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    unsigned missing;
+    unsigned i;
+    int rv;
+
+    (void)params;
+
+    __become_leader_with_lease(f);
+
+    rv = raft_transfer_leadership(&f->raft, 2);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_false(f->raft.leader_state.lease_valid);
+
+    __read_index(f);
+
+    munit_assert_int(f->read_cb.n, ==, 0);
+    munit_assert_ptr_equal(f->raft.leader_state.reads_round, &f->req);
+
+    /* Heartbeats don't start a new lease probe. */
+    raft_io_stub_advance(&f->io, f->raft.heartbeat_timeout + 1);
+    munit_assert_false(f->raft.leader_state.lease_probing);
+
+    raft_io_stub_flush(&f->io);
+
+    /* The read completes once a quorum acknowledges the round. */
+    missing = __missing_acks(f, 2);
+    for (i = 0; i < missing; i++) {
+        __append_entries_result(f, 2);
+    }
+
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, 0);
+    munit_assert_false(f->raft.leader_state.lease_valid);
+
+    return MUNIT_OK;
+}
+
+static MunitTest lease_tests[] = {
+    {"/local", test_lease_local, setup, tear_down, 0, NULL},
+    {"/expired", test_lease_expired, setup, tear_down, 0, NULL},
+    {"/adaptive", test_lease_adaptive, setup, tear_down, 0, NULL},
+    {"/transfer", test_lease_transfer, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Reads served by followers
+ */
+
+/* A follower that doesn't know the leader can't serve reads. */
+static MunitResult test_follower_no_leader(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    rv = raft_read_index(&f->raft, &f->req, __read_cb);
+    munit_assert_int(rv, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+/* The follower asks the leader for its read index and completes the read once
+ * it has applied entries up to it. */
+static MunitResult test_follower_confirm(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    __read_index(f);
+    __assert_read_index_sent(f, 2, 1);
+
+    /* Results for other requests are ignored. */
+    __read_index_result(f, 2, 2, true, 1);
+    munit_assert_int(f->read_cb.n, ==, 0);
+
+    __read_index_result(f, 2, 1, true, 1);
+
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, 0);
+    munit_assert_int(f->req.index, ==, 1);
+
+    return MUNIT_OK;
+}
+
+/* The read waits for the follower to apply entries up to the read index. */
+static MunitResult test_follower_wait_apply(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    __read_index(f);
+    __read_index_result(f, 2, 1, true, 2);
+
+    munit_assert_int(f->read_cb.n, ==, 0);
+    munit_assert_ptr_equal(f->raft.follower_state.reads_confirmed, &f->req);
+
+    raft_io_stub_flush(&f->io);
+
+    return MUNIT_OK;
+}
+
+/* Reads submitted while an RPC is in flight are batched in the next one. */
+static MunitResult test_follower_batch(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_read req1;
+    struct raft_read req2;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    __read_index(f);
+    __assert_read_index_sent(f, 2, 1);
+
+    req1.data = f;
+    req2.data = f;
+
+    rv = raft_read_index(&f->raft, &req1, __read_cb);
+    munit_assert_int(rv, ==, 0);
+    rv = raft_read_index(&f->raft, &req2, __read_cb);
+    munit_assert_int(rv, ==, 0);
+
+    __read_index_result(f, 2, 1, true, 1);
+    munit_assert_int(f->read_cb.n, ==, 1);
+
+    __assert_read_index_sent(f, 2, 2);
+
+    __read_index_result(f, 2, 2, true, 1);
+    munit_assert_int(f->read_cb.n, ==, 3);
+
+    return MUNIT_OK;
+}
+
+/* If a new leader is discovered, the RPC is sent to it. */
+static MunitResult test_follower_new_leader(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    __read_index(f);
+    __assert_read_index_sent(f, 2, 1);
+
+    f->raft.current_term++;
+    __heartbeat(f, 3);
+
+    __assert_read_index_sent(f, 3, 2);
+
+    /* The old leader's result is ignored. */
+    __read_index_result(f, 2, 1, true, 1);
+    munit_assert_int(f->read_cb.n, ==, 0);
+
+    __read_index_result(f, 3, 2, true, 1);
+    munit_assert_int(f->read_cb.n, ==, 1);
+
+    return MUNIT_OK;
+}
+
+/* If the server answers that it's not the leader, the reads fail. */
+static MunitResult test_follower_rejected(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    __read_index(f);
+    __read_index_result(f, 2, 1, false, 0);
+
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+/* Pending reads fail when the follower starts an election. */
+static MunitResult test_follower_election(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    __read_index(f);
+
+    raft_io_stub_advance(&f->io, f->raft.election_timeout_rand + 1);
+
+    munit_assert_int(f->raft.state, ==, RAFT_STATE_CANDIDATE);
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, RAFT_ERR_NOT_LEADER);
+
+    return MUNIT_OK;
+}
+
+static MunitTest follower_tests[] = {
+    {"/no-leader", test_follower_no_leader, setup, tear_down, 0, NULL},
+    {"/confirm", test_follower_confirm, setup, tear_down, 0, NULL},
+    {"/wait-apply", test_follower_wait_apply, setup, tear_down, 0, NULL},
+    {"/batch", test_follower_batch, setup, tear_down, 0, NULL},
+    {"/new-leader", test_follower_new_leader, setup, tear_down, 0, NULL},
+    {"/rejected", test_follower_rejected, setup, tear_down, 0, NULL},
+    {"/election", test_follower_election, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_read_stale
+ */
+
+/* A follower that recently heard from the leader serves the read at once. */
+static MunitResult test_stale_local(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    raft_io_stub_advance(&f->io, 50);
+
+    rv = raft_read_stale(&f->raft, &f->req, 100, __read_cb);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(f->read_cb.n, ==, 1);
+    munit_assert_int(f->read_cb.status, ==, 0);
+    munit_assert_int(f->req.index, ==, 1);
+
+    return MUNIT_OK;
+}
+
+/* If the bound is exceeded, the leader is asked for its read index. */
+static MunitResult test_stale_exceeded(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    raft_io_stub_advance(&f->io, 150);
+
+    rv = raft_read_stale(&f->raft, &f->req, 100, __read_cb);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(f->read_cb.n, ==, 0);
+    __assert_read_index_sent(f, 2, 1);
+
+    return MUNIT_OK;
+}
+
+/* An AppendEntries RPC rejected because the log doesn't match doesn't refresh
+ * the staleness bound, even if it resets the election timer. */
+static MunitResult test_stale_mismatch(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __heartbeat(f, 2);
+
+    raft_io_stub_advance(&f->io, 150);
+
+    __append_entries(f, 2, 5);
+
+    munit_assert_int(f->raft.timer, ==, 0);
+
+    rv = raft_read_stale(&f->raft, &f->req, 100, __read_cb);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(f->read_cb.n, ==, 0);
+    __assert_read_index_sent(f, 2, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitTest stale_tests[] = {
+    {"/local", test_stale_local, setup, tear_down, 0, NULL},
+    {"/exceeded", test_stale_exceeded, setup, tear_down, 0, NULL},
+    {"/mismatch", test_stale_mismatch, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Test suite
+ */
+
+MunitSuite raft_read_suites[] = {
+    {"/read-index", read_index_tests, NULL, 1, 0},
+    {"/lease", lease_tests, NULL, 1, 0},
+    {"/follower", follower_tests, NULL, 1, 0},
+    {"/stale", stale_tests, NULL, 1, 0},
+    {NULL, NULL, NULL, 0, 0},
+};
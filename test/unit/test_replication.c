@@ -19,8 +19,40 @@
 struct fixture
 {
     TEST_RAFT_FIXTURE_FIELDS;
+    unsigned n_batches;  /* Number of calls to __apply_batch */
+    unsigned n_applied;  /* Number of commands passed to __apply_batch */
+    unsigned n_events;   /* Number of RAFT_EVENT_COMMAND_APPLIED fired */
+    raft_index applied;  /* Index carried by the last event */
 };
 
+/**
+ * FSM batch method that just counts the commands it's passed. The fixture is
+ * stored as FSM data, see __enable_apply_batch.
+ */
+static int __apply_batch(struct raft_fsm *fsm,
+                         const struct raft_buffer bufs[],
+                         unsigned n)
+{
+    struct fixture *f = fsm->data;
+
+    (void)bufs;
+
+    f->n_batches++;
+    f->n_applied += n;
+
+    return 0;
+}
+
+static void __command_applied_cb(void *data, int event, void *payload)
+{
+    struct fixture *f = data;
+
+    (void)event;
+
+    f->n_events++;
+    f->applied = *(raft_index *)payload;
+}
+
 /**
  * Setup and tear down
  */
@@ -33,6 +65,13 @@ static void *setup(const MunitParameter params[], void *user_data)
 
     TEST_RAFT_FIXTURE_SETUP(f);
 
+    f->n_batches = 0;
+    f->n_applied = 0;
+    f->n_events = 0;
+    f->applied = 0;
+
+    raft_watch(&f->raft, RAFT_EVENT_COMMAND_APPLIED, __command_applied_cb);
+
     return f;
 }
 
@@ -52,7 +91,7 @@ static void tear_down(void *data)
     {                                                           \
         int rv;                                                 \
                                                                 \
-        rv = raft_state__convert_to_candidate(&F->raft);        \
+        rv = raft_state__convert_to_candidate(&F->raft, false); \
         munit_assert_int(rv, ==, 0);                            \
                                                                 \
         rv = raft_state__convert_to_leader(&F->raft);           \
@@ -79,6 +118,25 @@ static void tear_down(void *data)
         munit_assert_int(rv, ==, 0);                                          \
     }
 
+/**
+ * Make the fixture's FSM use the __apply_batch method. The original FSM data
+ * is saved and restored by __disable_apply_batch.
+ */
+#define __enable_apply_batch(F, DATA) \
+    {                                 \
+        DATA = F->fsm.data;           \
+        F->fsm.version = 2;           \
+        F->fsm.data = F;              \
+        F->fsm.apply_batch = __apply_batch; \
+    }
+
+#define __disable_apply_batch(F, DATA) \
+    {                                  \
+        F->fsm.version = 1;            \
+        F->fsm.data = DATA;            \
+        F->fsm.apply_batch = NULL;     \
+    }
+
 /**
  * raft_replication__send_append_entries
  */
@@ -200,8 +258,400 @@ static MunitResult test_trigger_io_err(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* No AppendEntries is sent to a congested follower, while the others keep
+ * receiving them. */
+static MunitResult test_trigger_congested(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    __convert_to_leader(f);
+    __append_entry(f);
+
+    raft_io_stub_congested(&f->io, 2);
+
+    raft_replication__trigger(&f->raft, 0);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(messages[0].type, ==, RAFT_IO_APPEND_ENTRIES);
+    munit_assert_int(messages[0].server_id, ==, 3);
+
+    /* Once the congestion clears, the follower gets its entries again. */
+    raft_io_stub_congested(&f->io, 0);
+
+    raft_replication__trigger(&f->raft, 0);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 2);
+
+    return MUNIT_OK;
+}
+
+/**
+ * Turn the server with the given ID into a learner.
+ */
+#define __set_learner(F, ID)                                       \
+    {                                                              \
+        struct raft_configuration *c = &F->raft.configuration;     \
+        size_t i = raft_configuration__index(c, ID);               \
+                                                                   \
+        c->servers[i].voting = false;                              \
+        c->servers[i].learner = true;                              \
+        raft_configuration__update_voting(c);                      \
+    }
+
+/* Learners are sent AppendEntries after all other servers. */
+static MunitResult test_trigger_learners_last(const MunitParameter params[],
+                                              void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __set_learner(f, 2);
+
+    __convert_to_leader(f);
+    __append_entry(f);
+
+    raft_replication__trigger(&f->raft, 0);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 2);
+    munit_assert_int(messages[0].server_id, ==, 3);
+    munit_assert_int(messages[1].server_id, ==, 2);
+
+    return MUNIT_OK;
+}
+
+/* Lazy learners get new entries only with heartbeats, or once a heartbeat
+ * timeout has elapsed since they were last sent entries. */
+static MunitResult test_trigger_lazy_learners(const MunitParameter params[],
+                                              void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    __set_learner(f, 2);
+    raft_set_lazy_learners(&f->raft, true);
+
+    __convert_to_leader(f);
+
+    /* A new entry is sent only to the voting follower. */
+    __append_entry(f);
+    raft_replication__trigger(&f->raft, 2);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(messages[0].server_id, ==, 3);
+
+    /* A heartbeat reaches the learner too. */
+    raft_replication__trigger(&f->raft, 0);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 2);
+
+    /* If the leader is never idle, the learner is still served once per
+     * heartbeat timeout. */
+    f->raft.leader_state.clock += f->raft.heartbeat_timeout;
+
+    __append_entry(f);
+    raft_replication__trigger(&f->raft, 3);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 2);
+    munit_assert_int(messages[1].server_id, ==, 2);
+
+    return MUNIT_OK;
+}
+
 static MunitTest trigger_tests[] = {
     {"/io-err", test_trigger_io_err, setup, tear_down, 0, NULL},
+    {"/congested", test_trigger_congested, setup, tear_down, 0, NULL},
+    {"/learners-last", test_trigger_learners_last, setup, tear_down, 0, NULL},
+    {"/lazy-learners", test_trigger_lazy_learners, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_replication__apply
+ */
+
+/* Contiguous committed commands are passed to the FSM in a single batch, and a
+ * single event is fired for them. */
+static MunitResult test_apply_batch(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    void *fsm_data;
+    int rv;
+
+    (void)params;
+
+    __enable_apply_batch(f, fsm_data);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __convert_to_leader(f);
+    __append_entry(f);
+    __append_entry(f);
+    __append_entry(f);
+
+    f->raft.commit_index = 4;
+
+    rv = raft_replication__apply(&f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(f->raft.last_applied, ==, 4);
+    munit_assert_int(f->n_batches, ==, 1);
+    munit_assert_int(f->n_applied, ==, 3);
+    munit_assert_int(f->n_events, ==, 1);
+    munit_assert_int(f->applied, ==, 4);
+
+    /* Applying again is a no-op. */
+    rv = raft_replication__apply(&f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_int(f->n_batches, ==, 1);
+
+    __disable_apply_batch(f, fsm_data);
+
+    return MUNIT_OK;
+}
+
+/* When applying in the background, last_applied is updated only once the
+ * queued work has completed, and entries committed in the meantime are applied
+ * right after. */
+static MunitResult test_apply_background(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+    void *fsm_data;
+    int rv;
+
+    (void)params;
+
+    __enable_apply_batch(f, fsm_data);
+
+    raft_set_apply_in_background(&f->raft, true);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __convert_to_leader(f);
+    __append_entry(f);
+    __append_entry(f);
+
+    f->raft.commit_index = 2;
+
+    rv = raft_replication__apply(&f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    munit_assert_true(f->raft.applying);
+    munit_assert_int(f->raft.last_applied, ==, 1);
+    munit_assert_int(f->n_batches, ==, 0);
+
+    /* A new commit while the work is in flight doesn't queue more work. */
+    f->raft.commit_index = 3;
+
+    rv = raft_replication__apply(&f->raft);
+    munit_assert_int(rv, ==, 0);
+
+    raft_io_stub_flush(&f->io);
+
+    munit_assert_int(f->raft.last_applied, ==, 2);
+    munit_assert_int(f->n_batches, ==, 1);
+    munit_assert_int(f->applied, ==, 2);
+
+    /* The completion callback has queued the remaining command. */
+    munit_assert_true(f->raft.applying);
+
+    raft_io_stub_flush(&f->io);
+
+    munit_assert_false(f->raft.applying);
+    munit_assert_int(f->raft.last_applied, ==, 3);
+    munit_assert_int(f->n_batches, ==, 2);
+    munit_assert_int(f->n_applied, ==, 2);
+    munit_assert_int(f->n_events, ==, 2);
+
+    __disable_apply_batch(f, fsm_data);
+
+    return MUNIT_OK;
+}
+
+/* A failure occurs when queuing the background work. */
+static MunitResult test_apply_background_io_err(const MunitParameter params[],
+                                                void *data)
+{
+    struct fixture *f = data;
+    int rv;
+
+    (void)params;
+
+    raft_set_apply_in_background(&f->raft, true);
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __convert_to_leader(f);
+    __append_entry(f);
+
+    f->raft.commit_index = 2;
+
+    raft_io_stub_fault(&f->io, 0, 1);
+
+    rv = raft_replication__apply(&f->raft);
+    munit_assert_int(rv, ==, RAFT_ERR_IO);
+
+    munit_assert_false(f->raft.applying);
+    munit_assert_int(f->raft.last_applied, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitTest apply_tests[] = {
+    {"/batch", test_apply_batch, setup, tear_down, 0, NULL},
+    {"/background", test_apply_background, setup, tear_down, 0, NULL},
+    {"/background-io-err", test_apply_background_io_err, setup, tear_down, 0,
+     NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_replication__quorum
+ */
+
+/**
+ * Append the given number of entries in the current term.
+ */
+#define __append_entries_current_term(F, N)                               \
+    {                                                                     \
+        unsigned i_;                                                      \
+                                                                          \
+        for (i_ = 0; i_ < N; i_++) {                                      \
+            struct raft_buffer buf;                                       \
+            int rv;                                                       \
+                                                                          \
+            buf.len = 8;                                                  \
+            buf.base = raft_malloc(buf.len);                              \
+            munit_assert_ptr_not_null(buf.base);                          \
+                                                                          \
+            rv = raft_log__append(&F->raft.log, F->raft.current_term,     \
+                                  RAFT_LOG_COMMAND, &buf, NULL);          \
+            munit_assert_int(rv, ==, 0);                                  \
+        }                                                                 \
+    }
+
+/**
+ * Set the match index of the server with the given ID.
+ */
+#define __set_match_index(F, ID, INDEX)                                    \
+    {                                                                      \
+        size_t i_ = raft_configuration__index(&F->raft.configuration, ID); \
+        F->raft.leader_state.match_index[i_] = INDEX;                      \
+    }
+
+/* The commit index jumps to the median of the voting servers' match indexes,
+ * regardless of which result triggered the computation. */
+static MunitResult test_quorum_median(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 5, 1, 5);
+
+    __convert_to_leader(f);
+    __append_entries_current_term(f, 10);
+
+    __set_match_index(f, 1, 11);
+    __set_match_index(f, 2, 8);
+    __set_match_index(f, 3, 4);
+    __set_match_index(f, 4, 0);
+    __set_match_index(f, 5, 10);
+
+    raft_replication__quorum(&f->raft);
+
+    munit_assert_int(f->raft.commit_index, ==, 8);
+
+    return MUNIT_OK;
+}
+
+/* Match indexes of non-voting servers are not counted. */
+static MunitResult test_quorum_non_voting(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 2);
+
+    __convert_to_leader(f);
+    __append_entries_current_term(f, 4);
+
+    __set_match_index(f, 1, 5);
+    __set_match_index(f, 2, 3);
+    __set_match_index(f, 3, 5);
+
+    raft_replication__quorum(&f->raft);
+
+    munit_assert_int(f->raft.commit_index, ==, 3);
+
+    return MUNIT_OK;
+}
+
+/* Entries from previous terms are not committed by counting replicas. */
+static MunitResult test_quorum_old_term(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    __convert_to_leader(f);
+    __append_entry(f);
+    __append_entry(f);
+
+    __set_match_index(f, 1, 3);
+    __set_match_index(f, 2, 3);
+
+    raft_replication__quorum(&f->raft);
+
+    munit_assert_int(f->raft.commit_index, ==, 1);
+
+    return MUNIT_OK;
+}
+
+static MunitTest quorum_tests[] = {
+    {"/median", test_quorum_median, setup, tear_down, 0, NULL},
+    {"/non-voting", test_quorum_non_voting, setup, tear_down, 0, NULL},
+    {"/old-term", test_quorum_old_term, setup, tear_down, 0, NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
@@ -211,5 +661,7 @@ static MunitTest trigger_tests[] = {
 MunitSuite raft_replication_suites[] = {
     {"/send-append-entries", send_append_entries_tests, NULL, 1, 0},
     {"/trigger", trigger_tests, NULL, 1, 0},
+    {"/apply", apply_tests, NULL, 1, 0},
+    {"/quorum", quorum_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
@@ -0,0 +1,256 @@
+#include <stdio.h>
+
+#include "../../include/raft.h"
+
+#include "../../src/configuration.h"
+#include "../../src/rpc_read_index.h"
+
+#include "../lib/fsm.h"
+#include "../lib/heap.h"
+#include "../lib/io.h"
+#include "../lib/logger.h"
+#include "../lib/munit.h"
+#include "../lib/raft.h"
+
+/**
+ * Helpers
+ */
+
+struct fixture
+{
+    TEST_RAFT_FIXTURE_FIELDS;
+};
+
+/**
+ * Setup and tear down
+ */
+
+static void *setup(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+
+    (void)user_data;
+
+    TEST_RAFT_FIXTURE_SETUP(f);
+
+    return f;
+}
+
+static void tear_down(void *data)
+{
+    struct fixture *f = data;
+
+    TEST_RAFT_FIXTURE_TEAR_DOWN(f);
+
+    free(f);
+}
+
+/**
+ * Call raft_rpc__recv_read_index with the given parameters and check that no
+ * error occurs.
+ */
+#define __recv_read_index(F, ID, TERM, READ_ID)                            \
+    {                                                                      \
+        struct raft_read_index args;                                       \
+        char address[4];                                                   \
+        int rv;                                                            \
+                                                                           \
+        sprintf(address, "%d", ID);                                        \
+                                                                           \
+        args.term = TERM;                                                  \
+        args.id = READ_ID;                                                 \
+                                                                           \
+        rv = raft_rpc__recv_read_index(&F->raft, ID, address, &args);      \
+        munit_assert_int(rv, ==, 0);                                       \
+    }
+
+/**
+ * Dispatch a successful AppendEntries result from the given server.
+ */
+#define __append_entries_result(F, ID)                                     \
+    {                                                                      \
+        struct raft_message message;                                       \
+        char address[4];                                                   \
+                                                                           \
+        sprintf(address, "%d", ID);                                        \
+                                                                           \
+        message.type = RAFT_IO_APPEND_ENTRIES_RESULT;                      \
+        message.server_id = ID;                                            \
+        message.server_address = address;                                  \
+        message.append_entries_result.term = F->raft.current_term;         \
+        message.append_entries_result.success = true;                      \
+        message.append_entries_result.last_log_index = 2;                  \
+                                                                           \
+        raft_io_stub_dispatch(&F->io, &message);                           \
+    }
+
+/**
+ * Become leader of a 3-server cluster and commit an entry in the new term.
+ */
+#define __become_leader_and_commit(F)                          \
+    {                                                          \
+        struct raft_buffer buf;                                \
+        int rv;                                                \
+                                                               \
+        test_bootstrap_and_start(&F->raft, 3, 1, 3);           \
+        test_become_leader(&F->raft);                          \
+                                                               \
+        test_fsm_encode_set_x(123, &buf);                      \
+        rv = raft_accept(&F->raft, &buf, 1);                   \
+        munit_assert_int(rv, ==, 0);                           \
+                                                               \
+        raft_io_stub_flush(&F->io);                            \
+                                                               \
+        __append_entries_result(F, 2);                         \
+                                                               \
+        munit_assert_int(F->raft.commit_index, ==, 2);         \
+    }
+
+/**
+ * Return the ReadIndex result sent to the given server, or NULL.
+ */
+static struct raft_read_index_result *__result_sent(struct fixture *f,
+                                                    unsigned id)
+{
+    struct raft_message *messages;
+    unsigned n;
+    unsigned i;
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    for (i = 0; i < n; i++) {
+        if (messages[i].type == RAFT_IO_READ_INDEX_RESULT &&
+            messages[i].server_id == id) {
+            return &messages[i].read_index_result;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * raft_rpc__recv_read_index
+ */
+
+/* If the server is not the leader, the request is rejected. */
+static MunitResult test_req_not_leader(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_read_index_result *result;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    __recv_read_index(f, 2, f->raft.current_term, 5);
+
+    result = __result_sent(f, 2);
+    munit_assert_ptr_not_null(result);
+
+    munit_assert_int(result->id, ==, 5);
+    munit_assert_false(result->success);
+
+    return MUNIT_OK;
+}
+
+/* The leader replies with its read index once leadership is confirmed. */
+static MunitResult test_req_confirm(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_read_index_result *result;
+    unsigned i;
+
+    (void)params;
+
+    __become_leader_and_commit(f);
+
+    __recv_read_index(f, 3, f->raft.current_term, 5);
+
+    munit_assert_ptr_null(__result_sent(f, 3));
+
+    for (i = 0; i < 3; i++) {
+        __append_entries_result(f, 3);
+    }
+
+    result = __result_sent(f, 3);
+    munit_assert_ptr_not_null(result);
+
+    munit_assert_int(result->term, ==, f->raft.current_term);
+    munit_assert_int(result->id, ==, 5);
+    munit_assert_true(result->success);
+    munit_assert_int(result->index, ==, 2);
+
+    return MUNIT_OK;
+}
+
+/* If the request carries a higher term, the leader steps down and rejects
+ * it. */
+static MunitResult test_req_higher_term(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+    struct raft_read_index_result *result;
+
+    (void)params;
+
+    __become_leader_and_commit(f);
+
+    __recv_read_index(f, 2, f->raft.current_term + 1, 5);
+
+    munit_assert_int(f->raft.state, ==, RAFT_STATE_FOLLOWER);
+
+    result = __result_sent(f, 2);
+    munit_assert_ptr_not_null(result);
+    munit_assert_false(result->success);
+
+    return MUNIT_OK;
+}
+
+/* If leadership is lost while confirming, no reply is sent. */
+static MunitResult test_req_step_down(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+
+    (void)params;
+
+    __become_leader_and_commit(f);
+
+    __recv_read_index(f, 3, f->raft.current_term, 5);
+
+    raft_io_stub_flush(&f->io);
+
+    message.type = RAFT_IO_APPEND_ENTRIES_RESULT;
+    message.server_id = 2;
+    message.server_address = "2";
+    message.append_entries_result.term = f->raft.current_term + 1;
+    message.append_entries_result.success = false;
+    message.append_entries_result.last_log_index = 2;
+
+    raft_io_stub_dispatch(&f->io, &message);
+
+    munit_assert_int(f->raft.state, ==, RAFT_STATE_FOLLOWER);
+    munit_assert_ptr_null(__result_sent(f, 3));
+
+    return MUNIT_OK;
+}
+
+static MunitTest req_tests[] = {
+    {"/not-leader", test_req_not_leader, setup, tear_down, 0, NULL},
+    {"/confirm", test_req_confirm, setup, tear_down, 0, NULL},
+    {"/higher-term", test_req_higher_term, setup, tear_down, 0, NULL},
+    {"/step-down", test_req_step_down, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Test suite
+ */
+
+MunitSuite raft_rpc_read_index_suites[] = {
+    {"/req", req_tests, NULL, 1, 0},
+    {NULL, NULL, NULL, 0, 0},
+};
@@ -64,6 +64,7 @@ static void tear_down(void *data)
         args.candidate_id = CANDIDATE_ID;                                 \
         args.last_log_index = LAST_LOG_INDEX;                             \
         args.last_log_term = LAST_LOG_TERM;                               \
+        args.disrupt_leader = false;                                      \
                                                                           \
         rv = raft_rpc__recv_request_vote(&F->raft, CANDIDATE_ID, address, \
                                          &args);                          \
@@ -89,6 +90,47 @@ static void tear_down(void *data)
         munit_assert_int(rv, ==, 0);                                         \
     }
 
+/**
+ * Call raft_rpc__recv_pre_vote with the given parameters and check that no
+ * error occurs.
+ */
+#define __recv_pre_vote(F, TERM, CANDIDATE_ID, LAST_LOG_INDEX, LAST_LOG_TERM) \
+    {                                                                         \
+        int rv;                                                               \
+        struct raft_request_vote args;                                        \
+        char address[4];                                                      \
+                                                                              \
+        sprintf(address, "%d", CANDIDATE_ID);                                 \
+                                                                              \
+        args.term = TERM;                                                     \
+        args.candidate_id = CANDIDATE_ID;                                     \
+        args.last_log_index = LAST_LOG_INDEX;                                 \
+        args.last_log_term = LAST_LOG_TERM;                                   \
+        args.disrupt_leader = false;                                          \
+                                                                              \
+        rv = raft_rpc__recv_pre_vote(&F->raft, CANDIDATE_ID, address, &args); \
+        munit_assert_int(rv, ==, 0);                                          \
+    }
+
+/**
+ * Call raft_rpc__recv_pre_vote_result with the given parameters and check
+ * that no error occurs.
+ */
+#define __recv_pre_vote_result(F, VOTER_ID, TERM, GRANTED)                    \
+    {                                                                         \
+        struct raft_request_vote_result result;                               \
+        char address[4];                                                      \
+        int rv;                                                               \
+                                                                              \
+        sprintf(address, "%d", VOTER_ID);                                     \
+                                                                              \
+        result.term = TERM;                                                   \
+        result.vote_granted = GRANTED;                                        \
+        rv = raft_rpc__recv_pre_vote_result(&F->raft, VOTER_ID, address,      \
+                                            &result);                         \
+        munit_assert_int(rv, ==, 0);                                          \
+    }
+
 /**
  * Add a server to the configuration of the raft instance of the given fixture.
  */
@@ -124,6 +166,26 @@ static void tear_down(void *data)
         munit_assert_int(result->vote_granted, ==, GRANTED); \
     }
 
+/**
+ * Assert that the I/O queue has exactly one pending RAFT_IO_PRE_VOTE_RESULT
+ * request, with the given parameters.
+ */
+#define __assert_pre_vote_result(F, TERM, GRANTED)                      \
+    {                                                                   \
+        struct raft_message *messages;                                  \
+        struct raft_request_vote_result *result;                        \
+        unsigned n;                                                     \
+                                                                        \
+        raft_io_stub_flush(&F->io);                                     \
+        raft_io_stub_sent(&F->io, &messages, &n);                       \
+        munit_assert_int(n, ==, 1);                                     \
+        munit_assert_int(messages[0].type, ==, RAFT_IO_PRE_VOTE_RESULT); \
+                                                                        \
+        result = &messages[0].pre_vote_result;                          \
+        munit_assert_int(result->term, ==, TERM);                       \
+        munit_assert_int(result->vote_granted, ==, GRANTED);            \
+    }
+
 /**
  * Assert that the test I/O implementation has received exactly one
  * AppendEntries RPC with the given parameters and no entries.
@@ -204,6 +266,35 @@ static MunitResult test_req_has_leader(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+/* If the candidate was asked by the leader to start an election, the vote is
+ * granted even if we have a leader. */
+static MunitResult test_req_disrupt_leader(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+    struct raft_request_vote args;
+    int rv;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    test_receive_heartbeat(&f->raft, 2);
+
+    args.term = f->raft.current_term + 1;
+    args.candidate_id = 3;
+    args.last_log_index = 1;
+    args.last_log_term = 1;
+    args.disrupt_leader = true;
+
+    rv = raft_rpc__recv_request_vote(&f->raft, 3, "3", &args);
+    munit_assert_int(rv, ==, 0);
+
+    __assert_request_vote_result(f, 2, true);
+
+    return MUNIT_OK;
+}
+
 /* If we are not a voting server, the vote is not granted. */
 static MunitResult test_req_non_voting(const MunitParameter params[],
                                        void *data)
@@ -444,6 +535,7 @@ static MunitResult test_req_last_idx_lower_index(const MunitParameter params[],
 static MunitTest req_tests[] = {
     {"/higher-term", test_req_higher_term, setup, tear_down, 0, NULL},
     {"/has-leader", test_req_has_leader, setup, tear_down, 0, NULL},
+    {"/disrupt-leader", test_req_disrupt_leader, setup, tear_down, 0, NULL},
     {"/non-voting", test_req_non_voting, setup, tear_down, 0, NULL},
     {"/already-voted", test_req_already_voted, setup, tear_down, 0, NULL},
     {"/dupe-vote", test_req_dupe_vote, setup, tear_down, 0, NULL},
@@ -655,11 +747,242 @@ static MunitTest res_tests[] = {
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 
+/**
+ * raft_rpc__recv_pre_vote
+ */
+
+/* The pre-vote is granted for a higher term if our log is not more
+ * up-to-date, and our state is left untouched. */
+static MunitResult test_pre_req_granted(const MunitParameter params[],
+                                        void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __recv_pre_vote(f, 2, 2, 1, 1);
+
+    __assert_pre_vote_result(f, 2, true);
+
+    munit_assert_int(f->raft.current_term, ==, 1);
+    munit_assert_int(raft_io_stub_term(&f->io), ==, 1);
+    munit_assert_int(f->raft.voted_for, ==, 0);
+    munit_assert_int(raft_io_stub_vote(&f->io), ==, 0);
+
+    return MUNIT_OK;
+}
+
+/* If we have a leader, the pre-vote is not granted. */
+static MunitResult test_pre_req_has_leader(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    test_receive_heartbeat(&f->raft, 2);
+
+    __recv_pre_vote(f, 2, 3, 1, 1);
+
+    __assert_pre_vote_result(f, 1, false);
+
+    return MUNIT_OK;
+}
+
+/* If we haven't heard from the leader within the minimum election timeout,
+ * the pre-vote is granted even if we didn't time out yet. */
+static MunitResult test_pre_req_leader_silent(const MunitParameter params[],
+                                              void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+
+    test_receive_heartbeat(&f->raft, 2);
+
+    f->raft.election_timeout_rand = 2 * f->raft.election_timeout - 1;
+    raft_io_stub_advance(&f->io, f->raft.election_timeout);
+
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+    munit_assert_int(f->raft.follower_state.current_leader_id, ==, 2);
+
+    __recv_pre_vote(f, 2, 3, 1, 1);
+
+    __assert_pre_vote_result(f, 2, true);
+
+    return MUNIT_OK;
+}
+
+/* If the requested term is not higher than ours, the pre-vote is not
+ * granted. */
+static MunitResult test_pre_req_same_term(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __recv_pre_vote(f, 1, 2, 1, 1);
+
+    __assert_pre_vote_result(f, 1, false);
+
+    return MUNIT_OK;
+}
+
+/* If our log is more up-to-date, the pre-vote is not granted. */
+static MunitResult test_pre_req_log_behind(const MunitParameter params[],
+                                           void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __recv_pre_vote(f, 2, 2, 0, 0);
+
+    __assert_pre_vote_result(f, 1, false);
+
+    return MUNIT_OK;
+}
+
+static MunitTest pre_req_tests[] = {
+    {"/granted", test_pre_req_granted, setup, tear_down, 0, NULL},
+    {"/has-leader", test_pre_req_has_leader, setup, tear_down, 0, NULL},
+    {"/leader-silent", test_pre_req_leader_silent, setup, tear_down, 0,
+     NULL},
+    {"/same-term", test_pre_req_same_term, setup, tear_down, 0, NULL},
+    {"/log-behind", test_pre_req_log_behind, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * raft_rpc__recv_pre_vote_result
+ */
+
+/* Once a majority grants the pre-vote, the real election starts. */
+static MunitResult test_pre_res_quorum(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+
+    (void)params;
+
+    raft_set_pre_vote(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_candidate(&f->raft);
+
+    __recv_pre_vote_result(f, 2, 2, true);
+
+    __assert_state(f, RAFT_STATE_CANDIDATE);
+    munit_assert_false(f->raft.candidate_state.in_pre_vote);
+
+    /* The term has been incremented and the vote persisted. */
+    munit_assert_int(f->raft.current_term, ==, 2);
+    munit_assert_int(raft_io_stub_term(&f->io), ==, 2);
+    munit_assert_int(raft_io_stub_vote(&f->io), ==, 1);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(messages[0].type, ==, RAFT_IO_REQUEST_VOTE);
+    munit_assert_int(messages[0].request_vote.term, ==, 2);
+
+    return MUNIT_OK;
+}
+
+/* Results granting the pre-vote for a different term are ignored. */
+static MunitResult test_pre_res_stale(const MunitParameter params[],
+                                      void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    raft_set_pre_vote(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_candidate(&f->raft);
+
+    __recv_pre_vote_result(f, 2, 3, true);
+
+    munit_assert_true(f->raft.candidate_state.in_pre_vote);
+    munit_assert_int(f->raft.current_term, ==, 1);
+
+    return MUNIT_OK;
+}
+
+/* A rejection carrying a higher term makes us step down. */
+static MunitResult test_pre_res_step_down(const MunitParameter params[],
+                                          void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    raft_set_pre_vote(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_candidate(&f->raft);
+
+    __recv_pre_vote_result(f, 2, 3, false);
+
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+    munit_assert_int(f->raft.current_term, ==, 3);
+
+    return MUNIT_OK;
+}
+
+/* Pre-vote results are ignored once the real election has started, and so
+ * are vote results during the pre-vote phase. */
+static MunitResult test_pre_res_wrong_phase(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_become_candidate(&f->raft);
+
+    __recv_pre_vote_result(f, 2, 3, true);
+
+    __assert_state(f, RAFT_STATE_CANDIDATE);
+    munit_assert_int(f->raft.current_term, ==, 2);
+
+    f->raft.candidate_state.in_pre_vote = true;
+
+    __recv_request_vote_result(f, 2, 2, true);
+
+    __assert_state(f, RAFT_STATE_CANDIDATE);
+
+    return MUNIT_OK;
+}
+
+static MunitTest pre_res_tests[] = {
+    {"/quorum", test_pre_res_quorum, setup, tear_down, 0, NULL},
+    {"/stale", test_pre_res_stale, setup, tear_down, 0, NULL},
+    {"/step-down", test_pre_res_step_down, setup, tear_down, 0, NULL},
+    {"/wrong-phase", test_pre_res_wrong_phase, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
 /**
  * Suite
  */
 MunitSuite raft_rpc_request_vote_suites[] = {
     {"/req", req_tests, NULL, 1, 0},
     {"/res", res_tests, NULL, 1, 0},
+    {"/pre-req", pre_req_tests, NULL, 1, 0},
+    {"/pre-res", pre_res_tests, NULL, 1, 0},
     {NULL, NULL, NULL, 0, 0},
 };
@@ -0,0 +1,184 @@
+#include <stdio.h>
+
+#include "../../include/raft.h"
+
+#include "../../src/configuration.h"
+#include "../../src/log.h"
+#include "../../src/rpc_timeout_now.h"
+
+#include "../lib/fsm.h"
+#include "../lib/heap.h"
+#include "../lib/io.h"
+#include "../lib/logger.h"
+#include "../lib/munit.h"
+#include "../lib/raft.h"
+
+/**
+ * Helpers
+ */
+
+struct fixture
+{
+    TEST_RAFT_FIXTURE_FIELDS;
+};
+
+/**
+ * Setup and tear down
+ */
+
+static void *setup(const MunitParameter params[], void *user_data)
+{
+    struct fixture *f = munit_malloc(sizeof *f);
+
+    (void)user_data;
+
+    TEST_RAFT_FIXTURE_SETUP(f);
+
+    return f;
+}
+
+static void tear_down(void *data)
+{
+    struct fixture *f = data;
+
+    TEST_RAFT_FIXTURE_TEAR_DOWN(f);
+
+    free(f);
+}
+
+/**
+ * Call raft_rpc__recv_timeout_now with the given parameters and check that no
+ * error occurs.
+ */
+#define __recv_timeout_now(F, ID, TERM, LAST_LOG_INDEX, LAST_LOG_TERM)         \
+    {                                                                         \
+        struct raft_timeout_now args;                                         \
+        char address[4];                                                      \
+        int rv;                                                               \
+                                                                              \
+        sprintf(address, "%d", ID);                                           \
+                                                                              \
+        args.term = TERM;                                                     \
+        args.last_log_index = LAST_LOG_INDEX;                                 \
+        args.last_log_term = LAST_LOG_TERM;                                   \
+                                                                              \
+        rv = raft_rpc__recv_timeout_now(&F->raft, ID, address, &args);        \
+        munit_assert_int(rv, ==, 0);                                          \
+    }
+
+/**
+ * Assert the current state of the raft instance of the given fixture.
+ */
+#define __assert_state(F, STATE) munit_assert_int(F->raft.state, ==, STATE);
+
+/**
+ * raft_rpc__recv_timeout_now
+ */
+
+/* A follower whose log matches the leader's starts an election right away,
+ * asking the other servers to disregard the current leader. */
+static MunitResult test_req_election(const MunitParameter params[],
+                                     void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+    unsigned i;
+
+    (void)params;
+
+    raft_set_pre_vote(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_receive_heartbeat(&f->raft, 2);
+
+    __recv_timeout_now(f, 2, 1, 1, 1);
+
+    __assert_state(f, RAFT_STATE_CANDIDATE);
+
+    /* The pre-vote phase was skipped. */
+    munit_assert_false(f->raft.candidate_state.in_pre_vote);
+    munit_assert_int(f->raft.current_term, ==, 2);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 2);
+    for (i = 0; i < n; i++) {
+        munit_assert_int(messages[i].type, ==, RAFT_IO_REQUEST_VOTE);
+        munit_assert_true(messages[i].request_vote.disrupt_leader);
+    }
+
+    return MUNIT_OK;
+}
+
+/* A request from an older term is ignored. */
+static MunitResult test_req_stale_term(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_receive_heartbeat(&f->raft, 2);
+
+    f->raft.current_term = 2;
+
+    __recv_timeout_now(f, 2, 1, 1, 1);
+
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+
+    return MUNIT_OK;
+}
+
+/* If our log doesn't match the leader's one, the request is ignored. */
+static MunitResult test_req_log_mismatch(const MunitParameter params[],
+                                         void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+    test_receive_heartbeat(&f->raft, 2);
+
+    __recv_timeout_now(f, 2, 1, 2, 1);
+
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+
+    return MUNIT_OK;
+}
+
+/* Non-voting servers don't start elections. */
+static MunitResult test_req_non_voting(const MunitParameter params[],
+                                       void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    test_bootstrap_and_start(&f->raft, 2, 2, 2);
+
+    __recv_timeout_now(f, 2, 1, 1, 1);
+
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+
+    return MUNIT_OK;
+}
+
+static MunitTest req_tests[] = {
+    {"/election", test_req_election, setup, tear_down, 0, NULL},
+    {"/stale-term", test_req_stale_term, setup, tear_down, 0, NULL},
+    {"/log-mismatch", test_req_log_mismatch, setup, tear_down, 0, NULL},
+    {"/non-voting", test_req_non_voting, setup, tear_down, 0, NULL},
+    {NULL, NULL, NULL, NULL, 0, NULL},
+};
+
+/**
+ * Test suite
+ */
+
+MunitSuite raft_rpc_timeout_now_suites[] = {
+    {"/req", req_tests, NULL, 1, 0},
+    {NULL, NULL, NULL, 0, 0},
+};
@@ -168,6 +168,30 @@ static MunitResult test_self_elect(const MunitParameter params[], void *data)
     return MUNIT_OK;
 }
 
+/* Self-electing skips the pre-vote phase, and still bumps the term and
+ * persists the vote. */
+static MunitResult test_self_elect_pre_vote(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+
+    (void)params;
+
+    raft_set_pre_vote(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 1, 1, 1);
+
+    __tick(f, 100);
+    __assert_state(f, RAFT_STATE_LEADER);
+
+    munit_assert_int(f->raft.current_term, ==, 2);
+    munit_assert_int(raft_io_stub_term(&f->io), ==, 2);
+
+    munit_assert_int(f->raft.voted_for, ==, 1);
+    munit_assert_int(raft_io_stub_vote(&f->io), ==, 1);
+
+    return MUNIT_OK;
+}
+
 /* If there's only a single voting server, but it's not us, stay follower. */
 static MunitResult test_one_voter_not_us(const MunitParameter params[],
                                          void *data)
@@ -440,10 +464,127 @@ static MunitResult test_request_vote_only_to_voters(
     return MUNIT_OK;
 }
 
+/* With pre-vote enabled, the election timeout makes us candidate without
+ * changing our term or vote, and we send PreVote RPCs for the next term. */
+static MunitResult test_pre_vote(const MunitParameter params[], void *data)
+{
+    struct fixture *f = data;
+    struct raft_message *messages;
+    unsigned n;
+
+    (void)params;
+
+    raft_set_pre_vote(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 2, 1, 2);
+
+    __tick(f, f->raft.election_timeout_rand + 100);
+
+    __assert_state(f, RAFT_STATE_CANDIDATE);
+    munit_assert_true(f->raft.candidate_state.in_pre_vote);
+
+    /* Nothing has been persisted. */
+    munit_assert_int(f->raft.current_term, ==, 1);
+    munit_assert_int(raft_io_stub_term(&f->io), ==, 1);
+    munit_assert_int(f->raft.voted_for, ==, 0);
+    munit_assert_int(raft_io_stub_vote(&f->io), ==, 0);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(messages[0].type, ==, RAFT_IO_PRE_VOTE);
+    munit_assert_int(messages[0].pre_vote.term, ==, 2);
+
+    /* When the election timeout expires again, a new pre-vote round is
+     * started. */
+    __tick(f, f->raft.election_timeout_rand + 100);
+
+    munit_assert_true(f->raft.candidate_state.in_pre_vote);
+    munit_assert_int(f->raft.current_term, ==, 1);
+
+    raft_io_stub_flush(&f->io);
+    raft_io_stub_sent(&f->io, &messages, &n);
+
+    munit_assert_int(n, ==, 1);
+    munit_assert_int(messages[0].type, ==, RAFT_IO_PRE_VOTE);
+
+    return MUNIT_OK;
+}
+
+/* With check quorum enabled, a leader that doesn't hear from a majority of
+ * the cluster within an election timeout steps down. */
+static MunitResult test_check_quorum_step_down(const MunitParameter params[],
+                                               void *data)
+{
+    struct fixture *f = data;
+    raft_term term;
+
+    (void)params;
+
+    raft_set_check_quorum(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    term = f->raft.current_term;
+
+    __tick(f, f->raft.election_timeout - 1);
+    raft_io_stub_flush(&f->io);
+    __assert_state(f, RAFT_STATE_LEADER);
+
+    __tick(f, 1);
+    raft_io_stub_flush(&f->io);
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+
+    /* The term is unchanged and no leader is known. */
+    munit_assert_int(f->raft.current_term, ==, term);
+    munit_assert_int(f->raft.follower_state.current_leader_id, ==, 0);
+
+    return MUNIT_OK;
+}
+
+/* Hearing from a majority of the cluster keeps the leader in charge. */
+static MunitResult test_check_quorum_contact(const MunitParameter params[],
+                                            void *data)
+{
+    struct fixture *f = data;
+    struct raft_message message;
+
+    (void)params;
+
+    raft_set_check_quorum(&f->raft, true);
+    test_bootstrap_and_start(&f->raft, 3, 1, 3);
+    test_become_leader(&f->raft);
+
+    __tick(f, f->raft.election_timeout - 1);
+    raft_io_stub_flush(&f->io);
+
+    message.type = RAFT_IO_APPEND_ENTRIES_RESULT;
+    message.server_id = 2;
+    message.server_address = "2";
+    message.append_entries_result.term = f->raft.current_term;
+    message.append_entries_result.success = true;
+    message.append_entries_result.last_log_index = 1;
+
+    raft_io_stub_dispatch(&f->io, &message);
+
+    __tick(f, f->raft.election_timeout - 1);
+    raft_io_stub_flush(&f->io);
+    __assert_state(f, RAFT_STATE_LEADER);
+
+    /* Without further contact we eventually step down. */
+    __tick(f, 1);
+    raft_io_stub_flush(&f->io);
+    __assert_state(f, RAFT_STATE_FOLLOWER);
+
+    return MUNIT_OK;
+}
+
 static MunitTest tick_tests[] = {
     {"/unavailable", test_unavailable, setup, tear_down, 0, NULL},
     {"/updates-timers", test_updates_timers, setup, tear_down, 0, NULL},
     {"/self-elect", test_self_elect, setup, tear_down, 0, NULL},
+    {"/self-elect-pre-vote", test_self_elect_pre_vote, setup, tear_down, 0,
+     NULL},
     {"/one-voter-not-us", test_one_voter_not_us, setup, tear_down, 0, NULL},
     {"/candidate-oom", test_candidate_oom, setup, tear_down, 0, NULL},
     {"/candidate-io-err", test_candidate_io_err, setup, tear_down, 0, NULL},
@@ -459,6 +600,11 @@ static MunitTest tick_tests[] = {
     {"/during-election", test_during_election, setup, tear_down, 0, NULL},
     {"/request-vote-only-to-voters", test_request_vote_only_to_voters, setup,
      tear_down, 0, NULL},
+    {"/pre-vote", test_pre_vote, setup, tear_down, 0, NULL},
+    {"/check-quorum-step-down", test_check_quorum_step_down, setup, tear_down,
+     0, NULL},
+    {"/check-quorum-contact", test_check_quorum_contact, setup, tear_down, 0,
+     NULL},
     {NULL, NULL, NULL, NULL, 0, NULL},
 };
 